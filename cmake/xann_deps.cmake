@@ -27,6 +27,7 @@ endif ()
 
 if (KMCMAKE_BUILD_TEST)
     enable_testing()
+    find_package(GTest REQUIRED)
     #include(require_gtest)
     #include(require_gmock)
     #include(require_doctest)
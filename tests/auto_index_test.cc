@@ -0,0 +1,118 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <gtest/gtest.h>
+#include <xann/index/auto_index.h>
+#include <xann/index/flat_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 8;
+
+    /// flat costs n, hnsw a flat 1000, so hnsw is cheaper past n = 1000 and
+    /// wins by migrate_gain = 1.5 only past n = 1500 (and flat below 667).
+    static AutoIndexOption two_candidates() {
+        AutoIndexOption option;
+        AutoIndexCandidate flat;
+        flat.name = "flat";
+        flat.factory = []() { return std::make_unique<FlatIndex>(); };
+        flat.query_cost = [](uint64_t n, const IndexCostModel &) { return static_cast<double>(n); };
+        AutoIndexCandidate hnsw;
+        hnsw.name = "hnsw";
+        hnsw.factory = []() { return std::make_unique<HnswIndex>(); };
+        hnsw.query_cost = [](uint64_t, const IndexCostModel &) { return 1000.0; };
+        option.candidates = {flat, hnsw};
+        option.migrate_gain = 1.5;
+        option.recheck_ratio = 0.25;
+        return option;
+    }
+
+    static void add_range(MemStore *store, AutoIndex *index, const std::vector<float> &data, uint64_t from,
+                          uint64_t to) {
+        for (auto label = from; label < to; ++label) {
+            auto rs = store->add_vector(0, label, test::as_bytes(data.data() + label * kDim, kDim));
+            ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+            ASSERT_TRUE(index->add(rs.value_or_die()).ok());
+        }
+    }
+
+    /// rechecks land at 625, 782, 978, 1223 and 1529 vectors. at 1223 hnsw
+    /// is cheaper by 1.22 only and flat stays, at 1529 the gain passes 1.5
+    /// and the index migrates, dropping the tuning of the old index.
+    TEST(AutoIndex, migrates_past_gain_and_resets_tuning) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * 2000, 1);
+        VectorStoreOption store_option;
+        store_option.max_elements = 4000;
+        auto store = MemStore::create(&vs, store_option).value_or_die();
+        AutoIndex index(two_candidates());
+        for (uint64_t label = 0; label < 500; ++label) {
+            ASSERT_TRUE(store->add_vector(0, label, test::as_bytes(data.data() + label * kDim, kDim)).ok());
+        }
+        ASSERT_TRUE(index.build(store.get()).ok());
+        EXPECT_EQ(index.current_name(), "flat");
+
+        SearchTuning tuning;
+        tuning.knob = SearchKnob::kEf;
+        tuning.value = 80;
+        index.set_tuning(tuning);
+
+        add_range(store.get(), &index, data, 500, 1400);
+        EXPECT_EQ(index.current_name(), "flat") << "hnsw is cheaper but not by migrate_gain";
+        EXPECT_TRUE(index.tuning().valid());
+        EXPECT_EQ(index.tuning().value, 80u);
+
+        add_range(store.get(), &index, data, 1400, 1600);
+        EXPECT_EQ(index.current_name(), "hnsw");
+        EXPECT_EQ(index.search_knob(), SearchKnob::kEf);
+        EXPECT_FALSE(index.tuning().valid());
+        EXPECT_EQ(index.size(), 1600u);
+
+        SearchOption option;
+        option.k = 10;
+        option.ef = 64;
+        auto queries = test::random_floats(kDim * 20, 2);
+        EXPECT_GE(test::mean_recall(index, store.get(), queries, 20, option), 0.9);
+    }
+
+    /// shrinking hands the store back to flat once flat wins by the gain,
+    /// not as soon as it is cheaper.
+    TEST(AutoIndex, migrates_back_when_shrinking) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * 1600, 3);
+        auto store = test::make_store(&vs, data, 1600);
+        AutoIndex index(two_candidates());
+        ASSERT_TRUE(index.build(store.get()).ok());
+        ASSERT_EQ(index.current_name(), "hnsw");
+
+        auto remove_to = [&](uint64_t size) {
+            for (uint64_t label = store->size() - 1; store->size() > size; --label) {
+                auto lid = store->get_id(label).value_or_die();
+                store->tombstone_vector_by_label(0, label);
+                ASSERT_TRUE(index.remove(lid).ok());
+                store->remove_vector_by_label(0, label);
+            }
+        };
+        /// rechecks land at 1200, 900, 675 and 506 vectors. flat is cheaper
+        /// from 900 on but wins by the gain only at 506.
+        remove_to(700);
+        EXPECT_EQ(index.current_name(), "hnsw");
+        remove_to(450);
+        EXPECT_EQ(index.current_name(), "flat");
+        EXPECT_EQ(index.size(), store->size());
+    }
+} // namespace xann
@@ -0,0 +1,176 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <gtest/gtest.h>
+#include <xann/index/cached_index.h>
+#include <xann/index/hnsw_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 16;
+    static constexpr size_t kCount = 500;
+
+    static std::vector<SearchHit> search_one(const VectorIndex &index, const float *q, uint32_t k = 10) {
+        SearchOption option;
+        option.k = k;
+        option.ef = 64;
+        auto rs = index.search(test::as_bytes(q, kDim), option);
+        EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+        return rs.ok() ? rs.value_or_die() : std::vector<SearchHit>{};
+    }
+
+    /// add a vector the way the collections do, label = snapshot id = next label.
+    static uint64_t add_one(MemStore *store, VectorIndex *index, uint64_t label, const float *v) {
+        auto rs = store->add_vector(label, label, test::as_bytes(v, kDim));
+        EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+        auto lid = rs.value_or_die();
+        EXPECT_TRUE(index->add(lid).ok());
+        return lid;
+    }
+
+    /// a mutation far from the cached hits keeps the entry, one that would
+    /// enter the top-k or removes a hit drops it.
+    TEST(CachedIndex, journal_invalidates_only_affected_entries) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 1);
+        auto store = test::make_store(&vs, data, kCount);
+        CachedIndex index(std::make_unique<FlatIndex>());
+        ASSERT_TRUE(index.build(store.get()).ok());
+
+        auto q = test::random_floats(kDim, 2);
+        auto first = search_one(index, q.data());
+        search_one(index, q.data());
+        EXPECT_EQ(index.stats().hits, 1u);
+
+        auto far = test::random_floats(kDim, 3, 50.0f, 60.0f);
+        add_one(store.get(), &index, kCount, far.data());
+        auto kept = search_one(index, q.data());
+        EXPECT_EQ(index.stats().hits, 2u);
+        EXPECT_EQ(index.stats().invalidations, 0u);
+        ASSERT_EQ(kept.size(), first.size());
+        EXPECT_EQ(kept[0].label, first[0].label);
+
+        add_one(store.get(), &index, kCount + 1, q.data());
+        auto fresh = search_one(index, q.data());
+        EXPECT_EQ(index.stats().invalidations, 1u);
+        ASSERT_FALSE(fresh.empty());
+        EXPECT_EQ(fresh[0].label, kCount + 1);
+
+        search_one(index, q.data());
+        auto lid = store->get_id(kCount + 1).value_or_die();
+        store->tombstone_vector_by_label(kCount + 2, kCount + 1);
+        ASSERT_TRUE(index.remove(lid).ok());
+        auto after = search_one(index, q.data());
+        EXPECT_EQ(index.stats().invalidations, 2u);
+        ASSERT_FALSE(after.empty());
+        EXPECT_EQ(after[0].label, first[0].label);
+    }
+
+    /// entries older than the journal can not be checked and are dropped.
+    TEST(CachedIndex, entry_older_than_journal_is_dropped) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 4);
+        auto store = test::make_store(&vs, data, kCount);
+        ResultCacheOption option;
+        option.max_journal = 2;
+        CachedIndex index(std::make_unique<FlatIndex>(), option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+        auto q = test::random_floats(kDim, 5);
+        search_one(index, q.data());
+        for (uint64_t i = 0; i < 3; ++i) {
+            auto far = test::random_floats(kDim, 10 + i, 50.0f, 60.0f);
+            add_one(store.get(), &index, kCount + i, far.data());
+        }
+        search_one(index, q.data());
+        EXPECT_EQ(index.stats().hits, 0u);
+        EXPECT_EQ(index.stats().invalidations, 1u);
+    }
+
+    /// kApproximate serves entries within max_staleness snapshot ids unchecked.
+    TEST(CachedIndex, approximate_mode_serves_stale_entries) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 6);
+        auto store = test::make_store(&vs, data, kCount);
+        ResultCacheOption option;
+        option.mode = ResultCacheMode::kApproximate;
+        option.max_staleness = kCount + 1;
+        CachedIndex index(std::make_unique<FlatIndex>(), option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+        auto q = test::random_floats(kDim, 7);
+        auto first = search_one(index, q.data());
+        add_one(store.get(), &index, kCount, q.data());
+        auto stale = search_one(index, q.data());
+        EXPECT_EQ(index.stats().stale_hits, 1u);
+        ASSERT_FALSE(stale.empty());
+        EXPECT_EQ(stale[0].label, first[0].label);
+
+        /// past max_staleness the entry is validated again and dropped.
+        add_one(store.get(), &index, kCount + 2, data.data());
+        auto fresh = search_one(index, q.data());
+        EXPECT_EQ(index.stats().invalidations, 1u);
+        ASSERT_FALSE(fresh.empty());
+        EXPECT_EQ(fresh[0].label, kCount);
+    }
+
+    /// a one-off query does not displace a hot one from a full cache.
+    TEST(CachedIndex, tiny_lfu_rejects_colder_query) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 8);
+        auto store = test::make_store(&vs, data, kCount);
+        ResultCacheOption option;
+        option.max_entries = 1;
+        option.tiny_lfu = true;
+        CachedIndex index(std::make_unique<FlatIndex>(), option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+        auto hot = test::random_floats(kDim, 9);
+        auto cold = test::random_floats(kDim, 10);
+        for (int i = 0; i < 3; ++i) {
+            search_one(index, hot.data());
+        }
+        search_one(index, cold.data());
+        EXPECT_EQ(index.stats().rejections, 1u);
+        EXPECT_EQ(index.cached_entries(), 1u);
+        search_one(index, hot.data());
+        EXPECT_EQ(index.stats().hits, 3u);
+    }
+
+    /// hnsw behind the cache keeps its concurrent inserts, and a query cached
+    /// before an insert sees the inserted vector afterwards.
+    TEST(CachedIndex, forwards_concurrent_add) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount * 2, 11);
+        auto store = test::make_store(&vs, data, kCount);
+        CachedIndex index(std::make_unique<HnswIndex>());
+        ASSERT_TRUE(index.build(store.get()).ok());
+        EXPECT_TRUE(index.concurrent_add());
+
+        std::vector<std::vector<SearchHit> > before;
+        for (size_t i = kCount; i < kCount + 20; ++i) {
+            before.push_back(search_one(index, data.data() + i * kDim, 1));
+        }
+        SearchOption option;
+        option.k = 10;
+        option.ef = 64;
+        test::concurrent_add_and_search(store.get(), &index, data, kCount, kCount * 2, 4, 2, option);
+        EXPECT_EQ(index.size(), kCount * 2);
+        for (size_t i = kCount; i < kCount + 20; ++i) {
+            auto hits = search_one(index, data.data() + i * kDim, 1);
+            ASSERT_EQ(hits.size(), 1u);
+            EXPECT_EQ(hits[0].label, i);
+        }
+    }
+} // namespace xann
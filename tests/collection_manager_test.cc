@@ -0,0 +1,141 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <fstream>
+#include <gtest/gtest.h>
+#include <xann/collection/collection_manager.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 16;
+    static constexpr uint32_t kBatch = 16;
+
+    static CollectionManagerOption manager_option() {
+        CollectionManagerOption option;
+        option.spill_dir = ::testing::TempDir();
+        option.store_option.batch_size = kBatch;
+        option.store_option.max_elements = 64;
+        return option;
+    }
+
+    static void add_range(CollectionManager &m, const std::string &name, const std::vector<float> &data, size_t from,
+                          size_t to) {
+        for (auto i = from; i < to; ++i) {
+            auto rs = m.add_vector(name, i, test::as_bytes(data.data() + i * kDim, kDim));
+            ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+        }
+    }
+
+    /// the label of the nearest vector to data[label], expected to be label itself.
+    static uint64_t nearest(CollectionManager &m, const std::string &name, const std::vector<float> &data,
+                            uint64_t label) {
+        SearchOption option;
+        option.k = 1;
+        auto rs = m.search(name, test::as_bytes(data.data() + label * kDim, kDim), option);
+        EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+        if (!rs.ok() || rs.value_or_die().empty()) {
+            return IdManager::kInvalidId;
+        }
+        return rs.value_or_die()[0].label;
+    }
+
+    /// id pools are charged, adds inside an open batch evict nothing, the add
+    /// opening a batch spills the cold collection and a reload spills the other.
+    TEST(CollectionManager, budget_charges_only_new_batches) {
+        auto batch = static_cast<uint64_t>(test::make_space(kDim, kL2).vector_byte_size) * kBatch;
+        CollectionManager m(manager_option());
+        ASSERT_TRUE(m.create_collection("budget_a", 1, kDim, kL2, DataType::DT_FLOAT).ok());
+        ASSERT_TRUE(m.create_collection("budget_b", 1, kDim, kL2, DataType::DT_FLOAT).ok());
+        auto pools = m.tenant_bytes(1);
+        ASSERT_GT(pools, 0u);
+        m.set_tenant_budget(1, pools + 2 * batch);
+
+        auto data = test::random_floats(kDim * 64, 1);
+        add_range(m, "budget_a", data, 0, kBatch);
+        add_range(m, "budget_b", data, 0, kBatch);
+        EXPECT_TRUE(m.is_resident("budget_a"));
+        EXPECT_TRUE(m.is_resident("budget_b"));
+        EXPECT_EQ(m.tenant_bytes(1), pools + 2 * batch);
+
+        add_range(m, "budget_a", data, kBatch, kBatch + 1);
+        EXPECT_TRUE(m.is_resident("budget_a"));
+        EXPECT_FALSE(m.is_resident("budget_b"));
+        EXPECT_EQ(m.tenant_bytes(1), pools / 2 + 2 * batch);
+
+        EXPECT_EQ(nearest(m, "budget_b", data, 3), 3u);
+        EXPECT_TRUE(m.is_resident("budget_b"));
+        EXPECT_FALSE(m.is_resident("budget_a"));
+        EXPECT_EQ(nearest(m, "budget_a", data, kBatch), kBatch);
+        EXPECT_LE(m.tenant_bytes(1), pools + 2 * batch);
+
+        ASSERT_TRUE(m.drop_collection("budget_a").ok());
+        ASSERT_TRUE(m.drop_collection("budget_b").ok());
+        EXPECT_EQ(m.tenant_bytes(1), 0u);
+    }
+
+    /// removes survive a spill, the reloaded collection serves the rest and
+    /// dropping it deletes the spill file.
+    TEST(CollectionManager, spill_and_reload) {
+        auto option = manager_option();
+        CollectionManager m(option);
+        ASSERT_TRUE(m.create_collection("spill_x", 2, kDim, kL2, DataType::DT_FLOAT).ok());
+        auto data = test::random_floats(kDim * 40, 2);
+        add_range(m, "spill_x", data, 0, 40);
+        for (uint64_t label = 0; label < 40; label += 8) {
+            ASSERT_TRUE(m.remove_vector("spill_x", label).ok());
+        }
+        ASSERT_TRUE(m.evict("spill_x").ok());
+        EXPECT_FALSE(m.is_resident("spill_x"));
+        EXPECT_EQ(m.tenant_bytes(2), 0u);
+        auto path = option.spill_dir + "/spill_x.xstore";
+        EXPECT_TRUE(std::ifstream(path).good());
+
+        for (uint64_t label = 0; label < 40; ++label) {
+            auto got = nearest(m, "spill_x", data, label);
+            if (label % 8 == 0) {
+                EXPECT_NE(got, label);
+            } else {
+                EXPECT_EQ(got, label);
+            }
+        }
+        EXPECT_TRUE(m.is_resident("spill_x"));
+        EXPECT_FALSE(m.add_vector("spill_x", 1, test::as_bytes(data.data(), kDim)).ok());
+        ASSERT_TRUE(m.drop_collection("spill_x").ok());
+        EXPECT_FALSE(std::ifstream(path).good());
+    }
+
+    /// evict_cold takes the least recently used collections of the tenant first.
+    TEST(CollectionManager, evict_cold_takes_least_recent) {
+        CollectionManager m(manager_option());
+        auto data = test::random_floats(kDim * 4, 3);
+        for (auto name: {"cold_0", "cold_1", "cold_2"}) {
+            ASSERT_TRUE(m.create_collection(name, 3, kDim, kL2, DataType::DT_FLOAT).ok());
+            add_range(m, name, data, 0, 4);
+        }
+        ASSERT_TRUE(m.create_collection("cold_other", 4, kDim, kL2, DataType::DT_FLOAT).ok());
+        nearest(m, "cold_0", data, 0);
+        auto freed = m.evict_cold(1, 3);
+        EXPECT_GT(freed, 0u);
+        EXPECT_TRUE(m.is_resident("cold_0"));
+        EXPECT_FALSE(m.is_resident("cold_1"));
+        EXPECT_TRUE(m.is_resident("cold_2"));
+        EXPECT_TRUE(m.is_resident("cold_other"));
+        for (auto name: {"cold_0", "cold_1", "cold_2", "cold_other"}) {
+            ASSERT_TRUE(m.drop_collection(name).ok());
+        }
+    }
+} // namespace xann
@@ -0,0 +1,366 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+#include <vector>
+#include <gtest/gtest.h>
+#include <xann/core/dtype_convert.h>
+#include <xann/core/kernel_calibration.h>
+#include <xann/core/operator_registry.h>
+#include <xann/core/query_vector.h>
+#include <xann/core/vector_space.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static const int kDims[] = {1, 7, 16, 33, 100, 130};
+
+    /// a zero padded slot of vs holding values, the layout the kernels get from the store.
+    static AlignedBytes make_slot(const VectorSpace &vs, const std::vector<float> &values) {
+        AlignedBytes slot(static_cast<size_t>(vs.vector_byte_size), 0);
+        std::memcpy(slot.data(), values.data(), values.size() * sizeof(float));
+        return slot;
+    }
+
+    static turbo::span<uint8_t> as_span(AlignedBytes &slot) {
+        return turbo::span<uint8_t>(slot.data(), slot.size());
+    }
+
+    /// every level the host runs that has a kernel for (metric, dt).
+    static std::vector<OperatorEntity> operators(MetricType metric, DataType dt) {
+        std::vector<OperatorEntity> out;
+        for (int l = static_cast<int>(SimdLevel::SIMD_NONE); l < static_cast<int>(SimdLevel::SIMD_MAX); ++l) {
+            auto level = static_cast<SimdLevel>(l);
+            if (!simd_level_supported(level)) {
+                continue;
+            }
+            auto rs = MetricRegistry::instance().get_metric_operator(metric, dt, level);
+            if (rs.ok() && rs.value_or_die().supports) {
+                out.push_back(rs.value_or_die());
+            }
+        }
+        return out;
+    }
+
+    static float tolerance(double reference) {
+        return static_cast<float>(1e-4 * std::abs(reference) + 1e-4);
+    }
+
+    static double reference_distance(MetricType metric, const std::vector<float> &a, const std::vector<float> &b) {
+        double sum = 0.0;
+        double na = 0.0;
+        double nb = 0.0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            double x = a[i];
+            double y = b[i];
+            switch (metric) {
+                case kL1:
+                    sum += std::abs(x - y);
+                    break;
+                case kL2:
+                    sum += (x - y) * (x - y);
+                    break;
+                default:
+                    sum += x * y;
+                    na += x * x;
+                    nb += y * y;
+                    break;
+            }
+        }
+        if (metric == kL2) {
+            return std::sqrt(sum);
+        }
+        if (metric == kCosine) {
+            return na == 0.0 || nb == 0.0 ? 0.0 : sum / std::sqrt(na * nb);
+        }
+        return sum;
+    }
+
+    /// distance_vector against a double reference, and rank taken back
+    /// through rank_to_distance equal to distance_vector.
+    TEST(DistanceKernel, rank_round_trips_to_reference_distance) {
+        for (auto metric: {kL1, kL2, kIP, kCosine}) {
+            for (auto dim: kDims) {
+                auto vs = test::make_space(dim, metric);
+                auto a = test::random_floats(dim, 11 + dim);
+                auto b = test::random_floats(dim, 23 + dim);
+                auto sa = make_slot(vs, a);
+                auto sb = make_slot(vs, b);
+                auto expect = reference_distance(metric, a, b);
+                for (auto &op: operators(metric, DataType::DT_FLOAT)) {
+                    auto distance = op.distance_vector(as_span(sa), as_span(sb));
+                    EXPECT_NEAR(distance, expect, tolerance(expect))
+                                        << "metric " << metric << " dim " << dim << " level "
+                                        << static_cast<int>(op.simd_level);
+                    float rank = op.rank(as_span(sa), as_span(sb));
+                    op.to_distance(&rank, 1);
+                    EXPECT_NEAR(rank, distance, tolerance(distance))
+                                        << "metric " << metric << " dim " << dim << " level "
+                                        << static_cast<int>(op.simd_level);
+                }
+            }
+        }
+    }
+
+    /// the batch conversion over a whole top-k equals converting one by one,
+    /// and ranks order pairs like the distances do.
+    TEST(DistanceKernel, batch_rank_to_distance) {
+        constexpr size_t kPairs = 37;
+        for (auto metric: {kL2, kIP, kCosine, kAngle}) {
+            auto vs = test::make_space(33, metric);
+            auto query = make_slot(vs, test::random_floats(33, 5));
+            std::vector<AlignedBytes> slots;
+            for (size_t i = 0; i < kPairs; ++i) {
+                slots.push_back(make_slot(vs, test::random_floats(33, 100 + i)));
+            }
+            for (auto &op: operators(metric, DataType::DT_FLOAT)) {
+                std::vector<float> ranks(kPairs);
+                std::vector<float> distances(kPairs);
+                for (size_t i = 0; i < kPairs; ++i) {
+                    ranks[i] = op.rank(as_span(query), as_span(slots[i]));
+                    distances[i] = op.distance_vector(as_span(query), as_span(slots[i]));
+                }
+                auto converted = ranks;
+                op.to_distance(converted.data(), converted.size());
+                for (size_t i = 0; i < kPairs; ++i) {
+                    float one = ranks[i];
+                    op.to_distance(&one, 1);
+                    EXPECT_EQ(converted[i], one);
+                    EXPECT_NEAR(converted[i], distances[i], tolerance(distances[i])) << "metric " << metric;
+                    for (size_t j = 0; j < kPairs; ++j) {
+                        if (ranks[i] < ranks[j]) {
+                            auto closer = metric_rank_score(metric, distances[i]);
+                            auto farther = metric_rank_score(metric, distances[j]);
+                            EXPECT_LE(closer, farther + tolerance(farther)) << "metric " << metric;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /// an unreachable bound gives the full rank, a bound below it stops at
+    /// or above the bound, and every level agrees with SIMD_NONE.
+    TEST(DistanceKernel, bounded_rank_abandons_past_bound) {
+        for (auto metric: {kL1, kL2}) {
+            for (auto dim: kDims) {
+                auto vs = test::make_space(dim, metric);
+                auto sa = make_slot(vs, test::random_floats(dim, 31 + dim));
+                auto sb = make_slot(vs, test::random_floats(dim, 47 + dim));
+                auto ops = operators(metric, DataType::DT_FLOAT);
+                ASSERT_FALSE(ops.empty());
+                auto scalar = ops.front().rank(as_span(sa), as_span(sb));
+                for (auto &op: ops) {
+                    ASSERT_NE(op.bounded_rank_vector, nullptr) << "metric " << metric;
+                    auto rank = op.rank(as_span(sa), as_span(sb));
+                    EXPECT_NEAR(rank, scalar, tolerance(scalar)) << "metric " << metric << " dim " << dim;
+                    auto full = op.bounded_rank(as_span(sa), as_span(sb), std::numeric_limits<float>::max());
+                    EXPECT_NEAR(full, rank, tolerance(rank)) << "metric " << metric << " dim " << dim;
+                    auto loose = op.bounded_rank(as_span(sa), as_span(sb), rank * 2.0f + 1.0f);
+                    EXPECT_NEAR(loose, rank, tolerance(rank)) << "metric " << metric << " dim " << dim;
+                    auto bound = rank * 0.5f;
+                    EXPECT_GE(op.bounded_rank(as_span(sa), as_span(sb), bound), bound)
+                                        << "metric " << metric << " dim " << dim;
+                }
+            }
+        }
+    }
+
+    /// n positive floats summing to 1.
+    static std::vector<float> random_distribution(size_t n, uint64_t seed) {
+        auto out = test::random_floats(n, seed, 0.01f, 1.0f);
+        double sum = 0.0;
+        for (auto v: out) {
+            sum += v;
+        }
+        for (auto &v: out) {
+            v = static_cast<float>(v / sum);
+        }
+        return out;
+    }
+
+    static double reference_kl(const std::vector<float> &a, const std::vector<float> &b) {
+        double d = 0.0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            d += a[i] > 0.0f ? a[i] * std::log(static_cast<double>(a[i]) / b[i]) : 0.0;
+        }
+        return d;
+    }
+
+    TEST(DistanceKernel, chebyshev_and_divergences_match_reference) {
+        for (auto dim: kDims) {
+            auto a = random_distribution(dim, 61 + dim);
+            auto b = random_distribution(dim, 67 + dim);
+            std::vector<float> m(dim);
+            double chebyshev = 0.0;
+            for (int i = 0; i < dim; ++i) {
+                m[i] = 0.5f * (a[i] + b[i]);
+                chebyshev = std::max(chebyshev, std::abs(static_cast<double>(a[i]) - b[i]));
+            }
+            std::vector<std::pair<MetricType, double> > expects = {
+                {kChebyshev, chebyshev},
+                {kKLDivergence, reference_kl(a, b)},
+                {kJensenShannon, 0.5 * (reference_kl(a, m) + reference_kl(b, m))},
+            };
+            for (auto &[metric, expect]: expects) {
+                auto vs = test::make_space(dim, metric);
+                auto sa = make_slot(vs, a);
+                auto sb = make_slot(vs, b);
+                auto ops = operators(metric, DataType::DT_FLOAT);
+                ASSERT_FALSE(ops.empty()) << "metric " << metric;
+                for (auto &op: ops) {
+                    auto distance = op.distance_vector(as_span(sa), as_span(sb));
+                    EXPECT_NEAR(distance, expect, tolerance(expect))
+                                        << "metric " << metric << " dim " << dim << " level "
+                                        << static_cast<int>(op.simd_level);
+                    float rank = op.rank(as_span(sa), as_span(sb));
+                    op.to_distance(&rank, 1);
+                    EXPECT_NEAR(rank, distance, tolerance(distance)) << "metric " << metric << " dim " << dim;
+                    if (metric == kChebyshev) {
+                        auto bound = distance * 0.5f;
+                        EXPECT_GE(op.bounded_rank(as_span(sa), as_span(sb), bound), bound);
+                    }
+                }
+            }
+        }
+    }
+
+    /// the transformed metrics run the l2 kernel on prepared vectors.
+    TEST(DistanceKernel, weighted_l2_and_mahalanobis_match_reference) {
+        for (auto dim: {7, 33}) {
+            auto a = test::random_floats(dim, 71);
+            auto b = test::random_floats(dim, 73);
+            auto weights = test::random_floats(dim, 79, 0.0f, 4.0f);
+            auto weighted = test::make_space(dim, kWeightedL2);
+            ASSERT_TRUE(weighted.set_weights(weights).ok());
+            double sum = 0.0;
+            for (int i = 0; i < dim; ++i) {
+                sum += weights[i] * (static_cast<double>(a[i]) - b[i]) * (static_cast<double>(a[i]) - b[i]);
+            }
+            auto sa = make_slot(weighted, a);
+            auto sb = make_slot(weighted, b);
+            weighted.prepare_vector(as_span(sa));
+            weighted.prepare_vector(as_span(sb));
+            auto expect = std::sqrt(sum);
+            EXPECT_NEAR(weighted.operation.distance_vector(as_span(sa), as_span(sb)), expect, tolerance(expect));
+
+            auto matrix = test::random_floats(static_cast<size_t>(dim) * dim, 83);
+            auto whitened = test::make_space(dim, kMahalanobis);
+            ASSERT_TRUE(whitened.set_whitening(matrix).ok());
+            sum = 0.0;
+            for (int r = 0; r < dim; ++r) {
+                double diff = 0.0;
+                for (int c = 0; c < dim; ++c) {
+                    diff += matrix[r * dim + c] * (static_cast<double>(a[c]) - b[c]);
+                }
+                sum += diff * diff;
+            }
+            auto wa = make_slot(whitened, a);
+            auto wb = make_slot(whitened, b);
+            whitened.prepare_vector(as_span(wa));
+            whitened.prepare_vector(as_span(wb));
+            expect = std::sqrt(sum);
+            EXPECT_NEAR(whitened.operation.distance_vector(as_span(wa), as_span(wb)), expect, tolerance(expect));
+        }
+    }
+
+    /// float queries against fp16, bf16 and uint8 storage: the mixed kernels
+    /// score the widened stored values, at every level the host runs.
+    TEST(DistanceKernel, mixed_kernels_match_widened_reference) {
+        for (auto dt: {DataType::DT_FLOAT16, DataType::DT_BFLOAT16, DataType::DT_UINT8}) {
+            for (auto metric: {kL2, kIP}) {
+                for (auto dim: kDims) {
+                    auto vs = test::make_space(dim, metric, dt);
+                    auto a = test::random_floats(dim, 89 + dim, 0.0f, 200.0f);
+                    auto b = test::random_floats(dim, 97 + dim, 0.0f, 200.0f);
+                    AlignedBytes query(static_cast<size_t>(vs.alignment_dim) * sizeof(float), 0);
+                    std::memcpy(query.data(), a.data(), a.size() * sizeof(float));
+                    AlignedBytes stored(static_cast<size_t>(vs.vector_byte_size), 0);
+                    ASSERT_TRUE(narrow_floats(b.data(), b.size(), dt, stored.data()).ok());
+                    std::vector<float> widened(dim);
+                    ASSERT_TRUE(widen_to_floats(stored.data(), widened.size(), dt, widened.data()).ok());
+                    auto expect = reference_distance(metric, a, widened);
+                    for (int l = static_cast<int>(SimdLevel::SIMD_NONE); l < static_cast<int>(SimdLevel::SIMD_MAX);
+                         ++l) {
+                        auto level = static_cast<SimdLevel>(l);
+                        auto rs = MetricRegistry::instance().get_mixed_operator(metric, DataType::DT_FLOAT, dt, level);
+                        if (!simd_level_supported(level) || !rs.ok()) {
+                            continue;
+                        }
+                        auto op = rs.value_or_die();
+                        auto distance = op.distance_vector(as_span(query), as_span(stored));
+                        EXPECT_NEAR(distance, expect, tolerance(expect))
+                                            << "dt " << static_cast<int>(dt) << " metric " << metric << " dim " << dim
+                                            << " level " << l;
+                        float rank = op.rank(as_span(query), as_span(stored));
+                        op.to_distance(&rank, 1);
+                        EXPECT_NEAR(rank, distance, tolerance(distance));
+                    }
+                }
+            }
+        }
+    }
+
+    /// a scaled uint8 store searched with float queries ranks like the
+    /// float vectors it was built from.
+    TEST(DistanceKernel, mixed_flat_scan_applies_storage_scale) {
+        constexpr int kDim = 24;
+        constexpr size_t kCount = 64;
+        auto rs = VectorSpace::create_mixed(kDim, kL2, DataType::DT_FLOAT, DataType::DT_UINT8);
+        ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+        auto vs = rs.value_or_die();
+        ASSERT_TRUE(vs.set_storage_scale(4.0f).ok());
+        auto data = test::random_floats(kDim * kCount, 101, 0.0f, 60.0f);
+        VectorStoreOption option;
+        option.max_elements = kCount;
+        auto srs = MemStore::create(&vs, option);
+        ASSERT_TRUE(srs.ok());
+        auto store = std::move(srs).value_or_die();
+        for (size_t i = 0; i < kCount; ++i) {
+            ASSERT_TRUE(store->add_float_vector(0, i, test::as_bytes(data.data() + i * kDim, kDim)).ok());
+        }
+        for (size_t q = 0; q < 8; ++q) {
+            auto query = test::random_floats(kDim, 200 + q, 0.0f, 60.0f);
+            size_t best = 0;
+            double best_distance = std::numeric_limits<double>::max();
+            for (size_t i = 0; i < kCount; ++i) {
+                double d = 0.0;
+                for (int j = 0; j < kDim; ++j) {
+                    auto stored = std::nearbyint(data[i * kDim + j] * 4.0f) / 4.0;
+                    d += (query[j] - stored) * (query[j] - stored);
+                }
+                if (d < best_distance) {
+                    best_distance = d;
+                    best = i;
+                }
+            }
+            QueryVector qv(&vs);
+            ASSERT_TRUE(qv.assign_float(test::as_bytes(query.data(), kDim)).ok());
+            SearchOption search;
+            search.k = 1;
+            auto hits = mixed_flat_scan(store.get(), qv.query_span(), search);
+            ASSERT_EQ(hits.size(), 1u);
+            EXPECT_EQ(hits[0].label, best);
+            /// distances are in storage units.
+            EXPECT_NEAR(hits[0].distance, std::sqrt(best_distance) * 4.0, 1e-3 * std::sqrt(best_distance) * 4.0 + 1e-3);
+        }
+    }
+} // namespace xann
@@ -0,0 +1,144 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <gtest/gtest.h>
+#include <xann/core/dtype_convert.h>
+
+namespace xann {
+
+    /// every tail length 0..17 behind 0, 1 and 4 full 16 wide units, so each
+    /// vector width of the build plus its scalar tail is covered.
+    static std::vector<size_t> lengths() {
+        std::vector<size_t> out;
+        for (size_t base: {0, 16, 64}) {
+            for (size_t tail = 0; tail <= 17; ++tail) {
+                out.push_back(base + tail);
+            }
+        }
+        return out;
+    }
+
+    /// rounding ties, saturation, signed zero and non finite values mixed into a ramp.
+    static std::vector<float> inputs(size_t n, float step) {
+        static const float kSpecial[] = {0.5f, 1.5f, 2.5f, -0.5f, -2.5f, 254.5f, 255.5f, 300.0f, -300.0f,
+                                         -0.0f, 65520.0f, 1e-8f, std::numeric_limits<float>::infinity(),
+                                         -std::numeric_limits<float>::infinity(),
+                                         std::numeric_limits<float>::quiet_NaN()};
+        std::vector<float> out(n);
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = i % 3 == 0 ? kSpecial[(i / 3) % (sizeof(kSpecial) / sizeof(float))]
+                                : static_cast<float>(i) * step - 40.0f;
+        }
+        return out;
+    }
+
+    static float reference_saturate(float v, float scale, float lo, float hi) {
+        return std::nearbyint(std::fmin(std::fmax(v * scale, lo), hi));
+    }
+
+    TEST(DtypeConvert, f16_round_trip_matches_scalar) {
+        for (auto n: lengths()) {
+            auto in = inputs(n, 0.37f);
+            std::vector<half_float::half> out(n);
+            f32_to_f16(in.data(), n, out.data());
+            std::vector<float> back(n);
+            f16_to_f32(out.data(), n, back.data());
+            for (size_t i = 0; i < n; ++i) {
+                half_float::half expect(in[i]);
+                auto want = static_cast<float>(expect);
+                if (std::isnan(in[i])) {
+                    EXPECT_TRUE(std::isnan(back[i])) << "n " << n << " i " << i;
+                    continue;
+                }
+                uint16_t got_bits;
+                uint16_t want_bits;
+                std::memcpy(&got_bits, &out[i], sizeof(got_bits));
+                std::memcpy(&want_bits, &expect, sizeof(want_bits));
+                EXPECT_EQ(got_bits, want_bits) << "n " << n << " i " << i << " in " << in[i];
+                EXPECT_EQ(back[i], want) << "n " << n << " i " << i;
+            }
+        }
+    }
+
+    TEST(DtypeConvert, bf16_round_trip_matches_scalar) {
+        for (auto n: lengths()) {
+            auto in = inputs(n, 0.37f);
+            std::vector<bfloat16> out(n);
+            f32_to_bf16(in.data(), n, out.data());
+            std::vector<float> back(n);
+            bf16_to_f32(out.data(), n, back.data());
+            for (size_t i = 0; i < n; ++i) {
+                EXPECT_EQ(out[i].bits, bfloat16::from_float(in[i])) << "n " << n << " i " << i << " in " << in[i];
+                if (std::isnan(in[i])) {
+                    EXPECT_TRUE(std::isnan(back[i]));
+                } else {
+                    EXPECT_EQ(back[i], bfloat16::to_float(out[i].bits)) << "n " << n << " i " << i;
+                }
+            }
+        }
+    }
+
+    TEST(DtypeConvert, u8_matches_scalar) {
+        for (float scale: {1.0f, 2.0f, 0.25f}) {
+            for (auto n: lengths()) {
+                auto in = inputs(n, 2.5f);
+                std::vector<uint8_t> out(n);
+                f32_to_u8(in.data(), n, scale, out.data());
+                std::vector<float> back(n);
+                u8_to_f32(out.data(), n, scale, back.data());
+                for (size_t i = 0; i < n; ++i) {
+                    auto want = static_cast<uint8_t>(reference_saturate(in[i], scale, 0.0f, 255.0f));
+                    EXPECT_EQ(out[i], want) << "n " << n << " i " << i << " in " << in[i] << " scale " << scale;
+                    EXPECT_EQ(back[i], static_cast<float>(out[i]) * (1.0f / scale)) << "n " << n << " i " << i;
+                }
+            }
+        }
+    }
+
+    TEST(DtypeConvert, i8_matches_scalar) {
+        for (float scale: {1.0f, 2.0f, 0.25f}) {
+            for (auto n: lengths()) {
+                auto in = inputs(n, 2.5f);
+                std::vector<int8_t> out(n);
+                f32_to_i8(in.data(), n, scale, out.data());
+                std::vector<float> back(n);
+                i8_to_f32(out.data(), n, scale, back.data());
+                for (size_t i = 0; i < n; ++i) {
+                    auto want = static_cast<int8_t>(reference_saturate(in[i], scale, -128.0f, 127.0f));
+                    EXPECT_EQ(out[i], want) << "n " << n << " i " << i << " in " << in[i] << " scale " << scale;
+                    EXPECT_EQ(back[i], static_cast<float>(out[i]) * (1.0f / scale)) << "n " << n << " i " << i;
+                }
+            }
+        }
+    }
+
+    TEST(DtypeConvert, narrow_and_widen_dispatch) {
+        auto in = inputs(17, 0.37f);
+        std::vector<uint8_t> bytes(17 * sizeof(float));
+        std::vector<float> back(17);
+        for (auto dt: {DataType::DT_FLOAT, DataType::DT_FLOAT16, DataType::DT_BFLOAT16, DataType::DT_UINT8}) {
+            EXPECT_TRUE(narrow_floats(in.data(), in.size(), dt, bytes.data(), 2.0f).ok());
+            EXPECT_TRUE(widen_to_floats(bytes.data(), in.size(), dt, back.data(), 2.0f).ok());
+        }
+        EXPECT_FALSE(narrow_floats(in.data(), in.size(), DataType::DT_NONE, bytes.data()).ok());
+        EXPECT_FALSE(widen_to_floats(bytes.data(), in.size(), DataType::DT_MAX, back.data()).ok());
+    }
+} // namespace xann
@@ -0,0 +1,90 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <gtest/gtest.h>
+#include <xann/index/flat_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 8;
+    static constexpr size_t kQueries = 20;
+
+    /// dimension d is scaled by d + 1, the learned order is kDim - 1 .. 0.
+    static std::vector<float> spread_floats(size_t n, uint64_t seed) {
+        auto data = test::random_floats(n * kDim, seed);
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] *= static_cast<float>(i % kDim + 1);
+        }
+        return data;
+    }
+
+    /// an index built over an empty store keeps scanning in place until
+    /// min_learn_size vectors arrived, then learns the order from all of them.
+    TEST(FlatIndex, learns_order_once_enough_vectors_arrived) {
+        auto vs = test::make_space(kDim, kL2);
+        VectorStoreOption store_option;
+        store_option.max_elements = 2048;
+        auto store = MemStore::create(&vs, store_option).value_or_die();
+        FlatIndexOption option;
+        option.reorder_dims = true;
+        option.min_learn_size = 256;
+        FlatIndex index(option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+        EXPECT_TRUE(index.dim_order().empty());
+
+        auto data = spread_floats(1000, 1);
+        auto queries = spread_floats(kQueries, 2);
+        SearchOption search;
+        search.k = 10;
+        for (uint64_t label = 0; label < 1000; ++label) {
+            auto rs = store->add_vector(0, label, test::as_bytes(data.data() + label * kDim, kDim));
+            ASSERT_TRUE(rs.ok());
+            ASSERT_TRUE(index.add(rs.value_or_die()).ok());
+            if (label + 1 < option.min_learn_size) {
+                EXPECT_TRUE(index.dim_order().empty()) << "learned from " << label + 1 << " vectors";
+            } else {
+                ASSERT_EQ(index.dim_order().size(), static_cast<size_t>(kDim));
+            }
+            if (label == 10 || label == 999) {
+                EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.999);
+            }
+        }
+        for (int i = 0; i < kDim; ++i) {
+            EXPECT_EQ(index.dim_order()[i], static_cast<uint32_t>(kDim - 1 - i));
+        }
+    }
+
+    /// build and maintain learn from what the store holds, however little.
+    TEST(FlatIndex, build_and_maintain_learn_the_order) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = spread_floats(100, 3);
+        auto store = test::make_store(&vs, data, 100);
+        FlatIndexOption option;
+        option.reorder_dims = true;
+        FlatIndex index(option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+        EXPECT_EQ(index.dim_order().size(), static_cast<size_t>(kDim));
+        ASSERT_TRUE(index.maintain().ok());
+        EXPECT_EQ(index.dim_order().size(), static_cast<size_t>(kDim));
+
+        auto ip = test::make_space(kDim, kIP);
+        auto ip_store = test::make_store(&ip, data, 100);
+        FlatIndex plain(option);
+        ASSERT_TRUE(plain.build(ip_store.get()).ok());
+        EXPECT_TRUE(plain.dim_order().empty()) << "no bounded rank for inner product";
+    }
+} // namespace xann
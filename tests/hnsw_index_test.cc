@@ -0,0 +1,81 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+#include <xann/index/hnsw_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 32;
+    static constexpr size_t kCount = 2000;
+    static constexpr size_t kQueries = 50;
+
+    /// full vectors, then sq8 codes trained early enough to serve the traversal.
+    TEST(HnswIndex, recall_against_flat_scan) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 1);
+        auto queries = test::random_floats(kDim * kQueries, 2);
+        auto store = test::make_store(&vs, data, kCount);
+        for (bool quantized: {false, true}) {
+            HnswOption option;
+            option.quantized = quantized;
+            option.min_train_size = 500;
+            HnswIndex index(option);
+            ASSERT_TRUE(index.build(store.get()).ok());
+            EXPECT_EQ(index.size(), kCount);
+            SearchOption search;
+            search.k = 10;
+            search.ef = 128;
+            EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.9)
+                                << "quantized " << quantized;
+        }
+    }
+
+    TEST(HnswIndex, recall_with_inner_product) {
+        auto vs = test::make_space(kDim, kIP);
+        auto data = test::random_floats(kDim * kCount, 3);
+        auto queries = test::random_floats(kDim * kQueries, 4);
+        auto store = test::make_store(&vs, data, kCount);
+        HnswIndex index;
+        ASSERT_TRUE(index.build(store.get()).ok());
+        SearchOption search;
+        search.k = 10;
+        search.ef = 200;
+        EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.8);
+    }
+
+    /// half the vectors are built, the other half is linked by four writers
+    /// through reserve / add_shared while two readers search.
+    TEST(HnswIndex, concurrent_add_and_search) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 5);
+        auto queries = test::random_floats(kDim * kQueries, 6);
+        auto store = test::make_store(&vs, data, kCount / 2);
+        HnswOption option;
+        option.min_train_size = 500;
+        HnswIndex index(option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+        SearchOption search;
+        search.k = 10;
+        search.ef = 128;
+        test::concurrent_add_and_search(store.get(), &index, data, kCount / 2, kCount, 4, 2, search);
+        EXPECT_EQ(store->size(), kCount);
+        EXPECT_EQ(index.size(), kCount);
+        EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.9);
+    }
+} // namespace xann
@@ -0,0 +1,130 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+#include <xann/index/ivf_flat_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 32;
+    static constexpr size_t kCount = 4000;
+    static constexpr size_t kQueries = 50;
+    static constexpr size_t kClusters = 32;
+
+    TEST(IvfFlatIndex, recall_against_flat_scan) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::clustered_floats(kCount + kQueries, kDim, kClusters, 0.05f, 7);
+        std::vector<float> queries(data.end() - kQueries * kDim, data.end());
+        data.resize(kCount * kDim);
+        auto store = test::make_store(&vs, data, kCount);
+        IvfOption option;
+        option.nlist = kClusters;
+        option.min_train_size = 500;
+        IvfFlatIndex index(option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+        EXPECT_TRUE(index.trained());
+        EXPECT_EQ(index.size(), kCount);
+        SearchOption search;
+        search.k = 10;
+        search.nprobe = 8;
+        EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.9);
+        /// probing every list is exact.
+        search.nprobe = kClusters;
+        EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.999);
+    }
+
+    /// residual codes rank the probed lists, the reranked top k keeps recall
+    /// for the l2 and inner product families.
+    TEST(IvfFlatIndex, residual_codes_recall) {
+        for (auto metric: {kL2, kIP}) {
+            auto vs = test::make_space(kDim, metric);
+            auto data = test::clustered_floats(kCount + kQueries, kDim, kClusters, 0.05f, 10);
+            std::vector<float> queries(data.end() - kQueries * kDim, data.end());
+            data.resize(kCount * kDim);
+            auto store = test::make_store(&vs, data, kCount);
+            IvfOption option;
+            option.nlist = kClusters;
+            option.min_train_size = 500;
+            option.residual_codes = true;
+            option.rq.m = 8;
+            option.rq.train_iterations = 10;
+            IvfFlatIndex index(option);
+            ASSERT_TRUE(index.build(store.get()).ok());
+            EXPECT_EQ(index.name(), "ivf_rq");
+            EXPECT_TRUE(index.residual_quantizer().trained());
+            SearchOption search;
+            search.k = 10;
+            search.nprobe = 8;
+            search.rerank = 100;
+            EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.9) << "metric " << metric;
+        }
+    }
+
+    /// below min_train_size every vector sits in the pending list and the scan is exact.
+    TEST(IvfFlatIndex, untrained_scan_is_exact) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * 300, 8);
+        auto queries = test::random_floats(kDim * kQueries, 9);
+        auto store = test::make_store(&vs, data, 300);
+        IvfFlatIndex index;
+        ASSERT_TRUE(index.build(store.get()).ok());
+        EXPECT_FALSE(index.trained());
+        SearchOption search;
+        search.k = 10;
+        EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.999);
+    }
+
+    /// inserts under the exclusive lock next to searches split the pending
+    /// and posting lists, then a quarter is removed and maintain() rebalances.
+    TEST(IvfFlatIndex, concurrent_add_remove_and_rebalance) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::clustered_floats(kCount + kQueries, kDim, kClusters, 0.05f, 10);
+        std::vector<float> queries(data.end() - kQueries * kDim, data.end());
+        data.resize(kCount * kDim);
+        auto store = test::make_store(&vs, data, kCount / 2);
+        IvfOption option;
+        option.nlist = kClusters / 2;
+        option.min_train_size = 500;
+        option.min_list_size = 16;
+        IvfFlatIndex index(option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+        SearchOption search;
+        search.k = 10;
+        search.nprobe = 8;
+        test::concurrent_add_and_search(store.get(), &index, data, kCount / 2, kCount, 2, 2, search);
+        EXPECT_EQ(index.size(), kCount);
+
+        for (uint64_t label = 0; label < kCount; label += 4) {
+            auto rs = store->get_id(label);
+            ASSERT_TRUE(rs.ok());
+            store->tombstone_vector_by_label(0, label);
+            ASSERT_TRUE(index.remove(rs.value_or_die()).ok());
+            store->remove_vector_by_label(0, label);
+        }
+        ASSERT_TRUE(index.maintain().ok());
+        EXPECT_EQ(index.size(), kCount - kCount / 4);
+        EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.9);
+        for (size_t q = 0; q < kQueries; ++q) {
+            auto rs = index.search(test::as_bytes(queries.data() + q * kDim, kDim), search);
+            ASSERT_TRUE(rs.ok());
+            for (auto &hit: rs.value_or_die()) {
+                EXPECT_NE(hit.label % 4, 0u) << "removed label " << hit.label;
+            }
+        }
+    }
+} // namespace xann
@@ -0,0 +1,108 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <cmath>
+#include <gtest/gtest.h>
+#include <xann/index/kd_tree_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 4;
+    static constexpr size_t kCount = 3000;
+    static constexpr size_t kQueries = 40;
+
+    /// the index returns the flat_scan top-k, rank by rank.
+    static void expect_exact(const VectorIndex &index, const MemStore *store, const std::vector<float> &queries,
+                             uint32_t k) {
+        SearchOption option;
+        option.k = k;
+        for (size_t q = 0; q < kQueries; ++q) {
+            auto *query = queries.data() + q * kDim;
+            auto truth = test::exact_search(store, query, k);
+            auto rs = index.search(test::as_bytes(query, kDim), option);
+            ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+            auto &hits = rs.value_or_die();
+            ASSERT_EQ(hits.size(), truth.size());
+            for (size_t i = 0; i < truth.size(); ++i) {
+                EXPECT_EQ(hits[i].label, truth[i].label) << "query " << q << " rank " << i;
+                EXPECT_NEAR(hits[i].distance, truth[i].distance, 1e-4f * (1.0f + std::fabs(truth[i].distance)));
+            }
+        }
+    }
+
+    TEST(KdTreeIndex, exact_across_metrics) {
+        for (auto metric: {kL1, kL2, kIP, kNormalizedL2, kNormalizedCosine}) {
+            auto vs = test::make_space(kDim, metric);
+            auto data = test::clustered_floats(kCount, kDim, 20, 0.1f, 1);
+            auto queries = test::random_floats(kDim * kQueries, 2);
+            auto store = test::make_store(&vs, data, kCount);
+            KdTreeOption option;
+            option.leaf_size = 16;
+            KdTreeIndex index(option);
+            ASSERT_TRUE(index.build(store.get()).ok());
+            EXPECT_TRUE(index.tree_supported()) << "metric " << metric;
+            EXPECT_GT(index.leaf_count(), 1u);
+            SCOPED_TRACE(metric);
+            expect_exact(index, store.get(), queries, 10);
+        }
+    }
+
+    /// inserts wait in the buffer and removes leave holes, before and after
+    /// the rebuilds they trigger the answers stay exact.
+    TEST(KdTreeIndex, exact_through_buffer_and_hole_churn) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount * 2, 3);
+        auto queries = test::random_floats(kDim * kQueries, 4);
+        auto store = test::make_store(&vs, data, kCount);
+        KdTreeOption option;
+        option.min_rebuild = 64;
+        option.rebuild_ratio = 0.05;
+        KdTreeIndex index(option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+
+        /// fewer than min_rebuild inserts stay buffered.
+        uint64_t next = kCount;
+        for (; next < kCount + 50; ++next) {
+            auto rs = store->add_vector(0, next, test::as_bytes(data.data() + next * kDim, kDim));
+            ASSERT_TRUE(rs.ok());
+            ASSERT_TRUE(index.add(rs.value_or_die()).ok());
+        }
+        EXPECT_EQ(index.buffer_size(), 50u);
+        expect_exact(index, store.get(), queries, 10);
+
+        /// holes, then freed lids reused by new labels.
+        for (uint64_t label = 0; label < kCount; label += 7) {
+            auto lid = store->get_id(label).value_or_die();
+            store->tombstone_vector_by_label(0, label);
+            ASSERT_TRUE(index.remove(lid).ok());
+            store->remove_vector_by_label(0, label);
+        }
+        expect_exact(index, store.get(), queries, 10);
+        for (; next < kCount + 600; ++next) {
+            auto rs = store->add_vector(0, next, test::as_bytes(data.data() + next * kDim, kDim));
+            ASSERT_TRUE(rs.ok());
+            ASSERT_TRUE(index.add(rs.value_or_die()).ok());
+        }
+        EXPECT_EQ(index.size(), store->size());
+        expect_exact(index, store.get(), queries, 10);
+
+        ASSERT_TRUE(index.maintain().ok());
+        EXPECT_EQ(index.buffer_size(), 0u);
+        EXPECT_EQ(index.tree_size(), store->size());
+        expect_exact(index, store.get(), queries, 10);
+    }
+} // namespace xann
@@ -0,0 +1,148 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <gtest/gtest.h>
+#include <xann/core/kernel_calibration.h>
+
+namespace xann {
+
+    /// decisions are cached for the whole process, every test uses dims no
+    /// other test calibrates so it reaches the path it means to.
+    static KernelCalibrationOption small_option(const std::string &file) {
+        KernelCalibrationOption option;
+        option.cache_file = file;
+        option.pool_bytes = 64 << 10;
+        option.rounds = 1;
+        return option;
+    }
+
+    static std::string temp_file(const std::string &name) {
+        auto path = ::testing::TempDir() + name;
+        std::remove(path.c_str());
+        return path;
+    }
+
+    struct Decision {
+        std::string cpu;
+        int metric, dt, dim, max_level, level;
+    };
+
+    static std::vector<Decision> read_decisions(const std::string &path) {
+        std::ifstream in(path);
+        std::vector<Decision> out;
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            Decision d;
+            EXPECT_TRUE(std::getline(fields, d.cpu, '\t')) << line;
+            EXPECT_TRUE(fields >> d.metric >> d.dt >> d.dim >> d.max_level >> d.level) << line;
+            out.push_back(d);
+        }
+        return out;
+    }
+
+    TEST(KernelCalibration, cpu_model_is_a_single_field) {
+        auto cpu = cpu_model_name();
+        EXPECT_FALSE(cpu.empty());
+        EXPECT_EQ(cpu.find('\t'), std::string::npos);
+        EXPECT_EQ(cpu.find('\n'), std::string::npos);
+        EXPECT_NE(cpu.front(), ' ');
+    }
+
+    /// a fresh decision is appended under this cpu, and the level never
+    /// passes max_level.
+    TEST(KernelCalibration, decision_is_written_under_the_cpu_model) {
+        auto path = temp_file("xann_calibration_write.tsv");
+        auto option = small_option(path);
+        auto rs = calibrate_simd_level(kL2, DataType::DT_FLOAT, 41, SimdLevel::SIMD_AVX512, option);
+        ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+        EXPECT_TRUE(simd_level_supported(rs.value_or_die()));
+        auto none = calibrate_simd_level(kL2, DataType::DT_FLOAT, 42, SimdLevel::SIMD_NONE, option);
+        ASSERT_TRUE(none.ok());
+        EXPECT_EQ(none.value_or_die(), SimdLevel::SIMD_NONE);
+
+        auto decisions = read_decisions(path);
+        ASSERT_EQ(decisions.size(), 2u);
+        EXPECT_EQ(decisions[0].cpu, cpu_model_name());
+        EXPECT_EQ(decisions[0].metric, kL2);
+        EXPECT_EQ(decisions[0].dt, static_cast<int>(DataType::DT_FLOAT));
+        EXPECT_EQ(decisions[0].dim, 41);
+        EXPECT_EQ(decisions[0].max_level, static_cast<int>(SimdLevel::SIMD_AVX512));
+        EXPECT_EQ(decisions[0].level, static_cast<int>(rs.value_or_die()));
+        EXPECT_EQ(decisions[1].dim, 42);
+        EXPECT_EQ(decisions[1].level, static_cast<int>(SimdLevel::SIMD_NONE));
+
+        /// the process cache answers the second call, nothing more is written.
+        auto again = calibrate_simd_level(kL2, DataType::DT_FLOAT, 41, SimdLevel::SIMD_AVX512, option);
+        ASSERT_TRUE(again.ok());
+        EXPECT_EQ(again.value_or_die(), rs.value_or_die());
+        EXPECT_EQ(read_decisions(path).size(), 2u);
+    }
+
+    /// a decision in the file is taken without benchmarking: lines of other
+    /// cpu models are skipped and the last line of a key wins.
+    TEST(KernelCalibration, decision_is_read_back_by_cpu_model) {
+        auto path = temp_file("xann_calibration_read.tsv");
+        auto cpu = cpu_model_name();
+        auto max = static_cast<int>(SimdLevel::SIMD_AVX512);
+        {
+            std::ofstream out(path);
+            out << cpu << '\t' << kL2 << '\t' << static_cast<int>(DataType::DT_FLOAT) << "\t37\t" << max << "\t2\n";
+            out << cpu << '\t' << kL2 << '\t' << static_cast<int>(DataType::DT_FLOAT) << "\t37\t" << max << "\t0\n";
+            out << "some other cpu\t" << kL2 << '\t' << static_cast<int>(DataType::DT_FLOAT) << "\t37\t" << max
+                << "\t1\n";
+            out << "not a decision\n";
+        }
+        auto rs = calibrate_simd_level(kL2, DataType::DT_FLOAT, 37, SimdLevel::SIMD_AVX512, small_option(path));
+        ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+        EXPECT_EQ(rs.value_or_die(), SimdLevel::SIMD_NONE);
+        /// a loaded decision is not appended again.
+        std::ifstream in(path);
+        EXPECT_EQ(std::count(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>(), '\n'), 4);
+    }
+
+    /// first calls racing on one key benchmark outside the lock, they all
+    /// get the decision that was published first and it is written once.
+    TEST(KernelCalibration, concurrent_first_calls_agree) {
+        auto path = temp_file("xann_calibration_race.tsv");
+        auto option = small_option(path);
+        constexpr size_t kThreads = 8;
+        std::vector<SimdLevel> levels(kThreads);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&, t] {
+                auto rs = calibrate_simd_level(kIP, DataType::DT_FLOAT, 43, SimdLevel::SIMD_AVX512, option);
+                ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+                levels[t] = rs.value_or_die();
+            });
+        }
+        for (auto &t: threads) {
+            t.join();
+        }
+        for (auto level: levels) {
+            EXPECT_EQ(level, levels.front());
+        }
+        auto decisions = read_decisions(path);
+        ASSERT_EQ(decisions.size(), 1u);
+        EXPECT_EQ(decisions[0].level, static_cast<int>(levels.front()));
+    }
+} // namespace xann
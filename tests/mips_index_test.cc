@@ -0,0 +1,109 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <memory>
+#include <vector>
+#include <gtest/gtest.h>
+#include <xann/index/flat_index.h>
+#include <xann/index/hnsw_index.h>
+#include <xann/index/mips_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 24;
+    static constexpr size_t kCount = 1500;
+    static constexpr size_t kQueries = 40;
+
+    static double dot(const float *a, const float *b) {
+        double sum = 0.0;
+        for (int d = 0; d < kDim; ++d) {
+            sum += static_cast<double>(a[d]) * b[d];
+        }
+        return sum;
+    }
+
+    /// over an exact l2 index the augmented search is exact for inner
+    /// product, and hits carry q . x rather than the mirror distance.
+    TEST(MipsIndex, flat_mirror_matches_inner_product_scan) {
+        auto vs = test::make_space(kDim, kIP);
+        /// norms spread over [0.1, 3) so the augmentation matters.
+        auto data = test::random_floats(kDim * kCount, 1);
+        auto scales = test::random_floats(kCount, 2, 0.1f, 3.0f);
+        for (size_t i = 0; i < kCount; ++i) {
+            for (int d = 0; d < kDim; ++d) {
+                data[i * kDim + d] *= scales[i];
+            }
+        }
+        auto queries = test::random_floats(kDim * kQueries, 3);
+        auto store = test::make_store(&vs, data, kCount);
+        MipsIndex index(std::make_unique<FlatIndex>());
+        ASSERT_TRUE(index.build(store.get()).ok());
+        EXPECT_TRUE(index.augmented());
+        SearchOption search;
+        search.k = 10;
+        for (size_t q = 0; q < kQueries; ++q) {
+            auto *query = queries.data() + q * kDim;
+            auto rs = index.search(test::as_bytes(query, kDim), search);
+            ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+            auto &hits = rs.value_or_die();
+            auto truth = test::exact_search(store.get(), query, search.k);
+            ASSERT_EQ(hits.size(), truth.size());
+            EXPECT_GE(test::recall(hits, truth), 0.999);
+            for (auto &hit: hits) {
+                auto expect = dot(query, data.data() + hit.label * kDim);
+                EXPECT_NEAR(hit.distance, expect, 1e-3 * std::abs(expect) + 1e-3) << "label " << hit.label;
+            }
+        }
+    }
+
+    /// an insert above M rebuilds the mirror, results stay exact.
+    TEST(MipsIndex, insert_above_max_norm_rebuilds) {
+        auto vs = test::make_space(kDim, kIP);
+        auto data = test::random_floats(kDim * (kCount + 1), 4);
+        for (int d = 0; d < kDim; ++d) {
+            data[kCount * kDim + d] *= 10.0f;
+        }
+        auto queries = test::random_floats(kDim * kQueries, 5);
+        auto store = test::make_store(&vs, data, kCount);
+        MipsIndex index(std::make_unique<FlatIndex>());
+        ASSERT_TRUE(index.build(store.get()).ok());
+        auto before = index.max_norm();
+        auto rs = store->add_vector(0, kCount, test::as_bytes(data.data() + kCount * kDim, kDim));
+        ASSERT_TRUE(rs.ok());
+        ASSERT_TRUE(index.add(rs.value_or_die()).ok());
+        EXPECT_GT(index.max_norm(), before);
+        EXPECT_EQ(index.rebuilds(), 1u);
+        EXPECT_EQ(index.size(), kCount + 1);
+        SearchOption search;
+        search.k = 10;
+        EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.999);
+    }
+
+    TEST(MipsIndex, hnsw_mirror_recall) {
+        auto vs = test::make_space(kDim, kIP);
+        auto data = test::random_floats(kDim * kCount, 6);
+        auto queries = test::random_floats(kDim * kQueries, 7);
+        auto store = test::make_store(&vs, data, kCount);
+        MipsIndex index(std::make_unique<HnswIndex>());
+        ASSERT_TRUE(index.build(store.get()).ok());
+        SearchOption search;
+        search.k = 10;
+        search.ef = 200;
+        EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.9);
+    }
+} // namespace xann
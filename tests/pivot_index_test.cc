@@ -0,0 +1,141 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <cmath>
+#include <gtest/gtest.h>
+#include <xann/index/pivot_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 8;
+    static constexpr size_t kCount = 2000;
+    static constexpr size_t kQueries = 30;
+
+    static void expect_same_hits(const std::vector<SearchHit> &got, const std::vector<SearchHit> &truth) {
+        ASSERT_EQ(got.size(), truth.size());
+        for (size_t i = 0; i < truth.size(); ++i) {
+            EXPECT_EQ(got[i].label, truth[i].label) << "rank " << i;
+            EXPECT_NEAR(got[i].distance, truth[i].distance, 1e-4f * (1.0f + std::fabs(truth[i].distance)));
+        }
+    }
+
+    static void expect_exact(const PivotIndex &index, const MemStore *store, const std::vector<float> &queries) {
+        SearchOption option;
+        option.k = 10;
+        for (size_t q = 0; q < kQueries; ++q) {
+            auto *query = queries.data() + q * kDim;
+            auto rs = index.search(test::as_bytes(query, kDim), option);
+            ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+            SCOPED_TRACE(q);
+            expect_same_hits(rs.value_or_die(), test::exact_search(store, query, option.k));
+        }
+    }
+
+    TEST(PivotIndex, search_matches_brute_force) {
+        for (auto half: {false, true}) {
+            for (auto metric: {kL1, kL2, kChebyshev, kNormalizedL2, kIP}) {
+                auto vs = test::make_space(kDim, metric);
+                auto data = test::clustered_floats(kCount, kDim, 16, 0.2f, 1);
+                auto queries = test::random_floats(kDim * kQueries, 2);
+                auto store = test::make_store(&vs, data, kCount);
+                PivotIndexOption option;
+                option.half_table = half;
+                PivotIndex index(option);
+                ASSERT_TRUE(index.build(store.get()).ok());
+                EXPECT_EQ(index.pivots_supported(), metric != kIP);
+                SCOPED_TRACE(testing::Message() << "metric " << metric << " half " << half);
+                expect_exact(index, store.get(), queries);
+            }
+        }
+    }
+
+    /// every vector within the radius and nothing beyond it, best first.
+    TEST(PivotIndex, range_search_matches_brute_force) {
+        for (auto metric: {kL1, kL2}) {
+            auto vs = test::make_space(kDim, metric);
+            auto data = test::clustered_floats(kCount, kDim, 16, 0.2f, 3);
+            auto queries = test::random_floats(kDim * kQueries, 4);
+            auto store = test::make_store(&vs, data, kCount);
+            PivotIndex index;
+            ASSERT_TRUE(index.build(store.get()).ok());
+            SearchOption option;
+            for (size_t q = 0; q < kQueries; ++q) {
+                auto *query = queries.data() + q * kDim;
+                auto all = test::exact_search(store.get(), query, kCount);
+                auto radius = all[24].distance;
+                std::vector<SearchHit> truth;
+                for (auto &hit: all) {
+                    if (hit.distance <= radius) {
+                        truth.push_back(hit);
+                    }
+                }
+                auto rs = index.range_search(test::as_bytes(query, kDim), radius, option);
+                ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+                SCOPED_TRACE(testing::Message() << "metric " << metric << " query " << q);
+                expect_same_hits(rs.value_or_die(), truth);
+                EXPECT_LT(index.last_evaluations(), kCount);
+            }
+        }
+        auto vs = test::make_space(kDim, kIP);
+        auto data = test::random_floats(kDim * 100, 5);
+        auto store = test::make_store(&vs, data, 100);
+        PivotIndex index;
+        ASSERT_TRUE(index.build(store.get()).ok());
+        EXPECT_FALSE(index.range_search(test::as_bytes(data.data(), kDim), 1.0f, SearchOption{}).ok());
+    }
+
+    /// maintain keeps the pivots through a few changes and reselects them once
+    /// rebuild_ratio of the vectors changed, the answers stay exact either way.
+    TEST(PivotIndex, maintain_rebuilds_after_enough_changes) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount * 2, 6);
+        auto queries = test::random_floats(kDim * kQueries, 7);
+        auto store = test::make_store(&vs, data, kCount);
+        PivotIndexOption option;
+        option.rebuild_ratio = 0.2;
+        PivotIndex index(option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+        auto pivots = index.pivot_lids();
+
+        for (uint64_t label = 0; label < 100; ++label) {
+            auto lid = store->get_id(label).value_or_die();
+            store->tombstone_vector_by_label(0, label);
+            ASSERT_TRUE(index.remove(lid).ok());
+            store->remove_vector_by_label(0, label);
+        }
+        for (uint64_t label = kCount; label < kCount + 100; ++label) {
+            auto rs = store->add_vector(0, label, test::as_bytes(data.data() + label * kDim, kDim));
+            ASSERT_TRUE(rs.ok());
+            ASSERT_TRUE(index.add(rs.value_or_die()).ok());
+        }
+        ASSERT_TRUE(index.maintain().ok());
+        EXPECT_EQ(index.changes_since_build(), 200u);
+        EXPECT_EQ(index.pivot_lids(), pivots);
+        EXPECT_EQ(index.size(), kCount);
+        expect_exact(index, store.get(), queries);
+
+        for (uint64_t label = kCount + 100; label < kCount + 300; ++label) {
+            auto rs = store->add_vector(0, label, test::as_bytes(data.data() + label * kDim, kDim));
+            ASSERT_TRUE(rs.ok());
+            ASSERT_TRUE(index.add(rs.value_or_die()).ok());
+        }
+        ASSERT_TRUE(index.maintain().ok());
+        EXPECT_EQ(index.changes_since_build(), 0u);
+        EXPECT_EQ(index.size(), kCount + 200);
+        expect_exact(index, store.get(), queries);
+    }
+} // namespace xann
@@ -0,0 +1,79 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <gtest/gtest.h>
+#include <xann/index/pq_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 32;
+    static constexpr size_t kCount = 3000;
+    static constexpr size_t kQueries = 50;
+
+    /// codes rank the whole store, max(k, rerank) of them are rescored with full vectors.
+    TEST(PqIndex, recall_against_flat_scan) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::clustered_floats(kCount + kQueries, kDim, 24, 0.1f, 11);
+        std::vector<float> queries(data.end() - kQueries * kDim, data.end());
+        data.resize(kCount * kDim);
+        auto store = test::make_store(&vs, data, kCount);
+        for (bool opq: {false, true}) {
+            PqIndexOption option;
+            option.m = 8;
+            option.opq = opq;
+            option.min_train_size = 1000;
+            PqIndex index(option);
+            ASSERT_TRUE(index.build(store.get()).ok());
+            EXPECT_TRUE(index.trained());
+            EXPECT_EQ(index.size(), kCount);
+            SearchOption search;
+            search.k = 10;
+            search.rerank = 200;
+            EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.9) << "opq " << opq;
+        }
+    }
+
+    TEST(PqIndex, concurrent_add_and_search) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::clustered_floats(kCount + kQueries, kDim, 24, 0.1f, 12);
+        std::vector<float> queries(data.end() - kQueries * kDim, data.end());
+        data.resize(kCount * kDim);
+        auto store = test::make_store(&vs, data, kCount / 2);
+        PqIndexOption option;
+        option.m = 8;
+        option.min_train_size = 1000;
+        PqIndex index(option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+        SearchOption search;
+        search.k = 10;
+        search.rerank = 200;
+        test::concurrent_add_and_search(store.get(), &index, data, kCount / 2, kCount, 2, 2, search);
+        EXPECT_EQ(index.size(), kCount);
+        EXPECT_GE(test::mean_recall(index, store.get(), queries, kQueries, search), 0.9);
+    }
+
+    /// pq has no mixed precision scoring and refuses such a space.
+    TEST(PqIndex, refuses_mixed_precision_space) {
+        auto rs = VectorSpace::create_mixed(kDim, kL2, DataType::DT_FLOAT, DataType::DT_FLOAT16);
+        ASSERT_TRUE(rs.ok());
+        auto vs = rs.value_or_die();
+        auto store = test::make_store(&vs, {}, 0);
+        PqIndex index;
+        EXPECT_FALSE(index.build(store.get()).ok());
+    }
+} // namespace xann
@@ -0,0 +1,152 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cmath>
+#include <vector>
+#include <gtest/gtest.h>
+#include <xann/quantization/projection.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr size_t kDim = 32;
+    static constexpr size_t kRank = 8;
+    static constexpr size_t kCount = 500;
+
+    /// n rows of kDim floats spanning a kRank dim affine subspace.
+    static std::vector<float> low_rank_floats(size_t n, uint64_t seed) {
+        auto basis = test::random_floats(kRank * kDim, seed);
+        auto offset = test::random_floats(kDim, seed + 1, 2.0f, 3.0f);
+        auto coords = test::random_floats(n * kRank, seed + 2);
+        std::vector<float> out(n * kDim);
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t d = 0; d < kDim; ++d) {
+                float v = offset[d];
+                for (size_t r = 0; r < kRank; ++r) {
+                    v += coords[i * kRank + r] * basis[r * kDim + d];
+                }
+                out[i * kDim + d] = v;
+            }
+        }
+        return out;
+    }
+
+    static double l2(const float *a, const float *b, size_t dim) {
+        double sum = 0.0;
+        for (size_t d = 0; d < dim; ++d) {
+            sum += (static_cast<double>(a[d]) - b[d]) * (static_cast<double>(a[d]) - b[d]);
+        }
+        return std::sqrt(sum);
+    }
+
+    static std::vector<AlignedBytes> apply_all(const ProjectionStage &stage, const std::vector<float> &data,
+                                               size_t n) {
+        std::vector<AlignedBytes> out(n);
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_TRUE(stage.apply(test::as_bytes(data.data() + i * kDim, kDim), &out[i]).ok());
+        }
+        return out;
+    }
+
+    static turbo::span<uint8_t> as_span(AlignedBytes &slot) {
+        return turbo::span<uint8_t>(slot.data(), slot.size());
+    }
+
+    /// centered pca onto the rank of the data keeps every l2 distance.
+    TEST(Projection, pca_keeps_distances_of_low_rank_data) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = low_rank_floats(kCount, 1);
+        ProjectionOption option;
+        option.out_dim = kRank;
+        auto rs = ProjectionStage::train(&vs, data.data(), kCount, option);
+        ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+        auto &stage = *rs.value_or_die();
+        EXPECT_GE(stage.explained_variance(), 0.999);
+        EXPECT_EQ(stage.output_space()->dim, static_cast<int32_t>(kRank));
+        auto out = apply_all(stage, data, 50);
+        for (size_t i = 0; i + 1 < out.size(); ++i) {
+            auto expect = l2(data.data() + i * kDim, data.data() + (i + 1) * kDim, kDim);
+            auto got = stage.output_space()->operation.distance_vector(as_span(out[i]), as_span(out[i + 1]));
+            EXPECT_NEAR(got, expect, 1e-3 * expect + 1e-3) << "pair " << i;
+        }
+    }
+
+    /// a random orthogonal map onto the full dimension is a rotation, a
+    /// gaussian one keeps squared distances in expectation.
+    TEST(Projection, random_projections_keep_distances) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kCount * kDim, 2);
+        ProjectionOption option;
+        option.type = ProjectionType::kRandomOrthogonal;
+        option.out_dim = kDim;
+        auto rs = ProjectionStage::train(&vs, nullptr, 0, option);
+        ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+        auto out = apply_all(*rs.value_or_die(), data, 50);
+        auto *output = rs.value_or_die()->output_space();
+        for (size_t i = 0; i + 1 < out.size(); ++i) {
+            auto expect = l2(data.data() + i * kDim, data.data() + (i + 1) * kDim, kDim);
+            auto got = output->operation.distance_vector(as_span(out[i]), as_span(out[i + 1]));
+            EXPECT_NEAR(got, expect, 1e-3 * expect + 1e-4) << "pair " << i;
+        }
+
+        option.type = ProjectionType::kGaussian;
+        option.out_dim = kDim / 2;
+        auto grs = ProjectionStage::train(&vs, nullptr, 0, option);
+        ASSERT_TRUE(grs.ok()) << grs.status().to_string();
+        auto gout = apply_all(*grs.value_or_die(), data, kCount);
+        double ratio = 0.0;
+        for (size_t i = 0; i + 1 < gout.size(); ++i) {
+            auto expect = l2(data.data() + i * kDim, data.data() + (i + 1) * kDim, kDim);
+            auto got = grs.value_or_die()->output_space()->operation.distance_vector(as_span(gout[i]),
+                                                                                     as_span(gout[i + 1]));
+            ratio += (got * got) / (expect * expect);
+        }
+        ratio /= static_cast<double>(gout.size() - 1);
+        EXPECT_NEAR(ratio, 1.0, 0.15);
+    }
+
+    /// the normalized family gets unit outputs back, uncentered.
+    TEST(Projection, normalized_metrics_output_unit_vectors) {
+        for (auto metric: {kNormalizedL2, kNormalizedCosine}) {
+            auto vs = test::make_space(kDim, metric);
+            ASSERT_TRUE(vs.need_normalize_vector);
+            auto data = test::random_floats(kCount * kDim, 3);
+            ProjectionOption option;
+            option.out_dim = kRank;
+            auto rs = ProjectionStage::train(&vs, data.data(), kCount, option);
+            ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+            auto out = apply_all(*rs.value_or_die(), data, 50);
+            for (auto &slot: out) {
+                auto *p = reinterpret_cast<const float *>(slot.data());
+                double norm = 0.0;
+                for (size_t d = 0; d < kRank; ++d) {
+                    norm += static_cast<double>(p[d]) * p[d];
+                }
+                EXPECT_NEAR(std::sqrt(norm), 1.0, 1e-4) << "metric " << metric;
+            }
+        }
+    }
+
+    TEST(Projection, refuses_transformed_space) {
+        auto vs = test::make_space(kDim, kWeightedL2);
+        ASSERT_TRUE(vs.set_weights(std::vector<float>(kDim, 2.0f)).ok());
+        auto data = test::random_floats(kCount * kDim, 4);
+        ProjectionOption option;
+        option.out_dim = kRank;
+        EXPECT_FALSE(ProjectionStage::train(&vs, data.data(), kCount, option).ok());
+    }
+} // namespace xann
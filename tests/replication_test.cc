@@ -0,0 +1,134 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <gtest/gtest.h>
+#include <xann/store/replication.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 16;
+    static constexpr uint64_t kLabels = 200;
+
+    /// same labels, same slot bytes, same tombstones.
+    static void expect_same_store(const MemStore &primary, const MemStore &replica) {
+        EXPECT_EQ(primary.size(), replica.size());
+        EXPECT_EQ(primary.tombstone_labels().size(), replica.tombstone_labels().size());
+        auto bytes = static_cast<size_t>(primary.get_vector_space()->vector_byte_size);
+        for (uint64_t label = 0; label < kLabels; ++label) {
+            auto prs = primary.get_vector_by_label(label);
+            auto rrs = replica.get_vector_by_label(label);
+            ASSERT_EQ(prs.ok(), rrs.ok()) << "label " << label;
+            if (!prs.ok()) {
+                continue;
+            }
+            auto p = prs.value_or_die();
+            auto r = rrs.value_or_die();
+            EXPECT_EQ(std::memcmp(p.data(), r.data(), bytes), 0) << "label " << label;
+            auto plid = primary.get_id(label).value_or_die();
+            auto rlid = replica.get_id(label).value_or_die();
+            EXPECT_EQ(primary.id_manager()->ids()[plid].status, replica.id_manager()->ids()[rlid].status)
+                                << "label " << label;
+        }
+    }
+
+    /// adds, overwrites, tombstones and removes of labels [from, to), one snapshot each.
+    static void mutate(MemStore *store, uint64_t from, uint64_t to, uint64_t seed) {
+        auto snapshot = store->snapshot_id();
+        auto data = test::random_floats(kDim * (to - from), seed);
+        for (uint64_t label = from; label < to; ++label) {
+            auto v = test::as_bytes(data.data() + (label - from) * kDim, kDim);
+            ASSERT_TRUE(store->add_vector(++snapshot, label, v).ok());
+        }
+        for (uint64_t label = from; label < to; label += 7) {
+            auto v = test::as_bytes(data.data() + (to - label - 1) * kDim, kDim);
+            ASSERT_TRUE(store->set_vector(++snapshot, label, v).ok());
+        }
+        for (uint64_t label = from + 3; label < to; label += 11) {
+            store->tombstone_vector_by_label(++snapshot, label);
+        }
+        for (uint64_t label = from + 5; label < to; label += 13) {
+            store->remove_vector_by_label(++snapshot, label);
+        }
+    }
+
+    /// a replica bootstrapped half way and tailed through a queue matches the primary.
+    TEST(Replication, snapshot_then_tail_matches_primary) {
+        auto vs = test::make_space(kDim, kL2);
+        VectorStoreOption option;
+        option.max_elements = kLabels;
+        auto primary = MemStore::create(&vs, option).value_or_die();
+        ChangeLog log;
+        primary->set_change_log(&log);
+        mutate(primary.get(), 0, kLabels / 2, 1);
+
+        auto snapshot = make_replication_snapshot(*primary);
+        ASSERT_TRUE(snapshot.ok());
+        auto replica = MemStore::create(&vs, option).value_or_die();
+        ReplicaApplier applier(replica.get());
+        ASSERT_TRUE(applier.bootstrap(snapshot.value_or_die()).ok());
+        expect_same_store(*primary, *replica);
+
+        mutate(primary.get(), kLabels / 2, kLabels, 2);
+        QueueTransport transport;
+        LogShipper shipper(&log, &transport, snapshot.value_or_die().sequence);
+        ASSERT_TRUE(shipper.ship(1 << 20).ok());
+        ASSERT_TRUE(applier.tail(&transport, 1 << 20).ok());
+        EXPECT_EQ(applier.applied_sequence(), log.last_sequence());
+        expect_same_store(*primary, *replica);
+
+        /// redelivery is skipped by sequence.
+        LogShipper again(&log, &transport, snapshot.value_or_die().sequence);
+        ASSERT_TRUE(again.ship(1 << 20).ok());
+        ASSERT_TRUE(applier.tail(&transport, 1 << 20).ok());
+        expect_same_store(*primary, *replica);
+    }
+
+    /// a weighted space stores prepared slots, the snapshot must not be
+    /// prepared a second time on the replica. tails through a file.
+    TEST(Replication, transformed_space_is_prepared_once) {
+        auto vs = test::make_space(kDim, kWeightedL2);
+        ASSERT_TRUE(vs.set_weights(test::random_floats(kDim, 3, 0.5f, 4.0f)).ok());
+        VectorStoreOption option;
+        option.max_elements = kLabels;
+        auto primary = MemStore::create(&vs, option).value_or_die();
+        ChangeLog log;
+        primary->set_change_log(&log);
+        mutate(primary.get(), 0, kLabels / 2, 4);
+
+        auto snapshot = make_replication_snapshot(*primary);
+        ASSERT_TRUE(snapshot.ok());
+        auto replica = MemStore::create(&vs, option).value_or_die();
+        ReplicaApplier applier(replica.get());
+        ASSERT_TRUE(applier.bootstrap(snapshot.value_or_die()).ok());
+        expect_same_store(*primary, *replica);
+
+        auto path = ::testing::TempDir() + "xann_replication_test.log";
+        std::remove(path.c_str());
+        mutate(primary.get(), kLabels / 2, kLabels, 5);
+        FileTransport writer(path);
+        LogShipper shipper(&log, &writer, snapshot.value_or_die().sequence);
+        ASSERT_TRUE(shipper.ship(1 << 20).ok());
+        FileTransport reader(path);
+        ASSERT_TRUE(applier.tail(&reader, 1 << 20).ok());
+        expect_same_store(*primary, *replica);
+        std::remove(path.c_str());
+    }
+} // namespace xann
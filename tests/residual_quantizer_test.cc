@@ -0,0 +1,108 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <cmath>
+#include <limits>
+#include <gtest/gtest.h>
+#include <xann/common/thread_pool.h>
+#include <xann/quantization/residual_quantizer.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr size_t kDim = 16;
+    static constexpr size_t kCount = 2000;
+
+    static double mean_squared_error(const ResidualQuantizer &rq, const std::vector<float> &data, size_t n) {
+        std::vector<uint8_t> codes(n * rq.code_size());
+        rq.encode_n(data.data(), n, codes.data());
+        std::vector<float> x(kDim);
+        double total = 0.0;
+        for (size_t i = 0; i < n; ++i) {
+            rq.decode(codes.data() + i * rq.code_size(), x.data());
+            for (size_t d = 0; d < kDim; ++d) {
+                auto diff = static_cast<double>(data[i * kDim + d]) - x[d];
+                total += diff * diff;
+            }
+        }
+        return total / static_cast<double>(n);
+    }
+
+    /// the codebooks do not depend on the beam, so a wider beam searches a
+    /// larger set of codes over the same codebooks and can only do as well.
+    TEST(ResidualQuantizer, error_does_not_grow_with_beam) {
+        auto data = test::clustered_floats(kCount, kDim, 20, 0.2f, 1);
+        ThreadPool pool(1);
+        double last = std::numeric_limits<double>::infinity();
+        double greedy = 0.0;
+        for (uint32_t beam: {1u, 2u, 4u, 8u, 16u}) {
+            RqOption option;
+            option.m = 4;
+            option.train_iterations = 10;
+            option.beam_size = beam;
+            option.pool = &pool;
+            ResidualQuantizer rq;
+            ASSERT_TRUE(rq.train(data.data(), kCount, kDim, option).ok());
+            auto mse = mean_squared_error(rq, data, kCount);
+            EXPECT_LE(mse, last * (1.0 + 1e-4)) << "beam " << beam;
+            last = mse;
+            if (beam == 1) {
+                greedy = mse;
+            }
+        }
+        EXPECT_LT(last, greedy);
+    }
+
+    /// more stages shrink the error, the norm and table helpers agree with decode.
+    TEST(ResidualQuantizer, stages_and_tables_agree_with_decode) {
+        auto data = test::clustered_floats(kCount, kDim, 20, 0.2f, 2);
+        double last = std::numeric_limits<double>::infinity();
+        for (uint32_t m: {1u, 2u, 4u}) {
+            RqOption option;
+            option.m = m;
+            option.train_iterations = 10;
+            ResidualQuantizer rq;
+            ASSERT_TRUE(rq.train(data.data(), kCount, kDim, option).ok());
+            EXPECT_EQ(rq.code_size(), m);
+            auto mse = mean_squared_error(rq, data, kCount);
+            EXPECT_LT(mse, last) << "m " << m;
+            last = mse;
+        }
+
+        RqOption option;
+        option.m = 4;
+        ResidualQuantizer rq;
+        ASSERT_TRUE(rq.train(data.data(), kCount, kDim, option).ok());
+        std::vector<uint8_t> code(rq.code_size());
+        std::vector<float> x(kDim);
+        std::vector<float> table(rq.m() * rq.ksub());
+        auto *q = data.data() + 7 * kDim;
+        rq.compute_ip_table(q, table.data());
+        for (size_t i = 0; i < 50; ++i) {
+            rq.encode(data.data() + i * kDim, code.data());
+            rq.decode(code.data(), x.data());
+            float norm = 0.0f;
+            float ip = 0.0f;
+            for (size_t d = 0; d < kDim; ++d) {
+                norm += x[d] * x[d];
+                ip += q[d] * x[d];
+            }
+            EXPECT_NEAR(rq.reconstruction_norm(code.data()), norm, 1e-3f * (1.0f + norm));
+            EXPECT_NEAR(rq.table_sum(table.data(), code.data()), ip, 1e-3f * (1.0f + std::abs(ip)));
+        }
+        EXPECT_FALSE(ResidualQuantizer().train(data.data(), 0, kDim, option).ok());
+    }
+} // namespace xann
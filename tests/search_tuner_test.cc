@@ -0,0 +1,147 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <gtest/gtest.h>
+#include <xann/collection/sharded_collection.h>
+#include <xann/index/hnsw_index.h>
+#include <xann/index/search_tuner.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 16;
+    static constexpr size_t kCount = 1000;
+    static constexpr size_t kQueries = 40;
+
+    static std::vector<std::vector<uint8_t> > as_queries(const std::vector<float> &data, size_t n) {
+        std::vector<std::vector<uint8_t> > out;
+        for (size_t i = 0; i < n; ++i) {
+            auto bytes = test::as_bytes(data.data() + i * kDim, kDim);
+            out.emplace_back(bytes.begin(), bytes.end());
+        }
+        return out;
+    }
+
+    static SearchTunerOption tuner_option() {
+        SearchTunerOption option;
+        option.k = 10;
+        option.target_recall = 0.95f;
+        option.max_value = 512;
+        option.drift_ratio = 0.2;
+        return option;
+    }
+
+    /// the tuned ef meets the target on the tuning queries and is the one
+    /// searches with use_tuning pick up.
+    TEST(SearchTuner, reaches_recall_target) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 1);
+        auto raw = test::random_floats(kDim * kQueries, 2);
+        auto store = test::make_store(&vs, data, kCount);
+        HnswOption hnsw;
+        hnsw.m = 4;
+        hnsw.ef_construction = 40;
+        HnswIndex index(hnsw);
+        ASSERT_TRUE(index.build(store.get()).ok());
+
+        SearchTuner tuner(tuner_option());
+        EXPECT_TRUE(tuner.needs_retune(index));
+        auto rs = tuner.tune(&index, as_queries(raw, kQueries));
+        ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+        auto tuning = rs.value_or_die();
+        EXPECT_EQ(tuning.knob, SearchKnob::kEf);
+        EXPECT_GE(tuning.recall, 0.95f);
+        EXPECT_GE(tuning.value, 10u);
+        EXPECT_LT(tuning.value, 512u);
+        EXPECT_EQ(tuning.size, kCount);
+        EXPECT_EQ(index.tuning().value, tuning.value);
+
+        SearchOption search;
+        search.k = 10;
+        search.use_tuning = true;
+        EXPECT_EQ(index.tuned_option(search).ef, tuning.value);
+        EXPECT_GE(test::mean_recall(index, store.get(), raw, kQueries, index.tuned_option(search)), 0.95);
+        EXPECT_FALSE(tuner.needs_retune(index));
+    }
+
+    /// retune only once the store saw more than drift_ratio of its tuned size in mutations.
+    TEST(SearchTuner, retunes_after_drift) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount * 2, 3);
+        auto raw = test::random_floats(kDim * kQueries, 4);
+        auto store = test::make_store(&vs, data, kCount);
+        HnswIndex index;
+        ASSERT_TRUE(index.build(store.get()).ok());
+        SearchTuner tuner(tuner_option());
+        auto queries = as_queries(raw, kQueries);
+        auto rs = tuner.maybe_retune(&index, queries);
+        ASSERT_TRUE(rs.ok());
+        EXPECT_TRUE(rs.value_or_die());
+
+        auto add = [&](size_t from, size_t to) {
+            for (auto i = from; i < to; ++i) {
+                auto ars = store->add_vector(i, i, test::as_bytes(data.data() + i * kDim, kDim));
+                ASSERT_TRUE(ars.ok());
+                ASSERT_TRUE(index.add(ars.value_or_die()).ok());
+            }
+        };
+        add(kCount, kCount + kCount / 10);
+        EXPECT_FALSE(tuner.needs_retune(index));
+        rs = tuner.maybe_retune(&index, queries);
+        ASSERT_TRUE(rs.ok());
+        EXPECT_FALSE(rs.value_or_die());
+
+        add(kCount + kCount / 10, kCount + kCount / 4);
+        EXPECT_TRUE(tuner.needs_retune(index));
+        rs = tuner.maybe_retune(&index, queries);
+        ASSERT_TRUE(rs.ok());
+        EXPECT_TRUE(rs.value_or_die());
+        EXPECT_EQ(index.tuning().size, kCount + kCount / 4);
+        EXPECT_FALSE(tuner.needs_retune(index));
+    }
+
+    /// writes to one shard leave the tuning of the others current.
+    TEST(SearchTuner, shard_drift_is_per_shard) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount * 2, 5);
+        auto raw = test::random_floats(kDim * kQueries, 6);
+        ShardedCollectionOption option;
+        option.num_shards = 2;
+        option.partition = PartitionType::kRange;
+        option.range_bounds = {kCount / 2};
+        auto crs = ShardedCollection::create(&vs, option, []() { return std::make_unique<HnswIndex>(); });
+        ASSERT_TRUE(crs.ok());
+        auto c = std::move(crs).value_or_die();
+        for (size_t i = 0; i < kCount; ++i) {
+            ASSERT_TRUE(c->add_vector(i, test::as_bytes(data.data() + i * kDim, kDim)).ok());
+        }
+        SearchTuner tuner(tuner_option());
+        auto queries = as_queries(raw, kQueries);
+        auto rs = c->tune(tuner, queries);
+        ASSERT_TRUE(rs.ok());
+        EXPECT_EQ(rs.value_or_die(), 2u);
+
+        /// labels past the bound all land in shard 1, half its size is drift.
+        for (size_t i = kCount; i < kCount + kCount / 4; ++i) {
+            ASSERT_TRUE(c->add_vector(i, test::as_bytes(data.data() + i * kDim, kDim)).ok());
+        }
+        EXPECT_FALSE(tuner.needs_retune(*c->shard_index(0)));
+        EXPECT_TRUE(tuner.needs_retune(*c->shard_index(1)));
+        rs = c->tune(tuner, queries);
+        ASSERT_TRUE(rs.ok());
+        EXPECT_EQ(rs.value_or_die(), 1u);
+    }
+} // namespace xann
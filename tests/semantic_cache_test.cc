@@ -0,0 +1,152 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <cmath>
+#include <gtest/gtest.h>
+#include <xann/index/semantic_cache.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 16;
+    static constexpr size_t kCount = 500;
+
+    /// q plus a random offset of length rel * |q|.
+    static std::vector<float> perturb(const float *q, float rel, uint64_t seed) {
+        auto noise = test::random_floats(kDim, seed);
+        float qn = 0.0f, nn = 0.0f;
+        for (int i = 0; i < kDim; ++i) {
+            qn += q[i] * q[i];
+            nn += noise[i] * noise[i];
+        }
+        auto scale = rel * std::sqrt(qn / nn);
+        std::vector<float> out(q, q + kDim);
+        for (int i = 0; i < kDim; ++i) {
+            out[i] += noise[i] * scale;
+        }
+        return out;
+    }
+
+    static std::vector<SearchHit> search_one(const VectorIndex &index, const float *q, uint32_t k = 10) {
+        SearchOption option;
+        option.k = k;
+        auto rs = index.search(test::as_bytes(q, kDim), option);
+        EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+        return rs.ok() ? rs.value_or_die() : std::vector<SearchHit>{};
+    }
+
+    static std::vector<uint64_t> labels_of(const std::vector<SearchHit> &hits) {
+        std::vector<uint64_t> out;
+        for (auto &h: hits) {
+            out.push_back(h.label);
+        }
+        return out;
+    }
+
+    TEST(SemanticCache, hit_on_same_and_near_duplicate_query) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 1);
+        auto store = test::make_store(&vs, data, kCount);
+        SemanticCacheOption option;
+        option.guard_interval = 0;
+        SemanticCacheIndex index(std::make_unique<FlatIndex>(), option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+
+        auto q = test::random_floats(kDim, 2);
+        auto first = search_one(index, q.data());
+        auto again = search_one(index, q.data());
+        auto near = perturb(q.data(), 0.01f, 3);
+        auto served = search_one(index, near.data());
+        auto stats = index.stats();
+        EXPECT_EQ(stats.misses, 1u);
+        EXPECT_EQ(stats.hits, 2u);
+        EXPECT_EQ(labels_of(again), labels_of(first));
+        EXPECT_EQ(labels_of(served), labels_of(first));
+    }
+
+    /// inner product space: 3q scores well against q but is not a duplicate of it.
+    TEST(SemanticCache, miss_on_scaled_far_or_other_params) {
+        auto vs = test::make_space(kDim, kIP);
+        auto data = test::random_floats(kDim * kCount, 4);
+        auto store = test::make_store(&vs, data, kCount);
+        SemanticCacheOption option;
+        option.guard_interval = 0;
+        SemanticCacheIndex index(std::make_unique<FlatIndex>(), option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+
+        auto q = test::random_floats(kDim, 5);
+        search_one(index, q.data());
+        std::vector<float> scaled(q);
+        for (auto &v: scaled) {
+            v *= 3.0f;
+        }
+        search_one(index, scaled.data());
+        auto far = perturb(q.data(), 0.5f, 6);
+        search_one(index, far.data());
+        search_one(index, q.data(), 5);
+        auto stats = index.stats();
+        EXPECT_EQ(stats.hits, 0u);
+        EXPECT_EQ(stats.misses, 4u);
+    }
+
+    TEST(SemanticCache, stale_entry_is_not_served) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 7);
+        auto store = test::make_store(&vs, data, kCount);
+        SemanticCacheOption option;
+        option.guard_interval = 0;
+        option.max_staleness = 0;
+        SemanticCacheIndex index(std::make_unique<FlatIndex>(), option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+
+        auto q = test::random_floats(kDim, 8);
+        search_one(index, q.data());
+        auto rs = store->add_vector(1, kCount, test::as_bytes(q.data(), kDim));
+        ASSERT_TRUE(rs.ok());
+        ASSERT_TRUE(index.add(rs.value_or_die()).ok());
+        auto hits = search_one(index, q.data());
+        ASSERT_FALSE(hits.empty());
+        EXPECT_EQ(hits[0].label, kCount);
+        EXPECT_EQ(index.stats().hits, 0u);
+        EXPECT_EQ(index.stats().misses, 2u);
+    }
+
+    /// a loose epsilon serves neighbors of other queries, the guard sees the
+    /// low recall and tightens it.
+    TEST(SemanticCache, guard_shrinks_epsilon_on_low_recall) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 9);
+        auto store = test::make_store(&vs, data, kCount);
+        SemanticCacheOption option;
+        option.epsilon = 1.0f;
+        option.guard_interval = 1;
+        option.min_recall = 0.9f;
+        SemanticCacheIndex index(std::make_unique<FlatIndex>(), option);
+        ASSERT_TRUE(index.build(store.get()).ok());
+
+        for (uint64_t i = 0; i < 10; ++i) {
+            auto q = test::random_floats(kDim, 100 + i);
+            search_one(index, q.data());
+            auto other = perturb(q.data(), 0.6f, 200 + i);
+            search_one(index, other.data());
+        }
+        auto stats = index.stats();
+        EXPECT_GT(stats.guard_checks, 0u);
+        EXPECT_GT(stats.guard_failures, 0u);
+        EXPECT_LT(stats.epsilon, option.epsilon);
+        EXPECT_LT(stats.recall, 1.0f);
+    }
+} // namespace xann
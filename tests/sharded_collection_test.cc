@@ -0,0 +1,183 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <gtest/gtest.h>
+#include <xann/collection/sharded_collection.h>
+#include <xann/index/hnsw_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    static constexpr int kDim = 16;
+    static constexpr size_t kCount = 400;
+
+    static std::unique_ptr<ShardedCollection> make_collection(const VectorSpace *vs, const std::vector<float> &data,
+                                                             size_t n, uint32_t num_shards = 2) {
+        ShardedCollectionOption option;
+        option.num_shards = num_shards;
+        auto rs = ShardedCollection::create(vs, option, []() { return std::make_unique<HnswIndex>(); });
+        EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+        auto c = std::move(rs).value_or_die();
+        for (size_t i = 0; i < n; ++i) {
+            auto ars = c->add_vector(i, test::as_bytes(data.data() + i * kDim, kDim));
+            EXPECT_TRUE(ars.ok()) << ars.status().to_string();
+        }
+        return c;
+    }
+
+    static std::vector<SearchHit> search_one(const ShardedCollection &c, const float *query, uint32_t k) {
+        SearchOption option;
+        option.k = k;
+        option.ef = 64;
+        auto rs = c.search(test::as_bytes(query, kDim), option);
+        EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+        return rs.ok() ? rs.value_or_die() : std::vector<SearchHit>{};
+    }
+
+    /// hnsw keeps a removed lid as a routing node until consolidation, the
+    /// label added again takes it back and is found under its new vector.
+    TEST(ShardedCollection, add_after_remove_on_hnsw_shard) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 11);
+        auto c = make_collection(&vs, data, kCount);
+        uint64_t label = 7;
+        auto shard = c->shard_of(label);
+        auto lid = c->shard_store(shard)->get_id(label).value_or_die();
+        c->remove_vector(label);
+        EXPECT_GT(c->shard_index(shard)->pending_deletes(), 0u);
+        EXPECT_EQ(c->size(), kCount - 1);
+
+        auto moved = test::random_floats(kDim, 12, 5.0f, 6.0f);
+        auto rs = c->add_vector(label, test::as_bytes(moved.data(), kDim));
+        ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+        EXPECT_EQ(rs.value_or_die(), lid);
+        EXPECT_EQ(c->size(), kCount);
+        EXPECT_EQ(c->shard_index(shard)->pending_deletes(), 0u);
+        auto hits = search_one(*c, moved.data(), 1);
+        ASSERT_EQ(hits.size(), 1u);
+        EXPECT_EQ(hits[0].label, label);
+        EXPECT_FLOAT_EQ(hits[0].distance, 0.0f);
+
+        /// nothing is left for consolidation to free under the live label.
+        auto crs = c->consolidate_shard(shard);
+        ASSERT_TRUE(crs.ok());
+        EXPECT_EQ(crs.value_or_die(), 0u);
+        EXPECT_TRUE(c->shard_store(shard)->is_live(lid));
+    }
+
+    /// a removed label is gone for set_vector even while its lid is pending,
+    /// and stays out of the results.
+    TEST(ShardedCollection, set_after_remove_on_hnsw_shard) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 13);
+        auto c = make_collection(&vs, data, kCount);
+        uint64_t label = 9;
+        c->remove_vector(label);
+        auto moved = test::random_floats(kDim, 14, 5.0f, 6.0f);
+        auto rs = c->set_vector(label, test::as_bytes(moved.data(), kDim));
+        EXPECT_FALSE(rs.ok());
+        EXPECT_EQ(c->size(), kCount - 1);
+        for (auto &h: search_one(*c, moved.data(), 10)) {
+            EXPECT_NE(h.label, label);
+        }
+
+        /// after consolidation the label is unknown, an add starts it over.
+        ASSERT_TRUE(c->compact_shard(c->shard_of(label)).ok());
+        EXPECT_FALSE(c->set_vector(label, test::as_bytes(moved.data(), kDim)).ok());
+        ASSERT_TRUE(c->add_vector(label, test::as_bytes(moved.data(), kDim)).ok());
+        auto hits = search_one(*c, moved.data(), 1);
+        ASSERT_EQ(hits.size(), 1u);
+        EXPECT_EQ(hits[0].label, label);
+    }
+
+    /// every label lives in the store of shard_of(label), hashing spreads
+    /// sequential labels and range bounds split them as configured.
+    TEST(ShardedCollection, labels_land_in_their_partition) {
+        auto vs = test::make_space(kDim, kL2);
+        auto data = test::random_floats(kDim * kCount, 15);
+        for (auto partition: {PartitionType::kHash, PartitionType::kRange}) {
+            ShardedCollectionOption option;
+            option.num_shards = 4;
+            option.partition = partition;
+            option.range_bounds = {100, 200, 300};
+            auto rs = ShardedCollection::create(&vs, option);
+            ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+            auto c = std::move(rs).value_or_die();
+            for (size_t i = 0; i < kCount; ++i) {
+                ASSERT_TRUE(c->add_vector(i, test::as_bytes(data.data() + i * kDim, kDim)).ok());
+            }
+            EXPECT_EQ(c->size(), kCount);
+            for (size_t i = 0; i < kCount; ++i) {
+                auto shard = c->shard_of(i);
+                ASSERT_LT(shard, c->num_shards());
+                EXPECT_TRUE(c->shard_store(shard)->get_id(i).ok());
+                if (partition == PartitionType::kRange) {
+                    EXPECT_EQ(shard, std::min<size_t>(i / 100, 3));
+                }
+            }
+            for (size_t s = 0; s < c->num_shards(); ++s) {
+                /// 400 labels over 4 shards, a fair hash keeps each well away from 0 and 400.
+                EXPECT_GT(c->shard_store(s)->size(), 50u);
+                EXPECT_LT(c->shard_store(s)->size(), 150u);
+            }
+        }
+    }
+
+    TEST(ShardedCollection, create_rejects_bad_range_bounds) {
+        auto vs = test::make_space(kDim, kL2);
+        ShardedCollectionOption option;
+        option.num_shards = 3;
+        option.partition = PartitionType::kRange;
+        option.range_bounds = {100};
+        EXPECT_FALSE(ShardedCollection::create(&vs, option).ok());
+        option.range_bounds = {200, 100};
+        EXPECT_FALSE(ShardedCollection::create(&vs, option).ok());
+        option.num_shards = 0;
+        EXPECT_FALSE(ShardedCollection::create(&vs, option).ok());
+    }
+
+    /// flat shards are exact, the merged top-k must be the top-k of one flat
+    /// scan over every vector, for distance and similarity metrics.
+    TEST(ShardedCollection, merged_hits_match_one_flat_scan) {
+        for (auto metric: {kL2, kIP}) {
+            auto vs = test::make_space(kDim, metric);
+            auto data = test::random_floats(kDim * kCount, 16);
+            auto queries = test::random_floats(kDim * 20, 17);
+            auto all = test::make_store(&vs, data, kCount);
+            ShardedCollectionOption option;
+            option.num_shards = 5;
+            auto rs = ShardedCollection::create(&vs, option);
+            ASSERT_TRUE(rs.ok());
+            auto c = std::move(rs).value_or_die();
+            for (size_t i = 0; i < kCount; ++i) {
+                ASSERT_TRUE(c->add_vector(i, test::as_bytes(data.data() + i * kDim, kDim)).ok());
+            }
+            for (size_t q = 0; q < 20; ++q) {
+                auto *query = queries.data() + q * kDim;
+                auto truth = test::exact_search(all.get(), query, 10);
+                SearchOption search;
+                search.k = 10;
+                auto hits = c->search(test::as_bytes(query, kDim), search);
+                ASSERT_TRUE(hits.ok());
+                ASSERT_EQ(hits.value_or_die().size(), truth.size());
+                for (size_t i = 0; i < truth.size(); ++i) {
+                    EXPECT_EQ(hits.value_or_die()[i].label, truth[i].label) << "metric " << metric << " rank " << i;
+                    EXPECT_FLOAT_EQ(hits.value_or_die()[i].distance, truth[i].distance);
+                }
+            }
+        }
+    }
+} // namespace xann
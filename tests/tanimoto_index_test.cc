@@ -0,0 +1,236 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <bitset>
+#include <map>
+#include <gtest/gtest.h>
+#include <xann/index/tanimoto_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    /// bytes per fingerprint, 256 bits.
+    static constexpr int kDim = 32;
+    static constexpr size_t kCount = 3000;
+    static constexpr size_t kQueries = 40;
+
+    /// fingerprints of mixed density so every query sees many popcount bins.
+    static std::vector<uint8_t> fingerprints(size_t n, uint64_t seed) {
+        std::mt19937_64 rng(seed);
+        std::uniform_real_distribution<float> density(0.05f, 0.5f);
+        std::uniform_real_distribution<float> coin(0.0f, 1.0f);
+        std::vector<uint8_t> out(n * kDim, 0);
+        for (size_t i = 0; i < n; ++i) {
+            auto p = density(rng);
+            for (size_t bit = 0; bit < kDim * 8; ++bit) {
+                if (coin(rng) < p) {
+                    out[i * kDim + bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+                }
+            }
+        }
+        return out;
+    }
+
+    /// stored fingerprints with a few bits flipped, so the top hits sit close.
+    static std::vector<uint8_t> queries_near(const std::vector<uint8_t> &data, uint64_t seed) {
+        std::mt19937_64 rng(seed);
+        std::uniform_int_distribution<size_t> pick(0, kCount - 1);
+        std::uniform_int_distribution<size_t> bit(0, kDim * 8 - 1);
+        std::vector<uint8_t> out(kQueries * kDim);
+        for (size_t q = 0; q < kQueries; ++q) {
+            std::copy_n(data.begin() + pick(rng) * kDim, kDim, out.begin() + q * kDim);
+            for (int flip = 0; flip < 12; ++flip) {
+                auto b = bit(rng);
+                out[q * kDim + b / 8] ^= static_cast<uint8_t>(1u << (b % 8));
+            }
+        }
+        return out;
+    }
+
+    static turbo::span<uint8_t> fp(const std::vector<uint8_t> &v, size_t i) {
+        return {const_cast<uint8_t *>(v.data()) + i * kDim, static_cast<size_t>(kDim)};
+    }
+
+    static size_t bits(turbo::span<uint8_t> a) {
+        size_t n = 0;
+        for (auto byte: a) {
+            n += std::bitset<8>(byte).count();
+        }
+        return n;
+    }
+
+    /// 1 - tanimoto, computed the way the index computes it.
+    static float jaccard(turbo::span<uint8_t> a, turbo::span<uint8_t> b) {
+        size_t common = 0;
+        for (size_t i = 0; i < a.size(); ++i) {
+            common += std::bitset<8>(a[i] & b[i]).count();
+        }
+        auto joint = bits(a) + bits(b) - common;
+        return joint == 0 ? 0.0f : 1.0f - static_cast<float>(common) / static_cast<float>(joint);
+    }
+
+    /// a kJaccard store of kCount fingerprints, labeled 0..kCount-1. not
+    /// movable, the store points at vs.
+    struct Fixture {
+        Fixture() : vs(test::make_space(kDim, kJaccard, DataType::DT_UINT8)), data(fingerprints(kCount, 1)) {
+            VectorStoreOption option;
+            option.max_elements = kCount * 2;
+            auto rs = MemStore::create(&vs, option);
+            EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+            store = std::move(rs).value_or_die();
+            for (size_t i = 0; i < kCount; ++i) {
+                EXPECT_TRUE(store->add_vector(0, i, fp(data, i)).ok());
+                live[i] = i;
+            }
+        }
+
+        Fixture(const Fixture &) = delete;
+
+        VectorSpace vs;
+        std::vector<uint8_t> data;
+        std::unique_ptr<MemStore> store;
+        /// label to fingerprint index of every live label.
+        std::map<uint64_t, size_t> live;
+    };
+
+    /// brute force distances of every live label to query, best first.
+    static std::vector<std::pair<float, uint64_t> > brute_force(const Fixture &f, turbo::span<uint8_t> query) {
+        std::vector<std::pair<float, uint64_t> > all;
+        for (auto &[label, i]: f.live) {
+            all.emplace_back(jaccard(query, fp(f.data, i)), label);
+        }
+        std::sort(all.begin(), all.end());
+        return all;
+    }
+
+    /// popcount ties make the order among equal scores arbitrary, so compare
+    /// the score at every rank and check each hit carries its own score.
+    static void expect_exact_top_k(const TanimotoIndex &index, const Fixture &f, const std::vector<uint8_t> &queries,
+                                   uint32_t k) {
+        SearchOption option;
+        option.k = k;
+        for (size_t q = 0; q < kQueries; ++q) {
+            auto query = fp(queries, q);
+            auto truth = brute_force(f, query);
+            auto rs = index.search(query, option);
+            ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+            auto &hits = rs.value_or_die();
+            ASSERT_EQ(hits.size(), std::min<size_t>(k, truth.size()));
+            for (size_t i = 0; i < hits.size(); ++i) {
+                EXPECT_FLOAT_EQ(hits[i].distance, truth[i].first) << "query " << q << " rank " << i;
+                ASSERT_TRUE(f.live.count(hits[i].label)) << "dead label " << hits[i].label;
+                EXPECT_FLOAT_EQ(hits[i].distance, jaccard(query, fp(f.data, f.live.at(hits[i].label))));
+            }
+        }
+    }
+
+    TEST(TanimotoIndex, search_matches_brute_force) {
+        Fixture f;
+        auto queries = queries_near(f.data, 2);
+        TanimotoIndex index;
+        ASSERT_TRUE(index.build(f.store.get()).ok());
+        ASSERT_TRUE(index.bins_supported());
+        for (uint32_t k: {1u, 10u, 100u}) {
+            SCOPED_TRACE(k);
+            expect_exact_top_k(index, f, queries, k);
+        }
+        /// the near copy is found after visiting only the bins close to the query.
+        SearchOption option;
+        option.k = 1;
+        ASSERT_TRUE(index.search(fp(queries, 0), option).ok());
+        EXPECT_LT(index.last_evaluations(), kCount);
+    }
+
+    TEST(TanimotoIndex, threshold_search_matches_brute_force) {
+        Fixture f;
+        auto queries = queries_near(f.data, 3);
+        TanimotoIndex index;
+        ASSERT_TRUE(index.build(f.store.get()).ok());
+        SearchOption option;
+        for (float t: {0.3f, 0.6f, 0.9f}) {
+            for (size_t q = 0; q < kQueries; ++q) {
+                auto query = fp(queries, q);
+                std::vector<uint64_t> truth;
+                for (auto &[d, label]: brute_force(f, query)) {
+                    if (1.0f - d >= t) {
+                        truth.push_back(label);
+                    }
+                }
+                auto rs = index.threshold_search(query, t, option);
+                ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+                std::vector<uint64_t> got;
+                float last = 0.0f;
+                for (auto &hit: rs.value_or_die()) {
+                    EXPECT_GE(hit.distance, last) << "not best first";
+                    last = hit.distance;
+                    got.push_back(hit.label);
+                }
+                std::sort(got.begin(), got.end());
+                std::sort(truth.begin(), truth.end());
+                EXPECT_EQ(got, truth) << "threshold " << t << " query " << q;
+                if (t >= 0.9f) {
+                    EXPECT_LT(index.last_evaluations(), kCount) << "threshold " << t;
+                }
+            }
+        }
+    }
+
+    /// bins stay exact as removes swap entries around and adds land in new bins.
+    TEST(TanimotoIndex, exact_after_removes_and_adds) {
+        Fixture f;
+        auto extra = fingerprints(500, 4);
+        auto queries = queries_near(f.data, 5);
+        TanimotoIndex index;
+        ASSERT_TRUE(index.build(f.store.get()).ok());
+        for (uint64_t label = 0; label < kCount; label += 3) {
+            auto lid = f.store->get_id(label).value_or_die();
+            f.store->tombstone_vector_by_label(0, label);
+            ASSERT_TRUE(index.remove(lid).ok());
+            f.store->remove_vector_by_label(0, label);
+            f.live.erase(label);
+        }
+        f.data.insert(f.data.end(), extra.begin(), extra.end());
+        for (size_t i = 0; i < 500; ++i) {
+            auto label = kCount + i;
+            auto rs = f.store->add_vector(0, label, fp(f.data, label));
+            ASSERT_TRUE(rs.ok());
+            ASSERT_TRUE(index.add(rs.value_or_die()).ok());
+            f.live[label] = label;
+        }
+        EXPECT_EQ(index.size(), f.live.size());
+        expect_exact_top_k(index, f, queries, 10);
+    }
+
+    /// spaces without bins fall back to flat scans and refuse threshold search.
+    TEST(TanimotoIndex, other_metric_falls_back) {
+        auto vs = test::make_space(8, kL2);
+        auto data = test::random_floats(8 * 200, 6);
+        auto store = test::make_store(&vs, data, 200);
+        TanimotoIndex index;
+        ASSERT_TRUE(index.build(store.get()).ok());
+        EXPECT_FALSE(index.bins_supported());
+        SearchOption option;
+        option.k = 5;
+        auto rs = index.search(test::as_bytes(data.data(), 8), option);
+        ASSERT_TRUE(rs.ok());
+        auto truth = test::exact_search(store.get(), data.data(), 5);
+        ASSERT_EQ(rs.value_or_die().size(), truth.size());
+        for (size_t i = 0; i < truth.size(); ++i) {
+            EXPECT_EQ(rs.value_or_die()[i].label, truth[i].label);
+        }
+        EXPECT_FALSE(index.threshold_search(test::as_bytes(data.data(), 8), 0.5f, option).ok());
+    }
+} // namespace xann
@@ -0,0 +1,186 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include <turbo/container/span.h>
+#include <xann/core/query_vector.h>
+#include <xann/core/search.h>
+#include <xann/core/vector_space.h>
+#include <xann/index/flat_index.h>
+#include <xann/index/vector_index.h>
+#include <xann/store/store.h>
+
+namespace xann::test {
+
+    /// n uniform floats in [lo, hi).
+    inline std::vector<float> random_floats(size_t n, uint64_t seed, float lo = -1.0f, float hi = 1.0f) {
+        std::mt19937_64 rng(seed);
+        std::uniform_real_distribution<float> dist(lo, hi);
+        std::vector<float> out(n);
+        for (auto &v: out) {
+            v = dist(rng);
+        }
+        return out;
+    }
+
+    /// n dim vectors around clusters random centers in [-1, 1), gaussian noise of sigma.
+    inline std::vector<float> clustered_floats(size_t n, size_t dim, size_t clusters, float sigma, uint64_t seed) {
+        auto centers = random_floats(clusters * dim, seed);
+        std::mt19937_64 rng(seed + 1);
+        std::normal_distribution<float> noise(0.0f, sigma);
+        std::vector<float> out(n * dim);
+        for (size_t i = 0; i < n; ++i) {
+            auto c = rng() % clusters;
+            for (size_t j = 0; j < dim; ++j) {
+                out[i * dim + j] = centers[c * dim + j] + noise(rng);
+            }
+        }
+        return out;
+    }
+
+    inline turbo::span<uint8_t> as_bytes(const float *data, size_t n) {
+        return turbo::span<uint8_t>(reinterpret_cast<uint8_t *>(const_cast<float *>(data)), n * sizeof(float));
+    }
+
+    inline VectorSpace make_space(int dim, MetricType metric, DataType dt = DataType::DT_FLOAT) {
+        auto rs = VectorSpace::create(dim, metric, dt);
+        EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+        return rs.value_or_die();
+    }
+
+    /// a store over vs holding the n dim float vectors of data, labeled 0..n-1.
+    inline std::unique_ptr<MemStore> make_store(const VectorSpace *vs, const std::vector<float> &data, size_t n) {
+        VectorStoreOption option;
+        option.max_elements = static_cast<uint32_t>(std::max<size_t>(n, 1) * 2);
+        auto rs = MemStore::create(vs, option);
+        EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+        auto store = std::move(rs).value_or_die();
+        auto dim = static_cast<size_t>(vs->dim);
+        for (size_t i = 0; i < n; ++i) {
+            auto ars = store->add_vector(0, i, as_bytes(data.data() + i * dim, dim));
+            EXPECT_TRUE(ars.ok()) << ars.status().to_string();
+        }
+        return store;
+    }
+
+    /// exact top k of a float query in a DT_FLOAT store.
+    inline std::vector<SearchHit> exact_search(const MemStore *store, const float *query, uint32_t k) {
+        auto *vs = store->get_vector_space();
+        QueryVector qv(vs);
+        auto rs = qv.assign(as_bytes(query, static_cast<size_t>(vs->dim)));
+        EXPECT_TRUE(rs.ok()) << rs.to_string();
+        SearchOption option;
+        option.k = k;
+        return flat_scan(store, qv.span(), option);
+    }
+
+    /// share of truth labels found in got.
+    inline double recall(const std::vector<SearchHit> &got, const std::vector<SearchHit> &truth) {
+        if (truth.empty()) {
+            return 1.0;
+        }
+        size_t found = 0;
+        for (auto &t: truth) {
+            for (auto &g: got) {
+                if (g.label == t.label) {
+                    ++found;
+                    break;
+                }
+            }
+        }
+        return static_cast<double>(found) / static_cast<double>(truth.size());
+    }
+
+    /// recall@option.k of index over nq dim float queries, averaged.
+    inline double mean_recall(const VectorIndex &index, const MemStore *store, const std::vector<float> &queries,
+                              size_t nq, const SearchOption &option) {
+        auto dim = static_cast<size_t>(store->get_vector_space()->dim);
+        double sum = 0.0;
+        for (size_t q = 0; q < nq; ++q) {
+            auto *query = queries.data() + q * dim;
+            auto rs = index.search(as_bytes(query, dim), option);
+            EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+            if (rs.ok()) {
+                sum += recall(rs.value_or_die(), exact_search(store, query, option.k));
+            }
+        }
+        return sum / static_cast<double>(nq);
+    }
+
+    /// writers add vectors [from, to) of data (label = position) the way the
+    /// collections do, reserve + add_shared when the index allows it and add
+    /// under the exclusive lock otherwise, while readers keep searching under
+    /// shared locks until every writer is done.
+    inline void concurrent_add_and_search(MemStore *store, VectorIndex *index, const std::vector<float> &data,
+                                          size_t from, size_t to, size_t writers, size_t readers,
+                                          const SearchOption &option) {
+        auto dim = static_cast<size_t>(store->get_vector_space()->dim);
+        std::atomic<size_t> running{writers};
+        std::vector<std::thread> threads;
+        for (size_t w = 0; w < writers; ++w) {
+            threads.emplace_back([&, w] {
+                for (size_t i = from + w; i < to; i += writers) {
+                    uint64_t lid = 0;
+                    {
+                        std::unique_lock<std::shared_mutex> lock(store->mutex());
+                        auto rs = store->add_vector(0, i, as_bytes(data.data() + i * dim, dim));
+                        EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+                        if (!rs.ok()) {
+                            continue;
+                        }
+                        lid = rs.value_or_die();
+                        auto st = index->concurrent_add() ? index->reserve(lid) : index->add(lid);
+                        EXPECT_TRUE(st.ok()) << st.to_string();
+                    }
+                    if (index->concurrent_add()) {
+                        std::shared_lock<std::shared_mutex> lock(store->mutex());
+                        auto st = index->add_shared(lid);
+                        EXPECT_TRUE(st.ok()) << st.to_string();
+                    }
+                }
+                running.fetch_sub(1);
+            });
+        }
+        for (size_t r = 0; r < readers; ++r) {
+            threads.emplace_back([&, r] {
+                size_t i = r;
+                while (running.load() > 0) {
+                    std::shared_lock<std::shared_mutex> lock(store->mutex());
+                    auto rs = index->search(as_bytes(data.data() + (i % to) * dim, dim), option);
+                    EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+                    if (rs.ok()) {
+                        EXPECT_LE(rs.value_or_die().size(), option.k);
+                    }
+                    i += readers;
+                }
+            });
+        }
+        for (auto &t: threads) {
+            t.join();
+        }
+    }
+} // namespace xann::test
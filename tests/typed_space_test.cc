@@ -0,0 +1,217 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <gtest/gtest.h>
+#include <xann/core/kernel_calibration.h>
+#include <xann/distance/typed_space.h>
+#include <xann/index/ivf_flat_index.h>
+#include "test_util.h"
+
+namespace xann {
+
+    /// not a multiple of any simd width, the tails are exercised.
+    static constexpr int kDim = 27;
+    static constexpr size_t kCount = 1500;
+    static constexpr size_t kQueries = 20;
+
+    static const MetricType kTypedMetrics[] = {
+        kL2, kIP, kCosine, kAngle, kNormalizedL2, kNormalizedCosine, kNormalizedAngle
+    };
+
+    /// every space this host and the registry can build for (metric, dt),
+    /// one per simd level.
+    static std::vector<VectorSpace> spaces_of(MetricType metric, DataType dt) {
+        std::vector<VectorSpace> out;
+        for (int l = 0; l < static_cast<int>(SimdLevel::SIMD_MAX); ++l) {
+            auto level = static_cast<SimdLevel>(l);
+            if (!simd_level_supported(level)) {
+                continue;
+            }
+            auto rs = VectorSpace::create(kDim, metric, dt, level);
+            if (rs.ok() && rs.value_or_die().operation.simd_level == level) {
+                out.push_back(std::move(rs).value_or_die());
+            }
+        }
+        return out;
+    }
+
+    static std::string describe(const VectorSpace &vs) {
+        return "metric " + std::to_string(vs.metric) + " dt " + std::to_string(static_cast<int>(vs.data_type)) +
+               " level " + std::to_string(static_cast<int>(vs.operation.simd_level));
+    }
+
+    /// n random vectors of the space data type, one vector_byte_size slot each.
+    static std::vector<uint8_t> random_vectors(const VectorSpace &vs, size_t n, uint64_t seed) {
+        std::mt19937_64 rng(seed);
+        auto stride = static_cast<size_t>(vs.vector_byte_size);
+        std::vector<uint8_t> out(n * stride, 0);
+        fill_random_vectors(vs.data_type, vs.dim, stride, out.data(), n, rng);
+        return out;
+    }
+
+    static turbo::span<uint8_t> slot(std::vector<uint8_t> &v, const VectorSpace &vs, size_t i) {
+        auto stride = static_cast<size_t>(vs.vector_byte_size);
+        return {v.data() + i * stride, stride};
+    }
+
+    /// the k best scores by the runtime operator, the function pointer path
+    /// the typed scans replace.
+    static std::vector<float> operator_top_k(const MemStore *store, turbo::span<uint8_t> query, size_t k) {
+        auto &op = store->get_vector_space()->operation;
+        std::vector<float> all;
+        for (auto lid: store->live_local_ids()) {
+            all.push_back(op.rank(query, store->vector_at(lid)));
+        }
+        k = std::min(k, all.size());
+        std::partial_sort(all.begin(), all.begin() + k, all.end());
+        all.resize(k);
+        return all;
+    }
+
+    /// scores of the hits by the runtime operator. integer and fp16 data tie
+    /// often, so scans are compared by score at each rank, not by label.
+    static std::vector<float> operator_scores(const MemStore *store, turbo::span<uint8_t> query,
+                                              const std::vector<SearchHit> &hits) {
+        auto &op = store->get_vector_space()->operation;
+        std::vector<float> scores;
+        for (auto &hit: hits) {
+            scores.push_back(op.rank(query, store->vector_at(hit.lid)));
+        }
+        return scores;
+    }
+
+    static void expect_same_scores(const std::vector<float> &got, const std::vector<float> &expect) {
+        ASSERT_EQ(got.size(), expect.size());
+        for (size_t i = 0; i < got.size(); ++i) {
+            EXPECT_FLOAT_EQ(got[i], expect[i]) << "rank " << i;
+        }
+    }
+
+    static std::unique_ptr<MemStore> make_typed_store(const VectorSpace *vs, std::vector<uint8_t> &data, size_t n) {
+        VectorStoreOption option;
+        option.max_elements = static_cast<uint32_t>(n * 2);
+        auto rs = MemStore::create(vs, option);
+        EXPECT_TRUE(rs.ok()) << rs.status().to_string();
+        auto store = std::move(rs).value_or_die();
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_TRUE(store->add_vector(0, i, slot(data, *vs, i)).ok());
+        }
+        return store;
+    }
+
+    /// the instantiation picked for a space is its own, and its kernels
+    /// score exactly like the registered operator.
+    TEST(TypedSpace, dispatch_matches_registered_operator) {
+        size_t dispatched = 0;
+        for (auto metric: kTypedMetrics) {
+            for (auto dt: {DataType::DT_FLOAT, DataType::DT_FLOAT16, DataType::DT_UINT8}) {
+                for (auto &vs: spaces_of(metric, dt)) {
+                    SCOPED_TRACE(describe(vs));
+                    auto data = random_vectors(vs, 64, 1);
+                    bool called = false;
+                    auto typed = dispatch_typed_space(&vs, [&](auto space) {
+                        using Space = decltype(space);
+                        called = true;
+                        EXPECT_EQ(Space::metric, vs.metric);
+                        EXPECT_EQ(Space::data_type, vs.data_type);
+                        EXPECT_EQ(Space::kScalar, vs.operation.simd_level == SimdLevel::SIMD_NONE);
+                        for (size_t i = 1; i < 64; ++i) {
+                            auto a = slot(data, vs, 0);
+                            auto b = slot(data, vs, i);
+                            auto bound = std::numeric_limits<float>::max();
+                            EXPECT_FLOAT_EQ(Space::rank(a, b), vs.operation.rank(a, b));
+                            EXPECT_FLOAT_EQ(Space::bounded_rank(a, b, bound),
+                                            vs.operation.bounded_rank(a, b, bound));
+                        }
+                    });
+                    EXPECT_EQ(typed, called);
+                    /// simd twins exist for DT_FLOAT only, other types dispatch at SIMD_NONE.
+                    auto twin = vs.data_type == DataType::DT_FLOAT || vs.operation.simd_level == SimdLevel::SIMD_NONE;
+                    EXPECT_EQ(typed, vs.operation.rank_vector != nullptr && twin);
+                    dispatched += typed;
+                }
+            }
+        }
+        EXPECT_GT(dispatched, 0u);
+        /// a metric without a typed twin keeps the function pointer path.
+        auto l1 = test::make_space(kDim, kL1);
+        EXPECT_FALSE(dispatch_typed_space(&l1, [](auto) {
+            ADD_FAILURE() << "kL1 has no typed space";
+        }));
+    }
+
+    /// flat_scan runs the typed loop, its top k equals a scan through the
+    /// runtime operator, with and without a filter.
+    TEST(TypedSpace, flat_scan_matches_operator_scan) {
+        for (auto metric: kTypedMetrics) {
+            for (auto dt: {DataType::DT_FLOAT, DataType::DT_FLOAT16, DataType::DT_UINT8}) {
+                for (auto &vs: spaces_of(metric, dt)) {
+                    SCOPED_TRACE(describe(vs));
+                    auto data = random_vectors(vs, kCount + kQueries, 2);
+                    auto store = make_typed_store(&vs, data, kCount);
+                    for (size_t q = 0; q < kQueries; ++q) {
+                        QueryVector qv(&vs);
+                        ASSERT_TRUE(qv.assign(slot(data, vs, kCount + q)).ok());
+                        SearchOption option;
+                        option.k = 10;
+                        auto hits = flat_scan(store.get(), qv.span(), option);
+                        expect_same_scores(operator_scores(store.get(), qv.span(), hits),
+                                           operator_top_k(store.get(), qv.span(), option.k));
+                        option.filter = [](uint64_t label) {
+                            return label % 3 == 0;
+                        };
+                        for (auto &hit: flat_scan(store.get(), qv.span(), option)) {
+                            EXPECT_EQ(hit.label % 3, 0u);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /// probing every list of the ivf index runs the typed probe loop over
+    /// all vectors, the answer equals the operator scan.
+    TEST(TypedSpace, ivf_full_probe_matches_operator_scan) {
+        for (auto metric: {kL2, kIP, kNormalizedCosine}) {
+            for (auto &vs: spaces_of(metric, DataType::DT_FLOAT)) {
+                SCOPED_TRACE(describe(vs));
+                auto data = test::clustered_floats(kCount + kQueries, kDim, 16, 0.1f, 3);
+                auto store = test::make_store(&vs, data, kCount);
+                IvfOption option;
+                option.nlist = 16;
+                option.min_train_size = 500;
+                IvfFlatIndex index(option);
+                ASSERT_TRUE(index.build(store.get()).ok());
+                ASSERT_TRUE(index.trained());
+                SearchOption search;
+                search.k = 10;
+                search.nprobe = 16;
+                for (size_t q = 0; q < kQueries; ++q) {
+                    auto query = test::as_bytes(data.data() + (kCount + q) * kDim, kDim);
+                    auto rs = index.search(query, search);
+                    ASSERT_TRUE(rs.ok()) << rs.status().to_string();
+                    QueryVector qv(&vs);
+                    ASSERT_TRUE(qv.assign(query).ok());
+                    expect_same_scores(operator_scores(store.get(), qv.span(), rs.value_or_die()),
+                                       operator_top_k(store.get(), qv.span(), search.k));
+                }
+            }
+        }
+    }
+} // namespace xann
@@ -0,0 +1,470 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/collection/collection_manager.h>
+#include <xann/index/flat_index.h>
+#include <xann/store/serializer.h>
+#include <algorithm>
+#include <cstdio>
+
+namespace xann {
+
+    static constexpr size_t kMaxNameLength = 128;
+
+    /// the name becomes a file name under spill_dir, so no separators, no
+    /// leading dot (".", "..", hidden files) and nothing a shell would quote.
+    static bool valid_collection_name(const std::string &name) {
+        if (name.empty() || name.size() > kMaxNameLength || name[0] == '.') {
+            return false;
+        }
+        return std::all_of(name.begin(), name.end(), [](char ch) {
+            return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') || ch == '_' ||
+                   ch == '-' || ch == '.';
+        });
+    }
+
+    CollectionManager::CollectionManager(CollectionManagerOption option)
+        : _option(std::move(option)), _arena(_option.global_memory_budget) {
+        if (!_option.index_factory) {
+            _option.index_factory = []() { return std::make_unique<FlatIndex>(); };
+        }
+    }
+
+    CollectionManager::~CollectionManager() {
+        /// batches go back to the arena before it is destroyed.
+        _collections.clear();
+    }
+
+    turbo::Result<std::shared_ptr<const VectorSpace> > CollectionManager::acquire_space(const SpaceKey &key) {
+        auto it = _spaces.find(key);
+        if (it != _spaces.end()) {
+            return it->second;
+        }
+        auto rs = VectorSpace::create(key.dim, key.metric, key.dt, key.level);
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        auto space = std::make_shared<const VectorSpace>(std::move(rs).value_or_die());
+        _spaces[key] = space;
+        return space;
+    }
+
+    turbo::Status CollectionManager::create_collection(const std::string &name, uint64_t tenant, int32_t dim,
+                                                       MetricType metric, DataType dt, SimdLevel level) {
+        if (!valid_collection_name(name)) {
+            return turbo::invalid_argument_error("bad collection name:", name,
+                                                 ", expect 1-128 of [A-Za-z0-9_.-] not starting with '.'");
+        }
+        std::lock_guard<std::mutex> lk(_mutex);
+        if (_collections.find(name) != _collections.end()) {
+            return turbo::already_exists_error("collection already exists:", name);
+        }
+        auto srs = acquire_space({dim, metric, dt, level});
+        if (!srs.ok()) {
+            return srs.status();
+        }
+        auto c = std::make_shared<Collection>();
+        c->name = name;
+        c->tenant = tenant;
+        c->space = srs.value_or_die();
+        auto rs = MemStore::create(c->space.get(), _option.store_option);
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        c->store = std::move(rs).value_or_die();
+        c->store->set_batch_arena(&_arena, tenant);
+        c->charged = c->store->id_pool_bytes();
+        _arena.charge(c->charged, tenant);
+        c->index = _option.index_factory();
+        auto st = c->index->build(c->store.get());
+        if (!st.ok()) {
+            return st;
+        }
+        c->last_access = ++_clock;
+        if (_tenant_budgets.find(tenant) == _tenant_budgets.end()) {
+            _tenant_budgets[tenant] = _option.default_tenant_budget;
+            _arena.set_owner_limit(tenant, _option.default_tenant_budget);
+        }
+        _collections[name] = std::move(c);
+        return turbo::OkStatus();
+    }
+
+    turbo::Status CollectionManager::drop_collection(const std::string &name) {
+        std::shared_ptr<Collection> c;
+        {
+            std::lock_guard<std::mutex> lk(_mutex);
+            auto it = _collections.find(name);
+            if (it == _collections.end()) {
+                return turbo::not_found_error("collection not found:", name);
+            }
+            c = it->second;
+            _collections.erase(it);
+        }
+        std::unique_lock<std::shared_mutex> lk(c->mutex);
+        c->index.reset();
+        if (c->store) {
+            c->store.reset();
+            _arena.uncharge(c->charged, c->tenant);
+        }
+        if (c->spilled) {
+            std::remove(spill_path(name).c_str());
+            std::remove(tuning_path(name).c_str());
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Result<std::shared_ptr<CollectionManager::Collection> > CollectionManager::find(const std::string &name) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        auto it = _collections.find(name);
+        if (it == _collections.end()) {
+            return turbo::not_found_error("collection not found:", name);
+        }
+        it->second->last_access = ++_clock;
+        return it->second;
+    }
+
+    std::string CollectionManager::spill_path(const std::string &name) const {
+        return _option.spill_dir + "/" + name + ".xstore";
+    }
+
+    std::string CollectionManager::tuning_path(const std::string &name) const {
+        return _option.spill_dir + "/" + name + ".xtune";
+    }
+
+    turbo::Status CollectionManager::load_locked(Collection *c) {
+        auto rs = Serializer::load_store(c->space.get(), spill_path(c->name), &_arena, c->tenant);
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        c->store = std::move(rs).value_or_die();
+        c->store->set_batch_arena(&_arena, c->tenant);
+        c->charged = c->store->id_pool_bytes();
+        _arena.charge(c->charged, c->tenant);
+        /// removes still pending at spill time, the fresh index never links them.
+        for (auto lid: c->store->tombstone_local_ids()) {
+            c->store->remove_vector_by_id(++_snapshot_id, lid);
+        }
+        c->index = _option.index_factory();
+        auto brs = c->index->build(c->store.get());
+        if (!brs.ok()) {
+            return brs;
+        }
+        auto trs = Serializer::load_tuning(tuning_path(c->name));
+        if (trs.ok()) {
+            c->index->set_tuning(trs.value_or_die());
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Status CollectionManager::pin_resident(Collection *c, std::shared_lock<std::shared_mutex> &lk) {
+        while (true) {
+            lk = std::shared_lock<std::shared_mutex>(c->mutex);
+            if (c->store) {
+                return turbo::OkStatus();
+            }
+            lk.unlock();
+            {
+                std::unique_lock<std::shared_mutex> ulk(c->mutex);
+                if (!c->store) {
+                    ensure_headroom(c, c->spilled_bytes);
+                    auto rs = load_locked(c);
+                    if (!rs.ok()) {
+                        return rs;
+                    }
+                }
+            }
+        }
+    }
+
+    void CollectionManager::ensure_headroom(const Collection *c, uint64_t need) {
+        if (need == 0) {
+            return;
+        }
+        uint64_t tenant_limit = 0;
+        {
+            std::lock_guard<std::mutex> lk(_mutex);
+            auto it = _tenant_budgets.find(c->tenant);
+            tenant_limit = it == _tenant_budgets.end() ? 0 : it->second;
+        }
+        if (tenant_limit != 0) {
+            auto used = _arena.owner_bytes(c->tenant);
+            if (used + need > tenant_limit) {
+                evict_cold(used + need - tenant_limit, c->tenant, c);
+            }
+        }
+        if (_option.global_memory_budget != 0) {
+            auto used = _arena.used_bytes();
+            if (used + need > _option.global_memory_budget) {
+                evict_cold(used + need - _option.global_memory_budget, kAnyTenant, c);
+            }
+        }
+    }
+
+    turbo::Result<uint64_t> CollectionManager::add_vector(const std::string &name, uint64_t label,
+                                                          turbo::span<uint8_t> vector) {
+        auto crs = find(name);
+        if (!crs.ok()) {
+            return crs.status();
+        }
+        auto c = crs.value_or_die();
+        std::shared_lock<std::shared_mutex> lk;
+        auto rs = pin_resident(c.get(), lk);
+        if (!rs.ok()) {
+            return rs;
+        }
+        /// only an add that opens a new batch is charged, the pinned c is never spilled for it.
+        uint64_t need = 0;
+        {
+            std::shared_lock<std::shared_mutex> slk(c->store->mutex());
+            need = c->store->add_bytes(label);
+        }
+        ensure_headroom(c.get(), need);
+        std::unique_lock<std::shared_mutex> slk(c->store->mutex());
+        auto ars = c->store->add_vector(++_snapshot_id, label, vector);
+        if (!ars.ok()) {
+            return ars;
+        }
+        auto irs = c->index->add(ars.value_or_die());
+        if (!irs.ok()) {
+            /// the lid may be a revived one the graph still routes through.
+            drop_locked(c.get(), label, ars.value_or_die());
+            return irs;
+        }
+        return ars;
+    }
+
+    turbo::Result<uint64_t> CollectionManager::set_vector(const std::string &name, uint64_t label,
+                                                          turbo::span<uint8_t> vector) {
+        auto crs = find(name);
+        if (!crs.ok()) {
+            return crs.status();
+        }
+        auto c = crs.value_or_die();
+        std::shared_lock<std::shared_mutex> lk;
+        auto rs = pin_resident(c.get(), lk);
+        if (!rs.ok()) {
+            return rs;
+        }
+        std::unique_lock<std::shared_mutex> slk(c->store->mutex());
+        auto srs = c->store->set_vector(++_snapshot_id, label, vector);
+        if (!srs.ok()) {
+            return srs;
+        }
+        auto irs = c->index->update(srs.value_or_die());
+        if (!irs.ok()) {
+            return irs;
+        }
+        return srs;
+    }
+
+    turbo::Status CollectionManager::remove_vector(const std::string &name, uint64_t label) {
+        auto crs = find(name);
+        if (!crs.ok()) {
+            return crs.status();
+        }
+        auto c = crs.value_or_die();
+        std::shared_lock<std::shared_mutex> lk;
+        auto rs = pin_resident(c.get(), lk);
+        if (!rs.ok()) {
+            return rs;
+        }
+        std::unique_lock<std::shared_mutex> slk(c->store->mutex());
+        auto lid = c->store->get_id(label);
+        if (!lid.ok()) {
+            return lid.status();
+        }
+        drop_locked(c.get(), label, lid.value_or_die());
+        return turbo::OkStatus();
+    }
+
+    void CollectionManager::drop_locked(Collection *c, uint64_t label, uint64_t lid) {
+        c->store->tombstone_vector_by_label(++_snapshot_id, label);
+        c->index->remove(lid);
+        /// a graph still routing through the lid must not see it reused.
+        if (c->index->pending_deletes() == 0) {
+            c->store->remove_vector_by_label(++_snapshot_id, label);
+        }
+    }
+
+    turbo::Result<size_t> CollectionManager::consolidate(const std::string &name, size_t max_lids) {
+        auto crs = find(name);
+        if (!crs.ok()) {
+            return crs.status();
+        }
+        auto c = crs.value_or_die();
+        std::shared_lock<std::shared_mutex> lk;
+        auto rs = pin_resident(c.get(), lk);
+        if (!rs.ok()) {
+            return rs;
+        }
+        std::vector<uint64_t> lids;
+        {
+            std::shared_lock<std::shared_mutex> slk(c->store->mutex());
+            auto lrs = c->index->consolidate(max_lids);
+            if (!lrs.ok()) {
+                return lrs.status();
+            }
+            lids = std::move(lrs).value_or_die();
+        }
+        if (lids.empty()) {
+            return 0;
+        }
+        std::unique_lock<std::shared_mutex> slk(c->store->mutex());
+        c->index->purge(lids);
+        auto &entities = c->store->id_manager()->ids();
+        for (auto lid: lids) {
+            if (lid < entities.size() && entities[lid].label != IdManager::kInvalidId &&
+                entities[lid].status == kTombstone) {
+                c->store->remove_vector_by_id(++_snapshot_id, lid);
+            }
+        }
+        return lids.size();
+    }
+
+    turbo::Result<std::vector<SearchHit> > CollectionManager::search(const std::string &name,
+                                                                    turbo::span<uint8_t> query,
+                                                                    const SearchOption &option) {
+        auto crs = find(name);
+        if (!crs.ok()) {
+            return crs.status();
+        }
+        auto c = crs.value_or_die();
+        std::shared_lock<std::shared_mutex> lk;
+        auto rs = pin_resident(c.get(), lk);
+        if (!rs.ok()) {
+            return rs;
+        }
+        std::shared_lock<std::shared_mutex> slk(c->store->mutex());
+        return c->index->search(query, c->index->tuned_option(option));
+    }
+
+    turbo::Result<bool> CollectionManager::tune_collection(const std::string &name, const SearchTuner &tuner,
+                                                           const std::vector<std::vector<uint8_t> > &queries,
+                                                           bool force) {
+        auto crs = find(name);
+        if (!crs.ok()) {
+            return crs.status();
+        }
+        auto c = crs.value_or_die();
+        std::shared_lock<std::shared_mutex> lk;
+        auto rs = pin_resident(c.get(), lk);
+        if (!rs.ok()) {
+            return rs;
+        }
+        std::unique_lock<std::shared_mutex> slk(c->store->mutex());
+        return tuner.maybe_retune(c->index.get(), queries, force);
+    }
+
+    void CollectionManager::set_tenant_budget(uint64_t tenant, uint64_t bytes) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        _tenant_budgets[tenant] = bytes;
+        _arena.set_owner_limit(tenant, bytes);
+    }
+
+    uint64_t CollectionManager::evict_locked(Collection *c) {
+        if (!c->store) {
+            return 0;
+        }
+        auto before = _arena.owner_bytes(c->tenant);
+        {
+            std::shared_lock<std::shared_mutex> slk(c->store->mutex());
+            auto rs = Serializer::save_store(*c->store, spill_path(c->name));
+            if (!rs.ok()) {
+                return 0;
+            }
+            if (!c->index->tuning().valid()) {
+                std::remove(tuning_path(c->name).c_str());
+            } else if (!Serializer::save_tuning(c->index->tuning(), tuning_path(c->name)).ok()) {
+                return 0;
+            }
+        }
+        c->spilled = true;
+        c->spilled_bytes = c->store->allocated_bytes() + c->charged;
+        c->index.reset();
+        c->store.reset();
+        _arena.uncharge(c->charged, c->tenant);
+        auto after = _arena.owner_bytes(c->tenant);
+        return before - std::min(before, after);
+    }
+
+    turbo::Status CollectionManager::evict(const std::string &name) {
+        auto crs = find(name);
+        if (!crs.ok()) {
+            return crs.status();
+        }
+        auto c = crs.value_or_die();
+        std::unique_lock<std::shared_mutex> lk(c->mutex);
+        if (c->store && evict_locked(c.get()) == 0 && c->store) {
+            return turbo::unavailable_error("can not spill collection:", name);
+        }
+        return turbo::OkStatus();
+    }
+
+    uint64_t CollectionManager::evict_cold(uint64_t target_bytes, uint64_t tenant, const void *keep) {
+        std::vector<std::shared_ptr<Collection> > candidates;
+        {
+            std::lock_guard<std::mutex> lk(_mutex);
+            for (auto &it: _collections) {
+                auto &c = it.second;
+                if (c.get() == keep || (tenant != kAnyTenant && c->tenant != tenant)) {
+                    continue;
+                }
+                candidates.push_back(c);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
+            return a->last_access.load() < b->last_access.load();
+        });
+        uint64_t freed = 0;
+        for (auto &c: candidates) {
+            if (freed >= target_bytes) {
+                break;
+            }
+            std::unique_lock<std::shared_mutex> lk(c->mutex, std::try_to_lock);
+            if (!lk.owns_lock()) {
+                continue;
+            }
+            freed += evict_locked(c.get());
+        }
+        return freed;
+    }
+
+    size_t CollectionManager::shared_space_count() const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        return _spaces.size();
+    }
+
+    size_t CollectionManager::collection_count() const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        return _collections.size();
+    }
+
+    bool CollectionManager::is_resident(const std::string &name) const {
+        std::shared_ptr<Collection> c;
+        {
+            std::lock_guard<std::mutex> lk(_mutex);
+            auto it = _collections.find(name);
+            if (it == _collections.end()) {
+                return false;
+            }
+            c = it->second;
+        }
+        std::shared_lock<std::shared_mutex> lk(c->mutex);
+        return c->store != nullptr;
+    }
+} // namespace xann
@@ -0,0 +1,191 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <turbo/container/flat_hash_map.h>
+#include <xann/collection/sharded_collection.h>
+#include <xann/store/batch_arena.h>
+
+namespace xann {
+
+    struct CollectionManagerOption {
+        /// 0 means unlimited, covers the batches and id pools of every resident collection.
+        uint64_t global_memory_budget{0};
+        /// 0 means unlimited, applied to tenants without an explicit budget.
+        uint64_t default_tenant_budget{0};
+        /// evicted collections are written here as <name>.xstore.
+        std::string spill_dir{"."};
+        /// small collections want a small batch_size, the default 256 wastes memory.
+        VectorStoreOption store_option;
+        /// nullptr means FlatIndex.
+        IndexFactory index_factory;
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Hosts many small collections in one process.
+    ///
+    /// @details  Collections with the same (dim, metric, data type, simd level)
+    ///           share one VectorSpace, and all batches come from one
+    ///           BatchArena, so freed batches of one collection are reused by
+    ///           another and memory is charged to the owning tenant. When a
+    ///           tenant or the process runs out of budget the least recently
+    ///           used collections are written to spill_dir and dropped from
+    ///           memory, they are loaded back transparently on next access.
+    ///
+    class CollectionManager {
+    public:
+        static constexpr uint64_t kAnyTenant = std::numeric_limits<uint64_t>::max();
+
+        explicit CollectionManager(CollectionManagerOption option);
+
+        ~CollectionManager();
+
+        CollectionManager(const CollectionManager &) = delete;
+
+        CollectionManager &operator=(const CollectionManager &) = delete;
+
+        /// name is also the spill file name, 1-128 of [A-Za-z0-9_.-] not starting with '.'.
+        turbo::Status create_collection(const std::string &name, uint64_t tenant, int32_t dim, MetricType metric,
+                                        DataType dt, SimdLevel level = SimdLevel::SIMD_NONE);
+
+        /// drop from memory and remove the spill file.
+        turbo::Status drop_collection(const std::string &name);
+
+        turbo::Result<uint64_t> add_vector(const std::string &name, uint64_t label, turbo::span<uint8_t> vector);
+
+        turbo::Result<uint64_t> set_vector(const std::string &name, uint64_t label, turbo::span<uint8_t> vector);
+
+        /// tombstone label and drop it from the index, the slot is freed at once
+        /// for an index without pending deletes, otherwise by consolidate().
+        /// adding the label before that takes its lid back, setting it fails.
+        turbo::Status remove_vector(const std::string &name, uint64_t label);
+
+        /// repair the index of name around up to max_lids removed lids and free
+        /// their slots, returns the number repaired.
+        turbo::Result<size_t> consolidate(const std::string &name, size_t max_lids = 0);
+
+        turbo::Result<std::vector<SearchHit> > search(const std::string &name, turbo::span<uint8_t> query,
+                                                      const SearchOption &option);
+
+        /// maybe_retune the index of name, the tuning is spilled and reloaded with it.
+        turbo::Result<bool> tune_collection(const std::string &name, const SearchTuner &tuner,
+                                            const std::vector<std::vector<uint8_t> > &queries, bool force = false);
+
+        void set_tenant_budget(uint64_t tenant, uint64_t bytes);
+
+        /// spill one collection to disk and free its memory.
+        turbo::Status evict(const std::string &name);
+
+        /// spill least recently used resident collections of tenant (kAnyTenant
+        /// for all) until target_bytes are freed, return the bytes freed.
+        /// collections in use by other threads are skipped.
+        uint64_t evict_cold(uint64_t target_bytes, uint64_t tenant = kAnyTenant, const void *keep = nullptr);
+
+        [[nodiscard]] uint64_t tenant_bytes(uint64_t tenant) const {
+            return _arena.owner_bytes(tenant);
+        }
+
+        [[nodiscard]] uint64_t used_bytes() const {
+            return _arena.used_bytes();
+        }
+
+        [[nodiscard]] size_t shared_space_count() const;
+
+        [[nodiscard]] size_t collection_count() const;
+
+        [[nodiscard]] bool is_resident(const std::string &name) const;
+
+    private:
+        struct Collection {
+            std::string name;
+            uint64_t tenant{0};
+            std::shared_ptr<const VectorSpace> space;
+            /// shared while the store is used, exclusive to load or evict it.
+            std::shared_mutex mutex;
+            std::unique_ptr<MemStore> store;
+            std::unique_ptr<VectorIndex> index;
+            std::atomic<uint64_t> last_access{0};
+            bool spilled{false};
+            /// id pool bytes charged to the arena while the store is resident.
+            uint64_t charged{0};
+            /// arena bytes of the store when it was spilled, made room for before a reload.
+            uint64_t spilled_bytes{0};
+        };
+
+        struct SpaceKey {
+            int32_t dim;
+            MetricType metric;
+            DataType dt;
+            SimdLevel level;
+
+            bool operator==(const SpaceKey &o) const {
+                return dim == o.dim && metric == o.metric && dt == o.dt && level == o.level;
+            }
+        };
+
+        struct SpaceKeyHash {
+            size_t operator()(const SpaceKey &k) const {
+                return std::hash<uint64_t>()((static_cast<uint64_t>(k.dim) << 32) ^
+                                             (static_cast<uint64_t>(k.metric) << 16) ^
+                                             (static_cast<uint64_t>(k.dt) << 8) ^ static_cast<uint64_t>(k.level));
+            }
+        };
+
+        turbo::Result<std::shared_ptr<const VectorSpace> > acquire_space(const SpaceKey &key);
+
+        turbo::Result<std::shared_ptr<Collection> > find(const std::string &name);
+
+        /// return with c->mutex held shared and the store resident.
+        turbo::Status pin_resident(Collection *c, std::shared_lock<std::shared_mutex> &lk);
+
+        turbo::Status load_locked(Collection *c);
+
+        /// c->mutex must be held exclusively.
+        uint64_t evict_locked(Collection *c);
+
+        [[nodiscard]] std::string spill_path(const std::string &name) const;
+
+        [[nodiscard]] std::string tuning_path(const std::string &name) const;
+
+        /// under the exclusive store lock, label maps to lid: tombstone it,
+        /// drop it from the index and free the slot unless deletes are pending.
+        void drop_locked(Collection *c, uint64_t label, uint64_t lid);
+
+        /// make room for need more bytes of c before they are allocated,
+        /// spilling cold collections of the same tenant first and then of anyone.
+        void ensure_headroom(const Collection *c, uint64_t need);
+
+    private:
+        CollectionManagerOption _option;
+        BatchArena _arena;
+        mutable std::mutex _mutex;
+        turbo::flat_hash_map<std::string, std::shared_ptr<Collection> > _collections;
+        turbo::flat_hash_map<SpaceKey, std::shared_ptr<const VectorSpace>, SpaceKeyHash> _spaces;
+        turbo::flat_hash_map<uint64_t, uint64_t> _tenant_budgets;
+        std::atomic<uint64_t> _clock{0};
+        std::atomic<uint64_t> _snapshot_id{0};
+    };
+} // namespace xann
@@ -0,0 +1,335 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/collection/sharded_collection.h>
+#include <xann/index/flat_index.h>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
+namespace xann {
+
+    /// splitmix64 finalizer, labels are often sequential.
+    static inline uint64_t mix_label(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    turbo::Result<std::unique_ptr<ShardedCollection> > ShardedCollection::create(const VectorSpace *vs,
+        const ShardedCollectionOption &option, IndexFactory factory) {
+        if (option.num_shards == 0) {
+            return turbo::invalid_argument_error("num_shards must be positive");
+        }
+        if (option.partition == PartitionType::kRange) {
+            if (option.range_bounds.size() + 1 != option.num_shards) {
+                return turbo::invalid_argument_error("range partition needs num_shards - 1 bounds, got:",
+                                                     option.range_bounds.size());
+            }
+            if (!std::is_sorted(option.range_bounds.begin(), option.range_bounds.end())) {
+                return turbo::invalid_argument_error("range bounds must be ascending");
+            }
+        }
+        if (option.projection && option.projection->output_space() != vs) {
+            return turbo::invalid_argument_error("collection space must be the projection output space");
+        }
+        if (!factory) {
+            factory = []() { return std::make_unique<FlatIndex>(); };
+        }
+        std::unique_ptr<ShardedCollection> c(new ShardedCollection());
+        c->_vector_space = vs;
+        c->_option = option;
+        c->_shards.resize(option.num_shards);
+        for (auto &shard: c->_shards) {
+            auto srs = MemStore::create(vs, option.store_option);
+            if (!srs.ok()) {
+                return srs.status();
+            }
+            shard.store = std::move(srs).value_or_die();
+            shard.index = factory();
+            auto rs = shard.index->build(shard.store.get());
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        c->_pool = std::make_unique<ThreadPool>(option.search_threads ? option.search_threads : option.num_shards);
+        return c;
+    }
+
+    size_t ShardedCollection::shard_of(uint64_t label) const {
+        if (_option.partition == PartitionType::kRange) {
+            auto it = std::upper_bound(_option.range_bounds.begin(), _option.range_bounds.end(), label);
+            return static_cast<size_t>(it - _option.range_bounds.begin());
+        }
+        return static_cast<size_t>(mix_label(label) % _shards.size());
+    }
+
+    turbo::Result<uint64_t> ShardedCollection::add_vector(uint64_t label, turbo::span<uint8_t> vector) {
+        AlignedBytes projected;
+        if (_option.projection) {
+            auto prs = _option.projection->apply(vector, &projected);
+            if (!prs.ok()) {
+                return prs;
+            }
+            vector = turbo::span<uint8_t>(projected.data(), projected.size());
+        }
+        auto &shard = _shards[shard_of(label)];
+        std::unique_lock<std::shared_mutex> lk(shard.store->mutex());
+        auto rs = shard.store->add_vector(next_snapshot_id(), label, vector);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto lid = rs.value_or_die();
+        if (!shard.index->concurrent_add()) {
+            auto irs = shard.index->add(lid);
+            if (!irs.ok()) {
+                /// the lid may be a revived one the graph still routes through.
+                drop_locked(shard, label, lid);
+                return irs;
+            }
+            return lid;
+        }
+        /// only the slot allocation is serialized, linking runs next to other writers and searches.
+        auto irs = shard.index->reserve(lid);
+        if (!irs.ok()) {
+            drop_locked(shard, label, lid);
+            return irs;
+        }
+        lk.unlock();
+        {
+            std::shared_lock<std::shared_mutex> slk(shard.store->mutex());
+            irs = shard.index->add_shared(lid);
+        }
+        if (!irs.ok()) {
+            /// a half linked node may already be routed through, drop it like
+            /// a remove unless another writer replaced the label meanwhile.
+            lk.lock();
+            auto ids = shard.store->get_id(label);
+            if (ids.ok() && ids.value_or_die() == lid) {
+                drop_locked(shard, label, lid);
+            }
+            return irs;
+        }
+        return lid;
+    }
+
+    turbo::Result<uint64_t> ShardedCollection::set_vector(uint64_t label, turbo::span<uint8_t> vector) {
+        AlignedBytes projected;
+        if (_option.projection) {
+            auto prs = _option.projection->apply(vector, &projected);
+            if (!prs.ok()) {
+                return prs;
+            }
+            vector = turbo::span<uint8_t>(projected.data(), projected.size());
+        }
+        auto &shard = _shards[shard_of(label)];
+        std::unique_lock<std::shared_mutex> lk(shard.store->mutex());
+        auto old = shard.store->get_vector_by_label(label);
+        if (!old.ok()) {
+            return old.status();
+        }
+        /// the slot bytes are already prepared, a failed update puts them back as they were.
+        std::vector<uint8_t> previous(old.value_or_die().begin(), old.value_or_die().end());
+        auto rs = shard.store->set_vector(next_snapshot_id(), label, vector);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto lid = rs.value_or_die();
+        auto irs = shard.index->update(lid);
+        if (!irs.ok()) {
+            shard.store->add_prepared_vector(next_snapshot_id(), label,
+                                             turbo::span<uint8_t>(previous.data(), previous.size()));
+            /// an index that can not take the old vector back either drops the label.
+            if (!shard.index->update(lid).ok()) {
+                drop_locked(shard, label, lid);
+            }
+            return irs;
+        }
+        return lid;
+    }
+
+    void ShardedCollection::remove_vector(uint64_t label) {
+        auto &shard = _shards[shard_of(label)];
+        std::unique_lock<std::shared_mutex> lk(shard.store->mutex());
+        auto rs = shard.store->get_id(label);
+        if (!rs.ok()) {
+            return;
+        }
+        drop_locked(shard, label, rs.value_or_die());
+    }
+
+    void ShardedCollection::drop_locked(Shard &shard, uint64_t label, uint64_t lid) {
+        shard.store->tombstone_vector_by_label(next_snapshot_id(), label);
+        shard.index->remove(lid);
+        /// a graph still routing through the lid must not see it reused.
+        if (shard.index->pending_deletes() == 0) {
+            shard.store->remove_vector_by_label(next_snapshot_id(), label);
+        }
+    }
+
+    void ShardedCollection::tombstone_vector(uint64_t label) {
+        auto &shard = _shards[shard_of(label)];
+        std::unique_lock<std::shared_mutex> lk(shard.store->mutex());
+        auto rs = shard.store->get_id(label);
+        if (!rs.ok()) {
+            return;
+        }
+        shard.store->tombstone_vector_by_label(next_snapshot_id(), label);
+        shard.index->remove(rs.value_or_die());
+    }
+
+    turbo::Result<std::vector<SearchHit> > ShardedCollection::search(turbo::span<uint8_t> query,
+                                                                    const SearchOption &option) const {
+        AlignedBytes projected;
+        if (_option.projection) {
+            auto prs = _option.projection->apply(query, &projected);
+            if (!prs.ok()) {
+                return prs;
+            }
+            query = turbo::span<uint8_t>(projected.data(), projected.size());
+        }
+        std::vector<std::future<turbo::Result<std::vector<SearchHit> > > > futures;
+        futures.reserve(_shards.size());
+        for (auto &shard: _shards) {
+            auto *s = &shard;
+            futures.push_back(_pool->submit([s, query, &option]() {
+                std::shared_lock<std::shared_mutex> lk(s->store->mutex());
+                return s->index->search(query, s->index->tuned_option(option));
+            }));
+        }
+        std::vector<std::vector<SearchHit> > parts;
+        parts.reserve(_shards.size());
+        turbo::Status first_error;
+        for (auto &f: futures) {
+            auto rs = f.get();
+            if (!rs.ok()) {
+                if (first_error.ok()) {
+                    first_error = rs.status();
+                }
+                continue;
+            }
+            parts.push_back(std::move(rs).value_or_die());
+        }
+        if (!first_error.ok()) {
+            return first_error;
+        }
+        return merge_search_hits(_vector_space->metric, std::move(parts), option.k);
+    }
+
+    turbo::Status ShardedCollection::rebuild_shard(size_t shard) {
+        if (shard >= _shards.size()) {
+            return turbo::out_of_range_error("shard:", shard, " num shards:", _shards.size());
+        }
+        auto &s = _shards[shard];
+        std::unique_lock<std::shared_mutex> lk(s.store->mutex());
+        return s.index->build(s.store.get());
+    }
+
+    turbo::Result<size_t> ShardedCollection::consolidate_shard(size_t shard, size_t max_lids) {
+        if (shard >= _shards.size()) {
+            return turbo::out_of_range_error("shard:", shard, " num shards:", _shards.size());
+        }
+        auto &s = _shards[shard];
+        std::vector<uint64_t> lids;
+        {
+            std::shared_lock<std::shared_mutex> lk(s.store->mutex());
+            auto rs = s.index->consolidate(max_lids);
+            if (!rs.ok()) {
+                return rs.status();
+            }
+            lids = std::move(rs).value_or_die();
+        }
+        if (lids.empty()) {
+            return 0;
+        }
+        std::unique_lock<std::shared_mutex> lk(s.store->mutex());
+        s.index->purge(lids);
+        auto &entities = s.store->id_manager()->ids();
+        for (auto lid: lids) {
+            /// every removed lid is tombstoned until here, skip one freed meanwhile.
+            if (lid < entities.size() && entities[lid].label != IdManager::kInvalidId &&
+                entities[lid].status == kTombstone) {
+                s.store->remove_vector_by_id(next_snapshot_id(), lid);
+            }
+        }
+        return lids.size();
+    }
+
+    turbo::Status ShardedCollection::compact_shard(size_t shard) {
+        while (true) {
+            auto rs = consolidate_shard(shard);
+            if (!rs.ok()) {
+                return rs.status();
+            }
+            if (rs.value_or_die() == 0) {
+                break;
+            }
+        }
+        auto &s = _shards[shard];
+        std::unique_lock<std::shared_mutex> lk(s.store->mutex());
+        for (auto lid: s.store->tombstone_local_ids()) {
+            s.store->remove_vector_by_id(next_snapshot_id(), lid);
+        }
+        return s.index->maintain();
+    }
+
+    turbo::Status ShardedCollection::maintain_shard(size_t shard) {
+        if (shard >= _shards.size()) {
+            return turbo::out_of_range_error("shard:", shard, " num shards:", _shards.size());
+        }
+        auto &s = _shards[shard];
+        std::unique_lock<std::shared_mutex> lk(s.store->mutex());
+        return s.index->maintain();
+    }
+
+    turbo::Status ShardedCollection::rebuild_all() {
+        for (size_t i = 0; i < _shards.size(); ++i) {
+            auto rs = rebuild_shard(i);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Result<size_t> ShardedCollection::tune(const SearchTuner &tuner,
+                                                  const std::vector<std::vector<uint8_t> > &queries, bool force) {
+        size_t tuned = 0;
+        for (auto &s: _shards) {
+            std::unique_lock<std::shared_mutex> lk(s.store->mutex());
+            auto rs = tuner.maybe_retune(s.index.get(), queries, force);
+            if (!rs.ok()) {
+                return rs.status();
+            }
+            tuned += rs.value_or_die() ? 1 : 0;
+        }
+        return tuned;
+    }
+
+    uint64_t ShardedCollection::size() const {
+        uint64_t n = 0;
+        for (auto &shard: _shards) {
+            std::shared_lock<std::shared_mutex> lk(shard.store->mutex());
+            n += shard.store->size();
+        }
+        return n;
+    }
+} // namespace xann
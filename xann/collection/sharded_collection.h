@@ -0,0 +1,166 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <xann/common/thread_pool.h>
+#include <xann/index/search_tuner.h>
+#include <xann/index/vector_index.h>
+#include <xann/quantization/projection.h>
+#include <xann/store/store.h>
+
+namespace xann {
+
+    enum class PartitionType {
+        /// label hashed over the shards, even spread for any label distribution.
+        kHash = 0,
+        /// shard i owns labels in [range_bounds[i-1], range_bounds[i]).
+        kRange = 1,
+    };
+
+    struct ShardedCollectionOption {
+        uint32_t num_shards{4};
+        PartitionType partition{PartitionType::kHash};
+        /// num_shards - 1 ascending exclusive upper bounds, kRange only.
+        std::vector<uint64_t> range_bounds;
+        /// per shard store option, max_elements is per shard.
+        VectorStoreOption store_option;
+        /// 0 means one search worker per shard.
+        uint32_t search_threads{0};
+        /// vectors and queries arrive in projection->input_space() and are
+        /// reduced before they reach a shard, the collection space must be
+        /// projection->output_space().
+        std::shared_ptr<const ProjectionStage> projection;
+    };
+
+    using IndexFactory = std::function<std::unique_ptr<VectorIndex>()>;
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Labels partitioned over N in process MemStore + index shards.
+    ///
+    /// @details  Each shard has its own store lock, writers only contend with
+    ///           writers and readers of the same shard. Searches fan out to all
+    ///           shards on a private thread pool and merge the per shard top-k.
+    ///           Snapshot ids are assigned by the collection, so they are
+    ///           monotonic across shards.
+    ///
+    class ShardedCollection {
+    public:
+        ShardedCollection(const ShardedCollection &) = delete;
+
+        ShardedCollection &operator=(const ShardedCollection &) = delete;
+
+        ~ShardedCollection() = default;
+
+        /// factory nullptr means a FlatIndex per shard.
+        static turbo::Result<std::unique_ptr<ShardedCollection> > create(const VectorSpace *vs,
+                                                                         const ShardedCollectionOption &option,
+                                                                         IndexFactory factory = nullptr);
+
+        turbo::Result<uint64_t> add_vector(uint64_t label, turbo::span<uint8_t> vector);
+
+        /// overwrite label, the old vector is restored when the index update fails.
+        turbo::Result<uint64_t> set_vector(uint64_t label, turbo::span<uint8_t> vector);
+
+        /// tombstone label and drop it from the index. the slot is freed at
+        /// once for an index without pending deletes, otherwise by
+        /// consolidate_shard() after the index purged the lid. adding the
+        /// label before that takes its lid back, setting it fails.
+        void remove_vector(uint64_t label);
+
+        void tombstone_vector(uint64_t label);
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const;
+
+        /// rebuild the index of one shard from its store.
+        turbo::Status rebuild_shard(size_t shard);
+
+        /// repair the shard index around up to max_lids removed lids and free
+        /// the tombstoned ones in the store, returns the number repaired.
+        /// searches and inserts keep running during the repair.
+        turbo::Result<size_t> consolidate_shard(size_t shard, size_t max_lids = 0);
+
+        /// consolidate until nothing is pending, then free every tombstoned slot of the shard.
+        turbo::Status compact_shard(size_t shard);
+
+        /// run the incremental upkeep of one shard index, e.g. posting list
+        /// compaction and rebalancing for ivf.
+        turbo::Status maintain_shard(size_t shard);
+
+        turbo::Status rebuild_all();
+
+        /// maybe_retune every shard index, returns the number of shards tuned.
+        /// drift is the shard store's own mutation_count, writes to other
+        /// shards do not make a shard retune.
+        turbo::Result<size_t> tune(const SearchTuner &tuner, const std::vector<std::vector<uint8_t> > &queries,
+                                   bool force = false);
+
+        [[nodiscard]] size_t shard_of(uint64_t label) const;
+
+        [[nodiscard]] size_t num_shards() const {
+            return _shards.size();
+        }
+
+        [[nodiscard]] const MemStore *shard_store(size_t shard) const {
+            return _shards[shard].store.get();
+        }
+
+        [[nodiscard]] const VectorIndex *shard_index(size_t shard) const {
+            return _shards[shard].index.get();
+        }
+
+        [[nodiscard]] uint64_t size() const;
+
+        [[nodiscard]] uint64_t snapshot_id() const {
+            return _snapshot_id.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] const VectorSpace *get_vector_space() const {
+            return _vector_space;
+        }
+
+    private:
+        ShardedCollection() = default;
+
+        uint64_t next_snapshot_id() {
+            return _snapshot_id.fetch_add(1, std::memory_order_acq_rel) + 1;
+        }
+
+    private:
+        struct Shard {
+            std::unique_ptr<MemStore> store;
+            std::unique_ptr<VectorIndex> index;
+        };
+
+        /// under the exclusive store lock, label maps to lid: tombstone it,
+        /// drop it from the index and free the slot unless deletes are pending.
+        void drop_locked(Shard &shard, uint64_t label, uint64_t lid);
+
+        const VectorSpace *_vector_space{nullptr};
+        ShardedCollectionOption _option;
+        std::vector<Shard> _shards;
+        std::unique_ptr<ThreadPool> _pool;
+        std::atomic<uint64_t> _snapshot_id{0};
+    };
+} // namespace xann
@@ -0,0 +1,59 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace xann {
+
+    /// the upper half of an ieee float, converted through float for arithmetic.
+    struct bfloat16 {
+        uint16_t bits{0};
+
+        bfloat16() = default;
+
+        explicit bfloat16(float f) : bits(from_float(f)) {
+        }
+
+        operator float() const {
+            return to_float(bits);
+        }
+
+        /// round to nearest even, nan stays a quiet nan.
+        static uint16_t from_float(float f) {
+            uint32_t u;
+            std::memcpy(&u, &f, sizeof(u));
+            if ((u & 0x7fffffffu) > 0x7f800000u) {
+                return static_cast<uint16_t>((u >> 16) | 0x0040u);
+            }
+            u += 0x7fffu + ((u >> 16) & 1u);
+            return static_cast<uint16_t>(u >> 16);
+        }
+
+        static float to_float(uint16_t bits) {
+            uint32_t u = static_cast<uint32_t>(bits) << 16;
+            float f;
+            std::memcpy(&f, &u, sizeof(f));
+            return f;
+        }
+    };
+
+    static_assert(sizeof(bfloat16) == 2, "bfloat16 must be 2 bytes");
+} // namespace xann
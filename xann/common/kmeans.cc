@@ -0,0 +1,180 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/common/kmeans.h>
+#include <xann/common/thread_pool.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace xann {
+
+    static constexpr size_t kAssignChunk = 1024;
+
+    float l2_sqr(const float *a, const float *b, size_t dim) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < dim; ++i) {
+            auto d = a[i] - b[i];
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    uint32_t kmeans_nearest(const float *centroids, size_t k, size_t dim, const float *x, float *distance) {
+        uint32_t best = 0;
+        float best_d = std::numeric_limits<float>::max();
+        for (size_t c = 0; c < k; ++c) {
+            auto d = l2_sqr(centroids + c * dim, x, dim);
+            if (d < best_d) {
+                best_d = d;
+                best = static_cast<uint32_t>(c);
+            }
+        }
+        if (distance) {
+            *distance = best_d;
+        }
+        return best;
+    }
+
+    static void normalize_rows(float *rows, size_t n, size_t dim) {
+        for (size_t i = 0; i < n; ++i) {
+            float *r = rows + i * dim;
+            float norm = 0.0f;
+            for (size_t j = 0; j < dim; ++j) {
+                norm += r[j] * r[j];
+            }
+            if (norm > 0.0f) {
+                norm = 1.0f / std::sqrt(norm);
+                for (size_t j = 0; j < dim; ++j) {
+                    r[j] *= norm;
+                }
+            }
+        }
+    }
+
+    static void kmeans_plus_plus(const float *data, size_t n, size_t dim, size_t k, std::mt19937_64 &rng,
+                                 float *centroids) {
+        std::vector<float> closest(n, std::numeric_limits<float>::max());
+        std::uniform_int_distribution<size_t> pick(0, n - 1);
+        auto first = pick(rng);
+        std::copy(data + first * dim, data + first * dim + dim, centroids);
+        for (size_t c = 1; c < k; ++c) {
+            const float *last = centroids + (c - 1) * dim;
+            double total = 0.0;
+            for (size_t i = 0; i < n; ++i) {
+                closest[i] = std::min(closest[i], l2_sqr(data + i * dim, last, dim));
+                total += closest[i];
+            }
+            size_t chosen = pick(rng);
+            if (total > 0.0) {
+                std::uniform_real_distribution<double> u(0.0, total);
+                auto target = u(rng);
+                for (size_t i = 0; i < n; ++i) {
+                    target -= closest[i];
+                    if (target <= 0.0) {
+                        chosen = i;
+                        break;
+                    }
+                }
+            }
+            std::copy(data + chosen * dim, data + chosen * dim + dim, centroids + c * dim);
+        }
+    }
+
+    turbo::Status kmeans_train(const float *data, size_t n, size_t dim, const KMeansOption &option,
+                               std::vector<float> *centroids, std::vector<uint32_t> *assign) {
+        auto k = static_cast<size_t>(option.k);
+        if (k == 0 || dim == 0) {
+            return turbo::invalid_argument_error("k and dim must be positive, k:", k, " dim:", dim);
+        }
+        if (n < k) {
+            return turbo::invalid_argument_error("need at least k points, n:", n, " k:", k);
+        }
+        auto &pool = option.pool ? *option.pool : ThreadPool::default_pool();
+        std::mt19937_64 rng(option.seed);
+        centroids->assign(k * dim, 0.0f);
+        kmeans_plus_plus(data, n, dim, k, rng, centroids->data());
+        if (option.spherical) {
+            normalize_rows(centroids->data(), k, dim);
+        }
+
+        std::vector<uint32_t> labels(n, 0);
+        std::vector<double> sums(k * dim);
+        std::vector<size_t> counts(k);
+        auto nchunk = (n + kAssignChunk - 1) / kAssignChunk;
+        for (uint32_t iter = 0; iter < option.iterations; ++iter) {
+            pool.parallel_for(nchunk, [&](size_t chunk) {
+                auto end = std::min(n, (chunk + 1) * kAssignChunk);
+                for (auto i = chunk * kAssignChunk; i < end; ++i) {
+                    labels[i] = kmeans_nearest(centroids->data(), k, dim, data + i * dim);
+                }
+            });
+            std::fill(sums.begin(), sums.end(), 0.0);
+            std::fill(counts.begin(), counts.end(), 0);
+            for (size_t i = 0; i < n; ++i) {
+                auto c = labels[i];
+                ++counts[c];
+                const float *x = data + i * dim;
+                double *s = sums.data() + c * dim;
+                for (size_t j = 0; j < dim; ++j) {
+                    s[j] += x[j];
+                }
+            }
+            for (size_t c = 0; c < k; ++c) {
+                if (counts[c] == 0) {
+                    continue;
+                }
+                float *dst = centroids->data() + c * dim;
+                for (size_t j = 0; j < dim; ++j) {
+                    dst[j] = static_cast<float>(sums[c * dim + j] / counts[c]);
+                }
+            }
+            /// split the largest cluster into every empty one.
+            for (size_t c = 0; c < k; ++c) {
+                if (counts[c] != 0) {
+                    continue;
+                }
+                auto big = static_cast<size_t>(std::max_element(counts.begin(), counts.end()) - counts.begin());
+                float *dst = centroids->data() + c * dim;
+                float *src = centroids->data() + big * dim;
+                std::normal_distribution<float> noise(0.0f, 1e-4f);
+                for (size_t j = 0; j < dim; ++j) {
+                    auto e = noise(rng) * (std::fabs(src[j]) + 1e-3f);
+                    dst[j] = src[j] + e;
+                    src[j] -= e;
+                }
+                counts[c] = counts[big] / 2;
+                counts[big] -= counts[c];
+            }
+            if (option.spherical) {
+                normalize_rows(centroids->data(), k, dim);
+            }
+        }
+        if (assign) {
+            pool.parallel_for(nchunk, [&](size_t chunk) {
+                auto end = std::min(n, (chunk + 1) * kAssignChunk);
+                for (auto i = chunk * kAssignChunk; i < end; ++i) {
+                    labels[i] = kmeans_nearest(centroids->data(), k, dim, data + i * dim);
+                }
+            });
+            *assign = std::move(labels);
+        }
+        return turbo::OkStatus();
+    }
+} // namespace xann
@@ -0,0 +1,50 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <turbo/utility/status.h>
+
+namespace xann {
+    class ThreadPool;
+
+    struct KMeansOption {
+        uint32_t k{0};
+        uint32_t iterations{10};
+        uint64_t seed{1234};
+        /// normalize centroids after every update, for angular metrics.
+        bool spherical{false};
+        /// nullptr means ThreadPool::default_pool().
+        ThreadPool *pool{nullptr};
+    };
+
+    /// squared l2 of two dense float rows.
+    float l2_sqr(const float *a, const float *b, size_t dim);
+
+    /// index of the closest of k centroids to x in squared l2.
+    uint32_t kmeans_nearest(const float *centroids, size_t k, size_t dim, const float *x, float *distance = nullptr);
+
+    /// lloyd k-means with k-means++ seeding over n row major float rows.
+    /// centroids is resized to k * dim, assign (optional) to n.
+    /// empty clusters are re-seeded by splitting the largest one.
+    turbo::Status kmeans_train(const float *data, size_t n, size_t dim, const KMeansOption &option,
+                               std::vector<float> *centroids, std::vector<uint32_t> *assign = nullptr);
+} // namespace xann
@@ -0,0 +1,60 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace xann {
+
+    /// test and test-and-set lock for short critical sections, e.g. one
+    /// graph node's link list. usable with std::lock_guard.
+    class SpinLock {
+    public:
+        void lock() {
+            while (_locked.exchange(true, std::memory_order_acquire)) {
+                size_t spins = 0;
+                while (_locked.load(std::memory_order_relaxed)) {
+                    if (++spins < 64) {
+#if defined(__x86_64__) || defined(_M_X64)
+                        _mm_pause();
+#endif
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        }
+
+        bool try_lock() {
+            return !_locked.load(std::memory_order_relaxed) && !_locked.exchange(true, std::memory_order_acquire);
+        }
+
+        void unlock() {
+            _locked.store(false, std::memory_order_release);
+        }
+
+    private:
+        std::atomic<bool> _locked{false};
+    };
+} // namespace xann
@@ -0,0 +1,87 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/common/thread_pool.h>
+#include <atomic>
+
+namespace xann {
+
+    ThreadPool::ThreadPool(size_t num_threads) {
+        if (num_threads == 0) {
+            num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        _workers.reserve(num_threads);
+        for (size_t i = 0; i < num_threads; ++i) {
+            _workers.emplace_back([this]() { run(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lk(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        for (auto &w: _workers) {
+            w.join();
+        }
+    }
+
+    void ThreadPool::run() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lk(_mutex);
+                _cv.wait(lk, [this]() { return _stop || !_tasks.empty(); });
+                if (_tasks.empty()) {
+                    return;
+                }
+                task = std::move(_tasks.front());
+                _tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    void ThreadPool::parallel_for(size_t n, const std::function<void(size_t)> &fn) {
+        if (n == 0) {
+            return;
+        }
+        std::atomic<size_t> next{0};
+        auto worker = [&next, n, &fn]() {
+            for (auto i = next.fetch_add(1); i < n; i = next.fetch_add(1)) {
+                fn(i);
+            }
+        };
+        auto helpers = std::min(n - 1, _workers.size());
+        std::vector<std::future<void> > futures;
+        futures.reserve(helpers);
+        for (size_t i = 0; i < helpers; ++i) {
+            futures.push_back(submit(worker));
+        }
+        worker();
+        for (auto &f: futures) {
+            f.get();
+        }
+    }
+
+    ThreadPool &ThreadPool::default_pool() {
+        static ThreadPool pool;
+        return pool;
+    }
+} // namespace xann
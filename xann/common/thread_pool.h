@@ -0,0 +1,79 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xann {
+
+    /// fixed size worker pool used for search fan out and parallel builds.
+    class ThreadPool {
+    public:
+        /// 0 means std::thread::hardware_concurrency().
+        explicit ThreadPool(size_t num_threads = 0);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        template<typename F>
+        auto submit(F &&fn) -> std::future<decltype(fn())> {
+            using R = decltype(fn());
+            auto task = std::make_shared<std::packaged_task<R()> >(std::forward<F>(fn));
+            auto future = task->get_future();
+            {
+                std::lock_guard<std::mutex> lk(_mutex);
+                _tasks.emplace_back([task]() { (*task)(); });
+            }
+            _cv.notify_one();
+            return future;
+        }
+
+        /// run fn(i) for i in [0, n) on the pool and wait, the calling
+        /// thread takes a share of the work too.
+        void parallel_for(size_t n, const std::function<void(size_t)> &fn);
+
+        [[nodiscard]] size_t size() const {
+            return _workers.size();
+        }
+
+        /// process wide pool, sized to the hardware.
+        static ThreadPool &default_pool();
+
+    private:
+        void run();
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _cv;
+        std::deque<std::function<void()> > _tasks;
+        std::vector<std::thread> _workers;
+        bool _stop{false};
+    };
+} // namespace xann
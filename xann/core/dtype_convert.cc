@@ -0,0 +1,213 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/core/dtype_convert.h>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace xann {
+
+    /// in * scale clamped before rounding, fmax / fmin drop a nan to lo.
+    static float saturate(float v, float scale, float lo, float hi) {
+        return std::nearbyint(std::fmin(std::fmax(v * scale, lo), hi));
+    }
+
+    void f32_to_f16(const float *in, size_t n, half_float::half *out) {
+        size_t i = 0;
+#if defined(__AVX512F__)
+        for (; i + 16 <= n; i += 16) {
+            auto h = _mm512_cvtps_ph(_mm512_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), h);
+        }
+#endif
+#if defined(__F16C__)
+        for (; i + 8 <= n; i += 8) {
+            auto h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), h);
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = half_float::half(in[i]);
+        }
+    }
+
+    void f16_to_f32(const half_float::half *in, size_t n, float *out) {
+        size_t i = 0;
+#if defined(__AVX512F__)
+        for (; i + 16 <= n; i += 16) {
+            auto h = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+            _mm512_storeu_ps(out + i, _mm512_cvtph_ps(h));
+        }
+#endif
+#if defined(__F16C__)
+        for (; i + 8 <= n; i += 8) {
+            auto h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = static_cast<float>(in[i]);
+        }
+    }
+
+    void f32_to_bf16(const float *in, size_t n, bfloat16 *out) {
+        size_t i = 0;
+#if defined(__AVX2__)
+        const auto one = _mm256_set1_epi32(1);
+        const auto bias = _mm256_set1_epi32(0x7fff);
+        const auto quiet = _mm256_set1_epi32(0x0040);
+        for (; i + 8 <= n; i += 8) {
+            auto f = _mm256_loadu_ps(in + i);
+            auto u = _mm256_castps_si256(f);
+            auto high = _mm256_srli_epi32(u, 16);
+            auto lsb = _mm256_and_si256(high, one);
+            auto rounded = _mm256_srli_epi32(_mm256_add_epi32(u, _mm256_add_epi32(bias, lsb)), 16);
+            auto nan = _mm256_castps_si256(_mm256_cmp_ps(f, f, _CMP_UNORD_Q));
+            auto r = _mm256_blendv_epi8(rounded, _mm256_or_si256(high, quiet), nan);
+            /// every lane is below 0x10000, the unsigned pack is exact.
+            auto packed = _mm_packus_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), packed);
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i].bits = bfloat16::from_float(in[i]);
+        }
+    }
+
+    void bf16_to_f32(const bfloat16 *in, size_t n, float *out) {
+        size_t i = 0;
+#if defined(__AVX2__)
+        for (; i + 8 <= n; i += 8) {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            _mm256_storeu_ps(out + i, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(v), 16)));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = bfloat16::to_float(in[i].bits);
+        }
+    }
+
+    void f32_to_u8(const float *in, size_t n, float scale, uint8_t *out) {
+        size_t i = 0;
+#if defined(__AVX2__)
+        const auto s = _mm256_set1_ps(scale);
+        const auto lo = _mm256_setzero_ps();
+        const auto hi = _mm256_set1_ps(255.0f);
+        for (; i + 8 <= n; i += 8) {
+            /// max_ps returns lo for a nan lane, as fmax does.
+            auto f = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), s), lo), hi);
+            auto v = _mm256_cvtps_epi32(f);
+            auto w = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(w, w));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = static_cast<uint8_t>(saturate(in[i], scale, 0.0f, 255.0f));
+        }
+    }
+
+    void f32_to_i8(const float *in, size_t n, float scale, int8_t *out) {
+        size_t i = 0;
+#if defined(__AVX2__)
+        const auto s = _mm256_set1_ps(scale);
+        const auto lo = _mm256_set1_ps(-128.0f);
+        const auto hi = _mm256_set1_ps(127.0f);
+        for (; i + 8 <= n; i += 8) {
+            auto f = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), s), lo), hi);
+            auto v = _mm256_cvtps_epi32(f);
+            auto w = _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi16(w, w));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = static_cast<int8_t>(saturate(in[i], scale, -128.0f, 127.0f));
+        }
+    }
+
+    void u8_to_f32(const uint8_t *in, size_t n, float scale, float *out) {
+        auto inv = 1.0f / scale;
+        size_t i = 0;
+#if defined(__AVX2__)
+        const auto s = _mm256_set1_ps(inv);
+        for (; i + 8 <= n; i += 8) {
+            auto v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i));
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)), s));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = static_cast<float>(in[i]) * inv;
+        }
+    }
+
+    void i8_to_f32(const int8_t *in, size_t n, float scale, float *out) {
+        auto inv = 1.0f / scale;
+        size_t i = 0;
+#if defined(__AVX2__)
+        const auto s = _mm256_set1_ps(inv);
+        for (; i + 8 <= n; i += 8) {
+            auto v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + i));
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v)), s));
+        }
+#endif
+        for (; i < n; ++i) {
+            out[i] = static_cast<float>(in[i]) * inv;
+        }
+    }
+
+    turbo::Status narrow_floats(const float *in, size_t n, DataType dt, uint8_t *out, float scale) {
+        switch (dt) {
+            case DataType::DT_FLOAT:
+                std::memcpy(out, in, n * sizeof(float));
+                return turbo::OkStatus();
+            case DataType::DT_FLOAT16:
+                f32_to_f16(in, n, reinterpret_cast<half_float::half *>(out));
+                return turbo::OkStatus();
+            case DataType::DT_BFLOAT16:
+                f32_to_bf16(in, n, reinterpret_cast<bfloat16 *>(out));
+                return turbo::OkStatus();
+            case DataType::DT_UINT8:
+                f32_to_u8(in, n, scale, out);
+                return turbo::OkStatus();
+            default:
+                return turbo::invalid_argument_error("no float conversion for data type:", static_cast<int>(dt));
+        }
+    }
+
+    turbo::Status widen_to_floats(const uint8_t *in, size_t n, DataType dt, float *out, float scale) {
+        switch (dt) {
+            case DataType::DT_FLOAT:
+                std::memcpy(out, in, n * sizeof(float));
+                return turbo::OkStatus();
+            case DataType::DT_FLOAT16:
+                f16_to_f32(reinterpret_cast<const half_float::half *>(in), n, out);
+                return turbo::OkStatus();
+            case DataType::DT_BFLOAT16:
+                bf16_to_f32(reinterpret_cast<const bfloat16 *>(in), n, out);
+                return turbo::OkStatus();
+            case DataType::DT_UINT8:
+                u8_to_f32(in, n, scale, out);
+                return turbo::OkStatus();
+            default:
+                return turbo::invalid_argument_error("no float conversion for data type:", static_cast<int>(dt));
+        }
+    }
+} // namespace xann
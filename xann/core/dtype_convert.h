@@ -0,0 +1,62 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <turbo/utility/status.h>
+#include <xann/common/bfloat16.h>
+#include <xann/common/half.hpp>
+#include <xann/core/operator_registry.h>
+
+namespace xann {
+
+    /// bulk conversions between float and the storage types, n elements from
+    /// in to out. the loops take the widest unit the build targets (AVX-512 /
+    /// F16C for fp16, AVX2 for the rest) and finish the tail element by
+    /// element with the same rounding, so results do not depend on n.
+
+    /// round to nearest even.
+    void f32_to_f16(const float *in, size_t n, half_float::half *out);
+
+    void f16_to_f32(const half_float::half *in, size_t n, float *out);
+
+    /// round to nearest even, nan stays a quiet nan, same as bfloat16::from_float.
+    void f32_to_bf16(const float *in, size_t n, bfloat16 *out);
+
+    void bf16_to_f32(const bfloat16 *in, size_t n, float *out);
+
+    /// round(in * scale) saturated to [0, 255], nan goes to 0.
+    void f32_to_u8(const float *in, size_t n, float scale, uint8_t *out);
+
+    /// round(in * scale) saturated to [-128, 127], nan goes to 0.
+    void f32_to_i8(const float *in, size_t n, float scale, int8_t *out);
+
+    /// in / scale.
+    void u8_to_f32(const uint8_t *in, size_t n, float scale, float *out);
+
+    /// in / scale.
+    void i8_to_f32(const int8_t *in, size_t n, float scale, float *out);
+
+    /// n floats to n dt values, scale only applies to DT_UINT8.
+    turbo::Status narrow_floats(const float *in, size_t n, DataType dt, uint8_t *out, float scale = 1.0f);
+
+    /// n dt values to n floats, scale only applies to DT_UINT8.
+    turbo::Status widen_to_floats(const uint8_t *in, size_t n, DataType dt, float *out, float scale = 1.0f);
+} // namespace xann
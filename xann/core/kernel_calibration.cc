@@ -0,0 +1,225 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/core/kernel_calibration.h>
+#include <xann/common/bfloat16.h>
+#include <xann/common/half.hpp>
+#include <xann/core/vector_space.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <tuple>
+
+namespace xann {
+
+    static constexpr size_t kCalibrateMinVectors = 1024;
+
+    std::string cpu_model_name() {
+        std::ifstream in("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, 10, "model name") != 0) {
+                continue;
+            }
+            auto pos = line.find(':');
+            if (pos == std::string::npos) {
+                break;
+            }
+            auto name = line.substr(line.find_first_not_of(" \t", pos + 1));
+            std::replace(name.begin(), name.end(), '\t', ' ');
+            return name;
+        }
+        return xsimd::default_arch::name();
+    }
+
+    bool simd_level_supported(SimdLevel level) {
+        auto archs = xsimd::available_architectures();
+        switch (level) {
+            case SimdLevel::SIMD_NONE:
+                return true;
+            case SimdLevel::SIMD_SSE2:
+                return archs.sse3;
+            case SimdLevel::SIMD_AVX2:
+                return archs.avx2 && archs.fma3_avx2;
+            case SimdLevel::SIMD_AVX512:
+                return archs.avx512f;
+            default:
+                return false;
+        }
+    }
+
+    void fill_random_vectors(DataType dt, int32_t dim, size_t stride, uint8_t *data, size_t n,
+                             std::mt19937_64 &rng) {
+        std::uniform_real_distribution<float> u(-1.0f, 1.0f);
+        for (size_t i = 0; i < n; ++i) {
+            auto *v = data + i * stride;
+            for (int32_t d = 0; d < dim; ++d) {
+                switch (dt) {
+                    case DataType::DT_FLOAT:
+                        reinterpret_cast<float *>(v)[d] = u(rng);
+                        break;
+                    case DataType::DT_FLOAT16:
+                        reinterpret_cast<half_float::half *>(v)[d] = half_float::half(u(rng));
+                        break;
+                    case DataType::DT_BFLOAT16:
+                        reinterpret_cast<bfloat16 *>(v)[d] = bfloat16(u(rng));
+                        break;
+                    default:
+                        v[d] = static_cast<uint8_t>(rng());
+                        break;
+                }
+            }
+        }
+    }
+
+    double time_kernel_scan(const OperatorEntity &op, size_t stride, const uint8_t *pool,
+                            const std::vector<uint32_t> &order, turbo::span<uint8_t> query, size_t rounds) {
+        double best = std::numeric_limits<double>::max();
+        volatile float sink = 0.0f;
+        for (size_t round = 0; round < std::max<size_t>(rounds, 1); ++round) {
+            auto start = std::chrono::steady_clock::now();
+            float acc = 0.0f;
+            for (auto i: order) {
+                acc += op.rank(query, turbo::span<uint8_t>(const_cast<uint8_t *>(pool) + i * stride, stride));
+            }
+            auto end = std::chrono::steady_clock::now();
+            sink = sink + acc;
+            auto ns = std::chrono::duration<double, std::nano>(end - start).count();
+            best = std::min(best, ns / static_cast<double>(order.size()));
+        }
+        return best;
+    }
+
+    /// (metric, data type, dim, max level)
+    using CalibrationKey = std::tuple<MetricType, int, int32_t, int>;
+
+    static bool usable_level(MetricType metric, DataType dt, SimdLevel level) {
+        if (!simd_level_supported(level)) {
+            return false;
+        }
+        auto rs = MetricRegistry::instance().get_metric_operator(metric, dt, level);
+        return rs.ok() && rs.value_or_die().supports;
+    }
+
+    /// one decision per line: cpu model, metric, data type, dim, max level, level.
+    static bool load_decision(const std::string &path, const std::string &cpu, const CalibrationKey &key,
+                              SimdLevel *level) {
+        std::ifstream in(path);
+        std::string line;
+        bool found = false;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string model;
+            int metric, dt, dim, max_level, chosen;
+            if (!std::getline(fields, model, '\t') || model != cpu) {
+                continue;
+            }
+            if (!(fields >> metric >> dt >> dim >> max_level >> chosen)) {
+                continue;
+            }
+            if (CalibrationKey{metric, dt, dim, max_level} == key && chosen >= 0 &&
+                chosen < static_cast<int>(SimdLevel::SIMD_MAX)) {
+                /// later lines win, a re-calibration appends rather than rewrites.
+                *level = static_cast<SimdLevel>(chosen);
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    static void store_decision(const std::string &path, const std::string &cpu, const CalibrationKey &key,
+                               SimdLevel level) {
+        std::ofstream out(path, std::ios::app);
+        out << cpu << '\t' << std::get<0>(key) << '\t' << std::get<1>(key) << '\t' << std::get<2>(key) << '\t'
+            << std::get<3>(key) << '\t' << static_cast<int>(level) << '\n';
+    }
+
+    turbo::Result<SimdLevel> calibrate_simd_level(MetricType metric, DataType dt, int32_t dim, SimdLevel max_level,
+                                                  const KernelCalibrationOption &option) {
+        static std::mutex mutex;
+        static std::map<CalibrationKey, SimdLevel> cache;
+        CalibrationKey key{metric, static_cast<int>(dt), dim, static_cast<int>(max_level)};
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            auto it = cache.find(key);
+            if (it != cache.end()) {
+                return it->second;
+            }
+        }
+
+        /// the benchmark runs unlocked so other keys are not held up behind
+        /// it; racing callers of one key each time it, the first to publish wins.
+        auto cpu = cpu_model_name();
+        SimdLevel level;
+        if (!option.cache_file.empty() && load_decision(option.cache_file, cpu, key, &level) &&
+            level <= max_level && usable_level(metric, dt, level)) {
+            std::lock_guard<std::mutex> lk(mutex);
+            return cache.emplace(key, level).first->second;
+        }
+
+        std::vector<VectorSpace> spaces;
+        for (int l = 0; l <= std::min(static_cast<int>(max_level), static_cast<int>(SimdLevel::SIMD_MAX) - 1); ++l) {
+            if (!usable_level(metric, dt, static_cast<SimdLevel>(l))) {
+                continue;
+            }
+            auto rs = VectorSpace::create(dim, metric, dt, static_cast<SimdLevel>(l));
+            if (rs.ok()) {
+                spaces.push_back(std::move(rs).value_or_die());
+            }
+        }
+        if (spaces.empty()) {
+            return turbo::unavailable_error("no usable kernel for metric:", metric, " data type:",
+                                            static_cast<int>(dt), " max simd level:", static_cast<int>(max_level));
+        }
+
+        auto stride = static_cast<size_t>(spaces.front().vector_byte_size);
+        auto n = std::max(option.pool_bytes / stride, kCalibrateMinVectors);
+        AlignedBytes pool(n * stride, 0);
+        AlignedBytes query(stride, 0);
+        std::mt19937_64 rng(n);
+        fill_random_vectors(dt, dim, stride, pool.data(), n, rng);
+        fill_random_vectors(dt, dim, stride, query.data(), 1, rng);
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+
+        /// one warm up pass so the first level does not pay the page faults.
+        time_kernel_scan(spaces.front().operation, stride, pool.data(), order,
+                         turbo::span<uint8_t>(query.data(), stride), 1);
+        double best_ns = std::numeric_limits<double>::max();
+        level = SimdLevel::SIMD_NONE;
+        for (auto &vs: spaces) {
+            auto ns = time_kernel_scan(vs.operation, stride, pool.data(), order,
+                                       turbo::span<uint8_t>(query.data(), stride), option.rounds);
+            if (ns < best_ns) {
+                best_ns = ns;
+                level = vs.operation.simd_level;
+            }
+        }
+        std::lock_guard<std::mutex> lk(mutex);
+        auto [it, inserted] = cache.emplace(key, level);
+        if (inserted && !option.cache_file.empty()) {
+            store_decision(option.cache_file, cpu, key, level);
+        }
+        return it->second;
+    }
+} // namespace xann
@@ -0,0 +1,63 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include <turbo/container/span.h>
+#include <turbo/utility/status.h>
+#include <xann/core/metric.h>
+#include <xann/core/operator_registry.h>
+
+namespace xann {
+
+    struct KernelCalibrationOption {
+        /// decisions are appended here keyed by cpu model, shared by hosts of
+        /// a fleet. empty keeps them for the process only.
+        std::string cache_file;
+        /// bytes of synthetic vectors scanned per level, past L2 on purpose so
+        /// memory bound levels lose to the narrower ones they tie with.
+        size_t pool_bytes{4 << 20};
+        size_t rounds{3};
+    };
+
+    /// "model name" of /proc/cpuinfo, the compiled xsimd arch elsewhere.
+    std::string cpu_model_name();
+
+    /// the host can execute kernels registered for level.
+    bool simd_level_supported(SimdLevel level);
+
+    /// fill n slots of stride bytes with uniform values of dt.
+    void fill_random_vectors(DataType dt, int32_t dim, size_t stride, uint8_t *data, size_t n,
+                             std::mt19937_64 &rng);
+
+    /// best of rounds ns per op.rank() call, query against pool in order.
+    double time_kernel_scan(const OperatorEntity &op, size_t stride, const uint8_t *pool,
+                            const std::vector<uint32_t> &order, turbo::span<uint8_t> query, size_t rounds);
+
+    /// time every registered level <= max_level the host supports for
+    /// (metric, dt, dim) and return the fastest. decisions are cached per
+    /// process and in option.cache_file under cpu_model_name(). thread safe,
+    /// concurrent first calls for one key may time it more than once but all
+    /// return the same decision.
+    turbo::Result<SimdLevel> calibrate_simd_level(MetricType metric, DataType dt, int32_t dim, SimdLevel max_level,
+                                                  const KernelCalibrationOption &option = KernelCalibrationOption());
+} // namespace xann
@@ -49,6 +49,39 @@ namespace xann {
     static constexpr MetricType kPoincare = 11;
 
     static constexpr MetricType kLorentz = 12;
+
+    /// L-infinity, the largest per dimension gap.
+    static constexpr MetricType kChebyshev = 13;
+
+    /// l2 with per dimension weights held in the VectorSpace.
+    static constexpr MetricType kWeightedL2 = 14;
+
+    /// l2 after the whitening transform held in the VectorSpace.
+    static constexpr MetricType kMahalanobis = 15;
+
+    /// Jensen-Shannon divergence of probability vectors, in nats.
+    static constexpr MetricType kJensenShannon = 16;
+
+    /// Kullback-Leibler divergence KL(a || b) of the operator arguments, the scans pass the
+    /// query as a. probability vectors, in nats.
+    static constexpr MetricType kKLDivergence = 17;
     static constexpr MetricType kMetricTypeMax = 30;
 
+    /// the operator returns a similarity, larger is closer.
+    inline constexpr bool is_similarity_metric(MetricType metric) {
+        return metric == kIP || metric == kCosine || metric == kNormalizedCosine;
+    }
+
+    /// the operator value obeys the triangle inequality.
+    inline constexpr bool is_true_metric(MetricType metric) {
+        return metric == kL1 || metric == kL2 || metric == kAngle || metric == kNormalizedL2 ||
+               metric == kNormalizedAngle || metric == kPoincare || metric == kChebyshev ||
+               metric == kWeightedL2 || metric == kMahalanobis;
+    }
+
+    /// map an operator value to ranking space, smaller is always closer.
+    inline constexpr float metric_rank_score(MetricType metric, float value) {
+        return is_similarity_metric(metric) ? -value : value;
+    }
+
 }  // namespace xann
@@ -26,6 +26,10 @@
 #include <xann/distance/normalized_l2_operator.h>
 #include <xann/distance/normalized_cosine_operator.h>
 #include <xann/distance/normalized_angle_operator.h>
+#include <xann/distance/chebyshev_operator.h>
+#include <xann/distance/whitened_l2_operator.h>
+#include <xann/distance/divergence_operator.h>
+#include <xann/distance/mixed_operator.h>
 #include <mutex>
 #include <turbo/log/logging.h>
 
@@ -64,6 +68,18 @@ namespace xann {
             return turbo::invalid_argument_error("invalid simd level:", static_cast<int>(op.simd_level));
         }
 
+        if (op.mixed_precision()) {
+            if (static_cast<int>(op.query_data_type) >= static_cast<int>(DataType::DT_MAX)) {
+                return turbo::invalid_argument_error("invalid query data type:", static_cast<int>(op.query_data_type));
+            }
+            auto key = mixed_key(op.metric, op.query_data_type, op.data_type, op.simd_level);
+            if (_mixed_operators.find(key) != _mixed_operators.end() && !replace) {
+                return turbo::already_exists_error("already inited:", static_cast<int>(op.simd_level));
+            }
+            _mixed_operators[key] = op;
+            return turbo::OkStatus();
+        }
+
         auto &sit = dit.operators[static_cast<int>(op.simd_level)];
         if (sit.init && !replace) {
             return turbo::already_exists_error("already inited:", static_cast<int>(op.simd_level));
@@ -107,6 +123,20 @@ namespace xann {
         return sit.operators[static_cast<int>(simd_level)];
     }
 
+    turbo::Result<OperatorEntity> MetricRegistry::get_mixed_operator(MetricType metric, DataType query_dt, DataType dt,
+                                                                     SimdLevel simd_level) {
+        if (query_dt == dt) {
+            return get_metric_operator(metric, dt, simd_level);
+        }
+        auto it = _mixed_operators.find(mixed_key(metric, query_dt, dt, simd_level));
+        if (it == _mixed_operators.end()) {
+            return turbo::unavailable_error("unavailable mixed kernel, metric:", metric, " query data type:",
+                                            static_cast<int>(query_dt), " data type:", static_cast<int>(dt),
+                                            " simd level:", static_cast<int>(simd_level));
+        }
+        return it->second;
+    }
+
     std::vector<OperatorEntity> MetricRegistry::all_metric_operators() {
         std::vector<OperatorEntity> result;
         for (auto &it: _metric_level_map) {
@@ -130,6 +160,9 @@ namespace xann {
                 }
             }
         }
+        for (auto &it: _mixed_operators) {
+            result.push_back(it.second);
+        }
         return result;
     }
 
@@ -177,6 +210,22 @@ namespace xann {
         if (!rs.ok()) {
             return rs;
         }
+        rs = initialize_chebyshev_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = initialize_whitened_l2_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = initialize_divergence_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = initialize_mixed_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
         return turbo::OkStatus();
     }
 
@@ -29,6 +29,7 @@ namespace xann {
         DT_UINT8,
         DT_FLOAT16,
         DT_FLOAT,
+        DT_BFLOAT16,
         DT_MAX,
     };
 
@@ -53,6 +54,11 @@ namespace xann {
         using value_type = float;
     };
 
+    template<>
+    struct data_type_traits<DataType::DT_BFLOAT16> {
+        using value_type = uint16_t;
+    };
+
 
     typedef void (*normalize_vector_func)(const turbo::span<uint8_t> &input, turbo::span<uint8_t> &output);
 
@@ -60,6 +66,16 @@ namespace xann {
 
     typedef float (*norm_vector_func)(const turbo::span<uint8_t> &v1);
 
+    /// maps n rank_vector values back to distance_vector values in place.
+    typedef void (*rank_to_distance_func)(float *values, size_t n);
+
+    /// rank that may stop early once the partial value reaches bound, any
+    /// value >= bound then means "not better than bound".
+    typedef float (*bounded_rank_func)(const turbo::span<uint8_t> &v1, const turbo::span<uint8_t> &v2, float bound);
+
+    /// elements accumulated between two early abandon checks.
+    static constexpr size_t kAbandonBlock = 64;
+
 
     enum class SimdLevel {
         SIMD_NONE = 0,
@@ -81,11 +97,51 @@ namespace xann {
 
         DataType data_type{DataType::DT_NONE};
 
+        /// DT_NONE for a symmetric kernel, else the type of the first (query)
+        /// argument of a mixed precision kernel whose second is data_type.
+        DataType query_data_type{DataType::DT_NONE};
+
+        [[nodiscard]] bool mixed_precision() const {
+            return query_data_type != DataType::DT_NONE && query_data_type != data_type;
+        }
+
         normalize_vector_func normalize_vector{nullptr};
 
         distance_vector_func distance_vector{nullptr};
 
         norm_vector_func norm_vector{nullptr};
+
+        /// fused kernel returning a ranking space value (smaller is closer)
+        /// monotone in distance_vector but without its sqrt / acos, nullptr
+        /// falls back to metric_rank_score of distance_vector.
+        distance_vector_func rank_vector{nullptr};
+
+        /// inverse of rank_vector, applied to the final top-k only.
+        rank_to_distance_func rank_to_distance{nullptr};
+
+        /// early abandoning rank for metrics whose rank only grows with each
+        /// dimension (l1, l2), nullptr for the others.
+        bounded_rank_func bounded_rank_vector{nullptr};
+
+        [[nodiscard]] float rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) const {
+            return rank_vector ? rank_vector(a, b) : metric_rank_score(metric, distance_vector(a, b));
+        }
+
+        [[nodiscard]] float bounded_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b,
+                                         float bound) const {
+            return bounded_rank_vector ? bounded_rank_vector(a, b, bound) : rank(a, b);
+        }
+
+        /// rank values to distance_vector values, in place.
+        void to_distance(float *values, size_t n) const {
+            if (rank_vector) {
+                rank_to_distance(values, n);
+                return;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                values[i] = metric_rank_score(metric, values[i]);
+            }
+        }
     };
 
     struct SimdLevelMap {
@@ -121,6 +177,10 @@ namespace xann {
 
         turbo::Result<OperatorEntity> get_metric_operator(MetricType metric, DataType dt, SimdLevel simd_level);
 
+        /// the kernel scoring a query_dt query against dt storage.
+        turbo::Result<OperatorEntity> get_mixed_operator(MetricType metric, DataType query_dt, DataType dt,
+                                                         SimdLevel simd_level);
+
         turbo::Status register_operator(OperatorEntity op, bool replace = false);
 
         /// mark end of building,
@@ -135,8 +195,15 @@ namespace xann {
     private:
         MetricRegistry();
 
+        static uint64_t mixed_key(MetricType metric, DataType query_dt, DataType dt, SimdLevel simd_level) {
+            return static_cast<uint64_t>(metric) << 24 | static_cast<uint64_t>(query_dt) << 16 |
+                   static_cast<uint64_t>(dt) << 8 | static_cast<uint64_t>(simd_level);
+        }
+
         bool _finish_build{false};
         std::vector<MetricLevelMap> _metric_level_map;
+        /// mixed precision kernels by mixed_key.
+        turbo::flat_hash_map<uint64_t, OperatorEntity> _mixed_operators;
     };
 
     inline turbo::Status register_metric_level_operator(MetricRegistry &r, OperatorEntity op, bool replace = false) {
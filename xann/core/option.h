@@ -18,6 +18,7 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 
 namespace xann {
     struct VectorStoreOption {
@@ -26,4 +27,67 @@ namespace xann {
         bool enable_replace_vacant{true};
         uint64_t reserved{0};
     };
+
+    /// return false to drop the label from the result.
+    using SearchFilter = std::function<bool(uint64_t label)>;
+
+    /// the search parameter of an index that trades cost for recall,
+    /// recall is assumed non decreasing in its value.
+    enum class SearchKnob : uint8_t {
+        kNone = 0,
+        kEf = 1,
+        kNprobe = 2,
+        kRerank = 3
+    };
+
+    struct SearchOption {
+        uint32_t k{10};
+        /// candidate list size for graph indexes.
+        uint32_t ef{64};
+        /// number of lists probed by ivf indexes.
+        uint32_t nprobe{8};
+        /// candidates reranked with full vectors by compressed indexes, 0 means the whole beam.
+        uint32_t rerank{0};
+        SearchFilter filter;
+        /// identifies filter for result caches, a filtered search with 0 is never cached.
+        uint64_t filter_key{0};
+        /// let an index with a SearchTuning override its knob.
+        bool use_tuning{false};
+        /// the query is dim or alignment_dim floats for a mixed precision
+        /// space, not a vector of the storage type.
+        bool float_query{false};
+    };
+
+    /// knob value chosen by SearchTuner, persisted next to the index.
+    struct SearchTuning {
+        SearchKnob knob{SearchKnob::kNone};
+        uint32_t value{0};
+        uint32_t k{0};
+        float target_recall{0.0f};
+        /// measured on the tuning queries, may be below target if max_value was hit.
+        float recall{0.0f};
+        /// store mutation_count and size at tuning time, the drift baseline.
+        uint64_t mutation_count{0};
+        uint64_t size{0};
+
+        [[nodiscard]] bool valid() const {
+            return knob != SearchKnob::kNone;
+        }
+
+        void apply(SearchOption &option) const {
+            switch (knob) {
+                case SearchKnob::kEf:
+                    option.ef = value;
+                    break;
+                case SearchKnob::kNprobe:
+                    option.nprobe = value;
+                    break;
+                case SearchKnob::kRerank:
+                    option.rerank = value;
+                    break;
+                default:
+                    break;
+            }
+        }
+    };
 } // namespace xann
@@ -0,0 +1,97 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/core/query_vector.h>
+#include <xann/core/dtype_convert.h>
+#include <algorithm>
+#include <cstring>
+
+namespace xann {
+
+    QueryVector::QueryVector(const VectorSpace *vs) : _vs(vs), _size(static_cast<size_t>(vs->vector_byte_size)) {
+        xsimd::aligned_allocator<uint8_t, VectorSpace::kAlignmentBytes> allocator;
+        _data = allocator.allocate(_size);
+        if (vs->mixed_precision()) {
+            _query_size = static_cast<size_t>(vs->alignment_dim) * sizeof(float);
+            _query = allocator.allocate(_query_size);
+        }
+    }
+
+    QueryVector::~QueryVector() {
+        xsimd::aligned_allocator<uint8_t, VectorSpace::kAlignmentBytes> allocator;
+        if (_data) {
+            allocator.deallocate(_data, _size);
+            _data = nullptr;
+        }
+        if (_query) {
+            allocator.deallocate(_query, _query_size);
+            _query = nullptr;
+        }
+    }
+
+    turbo::Status QueryVector::assign_float(turbo::span<uint8_t> raw) {
+        if (_vs->data_type == DataType::DT_FLOAT) {
+            return assign(raw);
+        }
+        if (!_query) {
+            return turbo::invalid_argument_error("float query needs a mixed precision space, data type:",
+                                                 static_cast<int>(_vs->data_type));
+        }
+        auto dim = static_cast<size_t>(_vs->dim);
+        auto dim_bytes = dim * sizeof(float);
+        if (raw.size() != dim_bytes && raw.size() != _query_size) {
+            return turbo::invalid_argument_error("bad float query bytes:", raw.size(), " expect:", dim_bytes, " or ",
+                                                 _query_size);
+        }
+        /// create_mixed refuses transformed and normalized metrics, the floats
+        /// only move to storage units, the mixed kernels widen stored values
+        /// without a scale.
+        std::memcpy(_query, raw.data(), dim_bytes);
+        std::memset(_query + dim_bytes, 0, _query_size - dim_bytes);
+        auto *q = reinterpret_cast<float *>(_query);
+        if (_vs->storage_scale != 1.0f) {
+            for (size_t i = 0; i < dim; ++i) {
+                q[i] *= _vs->storage_scale;
+            }
+        }
+        std::memset(_data, 0, _size);
+        return narrow_floats(q, dim, _vs->data_type, _data);
+    }
+
+    turbo::Status QueryVector::assign(turbo::span<uint8_t> raw) {
+        auto dim = static_cast<size_t>(_vs->dim);
+        auto dim_bytes = dim * _vs->element_size;
+        if (raw.size() != dim_bytes && raw.size() != _size) {
+            return turbo::invalid_argument_error("bad query bytes:", raw.size(), " expect:", dim_bytes, " or ", _size);
+        }
+        std::memcpy(_data, raw.data(), std::min(raw.size(), dim_bytes));
+        std::memset(_data + dim_bytes, 0, _size - dim_bytes);
+        if (_vs->has_transform()) {
+            _vs->prepare_vector(span());
+        }
+        if (_vs->need_normalize_vector && _vs->operation.normalize_vector) {
+            auto out = span();
+            _vs->operation.normalize_vector(out, out);
+        }
+        if (_query) {
+            std::memset(_query, 0, _query_size);
+            return widen_to_floats(_data, dim, _vs->data_type, reinterpret_cast<float *>(_query));
+        }
+        return turbo::OkStatus();
+    }
+} // namespace xann
@@ -0,0 +1,71 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <turbo/container/span.h>
+#include <turbo/utility/status.h>
+#include <xann/core/option.h>
+#include <xann/core/vector_space.h>
+
+namespace xann {
+
+    /// aligned, zero padded copy of a query in the layout of the store
+    /// slots, normalized when the space requires it. every index runs its
+    /// query through this before touching the kernels. a mixed precision
+    /// space also keeps the query as floats for vs->query_operation.
+    class QueryVector {
+    public:
+        explicit QueryVector(const VectorSpace *vs);
+
+        ~QueryVector();
+
+        QueryVector(const QueryVector &) = delete;
+
+        QueryVector &operator=(const QueryVector &) = delete;
+
+        /// raw is dim * element_size or vector_byte_size bytes of the storage type.
+        turbo::Status assign(turbo::span<uint8_t> raw);
+
+        /// raw is dim or alignment_dim floats, for a mixed precision or a
+        /// DT_FLOAT space. span() gets the query narrowed to the storage type.
+        turbo::Status assign_float(turbo::span<uint8_t> raw);
+
+        /// assign_float() if option.float_query is set, assign() otherwise.
+        turbo::Status assign(turbo::span<uint8_t> raw, const SearchOption &option) {
+            return option.float_query ? assign_float(raw) : assign(raw);
+        }
+
+        /// the query in the storage type.
+        [[nodiscard]] turbo::span<uint8_t> span() const {
+            return turbo::span<uint8_t>(_data, _size);
+        }
+
+        /// alignment_dim floats for a mixed precision space, span() otherwise.
+        [[nodiscard]] turbo::span<uint8_t> query_span() const {
+            return _query ? turbo::span<uint8_t>(_query, _query_size) : span();
+        }
+
+    private:
+        const VectorSpace *_vs{nullptr};
+        uint8_t *_data{nullptr};
+        size_t _size{0};
+        uint8_t *_query{nullptr};
+        size_t _query_size{0};
+    };
+} // namespace xann
@@ -0,0 +1,111 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <xann/core/metric.h>
+
+namespace xann {
+
+    struct SearchHit {
+        uint64_t label{0};
+        /// local id inside the store that produced the hit.
+        uint64_t lid{0};
+        /// operator value, not the ranking score.
+        float distance{0.0f};
+    };
+
+    /// keep the k best candidates in ranking space (smaller is closer),
+    /// a bounded max heap so threshold() is the current k-th score.
+    class TopKCollector {
+    public:
+        struct Entry {
+            float score;
+            uint64_t lid;
+
+            bool operator<(const Entry &other) const {
+                return score < other.score;
+            }
+        };
+
+        explicit TopKCollector(size_t k) : _k(k) {
+            _heap.reserve(k + 1);
+        }
+
+        /// return true if the candidate entered the heap.
+        bool push(float score, uint64_t lid) {
+            if (_k == 0) {
+                return false;
+            }
+            if (_heap.size() < _k) {
+                _heap.push_back({score, lid});
+                std::push_heap(_heap.begin(), _heap.end());
+                return true;
+            }
+            if (!(score < _heap.front().score)) {
+                return false;
+            }
+            std::pop_heap(_heap.begin(), _heap.end());
+            _heap.back() = {score, lid};
+            std::push_heap(_heap.begin(), _heap.end());
+            return true;
+        }
+
+        [[nodiscard]] bool full() const {
+            return _heap.size() >= _k;
+        }
+
+        /// the score a candidate must beat, +inf until the heap is full.
+        [[nodiscard]] float threshold() const {
+            return full() && _k > 0 ? _heap.front().score : std::numeric_limits<float>::infinity();
+        }
+
+        [[nodiscard]] size_t size() const {
+            return _heap.size();
+        }
+
+        /// sorted best first, the collector is empty afterwards.
+        std::vector<Entry> finish() {
+            std::sort_heap(_heap.begin(), _heap.end());
+            return std::move(_heap);
+        }
+
+    private:
+        size_t _k{0};
+        std::vector<Entry> _heap;
+    };
+
+    /// merge per partition results that are each sorted best first.
+    inline std::vector<SearchHit> merge_search_hits(MetricType metric, std::vector<std::vector<SearchHit> > parts,
+                                                   size_t k) {
+        std::vector<SearchHit> all;
+        for (auto &p: parts) {
+            all.insert(all.end(), p.begin(), p.end());
+        }
+        auto n = std::min(k, all.size());
+        std::partial_sort(all.begin(), all.begin() + n, all.end(), [metric](const SearchHit &a, const SearchHit &b) {
+            return metric_rank_score(metric, a.distance) < metric_rank_score(metric, b.distance);
+        });
+        all.resize(n);
+        return all;
+    }
+} // namespace xann
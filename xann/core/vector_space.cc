@@ -19,7 +19,10 @@
 #include <xann/core/operator_registry.h>
 #include <xann/distance/l1_operator.h>
 #include <xann/distance/l2_operator.h>
+#include <xann/quantization/linear_transform.h>
 #include <turbo/container/flat_hash_map.h>
+#include <algorithm>
+#include <cmath>
 
 namespace xann {
     turbo::Result<int32_t> data_type_size(DataType dt) {
@@ -30,6 +33,8 @@ namespace xann {
                 return sizeof(uint16_t);
             case DataType::DT_FLOAT:
                 return sizeof(float);
+            case DataType::DT_BFLOAT16:
+                return sizeof(uint16_t);
             default:
                 return turbo::invalid_argument_error("unknown datatype");
         }
@@ -74,6 +79,50 @@ namespace xann {
         return vs;
     }
 
+    turbo::Result<VectorSpace> VectorSpace::create(int dim, MetricType metric, DataType dt, SimdLevel level,
+                                                   const KernelCalibrationOption &calibration) {
+        auto lrs = calibrate_simd_level(metric, dt, dim, level, calibration);
+        if (!lrs.ok()) {
+            return lrs.status();
+        }
+        return create(dim, metric, dt, lrs.value_or_die());
+    }
+
+    turbo::Result<VectorSpace> VectorSpace::create_mixed(int dim, MetricType metric, DataType query_dt, DataType dt,
+                                                         SimdLevel level) {
+        /// float queries skip prepare_vector and normalization, see QueryVector::assign_float.
+        if (metric == kWeightedL2 || metric == kMahalanobis) {
+            return turbo::invalid_argument_error("mixed precision queries can not be transformed, metric:", metric);
+        }
+        turbo::Result<VectorSpace> rs = turbo::unavailable_error("no kernel for metric:", metric);
+        for (auto l = static_cast<int>(level); l >= static_cast<int>(SimdLevel::SIMD_NONE); --l) {
+            rs = create(dim, metric, dt, static_cast<SimdLevel>(l));
+            if (rs.ok()) {
+                break;
+            }
+        }
+        if (!rs.ok() || query_dt == dt) {
+            return rs;
+        }
+        auto vs = std::move(rs).value_or_die();
+        if (vs.need_normalize_vector) {
+            return turbo::invalid_argument_error("mixed precision queries can not be normalized, metric:", metric);
+        }
+        turbo::Result<OperatorEntity> qrs = turbo::unavailable_error("no mixed kernel for metric:", metric);
+        for (auto l = static_cast<int>(level); l >= static_cast<int>(SimdLevel::SIMD_NONE); --l) {
+            qrs = MetricRegistry::instance().get_mixed_operator(metric, query_dt, dt, static_cast<SimdLevel>(l));
+            if (qrs.ok()) {
+                break;
+            }
+        }
+        if (!qrs.ok()) {
+            return qrs.status();
+        }
+        vs.query_data_type = query_dt;
+        vs.query_operation = qrs.value_or_die();
+        return vs;
+    }
+
     turbo::span<uint8_t> VectorSpace::align_allocate_vector(size_t n) {
         auto nalloc = static_cast<size_t>(n * vector_byte_size);
         auto ptr = allocator.allocate(nalloc);
@@ -106,4 +155,102 @@ namespace xann {
         return xsimd::is_aligned(v.data());
     }
 
+    turbo::Status VectorSpace::set_weights(const std::vector<float> &weights) {
+        if (metric != kWeightedL2) {
+            return turbo::invalid_argument_error("weights need kWeightedL2, metric:", metric);
+        }
+        if (weights.size() != static_cast<size_t>(dim)) {
+            return turbo::invalid_argument_error("weights size:", weights.size(), " expect:", dim);
+        }
+        std::vector<float> scale(weights.size());
+        for (size_t i = 0; i < weights.size(); ++i) {
+            if (!(weights[i] >= 0.0f) || !std::isfinite(weights[i])) {
+                return turbo::invalid_argument_error("bad weight at:", i);
+            }
+            scale[i] = std::sqrt(weights[i]);
+        }
+        weight_scale = std::move(scale);
+        return turbo::OkStatus();
+    }
+
+    turbo::Status VectorSpace::set_storage_scale(float scale) {
+        if (data_type != DataType::DT_UINT8) {
+            return turbo::invalid_argument_error("storage scale needs DT_UINT8, data type:",
+                                                 static_cast<int>(data_type));
+        }
+        if (!(scale > 0.0f) || !std::isfinite(scale)) {
+            return turbo::invalid_argument_error("bad storage scale:", scale);
+        }
+        storage_scale = scale;
+        return turbo::OkStatus();
+    }
+
+    turbo::Status VectorSpace::set_whitening(std::vector<float> matrix) {
+        if (metric != kMahalanobis) {
+            return turbo::invalid_argument_error("whitening needs kMahalanobis, metric:", metric);
+        }
+        auto n = static_cast<size_t>(dim);
+        if (matrix.size() != n * n) {
+            return turbo::invalid_argument_error("whitening size:", matrix.size(), " expect:", n * n);
+        }
+        whitening = std::move(matrix);
+        whitening_gemv = select_gemv(operation.simd_level);
+        return turbo::OkStatus();
+    }
+
+    turbo::Status VectorSpace::set_covariance(const std::vector<float> &covariance) {
+        auto n = static_cast<size_t>(dim);
+        if (covariance.size() != n * n) {
+            return turbo::invalid_argument_error("covariance size:", covariance.size(), " expect:", n * n);
+        }
+        /// covariance = L L^T, lower triangular L in double.
+        std::vector<double> l(n * n, 0.0);
+        for (size_t i = 0; i < n; ++i) {
+            for (size_t j = 0; j <= i; ++j) {
+                double sum = covariance[i * n + j];
+                for (size_t k = 0; k < j; ++k) {
+                    sum -= l[i * n + k] * l[j * n + k];
+                }
+                if (i == j) {
+                    if (!(sum > 0.0)) {
+                        return turbo::invalid_argument_error("covariance not positive definite at:", i);
+                    }
+                    l[i * n + i] = std::sqrt(sum);
+                } else {
+                    l[i * n + j] = sum / l[j * n + j];
+                }
+            }
+        }
+        /// W = L^-1 by forward substitution, column by column of the identity.
+        std::vector<float> w(n * n, 0.0f);
+        std::vector<double> x(n);
+        for (size_t c = 0; c < n; ++c) {
+            for (size_t i = 0; i < n; ++i) {
+                double sum = i == c ? 1.0 : 0.0;
+                for (size_t k = c; k < i; ++k) {
+                    sum -= l[i * n + k] * x[k];
+                }
+                x[i] = i < c ? 0.0 : sum / l[i * n + i];
+                w[i * n + c] = static_cast<float>(x[i]);
+            }
+        }
+        return set_whitening(std::move(w));
+    }
+
+    void VectorSpace::prepare_vector(turbo::span<uint8_t> v) const {
+        auto *pv = reinterpret_cast<float *>(v.data());
+        if (!weight_scale.empty()) {
+            for (size_t i = 0; i < weight_scale.size(); ++i) {
+                pv[i] *= weight_scale[i];
+            }
+        } else if (!whitening.empty()) {
+            /// gemv can not run in place, one scratch row per thread.
+            thread_local std::vector<float> out;
+            auto n = static_cast<size_t>(dim);
+            out.resize(n);
+            whitening_gemv(whitening.data(), n, n, pv, out.data());
+            std::copy(out.begin(), out.end(), pv);
+        }
+    }
+
 } // namespace xann
@@ -18,10 +18,13 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include <string>
+#include <vector>
 #include <xann/core/metric.h>
 #include <turbo/container/span.h>
 #include <turbo/utility/status.h>
 #include <xsimd/xsimd.hpp>
+#include <xann/core/kernel_calibration.h>
 #include <xann/core/operator_registry.h>
 
 namespace xann {
@@ -41,6 +44,25 @@ namespace xann {
 
         static turbo::Result<VectorSpace> create(int dim, MetricType metric, DataType dt, SimdLevel level = SimdLevel::SIMD_NONE);
 
+        /// level is the widest level considered, the one used is the fastest
+        /// on this host per calibrate_simd_level().
+        static turbo::Result<VectorSpace> create(int dim, MetricType metric, DataType dt, SimdLevel level,
+                                                 const KernelCalibrationOption &calibration);
+
+        /// queries of query_dt scored against dt storage through query_operation.
+        /// both the symmetric operation (storage against storage) and the
+        /// mixed one take the widest level up to level that has a kernel.
+        /// metrics that normalize or transform vectors are refused. flat, hnsw
+        /// and ivf_flat score with query_operation, kd tree, pivot, pq and
+        /// tanimoto refuse such a space at build().
+        static turbo::Result<VectorSpace> create_mixed(int dim, MetricType metric, DataType query_dt, DataType dt,
+                                                       SimdLevel level = SimdLevel::SIMD_NONE);
+
+        /// query_operation scores a DT_FLOAT (query_data_type) query.
+        [[nodiscard]] bool mixed_precision() const {
+            return query_operation.supports;
+        }
+
         /// allocate n vector, bytes = n * alignment_dim * sizeof(DataType)
         turbo::span<uint8_t> align_allocate_vector(size_t n);
 
@@ -60,12 +82,60 @@ namespace xann {
 
         static bool is_aligned(turbo::span<uint8_t> v);
 
+        /// kWeightedL2 only, one non negative weight per dim. set before any
+        /// vector is stored, stored and query vectors are scaled by sqrt(weight).
+        turbo::Status set_weights(const std::vector<float> &weights);
+
+        /// kMahalanobis only, dim x dim row major W with d(x, y) = |W x - W y|.
+        turbo::Status set_whitening(std::vector<float> matrix);
+
+        /// kMahalanobis only, W = L^-1 for the cholesky factor L of a dim x dim
+        /// positive definite covariance.
+        turbo::Status set_covariance(const std::vector<float> &covariance);
+
+        /// DT_UINT8 only, a finite scale above zero. set before any vector is
+        /// stored, float vectors are stored as round(x * scale) saturated and
+        /// float queries are scaled the same way, so scores and distances are
+        /// in storage units.
+        turbo::Status set_storage_scale(float scale);
+
+        /// stored and query vectors go through prepare_vector().
+        [[nodiscard]] bool has_transform() const {
+            return !weight_scale.empty() || !whitening.empty();
+        }
+
+        /// map the first dim floats of v in place by the weights or the
+        /// whitening, a no-op for the other metrics.
+        void prepare_vector(turbo::span<uint8_t> v) const;
+
         OperatorEntity standard_operation;
 
         OperatorEntity operation;
 
+        /// DT_NONE unless created by create_mixed().
+        DataType query_data_type{DataType::DT_NONE};
+
+        /// mixed precision kernel, query of query_data_type first and a stored
+        /// vector second. supports is false for a symmetric space.
+        OperatorEntity query_operation;
+
+        /// float to DT_UINT8 scale, see set_storage_scale(). saved with the store.
+        float storage_scale{1.0f};
+
+        /// sqrt of the kWeightedL2 weights.
+        std::vector<float> weight_scale;
+
+        /// the kMahalanobis whitening map, dim x dim row major.
+        std::vector<float> whitening;
+
+        /// gemv for whitening at the level of operation.
+        void (*whitening_gemv)(const float *matrix, size_t rows, size_t cols, const float *x, float *y){nullptr};
+
     private:
         VectorSpace() = default;
     };
 
+    /// owned buffer aligned like the store slots, for index side vectors (centroids, codebooks).
+    using AlignedBytes = std::vector<uint8_t, xsimd::aligned_allocator<uint8_t, VectorSpace::kAlignmentBytes> >;
+
 } // namespace xann
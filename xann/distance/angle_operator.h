@@ -50,5 +50,21 @@ namespace xann {
         }
     }
 
+    /// the rank kernel is the cosine one, acos only runs on the top-k.
+    inline void simple_angle_rank_to_distance(float *values, size_t n) {
+        simple_cosine_rank_to_distance(values, n);
+        for (size_t i = 0; i < n; ++i) {
+            values[i] = fast_acos(values[i]);
+        }
+    }
+
+    template<typename ARCH>
+    void simd_angle_rank_to_distance(float *values, size_t n) {
+        using b_type = xsimd::batch<float, ARCH>;
+        simd_map_inplace<ARCH>(values, n, [](const b_type &v) {
+            return simd_acos<ARCH>(simd_signed_sqrt<ARCH>(-v));
+        });
+    }
+
     turbo::Status initialize_angle_operator(MetricRegistry &r);
 }  // namespace xann
@@ -0,0 +1,149 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <xann/distance/chebyshev_operator.h>
+
+namespace xann {
+
+    static turbo::Status initialize_l0_chebyshev_operator(MetricRegistry &r) {
+        ////////////////////////////////////////
+        /// SimdLevel::SIMD_NONE
+        /// uint8
+        {
+            OperatorEntity u8;
+            u8.supports = true;
+            u8.need_normalize_vector = false;
+            u8.simd_level = SimdLevel::SIMD_NONE;
+            u8.metric = kChebyshev;
+            u8.data_type = DataType::DT_UINT8;
+            u8.normalize_vector = nullptr;
+            u8.distance_vector = simple_distance_chebyshev<uint8_t>;
+            u8.norm_vector = simple_norm_chebyshev<uint8_t>;
+            u8.bounded_rank_vector = simple_chebyshev_bounded_rank<uint8_t>;
+
+            auto rs = register_metric_level_operator(r, u8, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        /// half
+        {
+            OperatorEntity hf;
+            hf.supports = true;
+            hf.need_normalize_vector = false;
+            hf.simd_level = SimdLevel::SIMD_NONE;
+            hf.metric = kChebyshev;
+            hf.data_type = DataType::DT_FLOAT16;
+            hf.normalize_vector = nullptr;
+            hf.distance_vector = simple_distance_chebyshev<half_float::half>;
+            hf.norm_vector = simple_norm_chebyshev<half_float::half>;
+            hf.bounded_rank_vector = simple_chebyshev_bounded_rank<half_float::half>;
+
+            auto rs = register_metric_level_operator(r, hf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        /// f32
+        {
+            OperatorEntity f32;
+            f32.supports = true;
+            f32.need_normalize_vector = false;
+            f32.simd_level = SimdLevel::SIMD_NONE;
+            f32.metric = kChebyshev;
+            f32.data_type = DataType::DT_FLOAT;
+            f32.normalize_vector = nullptr;
+            f32.distance_vector = simple_distance_chebyshev<float>;
+            f32.norm_vector = simple_norm_chebyshev<float>;
+            f32.bounded_rank_vector = simple_chebyshev_bounded_rank<float>;
+
+            auto rs = register_metric_level_operator(r, f32, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        ////////////////////////////////////////
+        /// SimdLevel::SIMD_NONE
+        return turbo::OkStatus();
+    }
+
+    static turbo::Status initialize_sse2_chebyshev_operator(MetricRegistry &r) {
+#ifdef XSIMD_WITH_SSE3
+        ////////////////////////////////////////
+        /// f32
+        {
+            OperatorEntity f32;
+            f32.supports = true;
+            f32.need_normalize_vector = false;
+            f32.simd_level = SimdLevel::SIMD_SSE2;
+            f32.metric = kChebyshev;
+            f32.data_type = DataType::DT_FLOAT;
+            f32.normalize_vector = nullptr;
+            f32.distance_vector = simd_distance_chebyshev<xsimd::sse3>;
+            f32.norm_vector = simd_norm_chebyshev<xsimd::sse3>;
+            f32.bounded_rank_vector = simd_chebyshev_bounded_rank<xsimd::sse3>;
+
+            auto rs = register_metric_level_operator(r, f32, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+#endif
+        return turbo::OkStatus();
+    }
+
+    static turbo::Status initialize_avx2_chebyshev_operator(MetricRegistry &r) {
+#ifdef XSIMD_WITH_AVX2
+        ////////////////////////////////////////
+        /// f32
+        {
+            OperatorEntity f32;
+            f32.supports = true;
+            f32.need_normalize_vector = false;
+            f32.simd_level = SimdLevel::SIMD_AVX2;
+            f32.metric = kChebyshev;
+            f32.data_type = DataType::DT_FLOAT;
+            f32.normalize_vector = nullptr;
+            f32.distance_vector = simd_distance_chebyshev<xsimd::avx2>;
+            f32.norm_vector = simd_norm_chebyshev<xsimd::avx2>;
+            f32.bounded_rank_vector = simd_chebyshev_bounded_rank<xsimd::avx2>;
+
+            auto rs = register_metric_level_operator(r, f32, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+#endif
+        return turbo::OkStatus();
+    }
+
+    turbo::Status initialize_chebyshev_operator(MetricRegistry &r) {
+        auto rs = initialize_l0_chebyshev_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = initialize_sse2_chebyshev_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = initialize_avx2_chebyshev_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return turbo::OkStatus();
+    }
+} // namespace xann
@@ -0,0 +1,144 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <turbo/container/span.h>
+#include <algorithm>
+#include <cmath>
+#include <xann/common/half.hpp>
+#include <xann/core/operator_registry.h>
+#include <xann/core/vector_space.h>
+
+namespace xann {
+
+    template<typename T>
+    float simple_distance_chebyshev(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        const T *pa = reinterpret_cast<const T *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        size_t size = a.size() / sizeof(T);
+        float d = 0.0f;
+        for (size_t i = 0; i < size; ++i) {
+            d = std::max(d, std::abs(static_cast<float>(pa[i]) - static_cast<float>(pb[i])));
+        }
+        return d;
+    }
+
+    template<typename T>
+    float simple_norm_chebyshev(const turbo::span<uint8_t> &a) {
+        const T *pa = reinterpret_cast<const T *>(a.data());
+        size_t size = a.size() / sizeof(T);
+        float d = 0.0f;
+        for (size_t i = 0; i < size; ++i) {
+            d = std::max(d, std::abs(static_cast<float>(pa[i])));
+        }
+        return d;
+    }
+
+    /// the max only grows, so a candidate stops once it reaches bound.
+    template<typename T>
+    float simple_chebyshev_bounded_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+        const T *pa = reinterpret_cast<const T *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        size_t size = a.size() / sizeof(T);
+        float d = 0.0f;
+        for (size_t block = 0; block < size; block += kAbandonBlock) {
+            auto last = std::min(size, block + kAbandonBlock);
+            for (size_t i = block; i < last; ++i) {
+                d = std::max(d, std::abs(static_cast<float>(pa[i]) - static_cast<float>(pb[i])));
+            }
+            if (d >= bound) {
+                return d;
+            }
+        }
+        return d;
+    }
+
+    template<typename ARCH>
+    float simd_reduce_max(const xsimd::batch<float, ARCH> &v) {
+        alignas(64) float lanes[xsimd::batch<float, ARCH>::size];
+        v.store_aligned(lanes);
+        return *std::max_element(lanes, lanes + xsimd::batch<float, ARCH>::size);
+    }
+
+    template<typename ARCH>
+    float simd_distance_chebyshev(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        using b_type = xsimd::batch<float, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t size = a.size() / sizeof(float);
+        std::size_t vec_size = size - size % inc;
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const float *pb = reinterpret_cast<const float *>(b.data());
+        b_type max_v = b_type::broadcast(0.0f);
+        for (std::size_t i = 0; i < vec_size; i += inc) {
+            max_v = xsimd::max(max_v, xsimd::abs(b_type::load(pa + i, xsimd::aligned_mode()) -
+                                                 b_type::load(pb + i, xsimd::aligned_mode())));
+        }
+        float d = simd_reduce_max<ARCH>(max_v);
+        for (std::size_t i = vec_size; i < size; ++i) {
+            d = std::max(d, std::abs(pa[i] - pb[i]));
+        }
+        return d;
+    }
+
+    template<typename ARCH>
+    float simd_norm_chebyshev(const turbo::span<uint8_t> &a) {
+        using b_type = xsimd::batch<float, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t size = a.size() / sizeof(float);
+        std::size_t vec_size = size - size % inc;
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        b_type max_v = b_type::broadcast(0.0f);
+        for (std::size_t i = 0; i < vec_size; i += inc) {
+            max_v = xsimd::max(max_v, xsimd::abs(b_type::load(pa + i, xsimd::aligned_mode())));
+        }
+        float d = simd_reduce_max<ARCH>(max_v);
+        for (std::size_t i = vec_size; i < size; ++i) {
+            d = std::max(d, std::abs(pa[i]));
+        }
+        return d;
+    }
+
+    template<typename ARCH>
+    float simd_chebyshev_bounded_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+        using b_type = xsimd::batch<float, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t size = a.size() / sizeof(float);
+        std::size_t vec_size = size - size % inc;
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const float *pb = reinterpret_cast<const float *>(b.data());
+        b_type max_v = b_type::broadcast(0.0f);
+        for (std::size_t block = 0; block < vec_size; block += kAbandonBlock) {
+            auto last = std::min(vec_size, block + kAbandonBlock);
+            for (std::size_t i = block; i < last; i += inc) {
+                max_v = xsimd::max(max_v, xsimd::abs(b_type::load(pa + i, xsimd::aligned_mode()) -
+                                                     b_type::load(pb + i, xsimd::aligned_mode())));
+            }
+            auto d = simd_reduce_max<ARCH>(max_v);
+            if (d >= bound) {
+                return d;
+            }
+        }
+        float d = simd_reduce_max<ARCH>(max_v);
+        for (std::size_t i = vec_size; i < size; ++i) {
+            d = std::max(d, std::abs(pa[i] - pb[i]));
+        }
+        return d;
+    }
+
+    turbo::Status initialize_chebyshev_operator(MetricRegistry &r);
+} // namespace xann
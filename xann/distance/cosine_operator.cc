@@ -33,6 +33,8 @@ namespace xann {
             u8.normalize_vector = nullptr;
             u8.distance_vector = simple_cosine_distance<uint8_t>;
             u8.norm_vector = nullptr;
+            u8.rank_vector = simple_cosine_rank<uint8_t>;
+            u8.rank_to_distance = simple_cosine_rank_to_distance;
 
             auto rs = register_metric_level_operator(r, u8, false);
             if (!rs.ok()) {
@@ -50,6 +52,8 @@ namespace xann {
             hf.normalize_vector = nullptr;
             hf.distance_vector = simple_cosine_distance<half_float::half>;
             hf.norm_vector = nullptr;
+            hf.rank_vector = simple_cosine_rank<half_float::half>;
+            hf.rank_to_distance = simple_cosine_rank_to_distance;
 
             auto rs = register_metric_level_operator(r, hf, false);
             if (!rs.ok()) {
@@ -67,6 +71,8 @@ namespace xann {
             f32.normalize_vector = nullptr;
             f32.distance_vector = simple_cosine_distance<float>;
             f32.norm_vector = nullptr;
+            f32.rank_vector = simple_cosine_rank<float>;
+            f32.rank_to_distance = simple_cosine_rank_to_distance;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
@@ -93,6 +99,8 @@ namespace xann {
             f32.normalize_vector = nullptr;
             f32.distance_vector = simd_distance_cosine<xsimd::sse3>;
             f32.norm_vector = nullptr;
+            f32.rank_vector = simd_cosine_rank<xsimd::sse3>;
+            f32.rank_to_distance = simd_cosine_rank_to_distance<xsimd::sse3>;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
@@ -117,6 +125,8 @@ namespace xann {
             f32.normalize_vector = nullptr;
             f32.distance_vector = simd_distance_cosine<xsimd::avx2>;
             f32.norm_vector = nullptr;
+            f32.rank_vector = simd_cosine_rank<xsimd::avx2>;
+            f32.rank_to_distance = simd_cosine_rank_to_distance<xsimd::avx2>;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
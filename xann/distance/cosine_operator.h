@@ -18,17 +18,21 @@
 #pragma once
 
 #include <turbo/container/span.h>
+#include <algorithm>
 #include <cmath>
 #include <xann/common/half.hpp>
 #include <xann/core/operator_registry.h>
 #include <xann/core/vector_space.h>
 #include <xann/distance/popcount.h>
+#include <xann/distance/simd_math.h>
 
 
 namespace xann {
 
+    /// dot product and both squared norms in one pass.
     template<typename T>
-    float simple_cosine_distance(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+    void simple_cosine_parts(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float *dot,
+                             float *norm_a2, float *norm_b2) {
         const T *pa = reinterpret_cast<const T *>(a.data());
         const T *pb = reinterpret_cast<const T *>(b.data());
         const T *last = pa + a.size() / sizeof(T);
@@ -49,7 +53,7 @@ namespace xann {
             pb3 = pb[3];
             norm_a += pa0 * pa0 + pa1 * pa1 + pa2 * pa2 + pa3 * pa3;
             norm_b += pb0 * pb0 + pb1 * pb1 + pb2 * pb2 + pb3 * pb3;
-            sum += pa0 * pb0 + pa1 * pb1 + pa2 * pb2 + pb3 * pb3;
+            sum += pa0 * pb0 + pa1 * pb1 + pa2 * pb2 + pa3 * pb3;
             pa += 4;
             pb += 4;
         }
@@ -60,7 +64,23 @@ namespace xann {
             norm_b += pb0 * pb0;
             sum += pa0 * pb0;
         }
+        *dot = sum;
+        *norm_a2 = norm_a;
+        *norm_b2 = norm_b;
+    }
 
+    /// -cos * |cos|, monotone in the cosine without the sqrt.
+    inline float cosine_rank(float dot, float norm_a2, float norm_b2) {
+        if (norm_a2 == 0.0f || norm_b2 == 0.0f) {
+            return 0.0f;
+        }
+        return -(dot / norm_a2) * (std::abs(dot) / norm_b2);
+    }
+
+    template<typename T>
+    float simple_cosine_distance(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        float sum, norm_a, norm_b;
+        simple_cosine_parts<T>(a, b, &sum, &norm_a, &norm_b);
         if (norm_a == 0.0 || norm_b == 0.0) {
             return 0.0;
         }
@@ -68,8 +88,23 @@ namespace xann {
         return cosine;
     }
 
+    template<typename T>
+    float simple_cosine_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        float sum, norm_a, norm_b;
+        simple_cosine_parts<T>(a, b, &sum, &norm_a, &norm_b);
+        return cosine_rank(sum, norm_a, norm_b);
+    }
+
+    inline void simple_cosine_rank_to_distance(float *values, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            auto v = -values[i];
+            values[i] = std::clamp(v < 0.0f ? -std::sqrt(-v) : std::sqrt(v), -1.0f, 1.0f);
+        }
+    }
+
     template<typename ARCH>
-    float simd_distance_cosine(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+    void simd_cosine_parts(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float *dot,
+                           float *norm_a2, float *norm_b2) {
         using b_type = xsimd::batch<float, ARCH>;
         std::size_t inc = b_type::size;
         std::size_t size = a.size() / sizeof(float);
@@ -98,6 +133,15 @@ namespace xann {
             norma += ai * ai;
             normb += bi * bi;
         }
+        *dot = sum;
+        *norm_a2 = norma;
+        *norm_b2 = normb;
+    }
+
+    template<typename ARCH>
+    float simd_distance_cosine(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        float sum, norma, normb;
+        simd_cosine_parts<ARCH>(a, b, &sum, &norma, &normb);
         if (norma == 0.0 || normb == 0.0) {
             return 0.0;
         }
@@ -105,5 +149,21 @@ namespace xann {
         return cosine;
     }
 
+    template<typename ARCH>
+    float simd_cosine_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        float sum, norma, normb;
+        simd_cosine_parts<ARCH>(a, b, &sum, &norma, &normb);
+        return cosine_rank(sum, norma, normb);
+    }
+
+    template<typename ARCH>
+    void simd_cosine_rank_to_distance(float *values, size_t n) {
+        using b_type = xsimd::batch<float, ARCH>;
+        simd_map_inplace<ARCH>(values, n, [](const b_type &v) {
+            return xsimd::min(xsimd::max(simd_signed_sqrt<ARCH>(-v), b_type::broadcast(-1.0f)),
+                              b_type::broadcast(1.0f));
+        });
+    }
+
     turbo::Status initialize_cosine_operator(MetricRegistry &r);
 }  // namespace xann
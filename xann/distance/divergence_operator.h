@@ -0,0 +1,116 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <turbo/container/span.h>
+#include <cmath>
+#include <xann/common/half.hpp>
+#include <xann/core/operator_registry.h>
+#include <xann/core/vector_space.h>
+
+namespace xann {
+
+    /// x * log(x / y), 0 where x is 0 so the zero padding adds nothing.
+    inline float entropy_term(float x, float y) {
+        return x > 0.0f ? x * std::log(x / y) : 0.0f;
+    }
+
+    template<typename ARCH>
+    xsimd::batch<float, ARCH> simd_entropy_term(const xsimd::batch<float, ARCH> &x,
+                                                const xsimd::batch<float, ARCH> &y) {
+        using b_type = xsimd::batch<float, ARCH>;
+        auto zero = b_type::broadcast(0.0f);
+        return xsimd::select(x > zero, x * xsimd::log(x / y), zero);
+    }
+
+    /// KL(a || b), +inf once b misses mass a has.
+    template<typename T>
+    float simple_distance_kl(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        const T *pa = reinterpret_cast<const T *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        size_t size = a.size() / sizeof(T);
+        float d = 0.0f;
+        for (size_t i = 0; i < size; ++i) {
+            d += entropy_term(static_cast<float>(pa[i]), static_cast<float>(pb[i]));
+        }
+        return d;
+    }
+
+    /// (KL(a || m) + KL(b || m)) / 2 with m = (a + b) / 2, always finite.
+    template<typename T>
+    float simple_distance_js(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        const T *pa = reinterpret_cast<const T *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        size_t size = a.size() / sizeof(T);
+        float d = 0.0f;
+        for (size_t i = 0; i < size; ++i) {
+            auto x = static_cast<float>(pa[i]);
+            auto y = static_cast<float>(pb[i]);
+            auto m = 0.5f * (x + y);
+            d += entropy_term(x, m) + entropy_term(y, m);
+        }
+        return 0.5f * d;
+    }
+
+    template<typename ARCH>
+    float simd_distance_kl(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        using b_type = xsimd::batch<float, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t size = a.size() / sizeof(float);
+        std::size_t vec_size = size - size % inc;
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const float *pb = reinterpret_cast<const float *>(b.data());
+        b_type sum_v = b_type::broadcast(0.0f);
+        for (std::size_t i = 0; i < vec_size; i += inc) {
+            sum_v += simd_entropy_term<ARCH>(b_type::load(pa + i, xsimd::aligned_mode()),
+                                             b_type::load(pb + i, xsimd::aligned_mode()));
+        }
+        float d = xsimd::reduce_add(sum_v);
+        for (std::size_t i = vec_size; i < size; ++i) {
+            d += entropy_term(pa[i], pb[i]);
+        }
+        return d;
+    }
+
+    template<typename ARCH>
+    float simd_distance_js(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        using b_type = xsimd::batch<float, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t size = a.size() / sizeof(float);
+        std::size_t vec_size = size - size % inc;
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const float *pb = reinterpret_cast<const float *>(b.data());
+        auto half = b_type::broadcast(0.5f);
+        b_type sum_v = b_type::broadcast(0.0f);
+        for (std::size_t i = 0; i < vec_size; i += inc) {
+            auto x = b_type::load(pa + i, xsimd::aligned_mode());
+            auto y = b_type::load(pb + i, xsimd::aligned_mode());
+            auto m = half * (x + y);
+            sum_v += simd_entropy_term<ARCH>(x, m) + simd_entropy_term<ARCH>(y, m);
+        }
+        float d = xsimd::reduce_add(sum_v);
+        for (std::size_t i = vec_size; i < size; ++i) {
+            auto m = 0.5f * (pa[i] + pb[i]);
+            d += entropy_term(pa[i], m) + entropy_term(pb[i], m);
+        }
+        return 0.5f * d;
+    }
+
+    /// kJensenShannon and kKLDivergence.
+    turbo::Status initialize_divergence_operator(MetricRegistry &r);
+} // namespace xann
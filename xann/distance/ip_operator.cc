@@ -34,6 +34,8 @@ namespace xann {
             u8.normalize_vector = nullptr;
             u8.distance_vector = simple_ip_distance<uint8_t>;
             u8.norm_vector = simple_l2_norm<uint8_t>;
+            u8.rank_vector = simple_ip_rank<uint8_t>;
+            u8.rank_to_distance = simple_negated_rank_to_distance;
 
             auto rs = register_metric_level_operator(r, u8, false);
             if (!rs.ok()) {
@@ -46,28 +48,51 @@ namespace xann {
             hf.supports = true;
             hf.need_normalize_vector = false;
             hf.simd_level = SimdLevel::SIMD_NONE;
-            hf.metric = kL2;
+            hf.metric = kIP;
             hf.data_type = DataType::DT_FLOAT16;
             hf.normalize_vector = nullptr;
             hf.distance_vector = simple_ip_distance<half_float::half>;
             hf.norm_vector = simple_l2_norm<half_float::half>;
+            hf.rank_vector = simple_ip_rank<half_float::half>;
+            hf.rank_to_distance = simple_negated_rank_to_distance;
 
             auto rs = register_metric_level_operator(r, hf, false);
             if (!rs.ok()) {
                 return rs;
             }
         }
+        /// bf16
+        {
+            OperatorEntity bf;
+            bf.supports = true;
+            bf.need_normalize_vector = false;
+            bf.simd_level = SimdLevel::SIMD_NONE;
+            bf.metric = kIP;
+            bf.data_type = DataType::DT_BFLOAT16;
+            bf.normalize_vector = nullptr;
+            bf.distance_vector = simple_ip_distance<bfloat16>;
+            bf.norm_vector = simple_l2_norm<bfloat16>;
+            bf.rank_vector = simple_ip_rank<bfloat16>;
+            bf.rank_to_distance = simple_negated_rank_to_distance;
+
+            auto rs = register_metric_level_operator(r, bf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
         /// f32
         {
             OperatorEntity f32;
             f32.supports = true;
             f32.need_normalize_vector = false;
             f32.simd_level = SimdLevel::SIMD_NONE;
-            f32.metric = kL2;
+            f32.metric = kIP;
             f32.data_type = DataType::DT_FLOAT;
             f32.normalize_vector = nullptr;
             f32.distance_vector = simple_ip_distance<float>;
             f32.norm_vector = simple_l2_norm<float>;
+            f32.rank_vector = simple_ip_rank<float>;
+            f32.rank_to_distance = simple_negated_rank_to_distance;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
@@ -89,11 +114,13 @@ namespace xann {
             f32.supports = true;
             f32.need_normalize_vector = false;
             f32.simd_level = SimdLevel::SIMD_SSE2;
-            f32.metric = kL2;
+            f32.metric = kIP;
             f32.data_type = DataType::DT_FLOAT;
             f32.normalize_vector = nullptr;
             f32.distance_vector = simd_distance_ip<xsimd::sse3>;
             f32.norm_vector = simd_norm_l2<xsimd::sse3>;
+            f32.rank_vector = simd_ip_rank<xsimd::sse3>;
+            f32.rank_to_distance = simd_negated_rank_to_distance<xsimd::sse3>;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
@@ -113,11 +140,13 @@ namespace xann {
             f32.supports = true;
             f32.need_normalize_vector = false;
             f32.simd_level = SimdLevel::SIMD_AVX2;
-            f32.metric = kL2;
+            f32.metric = kIP;
             f32.data_type = DataType::DT_FLOAT;
             f32.normalize_vector = nullptr;
             f32.distance_vector = simd_distance_ip<xsimd::avx2>;
             f32.norm_vector = simd_norm_l2<xsimd::avx2>;
+            f32.rank_vector = simd_ip_rank<xsimd::avx2>;
+            f32.rank_to_distance = simd_negated_rank_to_distance<xsimd::avx2>;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
@@ -19,10 +19,12 @@
 
 #include <turbo/container/span.h>
 #include <cmath>
+#include <xann/common/bfloat16.h>
 #include <xann/common/half.hpp>
 #include <xann/core/operator_registry.h>
 #include <xann/core/vector_space.h>
 #include <xsimd/xsimd.hpp>
+#include <xann/distance/simd_math.h>
 
 namespace xann {
 
@@ -47,7 +49,7 @@ namespace xann {
             diff0 = static_cast<float>(*pa++ * *pb++);
             d += diff0 ;
         }
-        return sqrt(d);
+        return d;
     }
 
     template<typename ARCH>
@@ -70,7 +72,30 @@ namespace xann {
         for (std::size_t i = vec_size; i < size; ++i) {
             sum += pa[i] * pb[i];
         }
-        return sqrt(sum);
+        return static_cast<float>(sum);
+    }
+
+    /// negated dot product, the rank kernel of every dot product based metric.
+    template<typename T>
+    float simple_ip_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        return -simple_ip_distance<T>(a, b);
+    }
+
+    template<typename ARCH>
+    float simd_ip_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        return -simd_distance_ip<ARCH>(a, b);
+    }
+
+    inline void simple_negated_rank_to_distance(float *values, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            values[i] = -values[i];
+        }
+    }
+
+    template<typename ARCH>
+    void simd_negated_rank_to_distance(float *values, size_t n) {
+        using b_type = xsimd::batch<float, ARCH>;
+        simd_map_inplace<ARCH>(values, n, [](const b_type &v) { return -v; });
     }
 
     turbo::Status initialize_ip_operator(MetricRegistry &r);
@@ -49,6 +49,35 @@ namespace xann {
         return 1.0f - static_cast<float>(count) / static_cast<float>(countDe);
     }
 
+    size_t simple_bit_count(const turbo::span<uint8_t> &a) {
+        const uint64_t *pa = reinterpret_cast<const uint64_t *>(a.data());
+        size_t size = a.size() / sizeof(uint64_t);
+        size_t count = 0;
+        for (size_t i = 0; i < size; ++i) {
+            count += turbo::popcount(pa[i]);
+        }
+        return count;
+    }
+
+    size_t simple_and_popcount(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        const uint64_t *pa = reinterpret_cast<const uint64_t *>(a.data());
+        const uint64_t *pb = reinterpret_cast<const uint64_t *>(b.data());
+        const uint64_t *last = pa + a.size() / sizeof(uint64_t);
+        const uint64_t *lastgroup = last - 3;
+        size_t count = 0;
+        while (pa < lastgroup) {
+            count += turbo::popcount(pa[0] & pb[0]) + turbo::popcount(pa[1] & pb[1]) + turbo::popcount(pa[2] & pb[2]) + turbo::popcount(pa[3] & pb[3]);
+            pa += 4;
+            pb += 4;
+        }
+        while (pa < last) {
+            count += turbo::popcount(*pa & *pb);
+            pa++;
+            pb++;
+        }
+        return count;
+    }
+
     static turbo::Status initialize_l0_jaccard_operator(MetricRegistry &r) {
         ////////////////////////////////////////
         /// SimdLevel::SIMD_NONE
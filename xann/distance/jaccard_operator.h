@@ -58,5 +58,31 @@ namespace xann {
         return 1 - sum/sum_de;
     }
 
+    /// set bits of a fingerprint.
+    size_t simple_bit_count(const turbo::span<uint8_t> &a);
+
+    /// popcount(a & b), with both popcounts known this is all Tanimoto needs.
+    size_t simple_and_popcount(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b);
+
+    template<typename ARCH>
+    size_t simd_and_popcount(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        using b_type = xsimd::batch<uint64_t, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t size = a.size() / sizeof(uint64_t);
+        std::size_t vec_size = size - size % inc;
+        const uint64_t *pa = reinterpret_cast<const uint64_t *>(a.data());
+        const uint64_t *pb = reinterpret_cast<const uint64_t *>(b.data());
+        size_t sum = 0;
+        for (std::size_t i = 0; i < vec_size; i += inc) {
+            b_type avec = b_type::load(pa + i, xsimd::aligned_mode());
+            b_type bvec = b_type::load(pb + i, xsimd::aligned_mode());
+            sum += static_cast<size_t>(PopCount<ARCH>::count(avec & bvec));
+        }
+        for (std::size_t i = vec_size; i < size; ++i) {
+            sum += turbo::popcount(pa[i] & pb[i]);
+        }
+        return sum;
+    }
+
     turbo::Status initialize_jaccard_operator(MetricRegistry &r);
 }  // namespace xann
@@ -34,6 +34,7 @@ namespace xann {
             u8.normalize_vector = nullptr;
             u8.distance_vector = simple_distance_l1<uint8_t>;
             u8.norm_vector = simple_normal_l1<uint8_t>;
+            u8.bounded_rank_vector = simple_l1_bounded_rank<uint8_t>;
 
             auto rs = register_metric_level_operator(r, u8, false);
             if (!rs.ok()) {
@@ -51,6 +52,7 @@ namespace xann {
             hf.normalize_vector = nullptr;
             hf.distance_vector = simple_distance_l1<half_float::half>;
             hf.norm_vector = simple_normal_l1<half_float::half>;
+            hf.bounded_rank_vector = simple_l1_bounded_rank<half_float::half>;
 
             auto rs = register_metric_level_operator(r, hf, false);
             if (!rs.ok()) {
@@ -68,6 +70,7 @@ namespace xann {
             f32.normalize_vector = nullptr;
             f32.distance_vector = simple_distance_l1<float>;
             f32.norm_vector = simple_normal_l1<float>;
+            f32.bounded_rank_vector = simple_l1_bounded_rank<float>;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
@@ -93,6 +96,7 @@ namespace xann {
             f32.normalize_vector = nullptr;
             f32.distance_vector = simd_distance_l1<xsimd::sse3>;
             f32.norm_vector = simd_normal_l1<xsimd::sse3>;
+            f32.bounded_rank_vector = simd_l1_bounded_rank<xsimd::sse3>;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
@@ -118,6 +122,7 @@ namespace xann {
             f32.normalize_vector = nullptr;
             f32.distance_vector = simd_distance_l1<xsimd::avx2>;
             f32.norm_vector = simd_normal_l1<xsimd::avx2>;
+            f32.bounded_rank_vector = simd_l1_bounded_rank<xsimd::avx2>;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
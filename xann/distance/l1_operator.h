@@ -18,6 +18,8 @@
 #pragma once
 
 #include <turbo/container/span.h>
+#include <algorithm>
+#include <cmath>
 #include <xann/common/half.hpp>
 #include <xann/core/operator_registry.h>
 #include <xann/core/vector_space.h>
@@ -55,6 +57,24 @@ namespace xann {
         return d;
     }
 
+    template<typename T>
+    float simple_l1_bounded_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+        const T *pa = reinterpret_cast<const T *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        size_t size = a.size() / sizeof(T);
+        float d = 0.0;
+        for (size_t block = 0; block < size; block += kAbandonBlock) {
+            auto last = std::min(size, block + kAbandonBlock);
+            for (size_t i = block; i < last; ++i) {
+                d += std::abs(static_cast<float>(pa[i]) - static_cast<float>(pb[i]));
+            }
+            if (d >= bound) {
+                return d;
+            }
+        }
+        return d;
+    }
+
     template<typename T>
     float simple_normal_l1(const turbo::span<uint8_t> &a) {
         const T *pa = reinterpret_cast<const T *>(a.data());
@@ -93,6 +113,33 @@ namespace xann {
         return sum;
     }
 
+    template<typename A = xsimd::default_arch>
+    float simd_l1_bounded_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+        using b_type = xsimd::batch<float, A>;
+        std::size_t inc = b_type::size;
+        std::size_t size = a.size() / sizeof(float);
+        std::size_t vec_size = size - size % inc;
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const float *pb = reinterpret_cast<const float *>(b.data());
+        float sum = 0.0f;
+        for (std::size_t block = 0; block < vec_size; block += kAbandonBlock) {
+            auto last = std::min(vec_size, block + kAbandonBlock);
+            b_type sum_v = b_type::broadcast(0.0);
+            for (std::size_t i = block; i < last; i += inc) {
+                sum_v += xsimd::abs(b_type::load(pa + i, xsimd::aligned_mode()) -
+                                    b_type::load(pb + i, xsimd::aligned_mode()));
+            }
+            sum += xsimd::reduce_add(sum_v);
+            if (sum >= bound) {
+                return sum;
+            }
+        }
+        for (std::size_t i = vec_size; i < size; ++i) {
+            sum += std::abs(pa[i] - pb[i]);
+        }
+        return sum;
+    }
+
     template<typename A = xsimd::default_arch>
     float simd_normal_l1(const turbo::span<uint8_t> &a) {
         using b_type = xsimd::batch<float, A>;
@@ -33,6 +33,9 @@ namespace xann {
             u8.normalize_vector = nullptr;
             u8.distance_vector = simple_l2_distance<uint8_t>;
             u8.norm_vector = simple_l2_norm<uint8_t>;
+            u8.bounded_rank_vector = simple_l2_bounded_rank<uint8_t>;
+            u8.rank_vector = simple_l2_rank<uint8_t>;
+            u8.rank_to_distance = simple_l2_rank_to_distance;
 
             auto rs = register_metric_level_operator(r, u8, false);
             if (!rs.ok()) {
@@ -50,12 +53,35 @@ namespace xann {
             hf.normalize_vector = nullptr;
             hf.distance_vector = simple_l2_distance<half_float::half>;
             hf.norm_vector = simple_l2_norm<half_float::half>;
+            hf.bounded_rank_vector = simple_l2_bounded_rank<half_float::half>;
+            hf.rank_vector = simple_l2_rank<half_float::half>;
+            hf.rank_to_distance = simple_l2_rank_to_distance;
 
             auto rs = register_metric_level_operator(r, hf, false);
             if (!rs.ok()) {
                 return rs;
             }
         }
+        /// bf16
+        {
+            OperatorEntity bf;
+            bf.supports = true;
+            bf.need_normalize_vector = false;
+            bf.simd_level = SimdLevel::SIMD_NONE;
+            bf.metric = kL2;
+            bf.data_type = DataType::DT_BFLOAT16;
+            bf.normalize_vector = nullptr;
+            bf.distance_vector = simple_l2_distance<bfloat16>;
+            bf.norm_vector = simple_l2_norm<bfloat16>;
+            bf.bounded_rank_vector = simple_l2_bounded_rank<bfloat16>;
+            bf.rank_vector = simple_l2_rank<bfloat16>;
+            bf.rank_to_distance = simple_l2_rank_to_distance;
+
+            auto rs = register_metric_level_operator(r, bf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
         /// f32
         {
             OperatorEntity f32;
@@ -67,6 +93,9 @@ namespace xann {
             f32.normalize_vector = nullptr;
             f32.distance_vector = simple_l2_distance<float>;
             f32.norm_vector = simple_l2_norm<float>;
+            f32.bounded_rank_vector = simple_l2_bounded_rank<float>;
+            f32.rank_vector = simple_l2_rank<float>;
+            f32.rank_to_distance = simple_l2_rank_to_distance;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
@@ -93,6 +122,9 @@ namespace xann {
             f32.normalize_vector = nullptr;
             f32.distance_vector = simd_distance_l2<xsimd::sse3>;
             f32.norm_vector = simd_norm_l2<xsimd::sse3>;
+            f32.bounded_rank_vector = simd_l2_bounded_rank<xsimd::sse3>;
+            f32.rank_vector = simd_l2_rank<xsimd::sse3>;
+            f32.rank_to_distance = simd_l2_rank_to_distance<xsimd::sse3>;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
@@ -117,6 +149,9 @@ namespace xann {
             f32.normalize_vector = nullptr;
             f32.distance_vector = simd_distance_l2<xsimd::avx2>;
             f32.norm_vector = simd_norm_l2<xsimd::avx2>;
+            f32.bounded_rank_vector = simd_l2_bounded_rank<xsimd::avx2>;
+            f32.rank_vector = simd_l2_rank<xsimd::avx2>;
+            f32.rank_to_distance = simd_l2_rank_to_distance<xsimd::avx2>;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
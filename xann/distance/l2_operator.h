@@ -19,13 +19,16 @@
 
 #include <turbo/container/span.h>
 #include <cmath>
+#include <xann/common/bfloat16.h>
 #include <xann/common/half.hpp>
 #include <xann/core/operator_registry.h>
 #include <xann/core/vector_space.h>
+#include <xann/distance/simd_math.h>
 
 namespace xann {
+    /// squared l2, the rank kernel of kL2.
     template<typename T>
-    float simple_l2_distance(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+    float simple_l2_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
         const T *pa = reinterpret_cast<const T *>(a.data());
         const T *pb = reinterpret_cast<const T *>(b.data());
         const T *last = pa + a.size() / sizeof(T);
@@ -45,7 +48,37 @@ namespace xann {
             diff0 = static_cast<float>(*pa++ - *pb++);
             d += diff0 * diff0;
         }
-        return sqrt(d);
+        return d;
+    }
+
+    template<typename T>
+    float simple_l2_bounded_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+        const T *pa = reinterpret_cast<const T *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        size_t size = a.size() / sizeof(T);
+        float d = 0.0;
+        for (size_t block = 0; block < size; block += kAbandonBlock) {
+            auto last = std::min(size, block + kAbandonBlock);
+            for (size_t i = block; i < last; ++i) {
+                auto diff = static_cast<float>(pa[i] - pb[i]);
+                d += diff * diff;
+            }
+            if (d >= bound) {
+                return d;
+            }
+        }
+        return d;
+    }
+
+    template<typename T>
+    float simple_l2_distance(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        return sqrt(simple_l2_rank<T>(a, b));
+    }
+
+    inline void simple_l2_rank_to_distance(float *values, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            values[i] = std::sqrt(std::max(values[i], 0.0f));
+        }
     }
 
     template<typename T>
@@ -71,7 +104,7 @@ namespace xann {
     }
 
     template<typename ARCH>
-    float simd_distance_l2(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+    float simd_l2_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
         using b_type = xsimd::batch<float, ARCH>;
         std::size_t inc = b_type::size;
         std::size_t size = a.size() / sizeof(float);
@@ -92,9 +125,53 @@ namespace xann {
             auto df = pa[i] - pb[i];
             sum += df * df;
         }
-        return sqrt(sum);
+        return sum;
+    }
+
+    /// kAbandonBlock is a multiple of every batch size, so only the last
+    /// block can have a scalar tail.
+    template<typename ARCH>
+    float simd_l2_bounded_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+        using b_type = xsimd::batch<float, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t size = a.size() / sizeof(float);
+        std::size_t vec_size = size - size % inc;
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const float *pb = reinterpret_cast<const float *>(b.data());
+        float sum = 0.0f;
+        for (std::size_t block = 0; block < vec_size; block += kAbandonBlock) {
+            auto last = std::min(vec_size, block + kAbandonBlock);
+            b_type sum_v = b_type::broadcast(0.0);
+            for (std::size_t i = block; i < last; i += inc) {
+                auto diff = b_type::load(pa + i, xsimd::aligned_mode()) - b_type::load(pb + i, xsimd::aligned_mode());
+                sum_v += xsimd::mul(diff, diff);
+            }
+            sum += xsimd::reduce_add(sum_v);
+            if (sum >= bound) {
+                return sum;
+            }
+        }
+        for (std::size_t i = vec_size; i < size; ++i) {
+            auto df = pa[i] - pb[i];
+            sum += df * df;
+        }
+        return sum;
+    }
+
+    template<typename ARCH>
+    float simd_distance_l2(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        return sqrt(simd_l2_rank<ARCH>(a, b));
+    }
+
+    template<typename ARCH>
+    void simd_l2_rank_to_distance(float *values, size_t n) {
+        using b_type = xsimd::batch<float, ARCH>;
+        simd_map_inplace<ARCH>(values, n, [](const b_type &v) {
+            return xsimd::sqrt(xsimd::max(v, b_type::broadcast(0.0f)));
+        });
     }
 
+    /// squared l2 norm.
     template<typename ARCH>
     float simd_norm_l2_sqrt(const turbo::span<uint8_t> &a) {
         using b_type = xsimd::batch<float, ARCH>;
@@ -114,7 +191,7 @@ namespace xann {
             auto df = pa[i];
             sum += df * df;
         }
-        return sqrt(sum);
+        return sum;
     }
 
     template<typename ARCH>
@@ -0,0 +1,401 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <xann/distance/mixed_operator.h>
+#include <xann/distance/ip_operator.h>
+#include <xann/distance/l2_operator.h>
+
+namespace xann {
+
+    static turbo::Status initialize_l0_mixed_operator(MetricRegistry &r) {
+        ////////////////////////////////////////
+        /// SimdLevel::SIMD_NONE
+        /// f32 query, uint8 storage
+        {
+            OperatorEntity u8;
+            u8.supports = true;
+            u8.need_normalize_vector = false;
+            u8.simd_level = SimdLevel::SIMD_NONE;
+            u8.metric = kL2;
+            u8.query_data_type = DataType::DT_FLOAT;
+            u8.data_type = DataType::DT_UINT8;
+            u8.normalize_vector = nullptr;
+            u8.distance_vector = simple_mixed_l2_distance<uint8_t>;
+            u8.bounded_rank_vector = simple_mixed_l2_bounded_rank<uint8_t>;
+            u8.rank_vector = simple_mixed_l2_rank<uint8_t>;
+            u8.rank_to_distance = simple_l2_rank_to_distance;
+
+            auto rs = register_metric_level_operator(r, u8, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity u8;
+            u8.supports = true;
+            u8.need_normalize_vector = false;
+            u8.simd_level = SimdLevel::SIMD_NONE;
+            u8.metric = kIP;
+            u8.query_data_type = DataType::DT_FLOAT;
+            u8.data_type = DataType::DT_UINT8;
+            u8.normalize_vector = nullptr;
+            u8.distance_vector = simple_mixed_ip_distance<uint8_t>;
+            u8.rank_vector = simple_mixed_ip_rank<uint8_t>;
+            u8.rank_to_distance = simple_negated_rank_to_distance;
+
+            auto rs = register_metric_level_operator(r, u8, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        /// f32 query, half storage
+        {
+            OperatorEntity hf;
+            hf.supports = true;
+            hf.need_normalize_vector = false;
+            hf.simd_level = SimdLevel::SIMD_NONE;
+            hf.metric = kL2;
+            hf.query_data_type = DataType::DT_FLOAT;
+            hf.data_type = DataType::DT_FLOAT16;
+            hf.normalize_vector = nullptr;
+            hf.distance_vector = simple_mixed_l2_distance<half_float::half>;
+            hf.bounded_rank_vector = simple_mixed_l2_bounded_rank<half_float::half>;
+            hf.rank_vector = simple_mixed_l2_rank<half_float::half>;
+            hf.rank_to_distance = simple_l2_rank_to_distance;
+
+            auto rs = register_metric_level_operator(r, hf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity hf;
+            hf.supports = true;
+            hf.need_normalize_vector = false;
+            hf.simd_level = SimdLevel::SIMD_NONE;
+            hf.metric = kIP;
+            hf.query_data_type = DataType::DT_FLOAT;
+            hf.data_type = DataType::DT_FLOAT16;
+            hf.normalize_vector = nullptr;
+            hf.distance_vector = simple_mixed_ip_distance<half_float::half>;
+            hf.rank_vector = simple_mixed_ip_rank<half_float::half>;
+            hf.rank_to_distance = simple_negated_rank_to_distance;
+
+            auto rs = register_metric_level_operator(r, hf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        /// f32 query, bf16 storage
+        {
+            OperatorEntity bf;
+            bf.supports = true;
+            bf.need_normalize_vector = false;
+            bf.simd_level = SimdLevel::SIMD_NONE;
+            bf.metric = kL2;
+            bf.query_data_type = DataType::DT_FLOAT;
+            bf.data_type = DataType::DT_BFLOAT16;
+            bf.normalize_vector = nullptr;
+            bf.distance_vector = simple_mixed_l2_distance<bfloat16>;
+            bf.bounded_rank_vector = simple_mixed_l2_bounded_rank<bfloat16>;
+            bf.rank_vector = simple_mixed_l2_rank<bfloat16>;
+            bf.rank_to_distance = simple_l2_rank_to_distance;
+
+            auto rs = register_metric_level_operator(r, bf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity bf;
+            bf.supports = true;
+            bf.need_normalize_vector = false;
+            bf.simd_level = SimdLevel::SIMD_NONE;
+            bf.metric = kIP;
+            bf.query_data_type = DataType::DT_FLOAT;
+            bf.data_type = DataType::DT_BFLOAT16;
+            bf.normalize_vector = nullptr;
+            bf.distance_vector = simple_mixed_ip_distance<bfloat16>;
+            bf.rank_vector = simple_mixed_ip_rank<bfloat16>;
+            bf.rank_to_distance = simple_negated_rank_to_distance;
+
+            auto rs = register_metric_level_operator(r, bf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        ////////////////////////////////////////
+        /// SimdLevel::SIMD_NONE
+        return turbo::OkStatus();
+    }
+
+    static turbo::Status initialize_sse2_mixed_operator(MetricRegistry &r) {
+#ifdef XSIMD_WITH_SSE3
+        /// f32 query, uint8 storage
+        {
+            OperatorEntity u8;
+            u8.supports = true;
+            u8.need_normalize_vector = false;
+            u8.simd_level = SimdLevel::SIMD_SSE2;
+            u8.metric = kL2;
+            u8.query_data_type = DataType::DT_FLOAT;
+            u8.data_type = DataType::DT_UINT8;
+            u8.normalize_vector = nullptr;
+            u8.distance_vector = simd_mixed_l2_distance<xsimd::sse3, uint8_t>;
+            u8.bounded_rank_vector = simd_mixed_l2_bounded_rank<xsimd::sse3, uint8_t>;
+            u8.rank_vector = simd_mixed_l2_rank<xsimd::sse3, uint8_t>;
+            u8.rank_to_distance = simd_l2_rank_to_distance<xsimd::sse3>;
+
+            auto rs = register_metric_level_operator(r, u8, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity u8;
+            u8.supports = true;
+            u8.need_normalize_vector = false;
+            u8.simd_level = SimdLevel::SIMD_SSE2;
+            u8.metric = kIP;
+            u8.query_data_type = DataType::DT_FLOAT;
+            u8.data_type = DataType::DT_UINT8;
+            u8.normalize_vector = nullptr;
+            u8.distance_vector = simd_mixed_ip_distance<xsimd::sse3, uint8_t>;
+            u8.rank_vector = simd_mixed_ip_rank<xsimd::sse3, uint8_t>;
+            u8.rank_to_distance = simd_negated_rank_to_distance<xsimd::sse3>;
+
+            auto rs = register_metric_level_operator(r, u8, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        /// f32 query, half storage
+        {
+            OperatorEntity hf;
+            hf.supports = true;
+            hf.need_normalize_vector = false;
+            hf.simd_level = SimdLevel::SIMD_SSE2;
+            hf.metric = kL2;
+            hf.query_data_type = DataType::DT_FLOAT;
+            hf.data_type = DataType::DT_FLOAT16;
+            hf.normalize_vector = nullptr;
+            hf.distance_vector = simd_mixed_l2_distance<xsimd::sse3, half_float::half>;
+            hf.bounded_rank_vector = simd_mixed_l2_bounded_rank<xsimd::sse3, half_float::half>;
+            hf.rank_vector = simd_mixed_l2_rank<xsimd::sse3, half_float::half>;
+            hf.rank_to_distance = simd_l2_rank_to_distance<xsimd::sse3>;
+
+            auto rs = register_metric_level_operator(r, hf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity hf;
+            hf.supports = true;
+            hf.need_normalize_vector = false;
+            hf.simd_level = SimdLevel::SIMD_SSE2;
+            hf.metric = kIP;
+            hf.query_data_type = DataType::DT_FLOAT;
+            hf.data_type = DataType::DT_FLOAT16;
+            hf.normalize_vector = nullptr;
+            hf.distance_vector = simd_mixed_ip_distance<xsimd::sse3, half_float::half>;
+            hf.rank_vector = simd_mixed_ip_rank<xsimd::sse3, half_float::half>;
+            hf.rank_to_distance = simd_negated_rank_to_distance<xsimd::sse3>;
+
+            auto rs = register_metric_level_operator(r, hf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        /// f32 query, bf16 storage
+        {
+            OperatorEntity bf;
+            bf.supports = true;
+            bf.need_normalize_vector = false;
+            bf.simd_level = SimdLevel::SIMD_SSE2;
+            bf.metric = kL2;
+            bf.query_data_type = DataType::DT_FLOAT;
+            bf.data_type = DataType::DT_BFLOAT16;
+            bf.normalize_vector = nullptr;
+            bf.distance_vector = simd_mixed_l2_distance<xsimd::sse3, bfloat16>;
+            bf.bounded_rank_vector = simd_mixed_l2_bounded_rank<xsimd::sse3, bfloat16>;
+            bf.rank_vector = simd_mixed_l2_rank<xsimd::sse3, bfloat16>;
+            bf.rank_to_distance = simd_l2_rank_to_distance<xsimd::sse3>;
+
+            auto rs = register_metric_level_operator(r, bf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity bf;
+            bf.supports = true;
+            bf.need_normalize_vector = false;
+            bf.simd_level = SimdLevel::SIMD_SSE2;
+            bf.metric = kIP;
+            bf.query_data_type = DataType::DT_FLOAT;
+            bf.data_type = DataType::DT_BFLOAT16;
+            bf.normalize_vector = nullptr;
+            bf.distance_vector = simd_mixed_ip_distance<xsimd::sse3, bfloat16>;
+            bf.rank_vector = simd_mixed_ip_rank<xsimd::sse3, bfloat16>;
+            bf.rank_to_distance = simd_negated_rank_to_distance<xsimd::sse3>;
+
+            auto rs = register_metric_level_operator(r, bf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+#endif
+        return turbo::OkStatus();
+    }
+
+    static turbo::Status initialize_avx2_mixed_operator(MetricRegistry &r) {
+#ifdef XSIMD_WITH_AVX2
+        /// f32 query, uint8 storage
+        {
+            OperatorEntity u8;
+            u8.supports = true;
+            u8.need_normalize_vector = false;
+            u8.simd_level = SimdLevel::SIMD_AVX2;
+            u8.metric = kL2;
+            u8.query_data_type = DataType::DT_FLOAT;
+            u8.data_type = DataType::DT_UINT8;
+            u8.normalize_vector = nullptr;
+            u8.distance_vector = simd_mixed_l2_distance<xsimd::avx2, uint8_t>;
+            u8.bounded_rank_vector = simd_mixed_l2_bounded_rank<xsimd::avx2, uint8_t>;
+            u8.rank_vector = simd_mixed_l2_rank<xsimd::avx2, uint8_t>;
+            u8.rank_to_distance = simd_l2_rank_to_distance<xsimd::avx2>;
+
+            auto rs = register_metric_level_operator(r, u8, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity u8;
+            u8.supports = true;
+            u8.need_normalize_vector = false;
+            u8.simd_level = SimdLevel::SIMD_AVX2;
+            u8.metric = kIP;
+            u8.query_data_type = DataType::DT_FLOAT;
+            u8.data_type = DataType::DT_UINT8;
+            u8.normalize_vector = nullptr;
+            u8.distance_vector = simd_mixed_ip_distance<xsimd::avx2, uint8_t>;
+            u8.rank_vector = simd_mixed_ip_rank<xsimd::avx2, uint8_t>;
+            u8.rank_to_distance = simd_negated_rank_to_distance<xsimd::avx2>;
+
+            auto rs = register_metric_level_operator(r, u8, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        /// f32 query, half storage
+        {
+            OperatorEntity hf;
+            hf.supports = true;
+            hf.need_normalize_vector = false;
+            hf.simd_level = SimdLevel::SIMD_AVX2;
+            hf.metric = kL2;
+            hf.query_data_type = DataType::DT_FLOAT;
+            hf.data_type = DataType::DT_FLOAT16;
+            hf.normalize_vector = nullptr;
+            hf.distance_vector = simd_mixed_l2_distance<xsimd::avx2, half_float::half>;
+            hf.bounded_rank_vector = simd_mixed_l2_bounded_rank<xsimd::avx2, half_float::half>;
+            hf.rank_vector = simd_mixed_l2_rank<xsimd::avx2, half_float::half>;
+            hf.rank_to_distance = simd_l2_rank_to_distance<xsimd::avx2>;
+
+            auto rs = register_metric_level_operator(r, hf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity hf;
+            hf.supports = true;
+            hf.need_normalize_vector = false;
+            hf.simd_level = SimdLevel::SIMD_AVX2;
+            hf.metric = kIP;
+            hf.query_data_type = DataType::DT_FLOAT;
+            hf.data_type = DataType::DT_FLOAT16;
+            hf.normalize_vector = nullptr;
+            hf.distance_vector = simd_mixed_ip_distance<xsimd::avx2, half_float::half>;
+            hf.rank_vector = simd_mixed_ip_rank<xsimd::avx2, half_float::half>;
+            hf.rank_to_distance = simd_negated_rank_to_distance<xsimd::avx2>;
+
+            auto rs = register_metric_level_operator(r, hf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        /// f32 query, bf16 storage
+        {
+            OperatorEntity bf;
+            bf.supports = true;
+            bf.need_normalize_vector = false;
+            bf.simd_level = SimdLevel::SIMD_AVX2;
+            bf.metric = kL2;
+            bf.query_data_type = DataType::DT_FLOAT;
+            bf.data_type = DataType::DT_BFLOAT16;
+            bf.normalize_vector = nullptr;
+            bf.distance_vector = simd_mixed_l2_distance<xsimd::avx2, bfloat16>;
+            bf.bounded_rank_vector = simd_mixed_l2_bounded_rank<xsimd::avx2, bfloat16>;
+            bf.rank_vector = simd_mixed_l2_rank<xsimd::avx2, bfloat16>;
+            bf.rank_to_distance = simd_l2_rank_to_distance<xsimd::avx2>;
+
+            auto rs = register_metric_level_operator(r, bf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity bf;
+            bf.supports = true;
+            bf.need_normalize_vector = false;
+            bf.simd_level = SimdLevel::SIMD_AVX2;
+            bf.metric = kIP;
+            bf.query_data_type = DataType::DT_FLOAT;
+            bf.data_type = DataType::DT_BFLOAT16;
+            bf.normalize_vector = nullptr;
+            bf.distance_vector = simd_mixed_ip_distance<xsimd::avx2, bfloat16>;
+            bf.rank_vector = simd_mixed_ip_rank<xsimd::avx2, bfloat16>;
+            bf.rank_to_distance = simd_negated_rank_to_distance<xsimd::avx2>;
+
+            auto rs = register_metric_level_operator(r, bf, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+#endif
+        return turbo::OkStatus();
+    }
+
+    turbo::Status initialize_mixed_operator(MetricRegistry &r) {
+        auto rs = initialize_l0_mixed_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = initialize_sse2_mixed_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = initialize_avx2_mixed_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return turbo::OkStatus();
+    }
+} // namespace xann
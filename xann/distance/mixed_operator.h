@@ -0,0 +1,247 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <turbo/container/span.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <xann/common/bfloat16.h>
+#include <xann/common/half.hpp>
+#include <xann/core/operator_registry.h>
+#include <xann/core/vector_space.h>
+#include <xsimd/xsimd.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace xann {
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief one float batch widened from batch size stored values at p
+    /// @details the generic form converts lane by lane through an aligned
+    ///          buffer, the avx2 / sse specializations widen uint8, bf16 and
+    ///          (with F16C) fp16 inside the load.
+    //////////////////////////////////////////////////////////////////////////
+    template<typename ARCH, typename T>
+    struct WidenLoad {
+        static xsimd::batch<float, ARCH> load(const T *p) {
+            using b_type = xsimd::batch<float, ARCH>;
+            alignas(64) float lanes[b_type::size];
+            for (std::size_t i = 0; i < b_type::size; ++i) {
+                lanes[i] = static_cast<float>(p[i]);
+            }
+            return b_type::load(lanes, xsimd::aligned_mode());
+        }
+    };
+
+#ifdef XSIMD_WITH_AVX2
+    template<>
+    struct WidenLoad<xsimd::avx2, uint8_t> {
+        static xsimd::batch<float, xsimd::avx2> load(const uint8_t *p) {
+            auto v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+            return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+        }
+    };
+
+    template<>
+    struct WidenLoad<xsimd::avx2, bfloat16> {
+        static xsimd::batch<float, xsimd::avx2> load(const bfloat16 *p) {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(v), 16));
+        }
+    };
+
+#if defined(__F16C__)
+    template<>
+    struct WidenLoad<xsimd::avx2, half_float::half> {
+        static xsimd::batch<float, xsimd::avx2> load(const half_float::half *p) {
+            return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+        }
+    };
+#endif
+#endif
+
+#ifdef XSIMD_WITH_SSE3
+    template<>
+    struct WidenLoad<xsimd::sse3, uint8_t> {
+        static xsimd::batch<float, xsimd::sse3> load(const uint8_t *p) {
+            int32_t bytes;
+            std::memcpy(&bytes, p, sizeof(bytes));
+            auto zero = _mm_setzero_si128();
+            auto v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero);
+            return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+        }
+    };
+
+    template<>
+    struct WidenLoad<xsimd::sse3, bfloat16> {
+        static xsimd::batch<float, xsimd::sse3> load(const bfloat16 *p) {
+            auto v = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+            return _mm_castsi128_ps(_mm_unpacklo_epi16(_mm_setzero_si128(), v));
+        }
+    };
+
+#if defined(__F16C__)
+    template<>
+    struct WidenLoad<xsimd::sse3, half_float::half> {
+        static xsimd::batch<float, xsimd::sse3> load(const half_float::half *p) {
+            return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)));
+        }
+    };
+#endif
+#endif
+
+    /// squared l2 of a float query a against a stored T vector b, the
+    /// element count comes from b.
+    template<typename T>
+    float simple_mixed_l2_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        size_t size = b.size() / sizeof(T);
+        float d = 0.0f;
+        for (size_t i = 0; i < size; ++i) {
+            auto diff = pa[i] - static_cast<float>(pb[i]);
+            d += diff * diff;
+        }
+        return d;
+    }
+
+    template<typename T>
+    float simple_mixed_l2_bounded_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        size_t size = b.size() / sizeof(T);
+        float d = 0.0f;
+        for (size_t block = 0; block < size; block += kAbandonBlock) {
+            auto last = std::min(size, block + kAbandonBlock);
+            for (size_t i = block; i < last; ++i) {
+                auto diff = pa[i] - static_cast<float>(pb[i]);
+                d += diff * diff;
+            }
+            if (d >= bound) {
+                return d;
+            }
+        }
+        return d;
+    }
+
+    template<typename T>
+    float simple_mixed_l2_distance(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        return std::sqrt(simple_mixed_l2_rank<T>(a, b));
+    }
+
+    template<typename T>
+    float simple_mixed_ip_distance(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        size_t size = b.size() / sizeof(T);
+        float d = 0.0f;
+        for (size_t i = 0; i < size; ++i) {
+            d += pa[i] * static_cast<float>(pb[i]);
+        }
+        return d;
+    }
+
+    template<typename T>
+    float simple_mixed_ip_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        return -simple_mixed_ip_distance<T>(a, b);
+    }
+
+    template<typename ARCH, typename T>
+    float simd_mixed_l2_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        using b_type = xsimd::batch<float, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t size = b.size() / sizeof(T);
+        std::size_t vec_size = size - size % inc;
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        b_type sum_v = b_type::broadcast(0.0f);
+        for (std::size_t i = 0; i < vec_size; i += inc) {
+            auto diff = b_type::load(pa + i, xsimd::aligned_mode()) - WidenLoad<ARCH, T>::load(pb + i);
+            sum_v = xsimd::fma(diff, diff, sum_v);
+        }
+        float d = xsimd::reduce_add(sum_v);
+        for (std::size_t i = vec_size; i < size; ++i) {
+            auto diff = pa[i] - static_cast<float>(pb[i]);
+            d += diff * diff;
+        }
+        return d;
+    }
+
+    template<typename ARCH, typename T>
+    float simd_mixed_l2_bounded_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+        using b_type = xsimd::batch<float, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t size = b.size() / sizeof(T);
+        std::size_t vec_size = size - size % inc;
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        float d = 0.0f;
+        for (std::size_t block = 0; block < vec_size; block += kAbandonBlock) {
+            auto last = std::min(vec_size, block + kAbandonBlock);
+            b_type sum_v = b_type::broadcast(0.0f);
+            for (std::size_t i = block; i < last; i += inc) {
+                auto diff = b_type::load(pa + i, xsimd::aligned_mode()) - WidenLoad<ARCH, T>::load(pb + i);
+                sum_v = xsimd::fma(diff, diff, sum_v);
+            }
+            d += xsimd::reduce_add(sum_v);
+            if (d >= bound) {
+                return d;
+            }
+        }
+        for (std::size_t i = vec_size; i < size; ++i) {
+            auto diff = pa[i] - static_cast<float>(pb[i]);
+            d += diff * diff;
+        }
+        return d;
+    }
+
+    template<typename ARCH, typename T>
+    float simd_mixed_l2_distance(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        return std::sqrt(simd_mixed_l2_rank<ARCH, T>(a, b));
+    }
+
+    template<typename ARCH, typename T>
+    float simd_mixed_ip_distance(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        using b_type = xsimd::batch<float, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t size = b.size() / sizeof(T);
+        std::size_t vec_size = size - size % inc;
+        const float *pa = reinterpret_cast<const float *>(a.data());
+        const T *pb = reinterpret_cast<const T *>(b.data());
+        b_type sum_v = b_type::broadcast(0.0f);
+        for (std::size_t i = 0; i < vec_size; i += inc) {
+            sum_v = xsimd::fma(b_type::load(pa + i, xsimd::aligned_mode()), WidenLoad<ARCH, T>::load(pb + i), sum_v);
+        }
+        float d = xsimd::reduce_add(sum_v);
+        for (std::size_t i = vec_size; i < size; ++i) {
+            d += pa[i] * static_cast<float>(pb[i]);
+        }
+        return d;
+    }
+
+    template<typename ARCH, typename T>
+    float simd_mixed_ip_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+        return -simd_mixed_ip_distance<ARCH, T>(a, b);
+    }
+
+    /// DT_FLOAT queries against DT_UINT8, DT_FLOAT16 and DT_BFLOAT16 storage for kL2 and kIP.
+    turbo::Status initialize_mixed_operator(MetricRegistry &r);
+} // namespace xann
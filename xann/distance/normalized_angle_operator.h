@@ -51,5 +51,18 @@ namespace xann {
     }
 
 
+    /// the rank kernel is the negated dot product.
+    inline void simple_normalized_angle_rank_to_distance(float *values, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            values[i] = fast_acos(-values[i]);
+        }
+    }
+
+    template<typename ARCH>
+    void simd_normalized_angle_rank_to_distance(float *values, size_t n) {
+        using b_type = xsimd::batch<float, ARCH>;
+        simd_map_inplace<ARCH>(values, n, [](const b_type &v) { return simd_acos<ARCH>(-v); });
+    }
+
     turbo::Status initialize_normalized_angle_operator(MetricRegistry &r);
 } // namespace xann
@@ -34,6 +34,8 @@ namespace xann {
             hf.normalize_vector = simple_normalize_l2<half_float::half>;
             hf.distance_vector = simple_normalized_l2_distance<half_float::half>;
             hf.norm_vector = simple_l2_norm<half_float::half>;
+            hf.rank_vector = simple_ip_rank<half_float::half>;
+            hf.rank_to_distance = simple_normalized_l2_rank_to_distance;
 
             auto rs = register_metric_level_operator(r, hf, false);
             if (!rs.ok()) {
@@ -51,6 +53,8 @@ namespace xann {
             f32.normalize_vector = simple_normalize_l2<float>;
             f32.distance_vector = simple_normalized_l2_distance<float>;
             f32.norm_vector = simple_l2_norm<float>;
+            f32.rank_vector = simple_ip_rank<float>;
+            f32.rank_to_distance = simple_normalized_l2_rank_to_distance;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
@@ -77,6 +81,8 @@ namespace xann {
             f32.normalize_vector = simd_normalize_l2<xsimd::sse3>;
             f32.distance_vector = simd_normalized_l2_distance<xsimd::sse3>;
             f32.norm_vector = simd_norm_l2<xsimd::sse3>;
+            f32.rank_vector = simd_ip_rank<xsimd::sse3>;
+            f32.rank_to_distance = simd_normalized_l2_rank_to_distance<xsimd::sse3>;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
@@ -101,6 +107,8 @@ namespace xann {
             f32.normalize_vector = simd_normalize_l2<xsimd::avx2>;
             f32.distance_vector = simd_normalized_l2_distance<xsimd::avx2>;
             f32.norm_vector = simd_norm_l2<xsimd::avx2>;
+            f32.rank_vector = simd_ip_rank<xsimd::avx2>;
+            f32.rank_to_distance = simd_normalized_l2_rank_to_distance<xsimd::avx2>;
 
             auto rs = register_metric_level_operator(r, f32, false);
             if (!rs.ok()) {
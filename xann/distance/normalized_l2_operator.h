@@ -71,7 +71,7 @@ namespace xann {
         std::size_t inc = b_type::size;
         std::size_t size = output.size()/sizeof(float);
         auto arr = reinterpret_cast<const float*>(input.data());
-        auto dst = reinterpret_cast<b_type*>(output.data());
+        auto dst = reinterpret_cast<float *>(output.data());
         // size for which the vectorization is possible
         std::size_t vec_size = size - size % inc;
         for (std::size_t i = 0; i < vec_size; i += inc) {
@@ -84,5 +84,21 @@ namespace xann {
         }
     }
 
+    /// the rank kernel is the negated dot product, |a - b| = sqrt(2 - 2 a . b).
+    inline void simple_normalized_l2_rank_to_distance(float *values, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            values[i] = std::sqrt(std::max(2.0f + 2.0f * values[i], 0.0f));
+        }
+    }
+
+    template<typename ARCH>
+    void simd_normalized_l2_rank_to_distance(float *values, size_t n) {
+        using b_type = xsimd::batch<float, ARCH>;
+        simd_map_inplace<ARCH>(values, n, [](const b_type &v) {
+            return xsimd::sqrt(xsimd::max(xsimd::fma(v, b_type::broadcast(2.0f), b_type::broadcast(2.0f)),
+                                          b_type::broadcast(0.0f)));
+        });
+    }
+
     turbo::Status initialize_normalized_l2_operator(MetricRegistry &r);
 } // namespace xann
@@ -0,0 +1,84 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <xsimd/xsimd.hpp>
+
+namespace xann {
+
+    /// Abramowitz-Stegun 4.4.46, acos(x) = sqrt(1 - x) * p(x) on [0, 1],
+    /// |error| < 2e-8 before float rounding.
+    static constexpr float kAcosCoefficients[8] = {
+        1.5707963050f, -0.2145988016f, 0.0889789874f, -0.0501743046f,
+        0.0308918810f, -0.0170881256f, 0.0066700901f, -0.0012624911f
+    };
+
+    /// acos of x clamped to [-1, 1] without a libm call.
+    inline float fast_acos(float x) {
+        auto c = std::clamp(x, -1.0f, 1.0f);
+        auto a = std::abs(c);
+        auto p = kAcosCoefficients[7];
+        for (int i = 6; i >= 0; --i) {
+            p = p * a + kAcosCoefficients[i];
+        }
+        auto r = std::sqrt(1.0f - a) * p;
+        return c < 0.0f ? 3.14159265358979f - r : r;
+    }
+
+    template<typename ARCH>
+    xsimd::batch<float, ARCH> simd_acos(const xsimd::batch<float, ARCH> &x) {
+        using b_type = xsimd::batch<float, ARCH>;
+        auto c = xsimd::min(xsimd::max(x, b_type::broadcast(-1.0f)), b_type::broadcast(1.0f));
+        auto a = xsimd::abs(c);
+        auto p = b_type::broadcast(kAcosCoefficients[7]);
+        for (int i = 6; i >= 0; --i) {
+            p = xsimd::fma(p, a, b_type::broadcast(kAcosCoefficients[i]));
+        }
+        auto r = xsimd::sqrt(b_type::broadcast(1.0f) - a) * p;
+        return xsimd::select(c < b_type::broadcast(0.0f), b_type::broadcast(3.14159265358979f) - r, r);
+    }
+
+    /// v[i] = fn(v[i]) batch wise, the tail runs through a zero padded batch.
+    template<typename ARCH, typename F>
+    void simd_map_inplace(float *v, size_t n, F fn) {
+        using b_type = xsimd::batch<float, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t vec_size = n - n % inc;
+        for (std::size_t i = 0; i < vec_size; i += inc) {
+            fn(b_type::load(v + i, xsimd::unaligned_mode())).store(v + i, xsimd::unaligned_mode());
+        }
+        if (vec_size < n) {
+            alignas(64) float tail[b_type::size] = {};
+            std::copy(v + vec_size, v + n, tail);
+            fn(b_type::load(tail, xsimd::aligned_mode())).store(tail, xsimd::aligned_mode());
+            std::copy(tail, tail + (n - vec_size), v + vec_size);
+        }
+    }
+
+    /// sign(x) * sqrt(|x|), the inverse of the signed square x * |x|.
+    template<typename ARCH>
+    xsimd::batch<float, ARCH> simd_signed_sqrt(const xsimd::batch<float, ARCH> &x) {
+        using b_type = xsimd::batch<float, ARCH>;
+        auto r = xsimd::sqrt(xsimd::abs(x));
+        return xsimd::select(x < b_type::broadcast(0.0f), -r, r);
+    }
+} // namespace xann
@@ -0,0 +1,187 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <type_traits>
+#include <utility>
+#include <xann/core/vector_space.h>
+#include <xann/distance/angle_operator.h>
+#include <xann/distance/cosine_operator.h>
+#include <xann/distance/ip_operator.h>
+#include <xann/distance/l2_operator.h>
+#include <xann/distance/normalized_angle_operator.h>
+#include <xann/distance/normalized_cosine_operator.h>
+#include <xann/distance/normalized_l2_operator.h>
+
+namespace xann {
+
+    /// arch tag of the SIMD_NONE kernels.
+    struct ScalarArch {
+    };
+
+    template<DataType dt>
+    struct kernel_value_type {
+    };
+
+    template<>
+    struct kernel_value_type<DataType::DT_UINT8> {
+        using type = uint8_t;
+    };
+
+    template<>
+    struct kernel_value_type<DataType::DT_FLOAT16> {
+        using type = half_float::half;
+    };
+
+    template<>
+    struct kernel_value_type<DataType::DT_FLOAT> {
+        using type = float;
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    /// @brief compile time twin of a registered OperatorEntity
+    /// @details rank() names the same kernel the registry stores in rank_vector,
+    ///          but as a direct call, so a scan loop instantiated over a
+    ///          TypedSpace gets the kernel inlined instead of going through a
+    ///          function pointer per candidate. dispatch_typed_space() picks the
+    ///          instantiation matching a runtime VectorSpace once per query.
+    //////////////////////////////////////////////////////////////////////////
+    template<MetricType M, DataType DT, typename ARCH>
+    struct TypedSpace {
+        static constexpr MetricType metric = M;
+        static constexpr DataType data_type = DT;
+        using value_type = typename kernel_value_type<DT>::type;
+        using arch_type = ARCH;
+        static constexpr bool kScalar = std::is_same_v<ARCH, ScalarArch>;
+
+        static float rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+            if constexpr (M == kL2) {
+                if constexpr (kScalar) {
+                    return simple_l2_rank<value_type>(a, b);
+                } else {
+                    return simd_l2_rank<ARCH>(a, b);
+                }
+            } else if constexpr (M == kCosine || M == kAngle) {
+                if constexpr (kScalar) {
+                    return simple_cosine_rank<value_type>(a, b);
+                } else {
+                    return simd_cosine_rank<ARCH>(a, b);
+                }
+            } else {
+                static_assert(M == kIP || M == kNormalizedL2 || M == kNormalizedCosine || M == kNormalizedAngle,
+                              "metric without a typed rank kernel");
+                if constexpr (kScalar) {
+                    return simple_ip_rank<value_type>(a, b);
+                } else {
+                    return simd_ip_rank<ARCH>(a, b);
+                }
+            }
+        }
+
+        /// the twin of bounded_rank_vector, plain rank() where there is none.
+        static float bounded_rank(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+            if constexpr (M == kL2) {
+                if constexpr (kScalar) {
+                    return simple_l2_bounded_rank<value_type>(a, b, bound);
+                } else {
+                    return simd_l2_bounded_rank<ARCH>(a, b, bound);
+                }
+            } else {
+                (void) bound;
+                return rank(a, b);
+            }
+        }
+    };
+
+    namespace detail {
+
+        template<MetricType M, DataType DT, typename F>
+        bool dispatch_typed_arch(SimdLevel level, F &&fn) {
+            if constexpr (DT == DataType::DT_FLOAT) {
+#ifdef XSIMD_WITH_AVX2
+                if (level == SimdLevel::SIMD_AVX2) {
+                    fn(TypedSpace<M, DT, xsimd::avx2>{});
+                    return true;
+                }
+#endif
+#ifdef XSIMD_WITH_SSE3
+                if (level == SimdLevel::SIMD_SSE2) {
+                    fn(TypedSpace<M, DT, xsimd::sse3>{});
+                    return true;
+                }
+#endif
+            }
+            if (level == SimdLevel::SIMD_NONE) {
+                fn(TypedSpace<M, DT, ScalarArch>{});
+                return true;
+            }
+            return false;
+        }
+
+        template<MetricType M, typename F>
+        bool dispatch_typed_data_type(DataType dt, SimdLevel level, F &&fn) {
+            /// the normalized metrics register no uint8 kernels.
+            constexpr bool with_u8 = M == kL2 || M == kIP || M == kCosine || M == kAngle;
+            switch (dt) {
+                case DataType::DT_UINT8:
+                    if constexpr (with_u8) {
+                        return dispatch_typed_arch<M, DataType::DT_UINT8>(level, std::forward<F>(fn));
+                    }
+                    return false;
+                case DataType::DT_FLOAT16:
+                    return dispatch_typed_arch<M, DataType::DT_FLOAT16>(level, std::forward<F>(fn));
+                case DataType::DT_FLOAT:
+                    return dispatch_typed_arch<M, DataType::DT_FLOAT>(level, std::forward<F>(fn));
+                default:
+                    return false;
+            }
+        }
+    } // namespace detail
+
+    /// call fn(TypedSpace<...>{}) for the instantiation behind vs->operation,
+    /// false (fn not called) when the operator has no typed twin.
+    template<typename F>
+    bool dispatch_typed_space(const VectorSpace *vs, F &&fn) {
+        auto &op = vs->operation;
+        if (!op.rank_vector) {
+            return false;
+        }
+        switch (vs->metric) {
+            case kL2:
+                return detail::dispatch_typed_data_type<kL2>(op.data_type, op.simd_level, std::forward<F>(fn));
+            case kIP:
+                return detail::dispatch_typed_data_type<kIP>(op.data_type, op.simd_level, std::forward<F>(fn));
+            case kCosine:
+                return detail::dispatch_typed_data_type<kCosine>(op.data_type, op.simd_level, std::forward<F>(fn));
+            case kAngle:
+                return detail::dispatch_typed_data_type<kAngle>(op.data_type, op.simd_level, std::forward<F>(fn));
+            case kNormalizedL2:
+                return detail::dispatch_typed_data_type<kNormalizedL2>(op.data_type, op.simd_level,
+                                                                       std::forward<F>(fn));
+            case kNormalizedCosine:
+                return detail::dispatch_typed_data_type<kNormalizedCosine>(op.data_type, op.simd_level,
+                                                                           std::forward<F>(fn));
+            case kNormalizedAngle:
+                return detail::dispatch_typed_data_type<kNormalizedAngle>(op.data_type, op.simd_level,
+                                                                          std::forward<F>(fn));
+            default:
+                return false;
+        }
+    }
+} // namespace xann
@@ -0,0 +1,177 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#include <xann/distance/whitened_l2_operator.h>
+#include <xann/distance/l2_operator.h>
+
+namespace xann {
+
+    static turbo::Status initialize_l0_whitened_l2_operator(MetricRegistry &r) {
+        ////////////////////////////////////////
+        /// SimdLevel::SIMD_NONE
+        /// f32
+        {
+            OperatorEntity f32;
+            f32.supports = true;
+            f32.need_normalize_vector = false;
+            f32.simd_level = SimdLevel::SIMD_NONE;
+            f32.metric = kWeightedL2;
+            f32.data_type = DataType::DT_FLOAT;
+            f32.normalize_vector = nullptr;
+            f32.distance_vector = simple_l2_distance<float>;
+            f32.norm_vector = simple_l2_norm<float>;
+            f32.bounded_rank_vector = simple_l2_bounded_rank<float>;
+            f32.rank_vector = simple_l2_rank<float>;
+            f32.rank_to_distance = simple_l2_rank_to_distance;
+
+            auto rs = register_metric_level_operator(r, f32, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity f32;
+            f32.supports = true;
+            f32.need_normalize_vector = false;
+            f32.simd_level = SimdLevel::SIMD_NONE;
+            f32.metric = kMahalanobis;
+            f32.data_type = DataType::DT_FLOAT;
+            f32.normalize_vector = nullptr;
+            f32.distance_vector = simple_l2_distance<float>;
+            f32.norm_vector = simple_l2_norm<float>;
+            f32.bounded_rank_vector = simple_l2_bounded_rank<float>;
+            f32.rank_vector = simple_l2_rank<float>;
+            f32.rank_to_distance = simple_l2_rank_to_distance;
+
+            auto rs = register_metric_level_operator(r, f32, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        ////////////////////////////////////////
+        /// SimdLevel::SIMD_NONE
+        return turbo::OkStatus();
+    }
+
+    static turbo::Status initialize_sse2_whitened_l2_operator(MetricRegistry &r) {
+#ifdef XSIMD_WITH_SSE3
+        ////////////////////////////////////////
+        /// f32
+        {
+            OperatorEntity f32;
+            f32.supports = true;
+            f32.need_normalize_vector = false;
+            f32.simd_level = SimdLevel::SIMD_SSE2;
+            f32.metric = kWeightedL2;
+            f32.data_type = DataType::DT_FLOAT;
+            f32.normalize_vector = nullptr;
+            f32.distance_vector = simd_distance_l2<xsimd::sse3>;
+            f32.norm_vector = simd_norm_l2<xsimd::sse3>;
+            f32.bounded_rank_vector = simd_l2_bounded_rank<xsimd::sse3>;
+            f32.rank_vector = simd_l2_rank<xsimd::sse3>;
+            f32.rank_to_distance = simd_l2_rank_to_distance<xsimd::sse3>;
+
+            auto rs = register_metric_level_operator(r, f32, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity f32;
+            f32.supports = true;
+            f32.need_normalize_vector = false;
+            f32.simd_level = SimdLevel::SIMD_SSE2;
+            f32.metric = kMahalanobis;
+            f32.data_type = DataType::DT_FLOAT;
+            f32.normalize_vector = nullptr;
+            f32.distance_vector = simd_distance_l2<xsimd::sse3>;
+            f32.norm_vector = simd_norm_l2<xsimd::sse3>;
+            f32.bounded_rank_vector = simd_l2_bounded_rank<xsimd::sse3>;
+            f32.rank_vector = simd_l2_rank<xsimd::sse3>;
+            f32.rank_to_distance = simd_l2_rank_to_distance<xsimd::sse3>;
+
+            auto rs = register_metric_level_operator(r, f32, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+#endif
+        return turbo::OkStatus();
+    }
+
+    static turbo::Status initialize_avx2_whitened_l2_operator(MetricRegistry &r) {
+#ifdef XSIMD_WITH_AVX2
+        ////////////////////////////////////////
+        /// f32
+        {
+            OperatorEntity f32;
+            f32.supports = true;
+            f32.need_normalize_vector = false;
+            f32.simd_level = SimdLevel::SIMD_AVX2;
+            f32.metric = kWeightedL2;
+            f32.data_type = DataType::DT_FLOAT;
+            f32.normalize_vector = nullptr;
+            f32.distance_vector = simd_distance_l2<xsimd::avx2>;
+            f32.norm_vector = simd_norm_l2<xsimd::avx2>;
+            f32.bounded_rank_vector = simd_l2_bounded_rank<xsimd::avx2>;
+            f32.rank_vector = simd_l2_rank<xsimd::avx2>;
+            f32.rank_to_distance = simd_l2_rank_to_distance<xsimd::avx2>;
+
+            auto rs = register_metric_level_operator(r, f32, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        {
+            OperatorEntity f32;
+            f32.supports = true;
+            f32.need_normalize_vector = false;
+            f32.simd_level = SimdLevel::SIMD_AVX2;
+            f32.metric = kMahalanobis;
+            f32.data_type = DataType::DT_FLOAT;
+            f32.normalize_vector = nullptr;
+            f32.distance_vector = simd_distance_l2<xsimd::avx2>;
+            f32.norm_vector = simd_norm_l2<xsimd::avx2>;
+            f32.bounded_rank_vector = simd_l2_bounded_rank<xsimd::avx2>;
+            f32.rank_vector = simd_l2_rank<xsimd::avx2>;
+            f32.rank_to_distance = simd_l2_rank_to_distance<xsimd::avx2>;
+
+            auto rs = register_metric_level_operator(r, f32, false);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+#endif
+        return turbo::OkStatus();
+    }
+
+    turbo::Status initialize_whitened_l2_operator(MetricRegistry &r) {
+        auto rs = initialize_l0_whitened_l2_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = initialize_sse2_whitened_l2_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = initialize_avx2_whitened_l2_operator(r);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return turbo::OkStatus();
+    }
+} // namespace xann
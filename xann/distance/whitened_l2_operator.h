@@ -0,0 +1,29 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include <xann/core/operator_registry.h>
+
+namespace xann {
+
+    /// kWeightedL2 and kMahalanobis. VectorSpace::prepare_vector() maps stored
+    /// and query vectors through the per dimension sqrt weights or the
+    /// whitening transform first, so both metrics register the float l2
+    /// kernels, early abandoning and the fused rank included.
+    turbo::Status initialize_whitened_l2_operator(MetricRegistry &r);
+} // namespace xann
@@ -0,0 +1,272 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/auto_index.h>
+#include <xann/index/flat_index.h>
+#include <algorithm>
+#include <map>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <tuple>
+
+namespace xann {
+
+    static constexpr size_t kCalibratePoolBytes = 32 << 20;
+    static constexpr size_t kCalibrateMaxVectors = 65536;
+    static constexpr size_t kCalibrateRounds = 3;
+
+    IndexCostModel calibrate_index_cost(const VectorSpace *vs) {
+        using Key = std::tuple<MetricType, int, int32_t, int>;
+        static std::mutex mutex;
+        static std::map<Key, IndexCostModel> cache;
+        Key key{vs->metric, static_cast<int>(vs->data_type), vs->dim, static_cast<int>(vs->operation.simd_level)};
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            auto it = cache.find(key);
+            if (it != cache.end()) {
+                return it->second;
+            }
+        }
+
+        auto stride = static_cast<size_t>(vs->vector_byte_size);
+        auto n = std::clamp<size_t>(kCalibratePoolBytes / stride, 1024, kCalibrateMaxVectors);
+        AlignedBytes pool(n * stride, 0);
+        AlignedBytes query(stride, 0);
+        std::mt19937_64 rng(n);
+        fill_random_vectors(vs->data_type, vs->dim, stride, pool.data(), n, rng);
+        fill_random_vectors(vs->data_type, vs->dim, stride, query.data(), 1, rng);
+        turbo::span<uint8_t> q(query.data(), stride);
+
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        IndexCostModel model;
+        model.sequential_ns = time_kernel_scan(vs->operation, stride, pool.data(), order, q, kCalibrateRounds);
+        std::shuffle(order.begin(), order.end(), rng);
+        model.random_ns = std::max(model.sequential_ns,
+                                   time_kernel_scan(vs->operation, stride, pool.data(), order, q, kCalibrateRounds));
+
+        std::lock_guard<std::mutex> lk(mutex);
+        cache[key] = model;
+        return model;
+    }
+
+    std::vector<AutoIndexCandidate> AutoIndex::default_candidates(IvfOption ivf, uint32_t nprobe, HnswOption hnsw,
+                                                                  uint32_t ef, PqIndexOption pq, uint32_t rerank) {
+        std::vector<AutoIndexCandidate> candidates;
+        AutoIndexCandidate flat;
+        flat.name = "flat";
+        flat.factory = []() { return std::make_unique<FlatIndex>(); };
+        flat.query_cost = [](uint64_t n, const IndexCostModel &m) {
+            return static_cast<double>(n) * m.sequential_ns;
+        };
+        candidates.push_back(std::move(flat));
+
+        AutoIndexCandidate ivf_flat;
+        ivf_flat.name = "ivf_flat";
+        ivf_flat.factory = [ivf]() { return std::make_unique<IvfFlatIndex>(ivf); };
+        ivf_flat.query_cost = [ivf, nprobe](uint64_t n, const IndexCostModel &m) {
+            auto nlist = static_cast<double>(ivf.nlist ? ivf.nlist : IvfFlatIndex::auto_nlist(n));
+            auto probes = std::min(nlist, static_cast<double>(std::max<uint32_t>(nprobe, 1)));
+            return nlist * m.sequential_ns + static_cast<double>(n) * probes / nlist * m.random_ns;
+        };
+        ivf_flat.min_size = ivf.min_train_size;
+        ivf_flat.supports = [](const VectorSpace *vs) {
+            return vs->data_type == DataType::DT_FLOAT;
+        };
+        ivf_flat.index_bytes = [](uint64_t n, const VectorSpace *) {
+            return n * sizeof(uint64_t);
+        };
+        candidates.push_back(std::move(ivf_flat));
+
+        AutoIndexCandidate graph;
+        graph.name = "hnsw";
+        graph.factory = [hnsw]() { return std::make_unique<HnswIndex>(hnsw); };
+        graph.query_cost = [hnsw, ef](uint64_t n, const IndexCostModel &m) {
+            /// a greedy hop per upper level, then the level 0 beam scores about
+            /// ef * 2m neighbours, all read in graph order.
+            auto links = static_cast<double>(std::max<uint32_t>(hnsw.m, 2));
+            auto levels = std::log(std::max(static_cast<double>(n), 2.0)) / std::log(links);
+            auto evaluations = levels * links + static_cast<double>(std::max<uint32_t>(ef, 1)) * 2.0 * links;
+            return std::min(evaluations, static_cast<double>(n)) * m.random_ns;
+        };
+        /// below this the sq8 codes are untrained and the cost model does not hold.
+        graph.min_size = hnsw.min_train_size;
+        /// links are built with rank(a, b) both ways, an asymmetric divergence breaks them.
+        graph.supports = [](const VectorSpace *vs) {
+            return vs->metric != kKLDivergence;
+        };
+        graph.index_bytes = [hnsw](uint64_t n, const VectorSpace *vs) {
+            uint64_t node = sizeof(uint32_t) * (1 + 2 * static_cast<uint64_t>(hnsw.m));
+            if (hnsw.quantized && vs->data_type == DataType::DT_FLOAT) {
+                node += static_cast<uint64_t>(vs->dim);
+            }
+            return n * node;
+        };
+        candidates.push_back(std::move(graph));
+
+        AutoIndexCandidate compressed;
+        compressed.name = pq.opq ? "opq" : "pq";
+        compressed.factory = [pq]() { return std::make_unique<PqIndex>(pq); };
+        compressed.query_cost = [rerank](uint64_t n, const IndexCostModel &m) {
+            /// the 256 entry tables cost about 256 full distances, a code is m
+            /// lookups against dim flops (m = dim / 8 by auto_m), then rerank
+            /// full vectors in random order.
+            auto lookups = m.sequential_ns * 256.0;
+            auto codes = static_cast<double>(n) * m.sequential_ns / 8.0;
+            auto reranked = std::min(static_cast<double>(std::max<uint32_t>(rerank, 1)), static_cast<double>(n));
+            return lookups + codes + reranked * m.random_ns;
+        };
+        compressed.min_size = pq.min_train_size;
+        compressed.supports = [](const VectorSpace *vs) {
+            if (vs->data_type != DataType::DT_FLOAT) {
+                return false;
+            }
+            switch (vs->metric) {
+                case kL2:
+                case kNormalizedL2:
+                case kIP:
+                case kNormalizedCosine:
+                case kNormalizedAngle:
+                    return true;
+                default:
+                    return false;
+            }
+        };
+        compressed.index_bytes = [pq](uint64_t n, const VectorSpace *vs) {
+            auto m = pq.m ? pq.m : PqIndex::auto_m(static_cast<uint32_t>(vs->dim));
+            return n * (static_cast<uint64_t>(m) + 1);
+        };
+        candidates.push_back(std::move(compressed));
+        return candidates;
+    }
+
+    AutoIndex::AutoIndex(AutoIndexOption option) : _option(std::move(option)) {
+        if (_option.candidates.empty()) {
+            _option.candidates = default_candidates();
+        }
+    }
+
+    bool AutoIndex::eligible(const AutoIndexCandidate &c, uint64_t n) const {
+        auto *vs = _store->get_vector_space();
+        if (n < c.min_size || (c.supports && !c.supports(vs))) {
+            return false;
+        }
+        return _option.index_memory_budget == 0 || !c.index_bytes ||
+               c.index_bytes(n, vs) <= _option.index_memory_budget;
+    }
+
+    int AutoIndex::choose(uint64_t n) const {
+        int best = -1;
+        double best_cost = std::numeric_limits<double>::max();
+        for (size_t i = 0; i < _option.candidates.size(); ++i) {
+            auto &c = _option.candidates[i];
+            if (!eligible(c, n)) {
+                continue;
+            }
+            auto cost = c.query_cost(n, _model);
+            if (cost < best_cost) {
+                best_cost = cost;
+                best = static_cast<int>(i);
+            }
+        }
+        return best;
+    }
+
+    turbo::Status AutoIndex::switch_to(int candidate) {
+        if (candidate < 0) {
+            return turbo::unavailable_error("no index candidate for the vector space");
+        }
+        auto index = _option.candidates[candidate].factory();
+        auto rs = index->build(_store);
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (candidate != _current_candidate) {
+            _tuning = SearchTuning();
+        }
+        _current = std::move(index);
+        _current_candidate = candidate;
+        _decision_size = _store->size();
+        return turbo::OkStatus();
+    }
+
+    turbo::Status AutoIndex::build(const MemStore *store) {
+        _store = store;
+        _model = calibrate_index_cost(store->get_vector_space());
+        return switch_to(choose(store->size()));
+    }
+
+    turbo::Status AutoIndex::maybe_migrate() {
+        auto n = _store->size();
+        auto base = static_cast<double>(std::max<uint64_t>(_decision_size, 64));
+        if (std::fabs(static_cast<double>(n) - static_cast<double>(_decision_size)) < base * _option.recheck_ratio) {
+            return turbo::OkStatus();
+        }
+        _decision_size = n;
+        auto best = choose(n);
+        if (best < 0 || best == _current_candidate) {
+            return turbo::OkStatus();
+        }
+        auto &current = _option.candidates[_current_candidate];
+        auto current_ok = eligible(current, n);
+        auto gain = current.query_cost(n, _model) / _option.candidates[best].query_cost(n, _model);
+        if (current_ok && gain < _option.migrate_gain) {
+            return turbo::OkStatus();
+        }
+        return switch_to(best);
+    }
+
+    turbo::Status AutoIndex::add(uint64_t lid) {
+        if (!_current) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        auto rs = _current->add(lid);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return maybe_migrate();
+    }
+
+    turbo::Status AutoIndex::update(uint64_t lid) {
+        if (!_current) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        return _current->update(lid);
+    }
+
+    turbo::Status AutoIndex::remove(uint64_t lid) {
+        if (!_current) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        auto rs = _current->remove(lid);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return maybe_migrate();
+    }
+
+    turbo::Result<std::vector<SearchHit> > AutoIndex::search(turbo::span<uint8_t> query,
+                                                            const SearchOption &option) const {
+        if (!_current) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        return _current->search(query, option);
+    }
+} // namespace xann
@@ -0,0 +1,165 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <xann/collection/sharded_collection.h>
+#include <xann/index/hnsw_index.h>
+#include <xann/index/ivf_flat_index.h>
+#include <xann/index/pq_index.h>
+#include <xann/index/vector_index.h>
+
+namespace xann {
+
+    /// measured per candidate costs of the space operator on this host.
+    struct IndexCostModel {
+        /// distance against vectors read in storage order.
+        double sequential_ns{0.0};
+        /// distance against vectors read in random order, posting lists and graph hops.
+        double random_ns{0.0};
+    };
+
+    /// microbenchmark the operator of vs on synthetic data, run once per
+    /// (metric, data type, dim, simd level) and cached for the process.
+    IndexCostModel calibrate_index_cost(const VectorSpace *vs);
+
+    struct AutoIndexCandidate {
+        std::string name;
+        IndexFactory factory;
+        /// predicted ns per query with n vectors.
+        std::function<double(uint64_t n, const IndexCostModel &model)> query_cost;
+        /// not considered below this size, e.g. ivf needs training data.
+        uint64_t min_size{0};
+        /// nullptr means any space.
+        std::function<bool(const VectorSpace *vs)> supports;
+        /// index side bytes for n vectors on top of the store, nullptr means negligible.
+        std::function<uint64_t(uint64_t n, const VectorSpace *vs)> index_bytes;
+    };
+
+    struct AutoIndexOption {
+        /// empty means AutoIndex::default_candidates().
+        std::vector<AutoIndexCandidate> candidates;
+        /// migrate only if the new candidate is predicted this much cheaper.
+        double migrate_gain{1.5};
+        /// re-evaluate once the size moved by this fraction since the last decision.
+        double recheck_ratio{0.25};
+        /// candidates whose index_bytes exceed this are skipped, 0 means no limit.
+        uint64_t index_memory_budget{0};
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Picks the cheapest index type for the current store size.
+    ///
+    /// @details  Every candidate predicts its query cost from the calibrated
+    ///           IndexCostModel, candidates whose index side memory would pass
+    ///           index_memory_budget are skipped, which hands large stores to
+    ///           the compressed candidates. The decision is re-evaluated as size() grows or
+    ///           shrinks, and when another candidate wins by migrate_gain the
+    ///           new index is built from the store and swapped in. Migration
+    ///           runs inside add/remove, under the store's exclusive lock.
+    ///
+    class AutoIndex : public VectorIndex {
+    public:
+        explicit AutoIndex(AutoIndexOption option = {});
+
+        [[nodiscard]] std::string_view name() const override {
+            return "auto";
+        }
+
+        turbo::Status build(const MemStore *store) override;
+
+        turbo::Status add(uint64_t lid) override;
+
+        turbo::Status update(uint64_t lid) override;
+
+        turbo::Status remove(uint64_t lid) override;
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const override;
+
+        [[nodiscard]] uint64_t size() const override {
+            return _current ? _current->size() : 0;
+        }
+
+        /// the knob of the current index, a migration drops the tuning.
+        [[nodiscard]] SearchKnob search_knob() const override {
+            return _current ? _current->search_knob() : SearchKnob::kNone;
+        }
+
+        [[nodiscard]] uint64_t pending_deletes() const override {
+            return _current ? _current->pending_deletes() : 0;
+        }
+
+        turbo::Result<std::vector<uint64_t> > consolidate(size_t max_lids) override {
+            if (!_current) {
+                return std::vector<uint64_t>();
+            }
+            return _current->consolidate(max_lids);
+        }
+
+        void purge(const std::vector<uint64_t> &lids) override {
+            if (_current) {
+                _current->purge(lids);
+            }
+        }
+
+        turbo::Status maintain() override {
+            return _current ? _current->maintain() : turbo::OkStatus();
+        }
+
+        [[nodiscard]] std::string_view current_name() const {
+            return _current_candidate < 0 ? std::string_view() : _option.candidates[_current_candidate].name;
+        }
+
+        [[nodiscard]] const VectorIndex *current() const {
+            return _current.get();
+        }
+
+        [[nodiscard]] const IndexCostModel &cost_model() const {
+            return _model;
+        }
+
+        /// flat, ivf_flat, hnsw and pq, the ivf cost assumes nprobe probes, the
+        /// hnsw cost a beam of ef and the pq cost rerank full vectors.
+        static std::vector<AutoIndexCandidate> default_candidates(IvfOption ivf = {}, uint32_t nprobe = 8,
+                                                                  HnswOption hnsw = {}, uint32_t ef = 64,
+                                                                  PqIndexOption pq = {}, uint32_t rerank = 64);
+
+    private:
+        /// size and space requirements and the memory budget.
+        [[nodiscard]] bool eligible(const AutoIndexCandidate &c, uint64_t n) const;
+
+        [[nodiscard]] int choose(uint64_t n) const;
+
+        turbo::Status maybe_migrate();
+
+        turbo::Status switch_to(int candidate);
+
+    private:
+        AutoIndexOption _option;
+        IndexCostModel _model;
+        std::unique_ptr<VectorIndex> _current;
+        int _current_candidate{-1};
+        uint64_t _decision_size{0};
+    };
+} // namespace xann
@@ -0,0 +1,342 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/cached_index.h>
+#include <xann/core/query_vector.h>
+#include <cstring>
+
+namespace xann {
+
+    static inline uint64_t mix64(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    static uint64_t hash_bytes(const uint8_t *data, size_t n, uint64_t seed) {
+        uint64_t h = mix64(seed ^ n);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint64_t w;
+            std::memcpy(&w, data + i, 8);
+            h = mix64(h ^ w);
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, data + i, n - i);
+        return mix64(h ^ tail);
+    }
+
+    struct CachedIndex::Entry {
+        uint64_t hash{0};
+        std::vector<uint8_t> query;
+        uint32_t k{0};
+        uint32_t ef{0};
+        uint32_t nprobe{0};
+        uint32_t rerank{0};
+        uint64_t filter_key{0};
+        bool float_query{false};
+        /// _version the hits are known to be current at.
+        uint64_t version{0};
+        uint64_t snapshot_id{0};
+        std::vector<SearchHit> hits;
+
+        [[nodiscard]] bool same_key(turbo::span<uint8_t> q, const SearchOption &option) const {
+            return k == option.k && ef == option.ef && nprobe == option.nprobe && rerank == option.rerank &&
+                   filter_key == option.filter_key && float_query == option.float_query && query.size() == q.size() &&
+                   std::memcmp(query.data(), q.data(), q.size()) == 0;
+        }
+    };
+
+    /// count-min sketch of 4 bit counters, halved every sample_size increments
+    /// so the frequencies age out.
+    class CachedIndex::FrequencySketch {
+    public:
+        explicit FrequencySketch(size_t capacity) {
+            size_t width = 64;
+            while (width < capacity * 2) {
+                width <<= 1;
+            }
+            _mask = width - 1;
+            _table.assign(width * kDepth, 0);
+            _sample_size = std::max<size_t>(capacity * 10, 64);
+        }
+
+        void increment(uint64_t hash) {
+            for (size_t d = 0; d < kDepth; ++d) {
+                auto &c = _table[slot(hash, d)];
+                if (c < 15) {
+                    ++c;
+                }
+            }
+            if (++_additions >= _sample_size) {
+                for (auto &c: _table) {
+                    c >>= 1;
+                }
+                _additions /= 2;
+            }
+        }
+
+        [[nodiscard]] uint8_t frequency(uint64_t hash) const {
+            uint8_t f = 15;
+            for (size_t d = 0; d < kDepth; ++d) {
+                f = std::min(f, _table[slot(hash, d)]);
+            }
+            return f;
+        }
+
+    private:
+        static constexpr size_t kDepth = 4;
+
+        [[nodiscard]] size_t slot(uint64_t hash, size_t d) const {
+            return d * (_mask + 1) + (mix64(hash + d * 0x9e3779b97f4a7c15ULL) & _mask);
+        }
+
+        std::vector<uint8_t> _table;
+        size_t _mask{0};
+        size_t _sample_size{0};
+        size_t _additions{0};
+    };
+
+    CachedIndex::CachedIndex(std::unique_ptr<VectorIndex> index, ResultCacheOption option)
+        : _index(std::move(index)), _option(option) {
+        if (_option.tiny_lfu) {
+            _sketch = std::make_unique<FrequencySketch>(std::max<size_t>(_option.max_entries, 1));
+        }
+    }
+
+    CachedIndex::~CachedIndex() = default;
+
+    turbo::Status CachedIndex::build(const MemStore *store) {
+        _store = store;
+        clear();
+        _journal.clear();
+        _linking.store(0, std::memory_order_relaxed);
+        ++_version;
+        return _index->build(store);
+    }
+
+    void CachedIndex::journal(uint64_t lid) {
+        _journal.push_back({++_version, lid});
+        while (_journal.size() > _option.max_journal) {
+            _journal.pop_front();
+        }
+    }
+
+    turbo::Status CachedIndex::add(uint64_t lid) {
+        journal(lid);
+        return _index->add(lid);
+    }
+
+    turbo::Status CachedIndex::reserve(uint64_t lid) {
+        journal(lid);
+        auto rs = _index->reserve(lid);
+        if (rs.ok()) {
+            _linking.fetch_add(1, std::memory_order_relaxed);
+        }
+        return rs;
+    }
+
+    turbo::Status CachedIndex::add_shared(uint64_t lid) {
+        auto rs = _index->add_shared(lid);
+        _linking.fetch_sub(1, std::memory_order_release);
+        return rs;
+    }
+
+    turbo::Status CachedIndex::update(uint64_t lid) {
+        journal(lid);
+        return _index->update(lid);
+    }
+
+    turbo::Status CachedIndex::remove(uint64_t lid) {
+        journal(lid);
+        return _index->remove(lid);
+    }
+
+    bool CachedIndex::still_valid(const Entry &entry, const SearchOption &option) const {
+        if (entry.version == _version) {
+            return true;
+        }
+        if (_journal.empty() || _journal.front().version > entry.version + 1) {
+            return false;
+        }
+        auto *vs = _store->get_vector_space();
+        auto &entities = _store->id_manager()->ids();
+        auto threshold = std::numeric_limits<float>::max();
+        if (entry.hits.size() >= entry.k && !entry.hits.empty()) {
+            threshold = metric_rank_score(vs->metric, entry.hits.back().distance);
+        }
+        QueryVector prepared(vs);
+        if (!prepared.assign(turbo::span<uint8_t>(entry.query.data(), entry.query.size()), option).ok()) {
+            return false;
+        }
+        auto begin = std::lower_bound(_journal.begin(), _journal.end(), entry.version + 1,
+                                      [](const Touched &t, uint64_t v) { return t.version < v; });
+        for (auto it = begin; it != _journal.end(); ++it) {
+            auto lid = it->lid;
+            for (auto &h: entry.hits) {
+                if (h.lid == lid) {
+                    return false;
+                }
+            }
+            if (!_store->is_live(lid) || (option.filter && !option.filter(entities[lid].label))) {
+                continue;
+            }
+            auto d = vs->mixed_precision()
+                         ? vs->query_operation.distance_vector(prepared.query_span(), _store->vector_at(lid))
+                         : vs->operation.distance_vector(prepared.span(), _store->vector_at(lid));
+            if (metric_rank_score(vs->metric, d) < threshold) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void CachedIndex::insert(Entry entry) const {
+        auto it = _map.find(entry.hash);
+        if (it != _map.end()) {
+            _lru.erase(it->second);
+            _map.erase(it);
+        }
+        if (_lru.size() >= _option.max_entries) {
+            if (_option.max_entries == 0) {
+                return;
+            }
+            auto &victim = _lru.back();
+            if (_sketch && _sketch->frequency(entry.hash) <= _sketch->frequency(victim.hash)) {
+                ++_stats.rejections;
+                return;
+            }
+            _map.erase(victim.hash);
+            _lru.pop_back();
+            ++_stats.evictions;
+        }
+        _lru.push_front(std::move(entry));
+        _map[_lru.front().hash] = _lru.begin();
+    }
+
+    turbo::Result<std::vector<SearchHit> > CachedIndex::search(turbo::span<uint8_t> query,
+                                                              const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (option.filter && option.filter_key == 0) {
+            {
+                std::lock_guard<std::mutex> lk(_mutex);
+                ++_stats.bypasses;
+            }
+            return _index->search(query, option);
+        }
+
+        uint64_t params[] = {option.k, option.ef, option.nprobe, option.rerank, option.filter_key, option.float_query};
+        auto hash = hash_bytes(query.data(), query.size(),
+                               hash_bytes(reinterpret_cast<const uint8_t *>(params), sizeof(params), 0));
+        /// the entry is copied out and checked without _mutex, so one slow
+        /// validation does not stall every other search; the journal and
+        /// _version do not move while the caller holds the store's shared lock.
+        Entry cached;
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lk(_mutex);
+            if (_sketch) {
+                _sketch->increment(hash);
+            }
+            auto it = _map.find(hash);
+            if (it != _map.end() && it->second->same_key(query, option)) {
+                auto &entry = *it->second;
+                auto age = _store->snapshot_id() - std::min(_store->snapshot_id(), entry.snapshot_id);
+                auto approximate = _option.mode == ResultCacheMode::kApproximate && age <= _option.max_staleness;
+                if (entry.version == _version || approximate) {
+                    if (entry.version != _version) {
+                        ++_stats.stale_hits;
+                    }
+                    ++_stats.hits;
+                    _lru.splice(_lru.begin(), _lru, it->second);
+                    return entry.hits;
+                }
+                cached = entry;
+                found = true;
+            } else {
+                ++_stats.misses;
+            }
+        }
+
+        if (found) {
+            auto valid = still_valid(cached, option);
+            std::lock_guard<std::mutex> lk(_mutex);
+            /// another search may have refreshed, replaced or evicted the entry meanwhile.
+            auto it = _map.find(hash);
+            auto same = it != _map.end() && it->second->version == cached.version &&
+                        it->second->same_key(query, option);
+            if (valid) {
+                ++_stats.hits;
+                if (same) {
+                    it->second->version = _version;
+                    _lru.splice(_lru.begin(), _lru, it->second);
+                }
+                return std::move(cached.hits);
+            }
+            ++_stats.invalidations;
+            ++_stats.misses;
+            if (same) {
+                _lru.erase(it->second);
+                _map.erase(it);
+            }
+        }
+
+        /// reserve needs the exclusive lock, so no lid starts linking during this search.
+        auto linking = _linking.load(std::memory_order_acquire) != 0;
+        auto rs = _index->search(query, option);
+        if (!rs.ok() || linking) {
+            return rs;
+        }
+        Entry entry;
+        entry.hash = hash;
+        entry.query.assign(query.begin(), query.end());
+        entry.k = option.k;
+        entry.ef = option.ef;
+        entry.nprobe = option.nprobe;
+        entry.rerank = option.rerank;
+        entry.filter_key = option.filter_key;
+        entry.float_query = option.float_query;
+        entry.version = _version;
+        entry.snapshot_id = _store->snapshot_id();
+        entry.hits = rs.value_or_die();
+        std::lock_guard<std::mutex> lk(_mutex);
+        insert(std::move(entry));
+        return rs;
+    }
+
+    ResultCacheStats CachedIndex::stats() const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        return _stats;
+    }
+
+    size_t CachedIndex::cached_entries() const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        return _lru.size();
+    }
+
+    void CachedIndex::clear() {
+        std::lock_guard<std::mutex> lk(_mutex);
+        _lru.clear();
+        _map.clear();
+    }
+} // namespace xann
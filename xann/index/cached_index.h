@@ -0,0 +1,178 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <xann/index/vector_index.h>
+
+namespace xann {
+
+    enum class ResultCacheMode : uint8_t {
+        /// an entry is served only if no later mutation could change it.
+        kExact = 0,
+        /// entries up to max_staleness snapshot ids old are served unchecked.
+        kApproximate = 1
+    };
+
+    struct ResultCacheOption {
+        size_t max_entries{10000};
+        ResultCacheMode mode{ResultCacheMode::kExact};
+        uint64_t max_staleness{0};
+        /// admit a new entry over the lru victim only if it was asked for more often.
+        bool tiny_lfu{false};
+        /// mutations remembered for lazy validation, older entries are dropped.
+        size_t max_journal{4096};
+    };
+
+    struct ResultCacheStats {
+        uint64_t hits{0};
+        /// hits served past a mutation without validation, kApproximate only.
+        uint64_t stale_hits{0};
+        uint64_t misses{0};
+        /// lookups that found an entry a later mutation invalidated.
+        uint64_t invalidations{0};
+        uint64_t evictions{0};
+        /// inserts refused by tiny_lfu admission.
+        uint64_t rejections{0};
+        /// searches that can not be cached, e.g. a filter without filter_key.
+        uint64_t bypasses{0};
+
+        [[nodiscard]] double hit_rate() const {
+            auto total = hits + misses;
+            return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  LRU result cache in front of another index.
+    ///
+    /// @details  Entries are keyed by the query bytes, k, filter_key and the
+    ///           ef / nprobe / rerank knobs, and tagged with the store
+    ///           snapshot_id. Mutations pass through this index, so it keeps a
+    ///           short journal of touched lids; on lookup an older entry is
+    ///           checked against the journal and dropped only if a touched lid
+    ///           is among its hits or now scores better than its k-th hit.
+    ///           Optional TinyLFU admission keeps one-off queries from
+    ///           flushing the hot set. Concurrent adds are forwarded: reserve
+    ///           journals the lid, and no result is cached while a reserved lid
+    ///           may still be unlinked.
+    ///
+    class CachedIndex : public VectorIndex {
+    public:
+        CachedIndex(std::unique_ptr<VectorIndex> index, ResultCacheOption option = {});
+
+        ~CachedIndex() override;
+
+        [[nodiscard]] std::string_view name() const override {
+            return _index->name();
+        }
+
+        turbo::Status build(const MemStore *store) override;
+
+        turbo::Status add(uint64_t lid) override;
+
+        turbo::Status update(uint64_t lid) override;
+
+        turbo::Status remove(uint64_t lid) override;
+
+        [[nodiscard]] bool concurrent_add() const override {
+            return _index->concurrent_add();
+        }
+
+        turbo::Status reserve(uint64_t lid) override;
+
+        turbo::Status add_shared(uint64_t lid) override;
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const override;
+
+        [[nodiscard]] uint64_t size() const override {
+            return _index->size();
+        }
+
+        [[nodiscard]] SearchKnob search_knob() const override {
+            return _index->search_knob();
+        }
+
+        [[nodiscard]] uint64_t pending_deletes() const override {
+            return _index->pending_deletes();
+        }
+
+        turbo::Result<std::vector<uint64_t> > consolidate(size_t max_lids) override {
+            return _index->consolidate(max_lids);
+        }
+
+        void purge(const std::vector<uint64_t> &lids) override {
+            _index->purge(lids);
+        }
+
+        turbo::Status maintain() override {
+            return _index->maintain();
+        }
+
+        [[nodiscard]] const VectorIndex *inner() const {
+            return _index.get();
+        }
+
+        [[nodiscard]] ResultCacheStats stats() const;
+
+        [[nodiscard]] size_t cached_entries() const;
+
+        void clear();
+
+    private:
+        struct Entry;
+        class FrequencySketch;
+
+        struct Touched {
+            uint64_t version;
+            uint64_t lid;
+        };
+
+        using EntryList = std::list<Entry>;
+
+        void journal(uint64_t lid);
+
+        [[nodiscard]] bool still_valid(const Entry &entry, const SearchOption &option) const;
+
+        void insert(Entry entry) const;
+
+    private:
+        std::unique_ptr<VectorIndex> _index;
+        ResultCacheOption _option;
+        /// bumped per mutation, written under the store's exclusive lock.
+        uint64_t _version{0};
+        std::deque<Touched> _journal;
+        /// lids reserved and not yet through add_shared, results are not cached meanwhile.
+        std::atomic<uint64_t> _linking{0};
+
+        mutable std::mutex _mutex;
+        mutable EntryList _lru;
+        mutable std::unordered_map<uint64_t, EntryList::iterator> _map;
+        mutable std::unique_ptr<FrequencySketch> _sketch;
+        mutable ResultCacheStats _stats;
+    };
+} // namespace xann
@@ -0,0 +1,252 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/flat_index.h>
+#include <xann/common/thread_pool.h>
+#include <xann/core/query_vector.h>
+#include <xann/distance/typed_space.h>
+#include <algorithm>
+#include <numeric>
+
+namespace xann {
+
+    /// rank is either a TypedSpace kernel (inlined) or the runtime operator,
+    /// called with the current k-th score so l1 / l2 can abandon early.
+    template<typename Rank>
+    static void scan_store(const MemStore *store, turbo::span<uint8_t> query, const SearchOption &option,
+                           Rank rank, TopKCollector *collector) {
+        auto *ids = store->id_manager();
+        auto &entities = ids->ids();
+        auto batch_size = store->option().batch_size;
+        auto begin = ids->reserved_id();
+        auto end = std::min(entities.size(), static_cast<size_t>(ids->next_id()));
+        auto &batches = store->vector_batch();
+        for (size_t bi = begin / batch_size; bi < batches.size(); ++bi) {
+            auto &batch = batches[bi];
+            auto first = std::max<uint64_t>(begin, bi * batch_size);
+            auto last = std::min<uint64_t>(end, (bi + 1) * batch_size);
+            for (auto lid = first; lid < last; ++lid) {
+                auto &entity = entities[lid];
+                if (entity.label == IdManager::kInvalidId || entity.status == kTombstone) {
+                    continue;
+                }
+                if (option.filter && !option.filter(entity.label)) {
+                    continue;
+                }
+                collector->push(rank(query, batch.at(lid - bi * batch_size), collector->threshold()), lid);
+            }
+        }
+    }
+
+    /// scan(rank) with the early abandoning rank of vs, the TypedSpace one
+    /// when there is one.
+    template<typename Scan>
+    static void with_bounded_rank(const VectorSpace *vs, Scan scan) {
+        auto typed = dispatch_typed_space(vs, [&](auto space) {
+            using Space = decltype(space);
+            scan([](const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+                return Space::bounded_rank(a, b, bound);
+            });
+        });
+        if (!typed) {
+            scan([vs](const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+                return vs->operation.bounded_rank(a, b, bound);
+            });
+        }
+    }
+
+    std::vector<SearchHit> flat_scan(const MemStore *store, turbo::span<uint8_t> query, const SearchOption &option) {
+        TopKCollector collector(option.k);
+        with_bounded_rank(store->get_vector_space(), [&](auto rank) {
+            scan_store(store, query, option, rank, &collector);
+        });
+        return ranked_hits(store, collector.finish());
+    }
+
+    std::vector<SearchHit> mixed_flat_scan(const MemStore *store, turbo::span<uint8_t> query,
+                                           const SearchOption &option) {
+        auto *vs = store->get_vector_space();
+        TopKCollector collector(option.k);
+        auto rank = [vs](const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b, float bound) {
+            return vs->query_operation.bounded_rank(a, b, bound);
+        };
+        scan_store(store, query, option, rank, &collector);
+        return ranked_hits(store, collector.finish(), vs->query_operation);
+    }
+
+    std::vector<SearchHit> ranked_hits(const MemStore *store, const std::vector<TopKCollector::Entry> &entries) {
+        return ranked_hits(store, entries, store->get_vector_space()->operation);
+    }
+
+    std::vector<SearchHit> ranked_hits(const MemStore *store, const std::vector<TopKCollector::Entry> &entries,
+                                       const OperatorEntity &op) {
+        auto &ids = store->id_manager()->ids();
+        std::vector<float> values(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            values[i] = entries[i].score;
+        }
+        op.to_distance(values.data(), values.size());
+        std::vector<SearchHit> hits;
+        hits.reserve(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            hits.push_back({ids[entries[i].lid].label, entries[i].lid, values[i]});
+        }
+        return hits;
+    }
+
+    FlatIndex::FlatIndex(FlatIndexOption option) : _option(option) {
+    }
+
+    bool FlatIndex::reorder_supported() const {
+        auto *vs = _store->get_vector_space();
+        return _option.reorder_dims && vs->data_type == DataType::DT_FLOAT && vs->operation.bounded_rank_vector;
+    }
+
+    void FlatIndex::learn_order() {
+        _order.clear();
+        _permuted.clear();
+        if (!reorder_supported()) {
+            return;
+        }
+        auto *vs = _store->get_vector_space();
+        auto dim = static_cast<size_t>(vs->dim);
+        auto lids = _store->live_local_ids();
+        if (lids.empty()) {
+            return;
+        }
+        auto step = std::max<size_t>(lids.size() / std::max<uint32_t>(_option.max_sample_size, 1), 1);
+        std::vector<double> sum(dim, 0.0);
+        std::vector<double> sum2(dim, 0.0);
+        for (size_t i = 0; i < lids.size(); i += step) {
+            auto *v = reinterpret_cast<const float *>(_store->vector_at(lids[i]).data());
+            for (size_t d = 0; d < dim; ++d) {
+                sum[d] += v[d];
+                sum2[d] += static_cast<double>(v[d]) * v[d];
+            }
+        }
+        auto n = static_cast<double>((lids.size() + step - 1) / step);
+        std::vector<double> variance(dim);
+        for (size_t d = 0; d < dim; ++d) {
+            variance[d] = sum2[d] / n - (sum[d] / n) * (sum[d] / n);
+        }
+        _order.resize(dim);
+        std::iota(_order.begin(), _order.end(), 0);
+        std::stable_sort(_order.begin(), _order.end(), [&](uint32_t a, uint32_t b) {
+            return variance[a] > variance[b];
+        });
+        auto stride = static_cast<size_t>(vs->vector_byte_size);
+        auto max_lid = *std::max_element(lids.begin(), lids.end());
+        _permuted.assign((max_lid + 1) * stride, 0);
+        ThreadPool::default_pool().parallel_for(lids.size(), [&](size_t i) {
+            copy_permuted(lids[i]);
+        });
+    }
+
+    void FlatIndex::copy_permuted(uint64_t lid) {
+        auto stride = static_cast<size_t>(_store->get_vector_space()->vector_byte_size);
+        auto *v = reinterpret_cast<const float *>(_store->vector_at(lid).data());
+        auto *out = reinterpret_cast<float *>(_permuted.data() + lid * stride);
+        for (size_t i = 0; i < _order.size(); ++i) {
+            out[i] = v[_order[i]];
+        }
+    }
+
+    turbo::Status FlatIndex::build(const MemStore *store) {
+        _store = store;
+        learn_order();
+        return turbo::OkStatus();
+    }
+
+    turbo::Status FlatIndex::add(uint64_t lid) {
+        if (_order.empty()) {
+            /// the vectors of a reordering index arrived after build, wait for
+            /// enough of them that the variances mean something.
+            if (_store && reorder_supported() && _store->size() >= _option.min_learn_size) {
+                learn_order();
+            }
+            return turbo::OkStatus();
+        }
+        auto stride = static_cast<size_t>(_store->get_vector_space()->vector_byte_size);
+        if ((lid + 1) * stride > _permuted.size()) {
+            _permuted.resize(std::max((lid + 1) * stride, _permuted.size() * 2), 0);
+        }
+        copy_permuted(lid);
+        return turbo::OkStatus();
+    }
+
+    turbo::Status FlatIndex::remove(uint64_t lid) {
+        return turbo::OkStatus();
+    }
+
+    turbo::Status FlatIndex::maintain() {
+        if (_store) {
+            learn_order();
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Result<std::vector<SearchHit> > FlatIndex::search(turbo::span<uint8_t> query,
+                                                            const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        auto *vs = _store->get_vector_space();
+        QueryVector qv(vs);
+        auto rs = qv.assign(query, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (vs->mixed_precision()) {
+            return mixed_flat_scan(_store, qv.query_span(), option);
+        }
+        if (_order.empty()) {
+            return flat_scan(_store, qv.span(), option);
+        }
+
+        auto stride = static_cast<size_t>(vs->vector_byte_size);
+        AlignedBytes permuted(stride, 0);
+        auto *q = reinterpret_cast<const float *>(qv.span().data());
+        for (size_t i = 0; i < _order.size(); ++i) {
+            reinterpret_cast<float *>(permuted.data())[i] = q[_order[i]];
+        }
+        turbo::span<uint8_t> pq(permuted.data(), stride);
+        auto *ids = _store->id_manager();
+        auto &entities = ids->ids();
+        auto end = std::min({entities.size(), static_cast<size_t>(ids->next_id()), _permuted.size() / stride});
+        auto *slots = const_cast<uint8_t *>(_permuted.data());
+        TopKCollector collector(option.k);
+        with_bounded_rank(vs, [&](auto rank) {
+            for (uint64_t lid = ids->reserved_id(); lid < end; ++lid) {
+                auto &entity = entities[lid];
+                if (entity.label == IdManager::kInvalidId || entity.status == kTombstone) {
+                    continue;
+                }
+                if (option.filter && !option.filter(entity.label)) {
+                    continue;
+                }
+                collector.push(rank(pq, turbo::span<uint8_t>(slots + lid * stride, stride), collector.threshold()),
+                               lid);
+            }
+        });
+        return ranked_hits(_store, collector.finish());
+    }
+
+    uint64_t FlatIndex::size() const {
+        return _store ? _store->size() : 0;
+    }
+} // namespace xann
@@ -0,0 +1,97 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <vector>
+#include <xann/core/vector_space.h>
+#include <xann/index/vector_index.h>
+
+namespace xann {
+
+    struct FlatIndexOption {
+        /// scan a copy of the vectors with the dimensions in descending
+        /// variance order, so early abandoning l1 / l2 scans stop sooner.
+        /// doubles the vector memory, only DT_FLOAT l1 / l2 spaces use it.
+        bool reorder_dims{false};
+        /// vectors sampled for the variances.
+        uint32_t max_sample_size{32768};
+        /// vectors the store must hold before add() learns the order, build()
+        /// and maintain() learn from whatever is there.
+        uint32_t min_learn_size{1024};
+    };
+
+    /// exact search, a full scan of the store batches with the space operator.
+    class FlatIndex : public VectorIndex {
+    public:
+        explicit FlatIndex(FlatIndexOption option = {});
+
+        [[nodiscard]] std::string_view name() const override {
+            return "flat";
+        }
+
+        turbo::Status build(const MemStore *store) override;
+
+        turbo::Status add(uint64_t lid) override;
+
+        turbo::Status remove(uint64_t lid) override;
+
+        /// relearn the dimension order from the current vectors.
+        turbo::Status maintain() override;
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const override;
+
+        [[nodiscard]] uint64_t size() const override;
+
+        /// scan position -> dimension, empty when the store is scanned in place.
+        [[nodiscard]] const std::vector<uint32_t> &dim_order() const {
+            return _order;
+        }
+
+    private:
+        [[nodiscard]] bool reorder_supported() const;
+
+        void learn_order();
+
+        void copy_permuted(uint64_t lid);
+
+    private:
+        FlatIndexOption _option;
+        std::vector<uint32_t> _order;
+        /// vector_byte_size bytes per lid, dimensions in _order.
+        AlignedBytes _permuted;
+    };
+
+    /// scan every live lid of store, shared by the flat index and by the
+    /// exact reference paths of other indexes. query must already be prepared.
+    std::vector<SearchHit> flat_scan(const MemStore *store, turbo::span<uint8_t> query, const SearchOption &option);
+
+    /// flat_scan of a float query against a mixed precision store through
+    /// vs->query_operation, query is QueryVector::query_span().
+    std::vector<SearchHit> mixed_flat_scan(const MemStore *store, turbo::span<uint8_t> query,
+                                           const SearchOption &option);
+
+    /// rank space top-k entries to hits, the scores go back to operator
+    /// values through one rank_to_distance batch.
+    std::vector<SearchHit> ranked_hits(const MemStore *store, const std::vector<TopKCollector::Entry> &entries);
+
+    /// ranked_hits for entries ranked by op.
+    std::vector<SearchHit> ranked_hits(const MemStore *store, const std::vector<TopKCollector::Entry> &entries,
+                                       const OperatorEntity &op);
+} // namespace xann
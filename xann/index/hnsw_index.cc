@@ -0,0 +1,573 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/hnsw_index.h>
+#include <xann/common/thread_pool.h>
+#include <xann/core/query_vector.h>
+#include <xann/index/flat_index.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <queue>
+
+namespace xann {
+
+    static constexpr size_t kTrainSampleSize = 65536;
+
+    /// epoch tagged visited marks, one per thread and reused across queries.
+    struct VisitedTable {
+        std::vector<uint32_t> tags;
+        uint32_t epoch{0};
+
+        void reset(size_t n) {
+            if (tags.size() < n) {
+                tags.resize(n, 0);
+            }
+            if (++epoch == 0) {
+                std::fill(tags.begin(), tags.end(), 0);
+                epoch = 1;
+            }
+        }
+
+        bool visit(uint32_t id) {
+            if (tags[id] == epoch) {
+                return false;
+            }
+            tags[id] = epoch;
+            return true;
+        }
+    };
+
+    static VisitedTable &visited_table() {
+        thread_local VisitedTable table;
+        return table;
+    }
+
+    HnswIndex::HnswIndex(HnswOption option) : _option(option), _rng(option.seed) {
+        _option.m = std::max<uint32_t>(_option.m, 2);
+        _m0 = static_cast<size_t>(_option.m) * 2;
+        _level_mult = 1.0 / std::log(static_cast<double>(_option.m));
+    }
+
+    bool HnswIndex::codes_supported() const {
+        auto *vs = _store->get_vector_space();
+        if (!_option.quantized || vs->data_type != DataType::DT_FLOAT) {
+            return false;
+        }
+        switch (vs->metric) {
+            case kL2:
+            case kNormalizedL2:
+            case kIP:
+            case kNormalizedCosine:
+            case kNormalizedAngle:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    float HnswIndex::vector_score(turbo::span<uint8_t> q, uint32_t lid) const {
+        auto *vs = _store->get_vector_space();
+        return vs->operation.rank(q, _store->vector_at(lid));
+    }
+
+    turbo::Status HnswIndex::build(const MemStore *store) {
+        _store = store;
+        auto *vs = store->get_vector_space();
+        _sq = ScalarQuantizer();
+        _l2_codes = vs->metric == kL2 || vs->metric == kNormalizedL2;
+        _code_offset = sizeof(uint32_t) * (1 + _m0);
+        auto bytes = _code_offset + (codes_supported() ? static_cast<size_t>(vs->dim) : 0);
+        _node_bytes = (bytes + VectorSpace::kAlignmentBytes - 1) / VectorSpace::kAlignmentBytes *
+                      VectorSpace::kAlignmentBytes;
+        _level0.clear();
+        _levels.clear();
+        _upper.clear();
+        _deleted.clear();
+        _locks.reset();
+        _entry.store(kNoEntry, std::memory_order_relaxed);
+        _count.store(0, std::memory_order_relaxed);
+        _pending.store(0, std::memory_order_relaxed);
+        _rng.seed(_option.seed);
+
+        auto lids = store->live_local_ids();
+        if (lids.empty()) {
+            return turbo::OkStatus();
+        }
+        if (codes_supported() && lids.size() >= _option.min_train_size) {
+            auto rs = train_quantizer(lids);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        ensure_capacity(*std::max_element(lids.begin(), lids.end()));
+        for (auto lid: lids) {
+            auto rs = reserve(lid);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        turbo::Status status;
+        std::mutex status_mutex;
+        ThreadPool::default_pool().parallel_for(lids.size(), [&](size_t i) {
+            auto rs = add_shared(lids[i]);
+            if (!rs.ok()) {
+                std::lock_guard<std::mutex> lk(status_mutex);
+                status = rs;
+            }
+        });
+        return status;
+    }
+
+    turbo::Status HnswIndex::train_quantizer(const std::vector<uint64_t> &lids) {
+        auto dim = static_cast<size_t>(_store->get_vector_space()->dim);
+        std::vector<uint64_t> sample(lids);
+        if (sample.size() > kTrainSampleSize) {
+            std::mt19937_64 rng(_option.seed);
+            std::shuffle(sample.begin(), sample.end(), rng);
+            sample.resize(kTrainSampleSize);
+        }
+        std::vector<float> data(sample.size() * dim);
+        for (size_t i = 0; i < sample.size(); ++i) {
+            std::memcpy(data.data() + i * dim, _store->vector_at(sample[i]).data(), dim * sizeof(float));
+        }
+        return _sq.train(data.data(), sample.size(), dim);
+    }
+
+    void HnswIndex::encode_node(uint32_t lid) {
+        if (_sq.trained()) {
+            _sq.encode(reinterpret_cast<const float *>(_store->vector_at(lid).data()), block(lid) + _code_offset);
+        }
+    }
+
+    void HnswIndex::ensure_capacity(uint64_t lid) {
+        if (lid < _levels.size()) {
+            return;
+        }
+        auto n = std::max<size_t>(lid + 1, _levels.size() * 2);
+        _level0.resize(n * _node_bytes, 0);
+        _levels.resize(n, -1);
+        _upper.resize(n);
+        _deleted.resize(n, 0);
+        /// no lock is held while the exclusive store lock is.
+        _locks = std::make_unique<SpinLock[]>(n);
+    }
+
+    int HnswIndex::random_level() {
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        auto level = static_cast<int>(-std::log(1.0 - u(_rng)) * _level_mult);
+        return std::min(level, kMaxLevel);
+    }
+
+    template<typename Score>
+    std::vector<HnswIndex::Candidate> HnswIndex::search_layer(const Score &score, uint32_t entry, size_t ef,
+                                                              int level) const {
+        auto &visited = visited_table();
+        visited.reset(_levels.size());
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<> > frontier;
+        std::priority_queue<Candidate> results;
+        visited.visit(entry);
+        Candidate first{score(entry), entry};
+        frontier.push(first);
+        results.push(first);
+        while (!frontier.empty()) {
+            auto c = frontier.top();
+            if (results.size() >= ef && c.score > results.top().score) {
+                break;
+            }
+            frontier.pop();
+            auto *l = links(c.lid, level);
+            auto count = std::min<size_t>(l[0].load(std::memory_order_acquire), max_links(level));
+            for (size_t i = 0; i < count; ++i) {
+                auto n = l[1 + i].load(std::memory_order_relaxed);
+                if (!visited.visit(n)) {
+                    continue;
+                }
+                auto s = score(n);
+                if (results.size() < ef || s < results.top().score) {
+                    frontier.push({s, n});
+                    results.push({s, n});
+                    if (results.size() > ef) {
+                        results.pop();
+                    }
+                }
+            }
+        }
+        std::vector<Candidate> out(results.size());
+        for (auto i = out.size(); i > 0; --i) {
+            out[i - 1] = results.top();
+            results.pop();
+        }
+        return out;
+    }
+
+    void HnswIndex::select_neighbors(std::vector<Candidate> &candidates, size_t m) const {
+        if (candidates.size() <= m) {
+            return;
+        }
+        std::vector<Candidate> selected;
+        selected.reserve(m);
+        for (auto &c: candidates) {
+            if (selected.size() >= m) {
+                break;
+            }
+            bool keep = true;
+            for (auto &s: selected) {
+                if (pair_score(c.lid, s.lid) < c.score) {
+                    keep = false;
+                    break;
+                }
+            }
+            if (keep) {
+                selected.push_back(c);
+            }
+        }
+        candidates.swap(selected);
+    }
+
+    void HnswIndex::set_links(uint32_t lid, int level, const std::vector<Candidate> &neighbors) {
+        auto *l = links(lid, level);
+        auto count = std::min(neighbors.size(), max_links(level));
+        for (size_t i = 0; i < count; ++i) {
+            l[1 + i].store(neighbors[i].lid, std::memory_order_relaxed);
+        }
+        l[0].store(static_cast<uint32_t>(count), std::memory_order_release);
+    }
+
+    void HnswIndex::add_link(uint32_t from, uint32_t to, int level) {
+        std::lock_guard<SpinLock> lk(_locks[from]);
+        auto *l = links(from, level);
+        auto count = l[0].load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (l[1 + i].load(std::memory_order_relaxed) == to) {
+                return;
+            }
+        }
+        if (count < max_links(level)) {
+            l[1 + count].store(to, std::memory_order_relaxed);
+            l[0].store(count + 1, std::memory_order_release);
+            return;
+        }
+        std::vector<Candidate> candidates;
+        candidates.reserve(count + 1);
+        for (uint32_t i = 0; i < count; ++i) {
+            auto n = l[1 + i].load(std::memory_order_relaxed);
+            candidates.push_back({pair_score(from, n), n});
+        }
+        candidates.push_back({pair_score(from, to), to});
+        std::sort(candidates.begin(), candidates.end());
+        select_neighbors(candidates, max_links(level));
+        set_links(from, level, candidates);
+    }
+
+    void HnswIndex::insert(uint32_t lid) {
+        auto q = _store->vector_at(lid);
+        auto score = [this, q](uint32_t other) {
+            return vector_score(q, other);
+        };
+        int level = _levels[lid];
+        auto entry = _entry.load(std::memory_order_acquire);
+        if (entry == kNoEntry && _entry.compare_exchange_strong(entry, pack_entry(lid, level),
+                                                                std::memory_order_acq_rel)) {
+            return;
+        }
+        auto cur = entry_lid(entry);
+        auto top = entry_level(entry);
+        for (int l = top; l > level; --l) {
+            cur = search_layer(score, cur, 1, l).front().lid;
+        }
+        for (int l = std::min(level, top); l >= 0; --l) {
+            auto w = search_layer(score, cur, _option.ef_construction, l);
+            /// removed nodes still route, but get no new links so consolidate() can retire them.
+            w.erase(std::remove_if(w.begin(), w.end(), [this, lid](const Candidate &c) {
+                return c.lid == lid || _deleted[c.lid];
+            }), w.end());
+            if (w.empty()) {
+                continue;
+            }
+            cur = w.front().lid;
+            select_neighbors(w, _option.m);
+            {
+                std::lock_guard<SpinLock> lk(_locks[lid]);
+                set_links(lid, l, w);
+            }
+            for (auto &c: w) {
+                add_link(c.lid, lid, l);
+            }
+        }
+        while (level > entry_level(entry)) {
+            if (_entry.compare_exchange_weak(entry, pack_entry(lid, level), std::memory_order_acq_rel)) {
+                break;
+            }
+        }
+    }
+
+    turbo::Status HnswIndex::reserve(uint64_t lid) {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (lid >= kNoNode) {
+            return turbo::out_of_range_error("lid:", lid, " exceeds hnsw capacity");
+        }
+        ensure_capacity(lid);
+        auto id = static_cast<uint32_t>(lid);
+        if (_levels[id] >= 0) {
+            if (!_deleted[id]) {
+                return turbo::already_exists_error("lid already indexed:", lid);
+            }
+            _deleted[id] = 0;
+            _pending.fetch_sub(1, std::memory_order_relaxed);
+        } else {
+            auto level = random_level();
+            _levels[id] = static_cast<int8_t>(level);
+            links(id, 0)[0].store(0, std::memory_order_relaxed);
+            _upper[id] = level > 0 ? std::make_unique<Link[]>(static_cast<size_t>(level) * (_option.m + 1))
+                                   : nullptr;
+        }
+        auto count = _count.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (!_sq.trained() && codes_supported() && count >= _option.min_train_size) {
+            std::vector<uint64_t> lids;
+            lids.reserve(count);
+            for (uint32_t i = 0; i < _levels.size(); ++i) {
+                if (_levels[i] >= 0 && !_deleted[i]) {
+                    lids.push_back(i);
+                }
+            }
+            auto rs = train_quantizer(lids);
+            if (!rs.ok()) {
+                return rs;
+            }
+            for (uint32_t i = 0; i < _levels.size(); ++i) {
+                if (_levels[i] >= 0) {
+                    encode_node(i);
+                }
+            }
+        } else {
+            /// a lid added again may still be linked, searches under a shared
+            /// lock read its code through those links. encode while no search runs.
+            encode_node(id);
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Status HnswIndex::add_shared(uint64_t lid) {
+        if (lid >= _levels.size() || _levels[lid] < 0) {
+            return turbo::failed_precondition_error("lid not reserved:", lid);
+        }
+        /// the code was written by reserve().
+        insert(static_cast<uint32_t>(lid));
+        return turbo::OkStatus();
+    }
+
+    turbo::Status HnswIndex::add(uint64_t lid) {
+        auto rs = reserve(lid);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return add_shared(lid);
+    }
+
+    turbo::Status HnswIndex::update(uint64_t lid) {
+        if (lid >= _levels.size() || _levels[lid] < 0 || _deleted[lid]) {
+            return add(lid);
+        }
+        /// under the exclusive store lock, no search reads the code being rewritten.
+        auto id = static_cast<uint32_t>(lid);
+        encode_node(id);
+        insert(id);
+        return turbo::OkStatus();
+    }
+
+    turbo::Status HnswIndex::remove(uint64_t lid) {
+        if (lid >= _levels.size() || _levels[lid] < 0 || _deleted[lid]) {
+            return turbo::OkStatus();
+        }
+        _deleted[lid] = 1;
+        _count.fetch_sub(1, std::memory_order_relaxed);
+        _pending.fetch_add(1, std::memory_order_relaxed);
+        return turbo::OkStatus();
+    }
+
+    void HnswIndex::repair_links(uint32_t lid, int level, const std::vector<uint8_t> &batch) {
+        std::lock_guard<SpinLock> lk(_locks[lid]);
+        auto *l = links(lid, level);
+        auto count = std::min<size_t>(l[0].load(std::memory_order_relaxed), max_links(level));
+        bool touched = false;
+        for (size_t i = 0; i < count && !touched; ++i) {
+            touched = batch[l[1 + i].load(std::memory_order_relaxed)];
+        }
+        if (!touched) {
+            return;
+        }
+        std::vector<uint32_t> ids;
+        for (size_t i = 0; i < count; ++i) {
+            auto n = l[1 + i].load(std::memory_order_relaxed);
+            if (!batch[n]) {
+                ids.push_back(n);
+                continue;
+            }
+            /// batch nodes are never rewritten during the pass, their links are stable.
+            auto *dl = links(n, level);
+            auto dcount = std::min<size_t>(dl[0].load(std::memory_order_acquire), max_links(level));
+            for (size_t j = 0; j < dcount; ++j) {
+                auto m = dl[1 + j].load(std::memory_order_relaxed);
+                if (m != lid && !batch[m]) {
+                    ids.push_back(m);
+                }
+            }
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        std::vector<Candidate> candidates;
+        candidates.reserve(ids.size());
+        for (auto n: ids) {
+            candidates.push_back({pair_score(lid, n), n});
+        }
+        std::sort(candidates.begin(), candidates.end());
+        select_neighbors(candidates, max_links(level));
+        set_links(lid, level, candidates);
+    }
+
+    turbo::Result<std::vector<uint64_t> > HnswIndex::consolidate(size_t max_lids) {
+        std::vector<uint64_t> lids;
+        if (_pending.load(std::memory_order_relaxed) == 0) {
+            return lids;
+        }
+        std::vector<uint8_t> batch(_levels.size(), 0);
+        for (uint32_t i = 0; i < _levels.size(); ++i) {
+            if (_levels[i] >= 0 && _deleted[i]) {
+                batch[i] = 1;
+                lids.push_back(i);
+                if (max_lids > 0 && lids.size() >= max_lids) {
+                    break;
+                }
+            }
+        }
+        ThreadPool::default_pool().parallel_for(_levels.size(), [&](size_t i) {
+            if (_levels[i] < 0 || batch[i]) {
+                return;
+            }
+            for (int l = 0; l <= _levels[i]; ++l) {
+                repair_links(static_cast<uint32_t>(i), l, batch);
+            }
+        });
+        return lids;
+    }
+
+    void HnswIndex::purge(const std::vector<uint64_t> &lids) {
+        auto entry = _entry.load(std::memory_order_relaxed);
+        bool entry_purged = false;
+        for (auto lid: lids) {
+            /// re-added between consolidate and purge, it is linked again.
+            if (lid >= _levels.size() || _levels[lid] < 0 || !_deleted[lid]) {
+                continue;
+            }
+            auto id = static_cast<uint32_t>(lid);
+            entry_purged |= entry != kNoEntry && entry_lid(entry) == id;
+            _levels[id] = -1;
+            _deleted[id] = 0;
+            links(id, 0)[0].store(0, std::memory_order_relaxed);
+            _upper[id].reset();
+            _pending.fetch_sub(1, std::memory_order_relaxed);
+        }
+        if (!entry_purged) {
+            return;
+        }
+        /// prefer a live node, a removed one still routes until its own purge.
+        uint64_t best = kNoEntry;
+        for (uint32_t i = 0; i < _levels.size(); ++i) {
+            if (_levels[i] < 0) {
+                continue;
+            }
+            if (best == kNoEntry || (_deleted[entry_lid(best)] && !_deleted[i]) ||
+                (_deleted[entry_lid(best)] == _deleted[i] && _levels[i] > entry_level(best))) {
+                best = pack_entry(i, _levels[i]);
+            }
+        }
+        _entry.store(best, std::memory_order_release);
+    }
+
+    turbo::Result<std::vector<SearchHit> > HnswIndex::search(turbo::span<uint8_t> query,
+                                                            const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        auto *vs = _store->get_vector_space();
+        QueryVector qv(vs);
+        auto rs = qv.assign(query, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto q = qv.span();
+        /// sq8 codes need DT_FLOAT, so a mixed precision space always takes
+        /// the full vector path and scores the float query there.
+        auto mixed = vs->mixed_precision();
+        auto &op = mixed ? vs->query_operation : vs->operation;
+        auto scored = mixed ? qv.query_span() : q;
+        auto entry = _entry.load(std::memory_order_acquire);
+        if (entry == kNoEntry || option.k == 0) {
+            return std::vector<SearchHit>();
+        }
+        auto ef = std::max<size_t>({option.ef, option.k, option.rerank});
+
+        std::vector<Candidate> beam;
+        if (_sq.trained()) {
+            ScalarQuantizer::Query sq;
+            auto *qf = reinterpret_cast<const float *>(q.data());
+            if (_l2_codes) {
+                _sq.prepare_l2(qf, &sq);
+            } else {
+                _sq.prepare_ip(qf, &sq);
+            }
+            auto score = [this, &sq](uint32_t lid) {
+                return _l2_codes ? _sq.l2_sqr(sq, code(lid)) : -_sq.inner_product(sq, code(lid));
+            };
+            auto cur = entry_lid(entry);
+            for (int l = entry_level(entry); l > 0; --l) {
+                cur = search_layer(score, cur, 1, l).front().lid;
+            }
+            beam = search_layer(score, cur, ef, 0);
+            if (option.rerank > 0 && beam.size() > std::max<size_t>(option.rerank, option.k)) {
+                beam.resize(std::max<size_t>(option.rerank, option.k));
+            }
+        } else {
+            auto score = [this, &op, scored](uint32_t lid) {
+                return op.rank(scored, _store->vector_at(lid));
+            };
+            auto cur = entry_lid(entry);
+            for (int l = entry_level(entry); l > 0; --l) {
+                cur = search_layer(score, cur, 1, l).front().lid;
+            }
+            beam = search_layer(score, cur, ef, 0);
+        }
+
+        auto &entities = _store->id_manager()->ids();
+        TopKCollector collector(option.k);
+        for (auto &c: beam) {
+            if (_deleted[c.lid] || entities[c.lid].status == kTombstone) {
+                continue;
+            }
+            if (option.filter && !option.filter(entities[c.lid].label)) {
+                continue;
+            }
+            collector.push(_sq.trained() ? op.rank(scored, _store->vector_at(c.lid)) : c.score, c.lid);
+        }
+        return ranked_hits(_store, collector.finish(), op);
+    }
+} // namespace xann
@@ -0,0 +1,240 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+#include <xann/common/spin_lock.h>
+#include <xann/core/vector_space.h>
+#include <xann/index/vector_index.h>
+#include <xann/quantization/scalar_quantizer.h>
+
+namespace xann {
+
+    struct HnswOption {
+        /// links per node on upper levels, level 0 keeps 2 * m.
+        uint32_t m{16};
+        uint32_t ef_construction{200};
+        uint64_t seed{100};
+        /// traverse with sq8 codes kept beside the level 0 links, then rerank
+        /// against the store. DT_FLOAT with l2, ip or normalized metrics only.
+        bool quantized{true};
+        /// codes are trained once this many vectors are indexed, full vectors are used before.
+        uint32_t min_train_size{1024};
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Hierarchical navigable small world graph over the store lids.
+    ///
+    /// @details  Level 0 is one flat array of fixed size node blocks indexed by
+    ///           lid: the link count, 2 * m links and, when quantized, the sq8
+    ///           code of the node. Expanding a node and scoring it are served
+    ///           by the same contiguous block, so a hop costs one block fetch
+    ///           instead of a link list plus a full vector from the store.
+    ///           Candidates left in the ef beam are reranked with the space
+    ///           operator on the full vectors. Removed lids stay in the graph
+    ///           as routing nodes and are skipped in results; adding the lid
+    ///           again relinks it in place.
+    ///
+    ///           Inserts are concurrent: reserve() sizes the arrays, draws
+    ///           the level and writes the sq8 code under the exclusive store
+    ///           lock, add_shared() links the node under a shared one, so a
+    ///           lid added again while still linked never has its code
+    ///           rewritten under a reader. Link lists are arrays of atomics
+    ///           guarded by a per node spin lock for writers, searches read
+    ///           them without locks and tolerate a list that is being
+    ///           rewritten. The entry point and top level are one atomic word
+    ///           raised by compare and swap. build() links in parallel on the
+    ///           default pool.
+    ///
+    ///           Deletes are repaired in batches: consolidate() rewires every
+    ///           node linking to a removed one through that node's own links
+    ///           (FreshDiskANN style) and purge() then drops the removed nodes
+    ///           so their lids can be freed in the store.
+    ///
+    class HnswIndex : public VectorIndex {
+    public:
+        static constexpr uint32_t kNoNode = std::numeric_limits<uint32_t>::max();
+        static constexpr int kMaxLevel = 16;
+
+        explicit HnswIndex(HnswOption option = {});
+
+        [[nodiscard]] std::string_view name() const override {
+            return "hnsw";
+        }
+
+        turbo::Status build(const MemStore *store) override;
+
+        turbo::Status add(uint64_t lid) override;
+
+        turbo::Status update(uint64_t lid) override;
+
+        turbo::Status remove(uint64_t lid) override;
+
+        [[nodiscard]] bool concurrent_add() const override {
+            return true;
+        }
+
+        turbo::Status reserve(uint64_t lid) override;
+
+        turbo::Status add_shared(uint64_t lid) override;
+
+        [[nodiscard]] uint64_t pending_deletes() const override {
+            return _pending.load(std::memory_order_relaxed);
+        }
+
+        turbo::Result<std::vector<uint64_t> > consolidate(size_t max_lids) override;
+
+        void purge(const std::vector<uint64_t> &lids) override;
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const override;
+
+        [[nodiscard]] uint64_t size() const override {
+            return _count.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] SearchKnob search_knob() const override {
+            return SearchKnob::kEf;
+        }
+
+        /// true once traversal runs on codes.
+        [[nodiscard]] bool quantized() const {
+            return _sq.trained();
+        }
+
+        /// bytes of one level 0 block, links and code.
+        [[nodiscard]] size_t node_bytes() const {
+            return _node_bytes;
+        }
+
+        [[nodiscard]] int max_level() const {
+            return entry_level(_entry.load(std::memory_order_acquire));
+        }
+
+    private:
+        struct Candidate {
+            float score;
+            uint32_t lid;
+
+            bool operator<(const Candidate &other) const {
+                return score < other.score;
+            }
+
+            bool operator>(const Candidate &other) const {
+                return score > other.score;
+            }
+        };
+
+        using Link = std::atomic<uint32_t>;
+
+        static constexpr uint64_t kNoEntry = std::numeric_limits<uint64_t>::max();
+
+        static uint64_t pack_entry(uint32_t lid, int level) {
+            return (static_cast<uint64_t>(level) << 32) | lid;
+        }
+
+        static uint32_t entry_lid(uint64_t entry) {
+            return static_cast<uint32_t>(entry);
+        }
+
+        static int entry_level(uint64_t entry) {
+            return entry == kNoEntry ? -1 : static_cast<int>(entry >> 32);
+        }
+
+        [[nodiscard]] uint8_t *block(uint32_t lid) const {
+            return const_cast<uint8_t *>(_level0.data()) + static_cast<size_t>(lid) * _node_bytes;
+        }
+
+        /// [count, links...] of lid at level, count is published last.
+        [[nodiscard]] Link *links(uint32_t lid, int level) const {
+            if (level == 0) {
+                return reinterpret_cast<Link *>(block(lid));
+            }
+            return _upper[lid].get() + static_cast<size_t>(level - 1) * (_option.m + 1);
+        }
+
+        [[nodiscard]] size_t max_links(int level) const {
+            return level == 0 ? _m0 : _option.m;
+        }
+
+        [[nodiscard]] const uint8_t *code(uint32_t lid) const {
+            return block(lid) + _code_offset;
+        }
+
+        [[nodiscard]] bool codes_supported() const;
+
+        [[nodiscard]] float vector_score(turbo::span<uint8_t> q, uint32_t lid) const;
+
+        [[nodiscard]] float pair_score(uint32_t a, uint32_t b) const {
+            return vector_score(_store->vector_at(a), b);
+        }
+
+        template<typename Score>
+        std::vector<Candidate> search_layer(const Score &score, uint32_t entry, size_t ef, int level) const;
+
+        /// keep at most m candidates that are closer to the base than to any kept one.
+        void select_neighbors(std::vector<Candidate> &candidates, size_t m) const;
+
+        /// caller holds the node lock of lid.
+        void set_links(uint32_t lid, int level, const std::vector<Candidate> &neighbors);
+
+        void add_link(uint32_t from, uint32_t to, int level);
+
+        /// replace the links of lid into batch by the batch nodes' own links.
+        void repair_links(uint32_t lid, int level, const std::vector<uint8_t> &batch);
+
+        void ensure_capacity(uint64_t lid);
+
+        int random_level();
+
+        void insert(uint32_t lid);
+
+        turbo::Status train_quantizer(const std::vector<uint64_t> &lids);
+
+        void encode_node(uint32_t lid);
+
+    private:
+        HnswOption _option;
+        size_t _m0{0};
+        double _level_mult{0.0};
+        std::mt19937_64 _rng;
+        ScalarQuantizer _sq;
+        /// l2 codes for l2 metrics, inner product codes for the rest.
+        bool _l2_codes{true};
+        size_t _code_offset{0};
+        size_t _node_bytes{0};
+        /// the arrays below are resized only under the exclusive store lock.
+        AlignedBytes _level0;
+        /// -1 for lids not in the graph.
+        std::vector<int8_t> _levels;
+        /// levels 1.._levels[lid] of lid, m + 1 links each.
+        std::vector<std::unique_ptr<Link[]> > _upper;
+        std::vector<uint8_t> _deleted;
+        std::unique_ptr<SpinLock[]> _locks;
+        std::atomic<uint64_t> _entry{kNoEntry};
+        std::atomic<uint64_t> _count{0};
+        /// removed nodes still in the graph.
+        std::atomic<uint64_t> _pending{0};
+    };
+} // namespace xann
@@ -0,0 +1,476 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/ivf_flat_index.h>
+#include <xann/common/kmeans.h>
+#include <xann/common/thread_pool.h>
+#include <xann/core/query_vector.h>
+#include <xann/distance/typed_space.h>
+#include <xann/index/flat_index.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace xann {
+
+    IvfFlatIndex::IvfFlatIndex(IvfOption option) : _option(option) {
+    }
+
+    uint32_t IvfFlatIndex::auto_nlist(uint64_t n) {
+        auto nlist = static_cast<uint64_t>(4.0 * std::sqrt(static_cast<double>(n)));
+        return static_cast<uint32_t>(std::clamp<uint64_t>(nlist, 1, 65536));
+    }
+
+    turbo::Status IvfFlatIndex::build(const MemStore *store) {
+        _store = store;
+        _nlist = 0;
+        _centroids.clear();
+        _lists.assign(1, {});
+        _list_of.clear();
+        _pos_of.clear();
+        _count = 0;
+        _dead = 0;
+        _l2_codes = store->get_vector_space()->metric == kL2 || store->get_vector_space()->metric == kNormalizedL2;
+        _rq = ResidualQuantizer();
+        _codes.clear();
+        _code_terms.clear();
+
+        auto lids = store->live_local_ids();
+        if (lids.size() >= _option.min_train_size && store->get_vector_space()->data_type == DataType::DT_FLOAT) {
+            auto rs = train(lids);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        std::vector<uint32_t> lists(lids.size(), pending_list());
+        if (trained()) {
+            ThreadPool::default_pool().parallel_for(lids.size(), [&](size_t i) {
+                lists[i] = nearest_list(store->vector_at(lids[i]));
+            });
+        }
+        for (size_t i = 0; i < lids.size(); ++i) {
+            insert_lid(lists[i], lids[i]);
+        }
+        encode_lids(lids);
+        return turbo::OkStatus();
+    }
+
+    turbo::Status IvfFlatIndex::train(const std::vector<uint64_t> &lids) {
+        auto *vs = _store->get_vector_space();
+        auto nlist = _option.nlist ? _option.nlist : auto_nlist(lids.size());
+        nlist = static_cast<uint32_t>(std::min<uint64_t>(nlist, lids.size()));
+        auto sample_size = std::min<size_t>(lids.size(), static_cast<size_t>(nlist) * _option.max_points_per_centroid);
+        std::vector<uint64_t> sample(lids);
+        if (sample_size < sample.size()) {
+            std::mt19937_64 rng(lids.size());
+            std::shuffle(sample.begin(), sample.end(), rng);
+            sample.resize(sample_size);
+        }
+        auto dim = static_cast<size_t>(vs->dim);
+        std::vector<float> data(sample.size() * dim);
+        for (size_t i = 0; i < sample.size(); ++i) {
+            std::memcpy(data.data() + i * dim, _store->vector_at(sample[i]).data(), dim * sizeof(float));
+        }
+        KMeansOption ko;
+        ko.k = nlist;
+        ko.iterations = _option.train_iterations;
+        ko.spherical = spherical();
+        std::vector<float> centroids;
+        std::vector<uint32_t> assign;
+        auto rs = kmeans_train(data.data(), sample.size(), dim, ko, &centroids, &assign);
+        if (!rs.ok()) {
+            return rs;
+        }
+        if (residual_supported()) {
+            rs = train_residuals(data, centroids, assign);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        _nlist = nlist;
+        _centroids.assign(static_cast<size_t>(nlist) * vs->vector_byte_size, 0);
+        for (uint32_t c = 0; c < nlist; ++c) {
+            std::memcpy(centroid(c).data(), centroids.data() + c * dim, dim * sizeof(float));
+        }
+        _lists.assign(nlist + 1, {});
+        return turbo::OkStatus();
+    }
+
+    bool IvfFlatIndex::spherical() const {
+        auto *vs = _store->get_vector_space();
+        return vs->need_normalize_vector || is_similarity_metric(vs->metric) || vs->metric == kAngle;
+    }
+
+    bool IvfFlatIndex::residual_supported() const {
+        if (!_option.residual_codes) {
+            return false;
+        }
+        switch (_store->get_vector_space()->metric) {
+            case kL2:
+            case kNormalizedL2:
+            case kIP:
+            case kNormalizedCosine:
+            case kNormalizedAngle:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    turbo::Status IvfFlatIndex::train_residuals(const std::vector<float> &data, const std::vector<float> &centroids,
+                                                const std::vector<uint32_t> &assign) {
+        auto dim = static_cast<size_t>(_store->get_vector_space()->dim);
+        std::vector<float> residuals(data.size());
+        for (size_t i = 0; i < assign.size(); ++i) {
+            auto *c = centroids.data() + assign[i] * dim;
+            for (size_t d = 0; d < dim; ++d) {
+                residuals[i * dim + d] = data[i * dim + d] - c[d];
+            }
+        }
+        return _rq.train(residuals.data(), assign.size(), dim, _option.rq);
+    }
+
+    void IvfFlatIndex::encode_lids(const std::vector<uint64_t> &lids) {
+        if (!_rq.trained() || lids.empty()) {
+            return;
+        }
+        auto dim = static_cast<size_t>(_store->get_vector_space()->dim);
+        auto code_size = _rq.code_size();
+        auto max_lid = *std::max_element(lids.begin(), lids.end());
+        if (_codes.size() < (max_lid + 1) * code_size) {
+            _codes.resize(std::max(_list_of.size(), max_lid + 1) * code_size, 0);
+            _code_terms.resize(std::max(_list_of.size(), max_lid + 1), 0.0f);
+        }
+        ThreadPool::default_pool().parallel_for(lids.size(), [&](size_t i) {
+            auto lid = lids[i];
+            auto list = _list_of[lid];
+            if (list >= _nlist) {
+                return;
+            }
+            auto *x = reinterpret_cast<const float *>(_store->vector_at(lid).data());
+            auto *c = reinterpret_cast<const float *>(centroid(list).data());
+            std::vector<float> r(dim);
+            for (size_t d = 0; d < dim; ++d) {
+                r[d] = x[d] - c[d];
+            }
+            auto *code = _codes.data() + lid * code_size;
+            _rq.encode(r.data(), code);
+            _rq.decode(code, r.data());
+            float term = 0.0f;
+            for (size_t d = 0; d < dim; ++d) {
+                term += r[d] * r[d] + 2.0f * c[d] * r[d];
+            }
+            _code_terms[lid] = term;
+        });
+    }
+
+    uint32_t IvfFlatIndex::nearest_list(turbo::span<uint8_t> v) const {
+        auto *vs = _store->get_vector_space();
+        uint32_t best = 0;
+        float best_score = std::numeric_limits<float>::infinity();
+        for (uint32_t c = 0; c < _nlist; ++c) {
+            auto score = vs->operation.rank(v, centroid(c));
+            if (score < best_score) {
+                best_score = score;
+                best = c;
+            }
+        }
+        return best;
+    }
+
+    void IvfFlatIndex::insert_lid(uint32_t list, uint64_t lid) {
+        if (lid >= _list_of.size()) {
+            _list_of.resize(lid + 1, kNoList);
+            _pos_of.resize(lid + 1, 0);
+        }
+        auto &pl = _lists[list];
+        _list_of[lid] = list;
+        _pos_of[lid] = static_cast<uint32_t>(pl.lids.size());
+        if ((pl.lids.size() & 63) == 0) {
+            pl.dead.push_back(0);
+        }
+        pl.lids.push_back(lid);
+        ++pl.live;
+        ++_count;
+    }
+
+    void IvfFlatIndex::relabel(uint32_t list) {
+        auto &pl = _lists[list];
+        for (size_t i = 0; i < pl.lids.size(); ++i) {
+            if (!pl.is_dead(i)) {
+                _list_of[pl.lids[i]] = list;
+                _pos_of[pl.lids[i]] = static_cast<uint32_t>(i);
+            }
+        }
+    }
+
+    void IvfFlatIndex::compact_list(uint32_t list) {
+        auto &pl = _lists[list];
+        if (pl.dead_count() == 0) {
+            return;
+        }
+        std::vector<uint64_t> lids;
+        lids.reserve(pl.live);
+        for (size_t i = 0; i < pl.lids.size(); ++i) {
+            if (!pl.is_dead(i)) {
+                lids.push_back(pl.lids[i]);
+            }
+        }
+        _dead -= pl.dead_count();
+        pl.lids = std::move(lids);
+        pl.dead.assign((pl.lids.size() + 63) / 64, 0);
+        relabel(list);
+    }
+
+    size_t IvfFlatIndex::split_threshold() const {
+        auto mean = static_cast<double>(_count) / std::max<uint32_t>(_nlist, 1);
+        return std::max<size_t>(_option.min_list_size, static_cast<size_t>(_option.split_ratio * mean));
+    }
+
+    turbo::Status IvfFlatIndex::split_list(uint32_t list) {
+        compact_list(list);
+        auto *vs = _store->get_vector_space();
+        auto dim = static_cast<size_t>(vs->dim);
+        auto lids = _lists[list].lids;
+        std::vector<float> data(lids.size() * dim);
+        for (size_t i = 0; i < lids.size(); ++i) {
+            std::memcpy(data.data() + i * dim, _store->vector_at(lids[i]).data(), dim * sizeof(float));
+        }
+        KMeansOption ko;
+        ko.k = 2;
+        ko.iterations = _option.train_iterations;
+        ko.seed = lids.size();
+        ko.spherical = spherical();
+        std::vector<float> centroids;
+        std::vector<uint32_t> assign;
+        auto rs = kmeans_train(data.data(), lids.size(), dim, ko, &centroids, &assign);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto moved = static_cast<size_t>(std::count(assign.begin(), assign.end(), 1u));
+        if (moved == 0 || moved == lids.size()) {
+            return turbo::OkStatus();
+        }
+        /// the new list goes before the pending list.
+        auto added = _nlist++;
+        _centroids.resize(static_cast<size_t>(_nlist) * vs->vector_byte_size, 0);
+        std::memcpy(centroid(list).data(), centroids.data(), dim * sizeof(float));
+        std::memcpy(centroid(added).data(), centroids.data() + dim, dim * sizeof(float));
+        _lists.insert(_lists.begin() + added, PostingList());
+        relabel(pending_list());
+        _lists[list] = PostingList();
+        _count -= lids.size();
+        for (size_t i = 0; i < lids.size(); ++i) {
+            insert_lid(assign[i] == 0 ? list : added, lids[i]);
+        }
+        encode_lids(lids);
+        return turbo::OkStatus();
+    }
+
+    void IvfFlatIndex::merge_list(uint32_t list) {
+        auto &pl = _lists[list];
+        std::vector<uint64_t> lids;
+        lids.reserve(pl.live);
+        for (size_t i = 0; i < pl.lids.size(); ++i) {
+            if (!pl.is_dead(i)) {
+                lids.push_back(pl.lids[i]);
+            }
+        }
+        _dead -= pl.dead_count();
+        auto last = _nlist - 1;
+        if (list != last) {
+            _lists[list] = std::move(_lists[last]);
+            std::memcpy(centroid(list).data(), centroid(last).data(), centroid(last).size());
+            relabel(list);
+        }
+        _lists.erase(_lists.begin() + last);
+        --_nlist;
+        _centroids.resize(static_cast<size_t>(_nlist) * _store->get_vector_space()->vector_byte_size);
+        relabel(pending_list());
+        _count -= lids.size();
+        for (auto lid: lids) {
+            insert_lid(nearest_list(_store->vector_at(lid)), lid);
+        }
+        encode_lids(lids);
+    }
+
+    turbo::Status IvfFlatIndex::add(uint64_t lid) {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (lid < _list_of.size() && _list_of[lid] != kNoList) {
+            return turbo::already_exists_error("lid already indexed:", lid);
+        }
+        auto list = trained() ? nearest_list(_store->vector_at(lid)) : pending_list();
+        insert_lid(list, lid);
+        encode_lids({lid});
+        if (!trained() && _count >= _option.min_train_size &&
+            _store->get_vector_space()->data_type == DataType::DT_FLOAT) {
+            return build(_store);
+        }
+        if (trained() && _option.split_ratio > 0 && _lists[list].live > split_threshold()) {
+            return split_list(list);
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Status IvfFlatIndex::remove(uint64_t lid) {
+        if (lid >= _list_of.size() || _list_of[lid] == kNoList) {
+            return turbo::OkStatus();
+        }
+        auto list = _list_of[lid];
+        auto &pl = _lists[list];
+        auto pos = _pos_of[lid];
+        pl.dead[pos >> 6] |= uint64_t(1) << (pos & 63);
+        --pl.live;
+        _list_of[lid] = kNoList;
+        --_count;
+        ++_dead;
+        if (pl.lids.size() > _option.min_list_size &&
+            static_cast<double>(pl.dead_count()) > _option.compact_dead_ratio * static_cast<double>(pl.lids.size())) {
+            compact_list(list);
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Status IvfFlatIndex::maintain() {
+        if (!_store) {
+            return turbo::OkStatus();
+        }
+        for (uint32_t l = 0; l < _lists.size(); ++l) {
+            compact_list(l);
+        }
+        if (!trained()) {
+            return turbo::OkStatus();
+        }
+        auto merge_below = static_cast<size_t>(_option.merge_ratio * static_cast<double>(_count) / _nlist);
+        for (auto l = _nlist; l-- > 0 && _nlist > 1;) {
+            /// the list moved into slot l was visited already.
+            if (_lists[l].live < merge_below) {
+                merge_list(l);
+            }
+        }
+        if (_option.split_ratio <= 0) {
+            return turbo::OkStatus();
+        }
+        auto threshold = split_threshold();
+        for (uint32_t l = 0; l < _nlist; ++l) {
+            if (_lists[l].live > threshold) {
+                auto rs = split_list(l);
+                if (!rs.ok()) {
+                    return rs;
+                }
+            }
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Result<std::vector<SearchHit> > IvfFlatIndex::search(turbo::span<uint8_t> query,
+                                                               const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        auto *vs = _store->get_vector_space();
+        QueryVector qv(vs);
+        auto rs = qv.assign(query, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto q = qv.span();
+        /// a mixed precision space never trains (DT_FLOAT only), every list
+        /// scan scores the float query through query_operation.
+        auto mixed = vs->mixed_precision();
+        auto scored = mixed ? qv.query_span() : q;
+
+        std::vector<uint32_t> probes;
+        if (trained()) {
+            std::vector<std::pair<float, uint32_t> > routes(_nlist);
+            for (uint32_t c = 0; c < _nlist; ++c) {
+                routes[c] = {vs->operation.rank(q, centroid(c)), c};
+            }
+            auto nprobe = std::min<size_t>(std::max<uint32_t>(option.nprobe, 1), _nlist);
+            std::partial_sort(routes.begin(), routes.begin() + nprobe, routes.end());
+            for (size_t i = 0; i < nprobe; ++i) {
+                probes.push_back(routes[i].second);
+            }
+        }
+        probes.push_back(pending_list());
+
+        auto &entities = _store->id_manager()->ids();
+        auto dim = static_cast<size_t>(vs->dim);
+        auto *qf = reinterpret_cast<const float *>(q.data());
+        std::vector<float> table;
+        if (_rq.trained()) {
+            table.resize(_rq.m() * _rq.ksub());
+            _rq.compute_ip_table(qf, table.data());
+        }
+        auto code_size = _rq.code_size();
+        TopKCollector collector(option.k);
+        TopKCollector candidates(_rq.trained() ? std::max<size_t>(option.k, option.rerank) : 0);
+        /// the probe loop is instantiated over the TypedSpace of vs when there
+        /// is one, so the exact kernel inlines into it.
+        auto scan = [&](auto rank) {
+            for (auto list: probes) {
+                auto &pl = _lists[list];
+                auto coded = _rq.trained() && list != pending_list();
+                /// |q - c|^2 for l2 codes, q . c for inner product ones.
+                float base = 0.0f;
+                if (coded) {
+                    auto *c = reinterpret_cast<const float *>(centroid(list).data());
+                    if (_l2_codes) {
+                        base = l2_sqr(qf, c, dim);
+                    } else {
+                        for (size_t d = 0; d < dim; ++d) {
+                            base += qf[d] * c[d];
+                        }
+                    }
+                }
+                for (size_t i = 0; i < pl.lids.size(); ++i) {
+                    auto lid = pl.lids[i];
+                    if (pl.is_dead(i) || entities[lid].status == kTombstone) {
+                        continue;
+                    }
+                    if (option.filter && !option.filter(entities[lid].label)) {
+                        continue;
+                    }
+                    if (coded) {
+                        auto ip = _rq.table_sum(table.data(), _codes.data() + lid * code_size);
+                        candidates.push(_l2_codes ? base - 2.0f * ip + _code_terms[lid] : -(base + ip), lid);
+                        continue;
+                    }
+                    collector.push(rank(scored, _store->vector_at(lid)), lid);
+                }
+            }
+            for (auto &e: candidates.finish()) {
+                collector.push(rank(scored, _store->vector_at(e.lid)), e.lid);
+            }
+        };
+        auto typed = !mixed && dispatch_typed_space(vs, [&](auto space) {
+            using Space = decltype(space);
+            scan([](const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) { return Space::rank(a, b); });
+        });
+        auto &op = mixed ? vs->query_operation : vs->operation;
+        if (!typed) {
+            scan([&op](const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+                return op.rank(a, b);
+            });
+        }
+        return ranked_hits(_store, collector.finish(), op);
+    }
+} // namespace xann
@@ -0,0 +1,199 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <limits>
+#include <vector>
+#include <xann/core/vector_space.h>
+#include <xann/index/vector_index.h>
+#include <xann/quantization/residual_quantizer.h>
+
+namespace xann {
+
+    struct IvfOption {
+        /// 0 means auto_nlist(size) at build time.
+        uint32_t nlist{0};
+        uint32_t train_iterations{10};
+        /// training sample is capped to nlist * max_points_per_centroid.
+        uint32_t max_points_per_centroid{256};
+        /// below this many vectors the index stays untrained and scans everything.
+        uint32_t min_train_size{1024};
+        /// a posting list is rewritten once this share of its entries is removed.
+        float compact_dead_ratio{0.25f};
+        /// a list holding more than split_ratio * the mean live list size is
+        /// split in two with 2-means, 0 disables splitting.
+        float split_ratio{4.0f};
+        /// maintain() folds lists under merge_ratio * the mean into their neighbours.
+        float merge_ratio{0.1f};
+        /// lists at or below this size are not split, nor compacted on remove.
+        uint32_t min_list_size{64};
+        /// keep a residual quantized code of vector - centroid per lid, scan
+        /// the codes and rerank max(k, rerank) with full vectors.
+        bool residual_codes{false};
+        RqOption rq;
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Inverted file over k-means centroids, posting lists keep lids.
+    ///
+    /// @details  Centroids are trained with l2 k-means (spherical for angular
+    ///           and inner product metrics) and stored in the store slot layout,
+    ///           so routing uses the space operator like the final scan does.
+    ///           Until min_train_size vectors are present everything lives in a
+    ///           pending list that every query scans, training happens on the
+    ///           next build() or once the pending list is large enough.
+    ///           Training needs DT_FLOAT vectors.
+    ///           Posting lists are append only, remove sets a bit in the list
+    ///           tombstone bitmap and a list is compacted once its dead ratio
+    ///           passes compact_dead_ratio. Lists that outgrow split_ratio are
+    ///           split on insert and maintain() merges lists that drained, so
+    ///           the scan per probe stays bounded as the data drifts without
+    ///           retraining the other centroids.
+    ///           With residual_codes the offsets from the list centroid are
+    ///           residual quantized, trained with the centroids and re-encoded
+    ///           whenever a split or merge moves an entry. One q . c table per
+    ///           query scores every probed list: |q - c - r|^2 is |q - c|^2 -
+    ///           2 q . r + (|r|^2 + 2 c . r), the last term is kept per lid.
+    ///           Residual codes need an l2 or inner product family metric.
+    ///
+    class IvfFlatIndex : public VectorIndex {
+    public:
+        static constexpr uint32_t kNoList = std::numeric_limits<uint32_t>::max();
+
+        explicit IvfFlatIndex(IvfOption option = {});
+
+        [[nodiscard]] std::string_view name() const override {
+            return _option.residual_codes ? "ivf_rq" : "ivf_flat";
+        }
+
+        turbo::Status build(const MemStore *store) override;
+
+        turbo::Status add(uint64_t lid) override;
+
+        turbo::Status remove(uint64_t lid) override;
+
+        /// compact every list with removed entries, merge drained lists and split oversized ones.
+        turbo::Status maintain() override;
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const override;
+
+        [[nodiscard]] uint64_t size() const override {
+            return _count;
+        }
+
+        [[nodiscard]] SearchKnob search_knob() const override {
+            return SearchKnob::kNprobe;
+        }
+
+        [[nodiscard]] bool trained() const {
+            return _nlist > 0;
+        }
+
+        [[nodiscard]] uint32_t nlist() const {
+            return _nlist;
+        }
+
+        [[nodiscard]] const ResidualQuantizer &residual_quantizer() const {
+            return _rq;
+        }
+
+        /// removed entries still held in posting lists.
+        [[nodiscard]] uint64_t dead_entries() const {
+            return _dead;
+        }
+
+        /// 4 * sqrt(n), clamped to [1, 65536].
+        static uint32_t auto_nlist(uint64_t n);
+
+    private:
+        struct PostingList {
+            std::vector<uint64_t> lids;
+            /// one bit per position, set once the lid there was removed.
+            std::vector<uint64_t> dead;
+            uint32_t live{0};
+
+            [[nodiscard]] bool is_dead(size_t pos) const {
+                return (dead[pos >> 6] >> (pos & 63)) & 1;
+            }
+
+            [[nodiscard]] size_t dead_count() const {
+                return lids.size() - live;
+            }
+        };
+
+        turbo::Status train(const std::vector<uint64_t> &lids);
+
+        [[nodiscard]] bool spherical() const;
+
+        [[nodiscard]] bool residual_supported() const;
+
+        turbo::Status train_residuals(const std::vector<float> &data, const std::vector<float> &centroids,
+                                      const std::vector<uint32_t> &assign);
+
+        /// code lids against their current list centroid, on the thread pool.
+        void encode_lids(const std::vector<uint64_t> &lids);
+
+        [[nodiscard]] uint32_t nearest_list(turbo::span<uint8_t> v) const;
+
+        [[nodiscard]] turbo::span<uint8_t> centroid(uint32_t list) const {
+            auto bytes = static_cast<size_t>(_store->get_vector_space()->vector_byte_size);
+            return turbo::span<uint8_t>(const_cast<uint8_t *>(_centroids.data()) + list * bytes, bytes);
+        }
+
+        void insert_lid(uint32_t list, uint64_t lid);
+
+        /// point _list_of and _pos_of of every live entry at list.
+        void relabel(uint32_t list);
+
+        /// drop the removed entries of list.
+        void compact_list(uint32_t list);
+
+        [[nodiscard]] size_t split_threshold() const;
+
+        /// 2-means over the live entries, the second half becomes a new list.
+        turbo::Status split_list(uint32_t list);
+
+        /// move the entries of list to their nearest other list and drop it,
+        /// the last trained list takes its slot.
+        void merge_list(uint32_t list);
+
+        /// the pending list sits after the trained lists.
+        [[nodiscard]] uint32_t pending_list() const {
+            return _nlist;
+        }
+
+    private:
+        IvfOption _option;
+        uint32_t _nlist{0};
+        AlignedBytes _centroids;
+        std::vector<PostingList> _lists;
+        /// per lid list and position, kNoList when not indexed.
+        std::vector<uint32_t> _list_of;
+        std::vector<uint32_t> _pos_of;
+        uint64_t _count{0};
+        uint64_t _dead{0};
+        bool _l2_codes{true};
+        ResidualQuantizer _rq;
+        /// code_size bytes per lid, and |r|^2 + 2 c . r (l2) per lid.
+        std::vector<uint8_t> _codes;
+        std::vector<float> _code_terms;
+    };
+} // namespace xann
@@ -0,0 +1,338 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/kd_tree_index.h>
+#include <xann/common/thread_pool.h>
+#include <xann/core/query_vector.h>
+#include <xann/distance/typed_space.h>
+#include <xann/index/flat_index.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace xann {
+
+    /// box bounds are computed in float like the kernels, keep a margin so
+    /// rounding never prunes a subtree holding a true neighbor.
+    static constexpr float kBoundSlack = 1e-5f;
+
+    KdTreeIndex::KdTreeIndex(KdTreeOption option) : _option(option) {
+        _option.leaf_size = std::max<uint32_t>(_option.leaf_size, 1);
+    }
+
+    bool KdTreeIndex::tree_supported() const {
+        auto *vs = _store->get_vector_space();
+        if (vs->data_type != DataType::DT_FLOAT) {
+            return false;
+        }
+        switch (vs->metric) {
+            case kL1:
+            case kL2:
+            case kIP:
+            case kNormalizedL2:
+            case kNormalizedCosine:
+            case kNormalizedAngle:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void KdTreeIndex::set_state(uint64_t lid, LidState state) {
+        if (lid >= _state.size()) {
+            _state.resize(lid + 1, kAbsent);
+        }
+        _state[lid] = state;
+    }
+
+    turbo::Status KdTreeIndex::build(const MemStore *store) {
+        if (store->get_vector_space()->mixed_precision()) {
+            return turbo::invalid_argument_error("kd tree index does not score float queries of a mixed precision space");
+        }
+        _store = store;
+        _state.clear();
+        _buffer.clear();
+        auto lids = store->live_local_ids();
+        for (auto lid: lids) {
+            set_state(lid, kInTree);
+        }
+        _count = lids.size();
+        rebuild();
+        return turbo::OkStatus();
+    }
+
+    void KdTreeIndex::rebuild() {
+        _nodes.clear();
+        _lo.clear();
+        _hi.clear();
+        _leaf_vectors.clear();
+        _tree_lids.clear();
+        _buffer.clear();
+        _holes = 0;
+        _first_leaf = 0;
+        if (!tree_supported()) {
+            return;
+        }
+        for (uint64_t lid = 0; lid < _state.size(); ++lid) {
+            if (_state[lid] != kAbsent) {
+                _state[lid] = kInTree;
+                _tree_lids.push_back(lid);
+            }
+        }
+        if (_tree_lids.empty()) {
+            return;
+        }
+
+        auto *vs = _store->get_vector_space();
+        auto dim = static_cast<size_t>(vs->dim);
+        auto stride = static_cast<size_t>(vs->vector_byte_size);
+        auto n = _tree_lids.size();
+        size_t levels = 0;
+        while ((size_t(1) << levels) * _option.leaf_size < n) {
+            ++levels;
+        }
+        auto leaves = size_t(1) << levels;
+        _nodes.resize(2 * leaves - 1);
+        _first_leaf = leaves - 1;
+        _nodes[0] = {0, static_cast<uint32_t>(n)};
+        auto vec = [this](uint64_t lid) {
+            return reinterpret_cast<const float *>(_store->vector_at(lid).data());
+        };
+
+        /// top down, each level splits all of its nodes at the median of
+        /// their widest coordinate, the nodes of a level own disjoint ranges.
+        auto &pool = ThreadPool::default_pool();
+        for (size_t level = 0; level < levels; ++level) {
+            auto first = (size_t(1) << level) - 1;
+            pool.parallel_for(size_t(1) << level, [&](size_t i) {
+                auto node = first + i;
+                auto begin = _nodes[node].begin;
+                auto end = _nodes[node].end;
+                auto mid = begin + (end - begin) / 2;
+                _nodes[2 * node + 1] = {begin, mid};
+                _nodes[2 * node + 2] = {mid, end};
+                if (end - begin < 2) {
+                    return;
+                }
+                std::vector<float> lo(dim, std::numeric_limits<float>::infinity());
+                std::vector<float> hi(dim, -std::numeric_limits<float>::infinity());
+                for (auto j = begin; j < end; ++j) {
+                    auto *v = vec(_tree_lids[j]);
+                    for (size_t d = 0; d < dim; ++d) {
+                        lo[d] = std::min(lo[d], v[d]);
+                        hi[d] = std::max(hi[d], v[d]);
+                    }
+                }
+                size_t axis = 0;
+                for (size_t d = 1; d < dim; ++d) {
+                    if (hi[d] - lo[d] > hi[axis] - lo[axis]) {
+                        axis = d;
+                    }
+                }
+                std::nth_element(_tree_lids.begin() + begin, _tree_lids.begin() + mid, _tree_lids.begin() + end,
+                                 [&](uint64_t a, uint64_t b) {
+                                     return vec(a)[axis] < vec(b)[axis];
+                                 });
+            });
+        }
+
+        /// leaf boxes and the contiguous leaf buckets, then boxes bottom up.
+        _lo.assign(_nodes.size() * dim, std::numeric_limits<float>::infinity());
+        _hi.assign(_nodes.size() * dim, -std::numeric_limits<float>::infinity());
+        _leaf_vectors.assign(n * stride, 0);
+        pool.parallel_for(leaves, [&](size_t i) {
+            auto node = _first_leaf + i;
+            auto *lo = _lo.data() + node * dim;
+            auto *hi = _hi.data() + node * dim;
+            for (auto j = _nodes[node].begin; j < _nodes[node].end; ++j) {
+                auto *v = vec(_tree_lids[j]);
+                std::memcpy(_leaf_vectors.data() + j * stride, v, stride);
+                for (size_t d = 0; d < dim; ++d) {
+                    lo[d] = std::min(lo[d], v[d]);
+                    hi[d] = std::max(hi[d], v[d]);
+                }
+            }
+        });
+        for (size_t level = levels; level-- > 0;) {
+            auto first = (size_t(1) << level) - 1;
+            pool.parallel_for(size_t(1) << level, [&](size_t i) {
+                auto node = first + i;
+                for (size_t d = 0; d < dim; ++d) {
+                    _lo[node * dim + d] = std::min(_lo[(2 * node + 1) * dim + d], _lo[(2 * node + 2) * dim + d]);
+                    _hi[node * dim + d] = std::max(_hi[(2 * node + 1) * dim + d], _hi[(2 * node + 2) * dim + d]);
+                }
+            });
+        }
+    }
+
+    turbo::Status KdTreeIndex::maybe_rebuild() {
+        if (!tree_supported()) {
+            return turbo::OkStatus();
+        }
+        auto limit = std::max<double>(_option.min_rebuild, _option.rebuild_ratio * static_cast<double>(tree_size()));
+        if (static_cast<double>(_buffer.size()) > limit || static_cast<double>(_holes) > limit) {
+            rebuild();
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Status KdTreeIndex::add(uint64_t lid) {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (state(lid) != kAbsent) {
+            return turbo::already_exists_error("lid already indexed:", lid);
+        }
+        /// without a tree every query is a flat scan, nothing to buffer.
+        if (tree_supported()) {
+            set_state(lid, kInBuffer);
+            _buffer.push_back(lid);
+        } else {
+            set_state(lid, kInTree);
+        }
+        ++_count;
+        return maybe_rebuild();
+    }
+
+    turbo::Status KdTreeIndex::remove(uint64_t lid) {
+        switch (state(lid)) {
+            case kAbsent:
+                return turbo::OkStatus();
+            case kInBuffer:
+                _buffer.erase(std::find(_buffer.begin(), _buffer.end(), lid));
+                break;
+            case kInTree:
+                ++_holes;
+                break;
+        }
+        _state[lid] = kAbsent;
+        --_count;
+        return maybe_rebuild();
+    }
+
+    turbo::Status KdTreeIndex::maintain() {
+        if (_store && tree_supported() && (!_buffer.empty() || _holes > 0)) {
+            rebuild();
+        }
+        return turbo::OkStatus();
+    }
+
+    float KdTreeIndex::box_bound(const float *q, size_t node) const {
+        auto *vs = _store->get_vector_space();
+        auto dim = static_cast<size_t>(vs->dim);
+        auto *lo = _lo.data() + node * dim;
+        auto *hi = _hi.data() + node * dim;
+        float bound = 0.0f;
+        if (vs->metric == kL1) {
+            for (size_t d = 0; d < dim; ++d) {
+                bound += std::max({lo[d] - q[d], q[d] - hi[d], 0.0f});
+            }
+        } else if (vs->metric == kL2) {
+            for (size_t d = 0; d < dim; ++d) {
+                auto gap = std::max({lo[d] - q[d], q[d] - hi[d], 0.0f});
+                bound += gap * gap;
+            }
+        } else {
+            /// the inner product family ranks by -q . x, maximized over the
+            /// box coordinate wise. no unit norm assumption on the store.
+            for (size_t d = 0; d < dim; ++d) {
+                bound -= std::max(q[d] * lo[d], q[d] * hi[d]);
+            }
+        }
+        return bound - kBoundSlack * (1.0f + std::abs(bound));
+    }
+
+    turbo::Result<std::vector<SearchHit> > KdTreeIndex::search(turbo::span<uint8_t> query,
+                                                              const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        auto *vs = _store->get_vector_space();
+        QueryVector qv(vs);
+        auto rs = qv.assign(query, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto q = qv.span();
+        if (!tree_supported()) {
+            return flat_scan(_store, q, option);
+        }
+
+        auto &entities = _store->id_manager()->ids();
+        auto visible = [&](uint64_t lid) {
+            return entities[lid].status != kTombstone && (!option.filter || option.filter(entities[lid].label));
+        };
+        auto *qf = reinterpret_cast<const float *>(q.data());
+        auto stride = static_cast<size_t>(vs->vector_byte_size);
+        auto *leaf_vectors = const_cast<uint8_t *>(_leaf_vectors.data());
+        TopKCollector collector(option.k);
+        /// depth first, nearer child first, a node is skipped once its box
+        /// bound cannot beat the k-th score.
+        auto scan = [&](auto rank) {
+            for (auto lid: _buffer) {
+                if (visible(lid)) {
+                    collector.push(rank(q, _store->vector_at(lid)), lid);
+                }
+            }
+            if (_nodes.empty()) {
+                return;
+            }
+            std::vector<std::pair<float, size_t> > stack;
+            stack.emplace_back(box_bound(qf, 0), 0);
+            while (!stack.empty()) {
+                auto [bound, node] = stack.back();
+                stack.pop_back();
+                if (!(bound < collector.threshold())) {
+                    continue;
+                }
+                if (node >= _first_leaf) {
+                    for (auto i = _nodes[node].begin; i < _nodes[node].end; ++i) {
+                        auto lid = _tree_lids[i];
+                        if (state(lid) != kInTree || !visible(lid)) {
+                            continue;
+                        }
+                        collector.push(rank(q, turbo::span<uint8_t>(leaf_vectors + i * stride, stride)), lid);
+                    }
+                    continue;
+                }
+                auto left = 2 * node + 1;
+                auto right = left + 1;
+                auto left_bound = box_bound(qf, left);
+                auto right_bound = box_bound(qf, right);
+                if (left_bound < right_bound) {
+                    stack.emplace_back(right_bound, right);
+                    stack.emplace_back(left_bound, left);
+                } else {
+                    stack.emplace_back(left_bound, left);
+                    stack.emplace_back(right_bound, right);
+                }
+            }
+        };
+        auto typed = dispatch_typed_space(vs, [&](auto space) {
+            using Space = decltype(space);
+            scan([](const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) { return Space::rank(a, b); });
+        });
+        if (!typed) {
+            scan([vs](const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b) {
+                return vs->operation.rank(a, b);
+            });
+        }
+        return ranked_hits(_store, collector.finish());
+    }
+} // namespace xann
@@ -0,0 +1,134 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <vector>
+#include <xann/core/vector_space.h>
+#include <xann/index/vector_index.h>
+
+namespace xann {
+
+    struct KdTreeOption {
+        /// vectors per leaf bucket.
+        uint32_t leaf_size{32};
+        /// inserts wait in a linearly scanned buffer and removes leave holes
+        /// in the leaves until either reaches this fraction of the tree, then
+        /// the tree is rebuilt.
+        double rebuild_ratio{0.1};
+        /// buffered inserts or holes that never trigger a rebuild on their own.
+        uint32_t min_rebuild{256};
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Exact kd-tree for low dimensional spaces.
+    ///
+    /// @details  A balanced tree in heap layout, each node split at the median
+    ///           of its widest coordinate and bounded by the box of its
+    ///           vectors. Leaf buckets hold copies of their vectors back to
+    ///           back so a leaf is one contiguous scan with the registered rank
+    ///           kernel, and a subtree is skipped when the box bound of the
+    ///           query cannot beat the current k-th score. Levels are
+    ///           partitioned in parallel. Answers are exact. The tree needs
+    ///           DT_FLOAT and kL1, kL2, kIP or a normalized metric, every other
+    ///           space runs flat scans.
+    ///
+    class KdTreeIndex : public VectorIndex {
+    public:
+        explicit KdTreeIndex(KdTreeOption option = {});
+
+        [[nodiscard]] std::string_view name() const override {
+            return "kd_tree";
+        }
+
+        turbo::Status build(const MemStore *store) override;
+
+        turbo::Status add(uint64_t lid) override;
+
+        turbo::Status remove(uint64_t lid) override;
+
+        /// fold the insert buffer and the holes into a fresh tree.
+        turbo::Status maintain() override;
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const override;
+
+        [[nodiscard]] uint64_t size() const override {
+            return _count;
+        }
+
+        [[nodiscard]] bool tree_supported() const;
+
+        /// inserts not in the tree yet.
+        [[nodiscard]] size_t buffer_size() const {
+            return _buffer.size();
+        }
+
+        /// vectors in the leaves, removed ones included until the next rebuild.
+        [[nodiscard]] size_t tree_size() const {
+            return _tree_lids.size();
+        }
+
+        [[nodiscard]] size_t leaf_count() const {
+            return _nodes.empty() ? 0 : _nodes.size() - _first_leaf;
+        }
+
+    private:
+        /// where a lid lives.
+        enum LidState : uint8_t {
+            kAbsent = 0,
+            kInTree = 1,
+            kInBuffer = 2,
+        };
+
+        struct Node {
+            uint32_t begin{0};
+            uint32_t end{0};
+        };
+
+        void set_state(uint64_t lid, LidState state);
+
+        [[nodiscard]] LidState state(uint64_t lid) const {
+            return lid < _state.size() ? static_cast<LidState>(_state[lid]) : kAbsent;
+        }
+
+        turbo::Status maybe_rebuild();
+
+        void rebuild();
+
+        /// lower bound of the rank of any vector in the box of node.
+        [[nodiscard]] float box_bound(const float *q, size_t node) const;
+
+    private:
+        KdTreeOption _option;
+        /// heap layout, children of i are 2i + 1 and 2i + 2.
+        std::vector<Node> _nodes;
+        size_t _first_leaf{0};
+        /// dim floats per node.
+        std::vector<float> _lo;
+        std::vector<float> _hi;
+        /// tree order, vector_byte_size bytes per slot.
+        AlignedBytes _leaf_vectors;
+        std::vector<uint64_t> _tree_lids;
+        std::vector<uint64_t> _buffer;
+        std::vector<uint8_t> _state;
+        uint64_t _holes{0};
+        uint64_t _count{0};
+    };
+} // namespace xann
@@ -0,0 +1,211 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/mips_index.h>
+#include <xann/core/query_vector.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace xann {
+
+    MipsIndex::MipsIndex(std::unique_ptr<VectorIndex> index, MipsIndexOption option)
+        : _index(std::move(index)), _option(option) {
+        _option.norm_headroom = std::max(_option.norm_headroom, 1.0f);
+    }
+
+    MipsIndex::~MipsIndex() = default;
+
+    float MipsIndex::norm_of(uint64_t lid) const {
+        auto v = _store->vector_at(lid);
+        return std::sqrt(std::max(_store->get_vector_space()->operation.distance_vector(v, v), 0.0f));
+    }
+
+    turbo::Status MipsIndex::mirror_add(uint64_t lid) {
+        auto dim = static_cast<size_t>(_store->get_vector_space()->dim);
+        auto v = _store->vector_at(lid);
+        _buffer.assign(static_cast<size_t>(_space->vector_byte_size), 0);
+        std::memcpy(_buffer.data(), v.data(), dim * sizeof(float));
+        auto norm = norm_of(lid);
+        reinterpret_cast<float *>(_buffer.data())[dim] = std::sqrt(std::max(_max_norm * _max_norm - norm * norm, 0.0f));
+        auto rs = _mirror->add_vector(_store->snapshot_id(), _next_label++,
+                                      turbo::span<uint8_t>(_buffer.data(), _buffer.size()));
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        auto m = rs.value_or_die();
+        if (lid >= _mirror_lid.size()) {
+            _mirror_lid.resize(lid + 1, kNoMirror);
+        }
+        if (m >= _source_lid.size()) {
+            _source_lid.resize(m + 1, kNoMirror);
+        }
+        _mirror_lid[lid] = m;
+        _source_lid[m] = lid;
+        return turbo::OkStatus();
+    }
+
+    turbo::Status MipsIndex::build(const MemStore *store) {
+        _store = store;
+        _mirror.reset();
+        _space.reset();
+        _mirror_lid.clear();
+        _source_lid.clear();
+        _removed.clear();
+        _next_label = 0;
+        _max_norm = 0.0f;
+        auto *vs = store->get_vector_space();
+        if (vs->metric != kIP || vs->data_type != DataType::DT_FLOAT) {
+            return _index->build(store);
+        }
+        auto vrs = VectorSpace::create(vs->dim + 1, kL2, DataType::DT_FLOAT, vs->operation.simd_level);
+        if (!vrs.ok()) {
+            return vrs.status();
+        }
+        _space = std::make_unique<VectorSpace>(std::move(vrs).value_or_die());
+        auto mrs = MemStore::create(_space.get(), store->option());
+        if (!mrs.ok()) {
+            return mrs.status();
+        }
+        _mirror = std::move(mrs).value_or_die();
+
+        auto lids = store->live_local_ids();
+        for (auto lid: lids) {
+            _max_norm = std::max(_max_norm, norm_of(lid));
+        }
+        _max_norm *= _option.norm_headroom;
+        for (auto lid: lids) {
+            auto rs = mirror_add(lid);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        return _index->build(_mirror.get());
+    }
+
+    turbo::Status MipsIndex::add(uint64_t lid) {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (!_mirror) {
+            return _index->add(lid);
+        }
+        if (lid < _mirror_lid.size() && _mirror_lid[lid] != kNoMirror) {
+            return turbo::already_exists_error("lid already indexed:", lid);
+        }
+        /// every augmented coordinate depends on M, a larger norm rebuilds
+        /// the mirror with the new M.
+        if (norm_of(lid) > _max_norm) {
+            ++_rebuilds;
+            return build(_store);
+        }
+        auto rs = mirror_add(lid);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return _index->add(_mirror_lid[lid]);
+    }
+
+    turbo::Status MipsIndex::remove(uint64_t lid) {
+        if (!_mirror) {
+            return _index->remove(lid);
+        }
+        if (lid >= _mirror_lid.size() || _mirror_lid[lid] == kNoMirror) {
+            return turbo::OkStatus();
+        }
+        auto m = _mirror_lid[lid];
+        _mirror_lid[lid] = kNoMirror;
+        auto rs = _index->remove(m);
+        if (!rs.ok()) {
+            return rs;
+        }
+        /// graph indexes may still route through m until consolidated, the
+        /// slot is freed by maintain().
+        _mirror->tombstone_vector_by_id(_store->snapshot_id(), m);
+        _removed.push_back(m);
+        return turbo::OkStatus();
+    }
+
+    turbo::Status MipsIndex::maintain() {
+        if (!_mirror) {
+            return _index->maintain();
+        }
+        if (!_removed.empty()) {
+            auto crs = _index->consolidate(0);
+            if (!crs.ok()) {
+                return crs.status();
+            }
+            _index->purge(crs.value_or_die());
+            for (auto m: _removed) {
+                _mirror->remove_vector_by_id(_store->snapshot_id(), m);
+                _source_lid[m] = kNoMirror;
+            }
+            _removed.clear();
+        }
+        return _index->maintain();
+    }
+
+    turbo::Result<std::vector<SearchHit> > MipsIndex::search(turbo::span<uint8_t> query,
+                                                            const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (!_mirror) {
+            return _index->search(query, option);
+        }
+        auto *vs = _store->get_vector_space();
+        QueryVector qv(vs);
+        auto rs = qv.assign(query, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto q = qv.span();
+        auto query_norm2 = vs->operation.distance_vector(q, q);
+        AlignedBytes augmented(static_cast<size_t>(_space->vector_byte_size), 0);
+        std::memcpy(augmented.data(), q.data(), static_cast<size_t>(vs->dim) * sizeof(float));
+
+        auto &entities = _store->id_manager()->ids();
+        SearchOption inner = option;
+        if (option.filter) {
+            inner.filter = [this, &entities, &option](uint64_t label) {
+                auto mrs = _mirror->get_id(label);
+                if (!mrs.ok()) {
+                    return false;
+                }
+                auto lid = _source_lid[mrs.value_or_die()];
+                return lid != kNoMirror && option.filter(entities[lid].label);
+            };
+        }
+        auto hrs = _index->search(turbo::span<uint8_t>(augmented.data(), augmented.size()), inner);
+        if (!hrs.ok()) {
+            return hrs;
+        }
+        /// |q' - x'|^2 = |q|^2 + M^2 - 2 q.x, the order is already ip descending.
+        auto m2 = _max_norm * _max_norm;
+        std::vector<SearchHit> hits;
+        hits.reserve(hrs.value_or_die().size());
+        for (auto &h: hrs.value_or_die()) {
+            auto lid = _source_lid[h.lid];
+            if (lid == kNoMirror) {
+                continue;
+            }
+            hits.push_back({entities[lid].label, lid, 0.5f * (query_norm2 + m2 - h.distance * h.distance)});
+        }
+        return hits;
+    }
+} // namespace xann
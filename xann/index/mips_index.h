@@ -0,0 +1,121 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <xann/core/vector_space.h>
+#include <xann/index/vector_index.h>
+
+namespace xann {
+
+    struct MipsIndexOption {
+        /// M is kept at norm_headroom times the largest norm seen, so inserts
+        /// slightly above it do not force a rebuild.
+        float norm_headroom{1.1f};
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Inner product search through an l2 index over augmented vectors.
+    ///
+    /// @details  Stored x becomes [x, sqrt(M^2 - |x|^2)] and a query q becomes
+    ///           [q, 0] (Bachrach et al.), so |q' - x'|^2 = |q|^2 + M^2 - 2 q.x
+    ///           and the smallest l2 distance is the largest inner product.
+    ///           The augmented vectors live in a mirror kL2 store of dim + 1
+    ///           owned by this index, and the wrapped index (hnsw, ivf, kd-tree,
+    ///           pivots...) is built over it, so the l2 kernels and metric
+    ///           pruning serve kIP. M grows only on an insert whose norm passes
+    ///           it, which rebuilds the mirror and the wrapped index. Hits carry
+    ///           the inner product. Spaces other than DT_FLOAT kIP build the
+    ///           wrapped index over the bound store directly.
+    ///
+    class MipsIndex : public VectorIndex {
+    public:
+        /// index must expect a kL2 store.
+        explicit MipsIndex(std::unique_ptr<VectorIndex> index, MipsIndexOption option = {});
+
+        ~MipsIndex() override;
+
+        [[nodiscard]] std::string_view name() const override {
+            return "mips";
+        }
+
+        turbo::Status build(const MemStore *store) override;
+
+        turbo::Status add(uint64_t lid) override;
+
+        turbo::Status remove(uint64_t lid) override;
+
+        /// consolidate the wrapped index and free the removed mirror slots.
+        turbo::Status maintain() override;
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const override;
+
+        [[nodiscard]] uint64_t size() const override {
+            return _index->size();
+        }
+
+        [[nodiscard]] SearchKnob search_knob() const override {
+            return _index->search_knob();
+        }
+
+        [[nodiscard]] bool augmented() const {
+            return _mirror != nullptr;
+        }
+
+        /// the current M, 0 before build.
+        [[nodiscard]] float max_norm() const {
+            return _max_norm;
+        }
+
+        /// builds caused by an insert above M.
+        [[nodiscard]] uint64_t rebuilds() const {
+            return _rebuilds;
+        }
+
+        [[nodiscard]] const VectorIndex *inner() const {
+            return _index.get();
+        }
+
+    private:
+        static constexpr uint64_t kNoMirror = ~uint64_t(0);
+
+        [[nodiscard]] float norm_of(uint64_t lid) const;
+
+        turbo::Status mirror_add(uint64_t lid);
+
+    private:
+        std::unique_ptr<VectorIndex> _index;
+        MipsIndexOption _option;
+        std::unique_ptr<VectorSpace> _space;
+        std::unique_ptr<MemStore> _mirror;
+        /// source lid -> mirror lid.
+        std::vector<uint64_t> _mirror_lid;
+        /// mirror lid -> source lid.
+        std::vector<uint64_t> _source_lid;
+        /// mirror lids removed from the wrapped index but not freed yet.
+        std::vector<uint64_t> _removed;
+        uint64_t _next_label{0};
+        float _max_norm{0.0f};
+        uint64_t _rebuilds{0};
+        AlignedBytes _buffer;
+    };
+} // namespace xann
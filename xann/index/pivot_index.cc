@@ -0,0 +1,301 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/pivot_index.h>
+#include <xann/common/thread_pool.h>
+#include <xann/core/query_vector.h>
+#include <xann/index/flat_index.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+
+namespace xann {
+
+    /// float rounding of the stored and the query side distances.
+    static constexpr float kBoundSlack = 1e-5f;
+    /// fp16 keeps 11 significant bits, a stored distance is off by at most
+    /// 2^-11 of itself.
+    static constexpr float kHalfSlack = 1.0f / 1024.0f;
+
+    PivotIndex::PivotIndex(PivotIndexOption option) : _option(option) {
+    }
+
+    bool PivotIndex::pivots_supported() const {
+        return is_true_metric(_store->get_vector_space()->metric) && _option.num_pivots > 0;
+    }
+
+    turbo::span<uint8_t> PivotIndex::pivot(size_t p) const {
+        auto stride = static_cast<size_t>(_store->get_vector_space()->vector_byte_size);
+        return {const_cast<uint8_t *>(_pivots.data()) + p * stride, stride};
+    }
+
+    bool PivotIndex::visible(uint64_t lid, const SearchOption &option) const {
+        if (lid >= _indexed.size() || !_indexed[lid]) {
+            return false;
+        }
+        auto &entity = _store->id_manager()->ids()[lid];
+        return entity.status != kTombstone && (!option.filter || option.filter(entity.label));
+    }
+
+    void PivotIndex::select_pivots(const std::vector<uint64_t> &lids) {
+        auto *vs = _store->get_vector_space();
+        auto stride = static_cast<size_t>(vs->vector_byte_size);
+        auto distance = vs->operation.distance_vector;
+        _pivot_lids.clear();
+        std::vector<uint64_t> sample(lids);
+        std::mt19937_64 rng(_option.seed);
+        std::shuffle(sample.begin(), sample.end(), rng);
+        if (sample.size() > _option.max_sample_size) {
+            sample.resize(_option.max_sample_size);
+        }
+        auto count = std::min<size_t>(_option.num_pivots, sample.size());
+        /// farthest first: each pivot maximizes its distance to the closest
+        /// pivot taken so far, the first one is random.
+        std::vector<float> nearest(sample.size(), std::numeric_limits<float>::infinity());
+        size_t next = 0;
+        for (size_t p = 0; p < count; ++p) {
+            _pivot_lids.push_back(sample[next]);
+            auto pv = _store->vector_at(sample[next]);
+            ThreadPool::default_pool().parallel_for(sample.size(), [&](size_t i) {
+                nearest[i] = std::min(nearest[i], distance(pv, _store->vector_at(sample[i])));
+            });
+            next = std::max_element(nearest.begin(), nearest.end()) - nearest.begin();
+        }
+        _pivots.assign(_pivot_lids.size() * stride, 0);
+        for (size_t p = 0; p < _pivot_lids.size(); ++p) {
+            std::memcpy(_pivots.data() + p * stride, _store->vector_at(_pivot_lids[p]).data(), stride);
+        }
+    }
+
+    void PivotIndex::fill_row(uint64_t lid) {
+        auto distance = _store->get_vector_space()->operation.distance_vector;
+        auto np = pivot_count();
+        auto v = _store->vector_at(lid);
+        for (size_t p = 0; p < np; ++p) {
+            auto d = distance(v, pivot(p));
+            if (_option.half_table) {
+                _table16[lid * np + p] = half_float::half(d);
+            } else {
+                _table[lid * np + p] = d;
+            }
+        }
+    }
+
+    turbo::Status PivotIndex::build(const MemStore *store) {
+        if (store->get_vector_space()->mixed_precision()) {
+            return turbo::invalid_argument_error("pivot index does not score float queries of a mixed precision space");
+        }
+        _store = store;
+        _pivot_lids.clear();
+        _pivots.clear();
+        _table.clear();
+        _table16.clear();
+        _indexed.clear();
+        auto lids = store->live_local_ids();
+        _count = lids.size();
+        _built_count = _count;
+        _changes = 0;
+        if (lids.empty()) {
+            return turbo::OkStatus();
+        }
+        auto max_lid = *std::max_element(lids.begin(), lids.end());
+        _indexed.assign(max_lid + 1, 0);
+        for (auto lid: lids) {
+            _indexed[lid] = 1;
+        }
+        if (!pivots_supported()) {
+            return turbo::OkStatus();
+        }
+        select_pivots(lids);
+        if (_option.half_table) {
+            _table16.assign((max_lid + 1) * pivot_count(), half_float::half(0.0f));
+        } else {
+            _table.assign((max_lid + 1) * pivot_count(), 0.0f);
+        }
+        ThreadPool::default_pool().parallel_for(lids.size(), [&](size_t i) {
+            fill_row(lids[i]);
+        });
+        return turbo::OkStatus();
+    }
+
+    turbo::Status PivotIndex::add(uint64_t lid) {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (lid < _indexed.size() && _indexed[lid]) {
+            return turbo::already_exists_error("lid already indexed:", lid);
+        }
+        if (lid >= _indexed.size()) {
+            _indexed.resize(lid + 1, 0);
+        }
+        _indexed[lid] = 1;
+        ++_count;
+        ++_changes;
+        if (!pivots_supported()) {
+            return turbo::OkStatus();
+        }
+        /// pivots are picked once there are enough vectors to spread them.
+        if (pivot_count() < _option.num_pivots && _count >= 2 * _option.num_pivots) {
+            return build(_store);
+        }
+        auto rows = lid + 1;
+        if (_option.half_table && _table16.size() < rows * pivot_count()) {
+            _table16.resize(std::max(rows * pivot_count(), _table16.size() * 2), half_float::half(0.0f));
+        } else if (!_option.half_table && _table.size() < rows * pivot_count()) {
+            _table.resize(std::max(rows * pivot_count(), _table.size() * 2), 0.0f);
+        }
+        fill_row(lid);
+        return turbo::OkStatus();
+    }
+
+    turbo::Status PivotIndex::remove(uint64_t lid) {
+        if (lid < _indexed.size() && _indexed[lid]) {
+            _indexed[lid] = 0;
+            --_count;
+            ++_changes;
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Status PivotIndex::maintain() {
+        if (!_store || _changes == 0) {
+            return turbo::OkStatus();
+        }
+        /// rows of added vectors are exact against the old pivots, a rebuild
+        /// only pays off once the pivots no longer spread over the data.
+        if (static_cast<double>(_changes) < _option.rebuild_ratio * static_cast<double>(_built_count)) {
+            return turbo::OkStatus();
+        }
+        return build(_store);
+    }
+
+    float PivotIndex::lower_bound(const float *qd, uint64_t lid) const {
+        auto np = pivot_count();
+        float bound = 0.0f;
+        if (_option.half_table) {
+            auto *row = _table16.data() + lid * np;
+            for (size_t p = 0; p < np; ++p) {
+                auto d = static_cast<float>(row[p]);
+                bound = std::max(bound, std::abs(qd[p] - d) - d * kHalfSlack);
+            }
+        } else {
+            auto *row = _table.data() + lid * np;
+            for (size_t p = 0; p < np; ++p) {
+                bound = std::max(bound, std::abs(qd[p] - row[p]));
+            }
+        }
+        return bound - kBoundSlack * (1.0f + bound);
+    }
+
+    turbo::Result<std::vector<SearchHit> > PivotIndex::search(turbo::span<uint8_t> query,
+                                                             const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        auto *vs = _store->get_vector_space();
+        QueryVector qv(vs);
+        auto rs = qv.assign(query, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto q = qv.span();
+        if (!pivots_supported()) {
+            return flat_scan(_store, q, option);
+        }
+        auto distance = vs->operation.distance_vector;
+        auto np = pivot_count();
+        std::vector<float> qd(np);
+        for (size_t p = 0; p < np; ++p) {
+            qd[p] = distance(q, pivot(p));
+        }
+        /// scores are operator values, smaller is closer for every true metric.
+        std::vector<std::pair<float, uint64_t> > bounds;
+        bounds.reserve(_count);
+        for (uint64_t lid = 0; lid < _indexed.size(); ++lid) {
+            if (visible(lid, option)) {
+                bounds.emplace_back(np ? lower_bound(qd.data(), lid) : 0.0f, lid);
+            }
+        }
+        /// the k smallest bounds first so the threshold tightens before the
+        /// linear pass over the rest.
+        auto seeds = std::min<size_t>(option.k, bounds.size());
+        std::nth_element(bounds.begin(), bounds.begin() + seeds, bounds.end());
+        TopKCollector collector(option.k);
+        uint64_t evaluations = 0;
+        for (size_t i = 0; i < bounds.size(); ++i) {
+            if (i >= seeds && !(bounds[i].first < collector.threshold())) {
+                continue;
+            }
+            ++evaluations;
+            collector.push(distance(q, _store->vector_at(bounds[i].second)), bounds[i].second);
+        }
+        _last_evaluations.store(evaluations + np, std::memory_order_relaxed);
+
+        auto &entities = _store->id_manager()->ids();
+        auto entries = collector.finish();
+        std::vector<SearchHit> hits;
+        hits.reserve(entries.size());
+        for (auto &e: entries) {
+            hits.push_back({entities[e.lid].label, e.lid, e.score});
+        }
+        return hits;
+    }
+
+    turbo::Result<std::vector<SearchHit> > PivotIndex::range_search(turbo::span<uint8_t> query, float radius,
+                                                                   const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        auto *vs = _store->get_vector_space();
+        if (!is_true_metric(vs->metric)) {
+            return turbo::invalid_argument_error("range search needs a true metric, metric:", vs->metric);
+        }
+        QueryVector qv(vs);
+        auto rs = qv.assign(query, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto q = qv.span();
+        auto distance = vs->operation.distance_vector;
+        auto np = pivot_count();
+        std::vector<float> qd(np);
+        for (size_t p = 0; p < np; ++p) {
+            qd[p] = distance(q, pivot(p));
+        }
+        auto &entities = _store->id_manager()->ids();
+        std::vector<SearchHit> hits;
+        uint64_t evaluations = 0;
+        for (uint64_t lid = 0; lid < _indexed.size(); ++lid) {
+            if (!visible(lid, option) || (np && lower_bound(qd.data(), lid) > radius)) {
+                continue;
+            }
+            ++evaluations;
+            auto d = distance(q, _store->vector_at(lid));
+            if (d <= radius) {
+                hits.push_back({entities[lid].label, lid, d});
+            }
+        }
+        _last_evaluations.store(evaluations + np, std::memory_order_relaxed);
+        std::sort(hits.begin(), hits.end(), [](const SearchHit &a, const SearchHit &b) {
+            return a.distance < b.distance;
+        });
+        return hits;
+    }
+} // namespace xann
@@ -0,0 +1,129 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <xann/common/half.hpp>
+#include <xann/core/vector_space.h>
+#include <xann/index/vector_index.h>
+
+namespace xann {
+
+    struct PivotIndexOption {
+        uint32_t num_pivots{16};
+        /// keep the pivot distances as fp16, the bounds widen by the rounding.
+        bool half_table{false};
+        /// vectors the farthest first pivot selection runs over.
+        uint32_t max_sample_size{8192};
+        /// maintain reselects the pivots once adds and removes since the last
+        /// build reach this fraction of the vectors that build saw.
+        double rebuild_ratio{0.2};
+        uint64_t seed{1234};
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Exact search pruned by distances to a few pivots.
+    ///
+    /// @details  For a true metric, |d(q, p) - d(x, p)| <= d(q, x) for every
+    ///           pivot p. The index keeps d(x, p) for all stored x in a lid
+    ///           indexed table of num_pivots floats (or fp16) per vector, and a
+    ///           search only evaluates the full distance of vectors whose best
+    ///           bound beats the current k-th distance or the radius. Pivots
+    ///           are picked farthest first so their bounds spread out. Spaces
+    ///           whose metric is not a true metric run flat scans.
+    ///
+    class PivotIndex : public VectorIndex {
+    public:
+        explicit PivotIndex(PivotIndexOption option = {});
+
+        [[nodiscard]] std::string_view name() const override {
+            return "pivot";
+        }
+
+        turbo::Status build(const MemStore *store) override;
+
+        turbo::Status add(uint64_t lid) override;
+
+        turbo::Status remove(uint64_t lid) override;
+
+        /// reselect the pivots from the current vectors and refill the table,
+        /// only when enough vectors changed since the last build.
+        turbo::Status maintain() override;
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const override;
+
+        /// every visible vector within radius (operator value) of query, best first.
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > range_search(turbo::span<uint8_t> query, float radius,
+                                                                         const SearchOption &option) const;
+
+        [[nodiscard]] uint64_t size() const override {
+            return _count;
+        }
+
+        [[nodiscard]] bool pivots_supported() const;
+
+        [[nodiscard]] size_t pivot_count() const {
+            return _pivot_lids.size();
+        }
+
+        /// lids the pivots were copied from.
+        [[nodiscard]] const std::vector<uint64_t> &pivot_lids() const {
+            return _pivot_lids;
+        }
+
+        /// full distance evaluations of the last search, for tests and tuning.
+        [[nodiscard]] uint64_t last_evaluations() const {
+            return _last_evaluations.load(std::memory_order_relaxed);
+        }
+
+        /// adds and removes since the last build.
+        [[nodiscard]] uint64_t changes_since_build() const {
+            return _changes;
+        }
+
+    private:
+        void select_pivots(const std::vector<uint64_t> &lids);
+
+        void fill_row(uint64_t lid);
+
+        [[nodiscard]] turbo::span<uint8_t> pivot(size_t p) const;
+
+        /// best lower bound of d(q, lid) from the pivot row of lid.
+        [[nodiscard]] float lower_bound(const float *qd, uint64_t lid) const;
+
+        [[nodiscard]] bool visible(uint64_t lid, const SearchOption &option) const;
+
+    private:
+        PivotIndexOption _option;
+        std::vector<uint64_t> _pivot_lids;
+        /// vector_byte_size bytes per pivot, own copies so pivots survive removal.
+        AlignedBytes _pivots;
+        /// pivot_count() distances per lid.
+        std::vector<float> _table;
+        std::vector<half_float::half> _table16;
+        std::vector<uint8_t> _indexed;
+        uint64_t _count{0};
+        uint64_t _built_count{0};
+        uint64_t _changes{0};
+        mutable std::atomic<uint64_t> _last_evaluations{0};
+    };
+} // namespace xann
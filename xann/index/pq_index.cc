@@ -0,0 +1,220 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/pq_index.h>
+#include <xann/common/thread_pool.h>
+#include <xann/core/query_vector.h>
+#include <xann/index/flat_index.h>
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+namespace xann {
+
+    PqIndex::PqIndex(PqIndexOption option) : _option(option) {
+    }
+
+    uint32_t PqIndex::auto_m(uint32_t dim) {
+        for (auto m = std::max<uint32_t>(dim / 8, 1); m > 1; --m) {
+            if (dim % m == 0) {
+                return m;
+            }
+        }
+        return 1;
+    }
+
+    bool PqIndex::codes_supported() const {
+        auto *vs = _store->get_vector_space();
+        if (vs->data_type != DataType::DT_FLOAT) {
+            return false;
+        }
+        switch (vs->metric) {
+            case kL2:
+            case kNormalizedL2:
+            case kIP:
+            case kNormalizedCosine:
+            case kNormalizedAngle:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    float PqIndex::vector_score(turbo::span<uint8_t> q, uint64_t lid) const {
+        auto *vs = _store->get_vector_space();
+        return vs->operation.rank(q, _store->vector_at(lid));
+    }
+
+    turbo::Status PqIndex::build(const MemStore *store) {
+        if (store->get_vector_space()->mixed_precision()) {
+            return turbo::invalid_argument_error("pq index does not score float queries of a mixed precision space");
+        }
+        _store = store;
+        auto *vs = store->get_vector_space();
+        _l2_codes = vs->metric == kL2 || vs->metric == kNormalizedL2;
+        _rotation = LinearTransform();
+        _pq = ProductQuantizer();
+        _codes.clear();
+        _indexed.clear();
+        _count = 0;
+
+        auto lids = store->live_local_ids();
+        if (codes_supported() && lids.size() >= _option.min_train_size) {
+            auto rs = train(lids);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        if (lids.empty()) {
+            return turbo::OkStatus();
+        }
+        auto max_lid = *std::max_element(lids.begin(), lids.end());
+        _indexed.assign(max_lid + 1, 0);
+        _codes.assign((max_lid + 1) * _pq.code_size(), 0);
+        for (auto lid: lids) {
+            _indexed[lid] = 1;
+        }
+        _count = lids.size();
+        if (trained()) {
+            ThreadPool::default_pool().parallel_for(lids.size(), [&](size_t i) {
+                encode(lids[i]);
+            });
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Status PqIndex::train(const std::vector<uint64_t> &lids) {
+        auto *vs = _store->get_vector_space();
+        auto dim = static_cast<size_t>(vs->dim);
+        std::vector<uint64_t> sample(lids);
+        if (sample.size() > _option.max_train_size) {
+            std::mt19937_64 rng(_option.seed);
+            std::shuffle(sample.begin(), sample.end(), rng);
+            sample.resize(_option.max_train_size);
+        }
+        std::vector<float> data(sample.size() * dim);
+        for (size_t i = 0; i < sample.size(); ++i) {
+            std::memcpy(data.data() + i * dim, _store->vector_at(sample[i]).data(), dim * sizeof(float));
+        }
+        PqOption po;
+        po.m = _option.m ? _option.m : auto_m(static_cast<uint32_t>(dim));
+        po.train_iterations = _option.train_iterations;
+        po.seed = _option.seed;
+        if (!_option.opq) {
+            return _pq.train(data.data(), sample.size(), dim, po);
+        }
+        return train_opq(data.data(), sample.size(), dim, po, _option.opq_option, vs->operation.simd_level,
+                         &_rotation, &_pq);
+    }
+
+    void PqIndex::encode(uint64_t lid) {
+        auto *x = reinterpret_cast<const float *>(_store->vector_at(lid).data());
+        auto *code = _codes.data() + lid * _pq.code_size();
+        if (_rotation.empty()) {
+            _pq.encode(x, code);
+            return;
+        }
+        std::vector<float> rotated(_rotation.rows());
+        _rotation.apply(x, rotated.data());
+        _pq.encode(rotated.data(), code);
+    }
+
+    turbo::Status PqIndex::add(uint64_t lid) {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (lid < _indexed.size() && _indexed[lid]) {
+            return turbo::already_exists_error("lid already indexed:", lid);
+        }
+        if (lid >= _indexed.size()) {
+            _indexed.resize(lid + 1, 0);
+            _codes.resize((lid + 1) * _pq.code_size(), 0);
+        }
+        _indexed[lid] = 1;
+        ++_count;
+        if (trained()) {
+            encode(lid);
+        } else if (codes_supported() && _count >= _option.min_train_size) {
+            return build(_store);
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Status PqIndex::remove(uint64_t lid) {
+        if (lid < _indexed.size() && _indexed[lid]) {
+            _indexed[lid] = 0;
+            --_count;
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Result<std::vector<SearchHit> > PqIndex::search(turbo::span<uint8_t> query,
+                                                          const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        auto *vs = _store->get_vector_space();
+        QueryVector qv(vs);
+        auto rs = qv.assign(query, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto q = qv.span();
+        auto &entities = _store->id_manager()->ids();
+        auto visible = [&](uint64_t lid) {
+            return _indexed[lid] && entities[lid].status != kTombstone &&
+                   (!option.filter || option.filter(entities[lid].label));
+        };
+
+        TopKCollector collector(option.k);
+        if (!trained()) {
+            for (uint64_t lid = 0; lid < _indexed.size(); ++lid) {
+                if (visible(lid)) {
+                    collector.push(vector_score(q, lid), lid);
+                }
+            }
+        } else {
+            auto *qf = reinterpret_cast<const float *>(q.data());
+            std::vector<float> rotated;
+            if (!_rotation.empty()) {
+                rotated.resize(_rotation.rows());
+                _rotation.apply(qf, rotated.data());
+                qf = rotated.data();
+            }
+            std::vector<float> table(_pq.m() * _pq.ksub());
+            if (_l2_codes) {
+                _pq.compute_l2_table(qf, table.data());
+            } else {
+                _pq.compute_ip_table(qf, table.data());
+            }
+            auto code_size = _pq.code_size();
+            TopKCollector candidates(std::max<size_t>(option.k, option.rerank));
+            for (uint64_t lid = 0; lid < _indexed.size(); ++lid) {
+                if (!visible(lid)) {
+                    continue;
+                }
+                auto d = _pq.table_distance(table.data(), _codes.data() + lid * code_size);
+                candidates.push(_l2_codes ? d : -d, lid);
+            }
+            for (auto &e: candidates.finish()) {
+                collector.push(vector_score(q, e.lid), e.lid);
+            }
+        }
+        return ranked_hits(_store, collector.finish());
+    }
+} // namespace xann
@@ -0,0 +1,117 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <vector>
+#include <xann/index/vector_index.h>
+#include <xann/quantization/linear_transform.h>
+#include <xann/quantization/opq.h>
+#include <xann/quantization/product_quantizer.h>
+
+namespace xann {
+
+    struct PqIndexOption {
+        /// code bytes per vector, 0 picks the largest divisor of dim up to dim / 8.
+        uint32_t m{0};
+        /// learn an OPQ rotation with the codebooks, the code size is unchanged.
+        bool opq{true};
+        OpqOption opq_option;
+        uint32_t train_iterations{20};
+        /// training sample cap.
+        uint32_t max_train_size{32768};
+        /// below this many vectors the index stays untrained and scans full vectors.
+        uint32_t min_train_size{4096};
+        uint64_t seed{1234};
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Flat scan over product quantized codes, reranked with full vectors.
+    ///
+    /// @details  With opq the index keeps a learned orthogonal rotation next to
+    ///           the codebooks. Codes are taken of the rotated vectors, a query
+    ///           is rotated once by a SIMD gemv right after QueryVector, and
+    ///           since the rotation preserves l2 and inner product its lookup
+    ///           table scores the codes directly. The best max(k, rerank)
+    ///           codes are rescored with the stored vectors. Codes need DT_FLOAT
+    ///           and an l2 or inner product family metric, otherwise and until
+    ///           min_train_size vectors are present every query scans full
+    ///           vectors.
+    ///
+    class PqIndex : public VectorIndex {
+    public:
+        explicit PqIndex(PqIndexOption option = {});
+
+        [[nodiscard]] std::string_view name() const override {
+            return _option.opq ? "opq" : "pq";
+        }
+
+        turbo::Status build(const MemStore *store) override;
+
+        turbo::Status add(uint64_t lid) override;
+
+        turbo::Status remove(uint64_t lid) override;
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const override;
+
+        [[nodiscard]] uint64_t size() const override {
+            return _count;
+        }
+
+        [[nodiscard]] SearchKnob search_knob() const override {
+            return SearchKnob::kRerank;
+        }
+
+        [[nodiscard]] bool trained() const {
+            return _pq.trained();
+        }
+
+        [[nodiscard]] const ProductQuantizer &quantizer() const {
+            return _pq;
+        }
+
+        /// empty without opq.
+        [[nodiscard]] const LinearTransform &rotation() const {
+            return _rotation;
+        }
+
+        /// largest divisor of dim up to dim / 8.
+        static uint32_t auto_m(uint32_t dim);
+
+    private:
+        [[nodiscard]] bool codes_supported() const;
+
+        turbo::Status train(const std::vector<uint64_t> &lids);
+
+        void encode(uint64_t lid);
+
+        [[nodiscard]] float vector_score(turbo::span<uint8_t> q, uint64_t lid) const;
+
+    private:
+        PqIndexOption _option;
+        bool _l2_codes{true};
+        LinearTransform _rotation;
+        ProductQuantizer _pq;
+        /// code_size bytes per lid.
+        std::vector<uint8_t> _codes;
+        std::vector<uint8_t> _indexed;
+        uint64_t _count{0};
+    };
+} // namespace xann
@@ -0,0 +1,163 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/search_tuner.h>
+#include <xann/index/flat_index.h>
+#include <xann/core/query_vector.h>
+#include <algorithm>
+
+namespace xann {
+
+    SearchTuner::SearchTuner(SearchTunerOption option) : _option(std::move(option)) {
+    }
+
+    float SearchTuner::recall(const std::vector<SearchHit> &truth, const std::vector<SearchHit> &hits) {
+        if (truth.empty()) {
+            return 1.0f;
+        }
+        std::vector<uint64_t> lids;
+        lids.reserve(hits.size());
+        for (auto &h: hits) {
+            lids.push_back(h.lid);
+        }
+        std::sort(lids.begin(), lids.end());
+        size_t found = 0;
+        for (auto &t: truth) {
+            if (std::binary_search(lids.begin(), lids.end(), t.lid)) {
+                ++found;
+            }
+        }
+        return static_cast<float>(found) / static_cast<float>(truth.size());
+    }
+
+    turbo::Result<SearchTuning> SearchTuner::tune(VectorIndex *index,
+                                                  const std::vector<std::vector<uint8_t> > &queries) const {
+        auto *store = index->store();
+        if (!store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (queries.empty() || _option.k == 0) {
+            return turbo::invalid_argument_error("tuning needs queries and k > 0");
+        }
+        auto knob = _option.knob == SearchKnob::kNone ? index->search_knob() : _option.knob;
+        if (knob == SearchKnob::kNone) {
+            return turbo::failed_precondition_error("index ", index->name(), " has no search knob");
+        }
+
+        SearchOption option = _option.base;
+        option.k = _option.k;
+        option.use_tuning = false;
+        std::vector<std::vector<SearchHit> > truth;
+        truth.reserve(queries.size());
+        QueryVector prepared(store->get_vector_space());
+        for (auto &q: queries) {
+            auto rs = prepared.assign(turbo::span<uint8_t>(const_cast<uint8_t *>(q.data()), q.size()), option);
+            if (!rs.ok()) {
+                return rs;
+            }
+            truth.push_back(store->get_vector_space()->mixed_precision()
+                                ? mixed_flat_scan(store, prepared.query_span(), option)
+                                : flat_scan(store, prepared.span(), option));
+        }
+
+        SearchTuning tuning;
+        tuning.knob = knob;
+        tuning.k = _option.k;
+        tuning.target_recall = _option.target_recall;
+        auto measure = [&](uint32_t value) -> turbo::Result<float> {
+            tuning.value = value;
+            SearchOption probe = option;
+            tuning.apply(probe);
+            double sum = 0.0;
+            for (size_t i = 0; i < queries.size(); ++i) {
+                auto rs = index->search(turbo::span<uint8_t>(const_cast<uint8_t *>(queries[i].data()),
+                                                             queries[i].size()), probe);
+                if (!rs.ok()) {
+                    return rs.status();
+                }
+                sum += recall(truth[i], rs.value_or_die());
+            }
+            return static_cast<float>(sum / static_cast<double>(queries.size()));
+        };
+
+        /// ef and rerank below k can never return k hits.
+        auto lo = _option.min_value;
+        if (knob != SearchKnob::kNprobe) {
+            lo = std::max(lo, _option.k);
+        }
+        auto hi = std::max(lo, _option.max_value);
+        auto rs = measure(hi);
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        auto best_value = hi;
+        auto best_recall = rs.value_or_die();
+        if (best_recall >= _option.target_recall) {
+            while (lo < hi) {
+                auto mid = lo + (hi - lo) / 2;
+                rs = measure(mid);
+                if (!rs.ok()) {
+                    return rs.status();
+                }
+                if (rs.value_or_die() >= _option.target_recall) {
+                    hi = mid;
+                    best_value = mid;
+                    best_recall = rs.value_or_die();
+                } else {
+                    lo = mid + 1;
+                }
+            }
+        }
+        tuning.value = best_value;
+        tuning.recall = best_recall;
+        tuning.mutation_count = store->mutation_count();
+        tuning.size = store->size();
+        index->set_tuning(tuning);
+        return tuning;
+    }
+
+    bool SearchTuner::needs_retune(const VectorIndex &index) const {
+        auto &tuning = index.tuning();
+        if (!tuning.valid() || tuning.k != _option.k || tuning.target_recall != _option.target_recall) {
+            return true;
+        }
+        if (_option.knob != SearchKnob::kNone && tuning.knob != _option.knob) {
+            return true;
+        }
+        auto *store = index.store();
+        if (!store) {
+            return false;
+        }
+        /// per store, a collection's snapshot ids also count the other shards.
+        auto drift = store->mutation_count() - std::min(store->mutation_count(), tuning.mutation_count);
+        auto base = static_cast<double>(std::max<uint64_t>(tuning.size, 1));
+        return static_cast<double>(drift) > base * _option.drift_ratio;
+    }
+
+    turbo::Result<bool> SearchTuner::maybe_retune(VectorIndex *index, const std::vector<std::vector<uint8_t> > &queries,
+                                                  bool force) const {
+        if (!force && !needs_retune(*index)) {
+            return false;
+        }
+        auto rs = tune(index, queries);
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        return true;
+    }
+} // namespace xann
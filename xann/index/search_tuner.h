@@ -0,0 +1,75 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <vector>
+#include <turbo/utility/status.h>
+#include <xann/index/vector_index.h>
+
+namespace xann {
+
+    struct SearchTunerOption {
+        uint32_t k{10};
+        float target_recall{0.9f};
+        /// kNone means the index's own search_knob().
+        SearchKnob knob{SearchKnob::kNone};
+        uint32_t min_value{1};
+        uint32_t max_value{4096};
+        /// re-tune once the store saw more mutations than this fraction of the tuned size.
+        double drift_ratio{0.2};
+        /// filter and untuned knobs used for every tuning search.
+        SearchOption base;
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Finds the cheapest knob value that meets a recall@k target.
+    ///
+    /// @details  Ground truth for the held out queries comes from flat_scan,
+    ///           then the knob is binary searched over [min_value, max_value]
+    ///           assuming recall is non decreasing in it. The result is stored
+    ///           on the index with the store mutation_count, so needs_retune
+    ///           can tell when enough mutations happened since.
+    ///
+    class SearchTuner {
+    public:
+        explicit SearchTuner(SearchTunerOption option = {});
+
+        /// queries are raw vectors, dim * element_size or vector_byte_size bytes each.
+        /// caller holds index->store()->mutex() exclusively.
+        turbo::Result<SearchTuning> tune(VectorIndex *index, const std::vector<std::vector<uint8_t> > &queries) const;
+
+        /// no tuning, another target, or the store drifted past drift_ratio.
+        [[nodiscard]] bool needs_retune(const VectorIndex &index) const;
+
+        /// tune when needs_retune or force, returns whether the index was tuned.
+        turbo::Result<bool> maybe_retune(VectorIndex *index, const std::vector<std::vector<uint8_t> > &queries,
+                                         bool force = false) const;
+
+        [[nodiscard]] const SearchTunerOption &option() const {
+            return _option;
+        }
+
+        /// fraction of truth found in hits, by lid.
+        static float recall(const std::vector<SearchHit> &truth, const std::vector<SearchHit> &hits);
+
+    private:
+        SearchTunerOption _option;
+    };
+} // namespace xann
@@ -0,0 +1,194 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/semantic_cache.h>
+#include <xann/core/dtype_convert.h>
+#include <xann/core/query_vector.h>
+#include <xann/index/search_tuner.h>
+#include <cstring>
+
+namespace xann {
+
+    static constexpr float kRecallDecay = 0.9f;
+    static constexpr float kEpsilonGrowth = 1.05f;
+
+    SemanticCacheIndex::SemanticCacheIndex(std::unique_ptr<VectorIndex> index, SemanticCacheOption option)
+        : _index(std::move(index)), _option(option), _epsilon(option.epsilon) {
+        _stats.epsilon = _epsilon;
+    }
+
+    turbo::Status SemanticCacheIndex::build(const MemStore *store) {
+        _store = store;
+        {
+            std::unique_lock<std::shared_mutex> lk(_mutex);
+            auto dim = static_cast<size_t>(store->get_vector_space()->dim);
+            _keys.assign(_option.capacity * dim, 0.0f);
+            _slots.assign(_option.capacity, Slot());
+            _next = 0;
+        }
+        return _index->build(store);
+    }
+
+    bool SemanticCacheIndex::make_key(turbo::span<uint8_t> prepared, std::vector<float> *key) const {
+        auto *vs = _store->get_vector_space();
+        key->resize(static_cast<size_t>(vs->dim));
+        return widen_to_floats(prepared.data(), key->size(), vs->data_type, key->data(), vs->storage_scale).ok();
+    }
+
+    int64_t SemanticCacheIndex::lookup(const std::vector<float> &key, const SearchOption &option) const {
+        auto dim = key.size();
+        auto limit = _epsilon * _epsilon;
+        auto snapshot_id = _store->snapshot_id();
+        auto scan = _option.max_scan == 0 ? _slots.size() : std::min(_option.max_scan, _slots.size());
+        int64_t best = -1;
+        float best_score = 0.0f;
+        for (size_t n = 0; n < scan; ++n) {
+            /// newest first, the ring is filled backwards from _next.
+            auto i = (_next + _slots.size() - 1 - n) % _slots.size();
+            auto &slot = _slots[i];
+            if (!slot.used) {
+                break;
+            }
+            auto age = snapshot_id - std::min(snapshot_id, slot.snapshot_id);
+            if (!slot.same_params(option) || age > _option.max_staleness) {
+                continue;
+            }
+            auto *cached = _keys.data() + i * dim;
+            auto bound = limit * slot.norm;
+            float d = 0.0f;
+            for (size_t j = 0; j < dim && d <= bound; ++j) {
+                auto diff = key[j] - cached[j];
+                d += diff * diff;
+            }
+            if (d > bound) {
+                continue;
+            }
+            auto score = slot.norm > 0.0f ? d / slot.norm : 0.0f;
+            if (best < 0 || score < best_score) {
+                best = static_cast<int64_t>(i);
+                best_score = score;
+            }
+        }
+        return best;
+    }
+
+    void SemanticCacheIndex::remember(const std::vector<float> &key, const SearchOption &option,
+                                      const std::vector<SearchHit> &hits) const {
+        if (_slots.empty()) {
+            return;
+        }
+        auto i = _next;
+        _next = (_next + 1) % _slots.size();
+        std::memcpy(_keys.data() + i * key.size(), key.data(), key.size() * sizeof(float));
+        auto &slot = _slots[i];
+        slot.used = true;
+        slot.k = option.k;
+        slot.ef = option.ef;
+        slot.nprobe = option.nprobe;
+        slot.rerank = option.rerank;
+        slot.filter_key = option.filter_key;
+        slot.float_query = option.float_query;
+        slot.snapshot_id = _store->snapshot_id();
+        slot.norm = 0.0f;
+        for (auto v: key) {
+            slot.norm += v * v;
+        }
+        slot.hits = hits;
+    }
+
+    void SemanticCacheIndex::guard(float recall) const {
+        ++_stats.guard_checks;
+        _stats.recall = kRecallDecay * _stats.recall + (1.0f - kRecallDecay) * recall;
+        if (recall < _option.min_recall) {
+            ++_stats.guard_failures;
+            _epsilon *= 0.5f;
+        } else if (_stats.recall >= _option.min_recall) {
+            _epsilon = std::min(_option.epsilon, _epsilon * kEpsilonGrowth);
+        }
+        _stats.epsilon = _epsilon;
+    }
+
+    turbo::Result<std::vector<SearchHit> > SemanticCacheIndex::search(turbo::span<uint8_t> query,
+                                                                     const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (option.filter && option.filter_key == 0) {
+            ++_bypasses;
+            return _index->search(query, option);
+        }
+        QueryVector prepared(_store->get_vector_space());
+        auto rs = prepared.assign(query, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        std::vector<float> key;
+        if (!make_key(prepared.span(), &key)) {
+            ++_bypasses;
+            return _index->search(query, option);
+        }
+
+        std::vector<SearchHit> cached;
+        bool check = false;
+        {
+            std::shared_lock<std::shared_mutex> lk(_mutex);
+            auto slot = lookup(key, option);
+            if (slot < 0) {
+                ++_misses;
+            } else {
+                ++_hits;
+                cached = _slots[slot].hits;
+                check = _option.guard_interval > 0 && ++_hits_since_guard >= _option.guard_interval;
+                if (!check) {
+                    return cached;
+                }
+                _hits_since_guard = 0;
+            }
+        }
+
+        /// the prepared copy is only the cache key, the inner index prepares
+        /// the raw query itself and a second transform would not be a no-op.
+        auto srs = _index->search(query, option);
+        if (!srs.ok()) {
+            return srs;
+        }
+        std::unique_lock<std::shared_mutex> lk(_mutex);
+        if (check) {
+            guard(SearchTuner::recall(srs.value_or_die(), cached));
+        }
+        remember(key, option, srs.value_or_die());
+        return srs;
+    }
+
+    SemanticCacheStats SemanticCacheIndex::stats() const {
+        std::shared_lock<std::shared_mutex> lk(_mutex);
+        auto stats = _stats;
+        stats.hits = _hits.load();
+        stats.misses = _misses.load();
+        stats.bypasses = _bypasses.load();
+        return stats;
+    }
+
+    void SemanticCacheIndex::clear() {
+        std::unique_lock<std::shared_mutex> lk(_mutex);
+        for (auto &slot: _slots) {
+            slot = Slot();
+        }
+        _next = 0;
+    }
+} // namespace xann
@@ -0,0 +1,187 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+#include <xann/core/vector_space.h>
+#include <xann/index/vector_index.h>
+
+namespace xann {
+
+    struct SemanticCacheOption {
+        /// ring of recent queries.
+        size_t capacity{1024};
+        /// newest slots compared per lookup, 0 scans the whole ring.
+        size_t max_scan{256};
+        /// a cached query q' serves q when |q - q'| <= epsilon * |q'| on the
+        /// prepared queries seen as floats, whatever the space metric.
+        float epsilon{0.05f};
+        /// entries older than this many snapshot ids are not served.
+        uint64_t max_staleness{0};
+        /// every guard_interval-th hit also runs the real search, 0 disables.
+        uint32_t guard_interval{64};
+        /// epsilon is halved when the guarded recall drops below this.
+        float min_recall{0.9f};
+    };
+
+    struct SemanticCacheStats {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t bypasses{0};
+        uint64_t guard_checks{0};
+        uint64_t guard_failures{0};
+        /// moving average of the guarded recall.
+        float recall{1.0f};
+        /// current epsilon after guard adjustments.
+        float epsilon{0.0f};
+
+        [[nodiscard]] double hit_rate() const {
+            auto total = hits + misses;
+            return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+        }
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Near duplicate query cache in front of another index.
+    ///
+    /// @details  The last capacity prepared queries, widened to floats, and
+    ///           their hits are kept in a ring. A new query is compared to the
+    ///           newest max_scan of them by relative L2 distance and served
+    ///           from the closest one within epsilon that has the same k,
+    ///           knobs, filter_key and query type. The space operator is not
+    ///           used: an inner product says nothing about two unnormalized
+    ///           queries being near duplicates. Lookups share the cache lock,
+    ///           only inserts and guard updates take it exclusively. A sample
+    ///           of hits is re-run against the inner index, and epsilon
+    ///           shrinks while the measured recall is below min_recall.
+    ///           Spaces whose data type has no float view, e.g. binary
+    ///           fingerprints, are passed through uncached.
+    ///
+    class SemanticCacheIndex : public VectorIndex {
+    public:
+        SemanticCacheIndex(std::unique_ptr<VectorIndex> index, SemanticCacheOption option = {});
+
+        [[nodiscard]] std::string_view name() const override {
+            return _index->name();
+        }
+
+        turbo::Status build(const MemStore *store) override;
+
+        turbo::Status add(uint64_t lid) override {
+            return _index->add(lid);
+        }
+
+        turbo::Status update(uint64_t lid) override {
+            return _index->update(lid);
+        }
+
+        turbo::Status remove(uint64_t lid) override {
+            return _index->remove(lid);
+        }
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const override;
+
+        [[nodiscard]] uint64_t size() const override {
+            return _index->size();
+        }
+
+        [[nodiscard]] SearchKnob search_knob() const override {
+            return _index->search_knob();
+        }
+
+        [[nodiscard]] uint64_t pending_deletes() const override {
+            return _index->pending_deletes();
+        }
+
+        turbo::Result<std::vector<uint64_t> > consolidate(size_t max_lids) override {
+            return _index->consolidate(max_lids);
+        }
+
+        void purge(const std::vector<uint64_t> &lids) override {
+            _index->purge(lids);
+        }
+
+        turbo::Status maintain() override {
+            return _index->maintain();
+        }
+
+        [[nodiscard]] const VectorIndex *inner() const {
+            return _index.get();
+        }
+
+        [[nodiscard]] SemanticCacheStats stats() const;
+
+        void clear();
+
+    private:
+        struct Slot {
+            bool used{false};
+            uint32_t k{0};
+            uint32_t ef{0};
+            uint32_t nprobe{0};
+            uint32_t rerank{0};
+            uint64_t filter_key{0};
+            bool float_query{false};
+            uint64_t snapshot_id{0};
+            /// squared norm of the key.
+            float norm{0.0f};
+            std::vector<SearchHit> hits;
+
+            [[nodiscard]] bool same_params(const SearchOption &option) const {
+                return used && k == option.k && ef == option.ef && nprobe == option.nprobe &&
+                       rerank == option.rerank && filter_key == option.filter_key &&
+                       float_query == option.float_query;
+            }
+        };
+
+        /// the prepared query as dim floats, false if the data type has none.
+        [[nodiscard]] bool make_key(turbo::span<uint8_t> prepared, std::vector<float> *key) const;
+
+        /// nearest usable slot within the current epsilon, -1 if none.
+        [[nodiscard]] int64_t lookup(const std::vector<float> &key, const SearchOption &option) const;
+
+        void remember(const std::vector<float> &key, const SearchOption &option,
+                      const std::vector<SearchHit> &hits) const;
+
+        void guard(float recall) const;
+
+    private:
+        std::unique_ptr<VectorIndex> _index;
+        SemanticCacheOption _option;
+
+        /// shared by lookups, exclusive for remember, guard and clear.
+        mutable std::shared_mutex _mutex;
+        /// capacity * dim floats, slot i at i * dim.
+        mutable std::vector<float> _keys;
+        mutable std::vector<Slot> _slots;
+        mutable size_t _next{0};
+        mutable float _epsilon{0.0f};
+        mutable std::atomic<uint64_t> _hits{0};
+        mutable std::atomic<uint64_t> _misses{0};
+        mutable std::atomic<uint64_t> _bypasses{0};
+        mutable std::atomic<uint64_t> _hits_since_guard{0};
+        /// guard counters, recall and epsilon, under the exclusive lock.
+        mutable SemanticCacheStats _stats;
+    };
+} // namespace xann
@@ -0,0 +1,278 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/index/tanimoto_index.h>
+#include <xann/common/thread_pool.h>
+#include <xann/core/query_vector.h>
+#include <xann/distance/jaccard_operator.h>
+#include <xann/index/flat_index.h>
+#include <algorithm>
+#include <cstring>
+
+namespace xann {
+
+    /// slot of a lid indexed while the space has no bins.
+    static constexpr uint32_t kUnbinned = ~uint32_t(0) - 1;
+
+    using and_popcount_func = size_t (*)(const turbo::span<uint8_t> &a, const turbo::span<uint8_t> &b);
+
+    static and_popcount_func and_popcount_kernel(SimdLevel level) {
+#ifdef XSIMD_WITH_AVX2
+        if (level == SimdLevel::SIMD_AVX2) {
+            return simd_and_popcount<xsimd::avx2>;
+        }
+#endif
+#ifdef XSIMD_WITH_SSE3
+        if (level == SimdLevel::SIMD_SSE2) {
+            return simd_and_popcount<xsimd::sse3>;
+        }
+#endif
+        (void) level;
+        return simple_and_popcount;
+    }
+
+    /// Swamidass-Baldi bound, the best tanimoto a popcount a query can reach
+    /// against a popcount b fingerprint. the float division rounds the same way
+    /// as c / (a + b - c), so the bound never undercuts a true score.
+    static float tanimoto_bound(size_t a, size_t b) {
+        if (a == 0 && b == 0) {
+            return 1.0f;
+        }
+        return static_cast<float>(std::min(a, b)) / static_cast<float>(std::max(a, b));
+    }
+
+    /// same value as simple_jaccard_distance, empty against empty is identical.
+    static float tanimoto(size_t a, size_t b, size_t common) {
+        auto joint = a + b - common;
+        if (joint == 0) {
+            return 1.0f;
+        }
+        return static_cast<float>(common) / static_cast<float>(joint);
+    }
+
+    bool TanimotoIndex::bins_supported() const {
+        return _store->get_vector_space()->metric == kJaccard;
+    }
+
+    void TanimotoIndex::insert(uint64_t lid) {
+        auto v = _store->vector_at(lid);
+        auto b = simple_bit_count(v);
+        auto &bin = _bins[b];
+        auto stride = v.size();
+        _slots[lid] = {static_cast<uint32_t>(b), static_cast<uint32_t>(bin.lids.size())};
+        bin.lids.push_back(lid);
+        bin.codes.resize(bin.lids.size() * stride);
+        std::memcpy(bin.codes.data() + (bin.lids.size() - 1) * stride, v.data(), stride);
+    }
+
+    turbo::Status TanimotoIndex::build(const MemStore *store) {
+        if (store->get_vector_space()->mixed_precision()) {
+            return turbo::invalid_argument_error("tanimoto index does not score float queries of a mixed precision space");
+        }
+        _store = store;
+        _bins.clear();
+        _slots.clear();
+        auto lids = store->live_local_ids();
+        _count = lids.size();
+        if (lids.empty()) {
+            if (bins_supported()) {
+                _bins.resize(static_cast<size_t>(store->get_vector_space()->vector_byte_size) * 8 + 1);
+            }
+            return turbo::OkStatus();
+        }
+        auto max_lid = *std::max_element(lids.begin(), lids.end());
+        _slots.assign(max_lid + 1, Slot{kNoBin, 0});
+        if (!bins_supported()) {
+            for (auto lid: lids) {
+                _slots[lid].bin = kUnbinned;
+            }
+            return turbo::OkStatus();
+        }
+        auto stride = static_cast<size_t>(store->get_vector_space()->vector_byte_size);
+        _bins.resize(stride * 8 + 1);
+        /// popcounts in parallel, then one sized copy per bin.
+        std::vector<uint32_t> bits(lids.size());
+        ThreadPool::default_pool().parallel_for(lids.size(), [&](size_t i) {
+            bits[i] = static_cast<uint32_t>(simple_bit_count(store->vector_at(lids[i])));
+        });
+        for (size_t i = 0; i < lids.size(); ++i) {
+            auto &slot = _slots[lids[i]];
+            slot.bin = bits[i];
+            slot.pos = static_cast<uint32_t>(_bins[bits[i]].lids.size());
+            _bins[bits[i]].lids.push_back(lids[i]);
+        }
+        ThreadPool::default_pool().parallel_for(_bins.size(), [&](size_t b) {
+            auto &bin = _bins[b];
+            bin.codes.resize(bin.lids.size() * stride);
+            for (size_t i = 0; i < bin.lids.size(); ++i) {
+                std::memcpy(bin.codes.data() + i * stride, store->vector_at(bin.lids[i]).data(), stride);
+            }
+        });
+        return turbo::OkStatus();
+    }
+
+    turbo::Status TanimotoIndex::add(uint64_t lid) {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (lid < _slots.size() && _slots[lid].bin != kNoBin) {
+            return turbo::already_exists_error("lid already indexed:", lid);
+        }
+        if (lid >= _slots.size()) {
+            _slots.resize(lid + 1, Slot{kNoBin, 0});
+        }
+        ++_count;
+        if (!bins_supported()) {
+            _slots[lid].bin = kUnbinned;
+            return turbo::OkStatus();
+        }
+        insert(lid);
+        return turbo::OkStatus();
+    }
+
+    turbo::Status TanimotoIndex::remove(uint64_t lid) {
+        if (lid >= _slots.size() || _slots[lid].bin == kNoBin) {
+            return turbo::OkStatus();
+        }
+        auto slot = _slots[lid];
+        _slots[lid] = Slot{kNoBin, 0};
+        --_count;
+        if (slot.bin == kUnbinned) {
+            return turbo::OkStatus();
+        }
+        /// the last entry of the bin moves into the hole.
+        auto &bin = _bins[slot.bin];
+        auto stride = static_cast<size_t>(_store->get_vector_space()->vector_byte_size);
+        auto last = bin.lids.size() - 1;
+        if (slot.pos != last) {
+            auto moved = bin.lids[last];
+            bin.lids[slot.pos] = moved;
+            std::memcpy(bin.codes.data() + slot.pos * stride, bin.codes.data() + last * stride, stride);
+            _slots[moved].pos = slot.pos;
+        }
+        bin.lids.pop_back();
+        bin.codes.resize(last * stride);
+        return turbo::OkStatus();
+    }
+
+    template<typename Fn>
+    void TanimotoIndex::scan_bin(size_t b, turbo::span<uint8_t> query, size_t query_bits,
+                                 const SearchOption &option, uint64_t *evaluations, Fn &&push) const {
+        auto &bin = _bins[b];
+        if (bin.lids.empty()) {
+            return;
+        }
+        auto and_popcount = and_popcount_kernel(_store->get_vector_space()->operation.simd_level);
+        auto &entities = _store->id_manager()->ids();
+        auto stride = query.size();
+        auto *codes = const_cast<uint8_t *>(bin.codes.data());
+        for (size_t i = 0; i < bin.lids.size(); ++i) {
+            auto &entity = entities[bin.lids[i]];
+            if (entity.status == kTombstone || (option.filter && !option.filter(entity.label))) {
+                continue;
+            }
+            ++*evaluations;
+            auto common = and_popcount(query, turbo::span<uint8_t>(codes + i * stride, stride));
+            push(tanimoto(query_bits, b, common), bin.lids[i]);
+        }
+    }
+
+    turbo::Result<std::vector<SearchHit> > TanimotoIndex::search(turbo::span<uint8_t> query,
+                                                                const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        QueryVector qv(_store->get_vector_space());
+        auto rs = qv.assign(query, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto q = qv.span();
+        if (!bins_supported()) {
+            return flat_scan(_store, q, option);
+        }
+        auto a = simple_bit_count(q);
+        TopKCollector collector(option.k);
+        uint64_t evaluations = 0;
+        auto push = [&](float similarity, uint64_t lid) {
+            collector.push(1.0f - similarity, lid);
+        };
+        /// bounds fall off on both sides of b = a, take the better side each
+        /// step and stop once neither can beat the k-th score.
+        auto nbins = _bins.size();
+        auto below = static_cast<int64_t>(std::min(a, nbins - 1));
+        auto above = below + 1;
+        while (below >= 0 || above < static_cast<int64_t>(nbins)) {
+            float below_bound = below >= 0 ? tanimoto_bound(a, static_cast<size_t>(below)) : -1.0f;
+            float above_bound = above < static_cast<int64_t>(nbins) ? tanimoto_bound(a, static_cast<size_t>(above)) : -1.0f;
+            auto take_below = below_bound >= above_bound;
+            auto bound = take_below ? below_bound : above_bound;
+            if (!(1.0f - bound < collector.threshold())) {
+                break;
+            }
+            scan_bin(static_cast<size_t>(take_below ? below-- : above++), q, a, option, &evaluations, push);
+        }
+        _last_evaluations.store(evaluations, std::memory_order_relaxed);
+
+        auto &entities = _store->id_manager()->ids();
+        auto entries = collector.finish();
+        std::vector<SearchHit> hits;
+        hits.reserve(entries.size());
+        for (auto &e: entries) {
+            hits.push_back({entities[e.lid].label, e.lid, e.score});
+        }
+        return hits;
+    }
+
+    turbo::Result<std::vector<SearchHit> > TanimotoIndex::threshold_search(turbo::span<uint8_t> query,
+                                                                          float min_similarity,
+                                                                          const SearchOption &option) const {
+        if (!_store) {
+            return turbo::failed_precondition_error("index not built");
+        }
+        if (!bins_supported()) {
+            return turbo::invalid_argument_error("threshold search needs kJaccard, metric:",
+                                                 _store->get_vector_space()->metric);
+        }
+        QueryVector qv(_store->get_vector_space());
+        auto rs = qv.assign(query, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        auto q = qv.span();
+        auto a = simple_bit_count(q);
+        auto &entities = _store->id_manager()->ids();
+        std::vector<SearchHit> hits;
+        uint64_t evaluations = 0;
+        auto push = [&](float similarity, uint64_t lid) {
+            if (similarity >= min_similarity) {
+                hits.push_back({entities[lid].label, lid, 1.0f - similarity});
+            }
+        };
+        for (size_t b = 0; b < _bins.size(); ++b) {
+            if (tanimoto_bound(a, b) >= min_similarity) {
+                scan_bin(b, q, a, option, &evaluations, push);
+            }
+        }
+        _last_evaluations.store(evaluations, std::memory_order_relaxed);
+        std::sort(hits.begin(), hits.end(), [](const SearchHit &lhs, const SearchHit &rhs) {
+            return lhs.distance < rhs.distance;
+        });
+        return hits;
+    }
+} // namespace xann
@@ -0,0 +1,103 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <xann/core/vector_space.h>
+#include <xann/index/vector_index.h>
+
+namespace xann {
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Exact Tanimoto search over binary fingerprints binned by popcount.
+    ///
+    /// @details  Every stored fingerprint goes to the bin of its popcount,
+    ///           and a bin keeps copies of its fingerprints back to back. A
+    ///           query with popcount a can reach at most min(a, b) / max(a, b)
+    ///           against bin b (Swamidass and Baldi), so top-k visits bins
+    ///           from b = a outwards by that bound and stops once it cannot
+    ///           beat the k-th score, and threshold search only scans the bins
+    ///           with b in [t * a, a / t]. Inside a bin only popcount(q & x)
+    ///           is computed, with the SIMD kernel of the space's level. Hits
+    ///           carry the kJaccard operator value 1 - tanimoto. The bins need
+    ///           kJaccard, every other space runs flat scans.
+    ///
+    class TanimotoIndex : public VectorIndex {
+    public:
+        TanimotoIndex() = default;
+
+        [[nodiscard]] std::string_view name() const override {
+            return "tanimoto";
+        }
+
+        turbo::Status build(const MemStore *store) override;
+
+        turbo::Status add(uint64_t lid) override;
+
+        turbo::Status remove(uint64_t lid) override;
+
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                   const SearchOption &option) const override;
+
+        /// every visible fingerprint with tanimoto similarity >= min_similarity, best first.
+        [[nodiscard]] turbo::Result<std::vector<SearchHit> > threshold_search(turbo::span<uint8_t> query,
+                                                                             float min_similarity,
+                                                                             const SearchOption &option) const;
+
+        [[nodiscard]] uint64_t size() const override {
+            return _count;
+        }
+
+        [[nodiscard]] bool bins_supported() const;
+
+        /// fingerprints whose and-popcount was computed by the last search, for tests and tuning.
+        [[nodiscard]] uint64_t last_evaluations() const {
+            return _last_evaluations.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct Bin {
+            std::vector<uint64_t> lids;
+            /// vector_byte_size bytes per entry of lids.
+            AlignedBytes codes;
+        };
+
+        struct Slot {
+            uint32_t bin{0};
+            uint32_t pos{0};
+        };
+
+        static constexpr uint32_t kNoBin = ~uint32_t(0);
+
+        void insert(uint64_t lid);
+
+        /// scan bin b, push(similarity, lid) for every visible entry.
+        template<typename Fn>
+        void scan_bin(size_t b, turbo::span<uint8_t> query, size_t query_bits, const SearchOption &option,
+                      uint64_t *evaluations, Fn &&push) const;
+
+    private:
+        std::vector<Bin> _bins;
+        std::vector<Slot> _slots;
+        uint64_t _count{0};
+        mutable std::atomic<uint64_t> _last_evaluations{0};
+    };
+} // namespace xann
@@ -0,0 +1,142 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <turbo/container/span.h>
+#include <turbo/utility/status.h>
+#include <xann/core/option.h>
+#include <xann/core/search.h>
+#include <xann/store/store.h>
+
+namespace xann {
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Search structure over the vectors of one MemStore.
+    ///
+    /// @details  Vectors live in the store, the index only keeps lids and its
+    ///           own routing data. Locking follows the store: the caller holds
+    ///           store->mutex() exclusively around build/add/update/remove and
+    ///           at least shared around search, so const methods must be safe
+    ///           to run concurrently with each other.
+    ///
+    class VectorIndex {
+    public:
+        virtual ~VectorIndex() = default;
+
+        [[nodiscard]] virtual std::string_view name() const = 0;
+
+        /// bind to store and build from all of its live vectors, dropping any previous state.
+        virtual turbo::Status build(const MemStore *store) = 0;
+
+        /// lid was just added to the bound store.
+        virtual turbo::Status add(uint64_t lid) = 0;
+
+        /// the vector of lid was overwritten in the bound store.
+        virtual turbo::Status update(uint64_t lid) {
+            auto rs = remove(lid);
+            if (!rs.ok()) {
+                return rs;
+            }
+            return add(lid);
+        }
+
+        /// lid is about to be freed or was tombstoned in the bound store.
+        virtual turbo::Status remove(uint64_t lid) = 0;
+
+        /// true if add can be split into reserve + add_shared, letting inserts
+        /// run in parallel with each other and with searches.
+        [[nodiscard]] virtual bool concurrent_add() const {
+            return false;
+        }
+
+        /// first half of a concurrent add, under the exclusive store lock right
+        /// after the store allocated lid. sizes the index for lid.
+        virtual turbo::Status reserve(uint64_t) {
+            return turbo::unimplemented_error("index ", name(), " has no concurrent add");
+        }
+
+        /// second half of a concurrent add, under a shared store lock.
+        virtual turbo::Status add_shared(uint64_t) {
+            return turbo::unimplemented_error("index ", name(), " has no concurrent add");
+        }
+
+        /// removed lids the index still routes through, 0 for indexes whose remove unlinks at once.
+        [[nodiscard]] virtual uint64_t pending_deletes() const {
+            return 0;
+        }
+
+        /// repair the index around up to max_lids (0 for all) removed lids,
+        /// under a shared store lock next to searches and add_shared. the
+        /// returned lids go to purge() under the exclusive lock.
+        virtual turbo::Result<std::vector<uint64_t> > consolidate(size_t) {
+            return std::vector<uint64_t>();
+        }
+
+        /// forget consolidated lids that are still removed, the store may free them afterwards.
+        virtual void purge(const std::vector<uint64_t> &) {
+        }
+
+        /// incremental upkeep that keeps search cost bounded without a rebuild,
+        /// under the exclusive store lock.
+        virtual turbo::Status maintain() {
+            return turbo::OkStatus();
+        }
+
+        /// query is dim * element_size or vector_byte_size bytes, hits are sorted best first.
+        [[nodiscard]] virtual turbo::Result<std::vector<SearchHit> > search(turbo::span<uint8_t> query,
+                                                                           const SearchOption &option) const = 0;
+
+        /// number of vectors reachable through the index.
+        [[nodiscard]] virtual uint64_t size() const = 0;
+
+        [[nodiscard]] const MemStore *store() const {
+            return _store;
+        }
+
+        /// the parameter SearchTuner adjusts for this index.
+        [[nodiscard]] virtual SearchKnob search_knob() const {
+            return SearchKnob::kNone;
+        }
+
+        [[nodiscard]] const SearchTuning &tuning() const {
+            return _tuning;
+        }
+
+        /// callers hold store->mutex() exclusively, like the mutators.
+        void set_tuning(const SearchTuning &tuning) {
+            _tuning = tuning;
+        }
+
+        /// option with the tuned knob applied when option.use_tuning is set.
+        [[nodiscard]] SearchOption tuned_option(const SearchOption &option) const {
+            SearchOption tuned = option;
+            if (option.use_tuning && _tuning.valid() && _tuning.knob == search_knob()) {
+                _tuning.apply(tuned);
+            }
+            return tuned;
+        }
+
+    protected:
+        const MemStore *_store{nullptr};
+        SearchTuning _tuning;
+    };
+} // namespace xann
@@ -0,0 +1,91 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/quantization/linear_transform.h>
+#include <xann/common/thread_pool.h>
+#include <algorithm>
+
+namespace xann {
+
+    gemv_func select_gemv(SimdLevel level) {
+#ifdef XSIMD_WITH_AVX2
+        if (level >= SimdLevel::SIMD_AVX2) {
+            return simd_gemv<xsimd::avx2>;
+        }
+#endif
+#ifdef XSIMD_WITH_SSE3
+        if (level >= SimdLevel::SIMD_SSE2) {
+            return simd_gemv<xsimd::sse3>;
+        }
+#endif
+        (void) level;
+        return simple_gemv;
+    }
+
+    turbo::Status LinearTransform::init(size_t rows, size_t cols, std::vector<float> matrix, SimdLevel level) {
+        if (rows == 0 || cols == 0 || matrix.size() != rows * cols) {
+            return turbo::invalid_argument_error("linear transform rows:", rows, " cols:", cols, " matrix size:",
+                                                 matrix.size());
+        }
+        _rows = rows;
+        _cols = cols;
+        _matrix = std::move(matrix);
+        _bias.clear();
+        _gemv = select_gemv(level);
+        return turbo::OkStatus();
+    }
+
+    turbo::Status LinearTransform::set_bias(std::vector<float> bias) {
+        if (!bias.empty() && bias.size() != _rows) {
+            return turbo::invalid_argument_error("bias size:", bias.size(), " rows:", _rows);
+        }
+        _bias = std::move(bias);
+        return turbo::OkStatus();
+    }
+
+    LinearTransform LinearTransform::identity(size_t dim, SimdLevel level) {
+        std::vector<float> matrix(dim * dim, 0.0f);
+        for (size_t i = 0; i < dim; ++i) {
+            matrix[i * dim + i] = 1.0f;
+        }
+        LinearTransform t;
+        (void) t.init(dim, dim, std::move(matrix), level);
+        return t;
+    }
+
+    void LinearTransform::apply_n(const float *x, size_t n, float *y, ThreadPool *pool) const {
+        constexpr size_t kChunk = 256;
+        auto &p = pool ? *pool : ThreadPool::default_pool();
+        p.parallel_for((n + kChunk - 1) / kChunk, [&](size_t chunk) {
+            auto end = std::min(n, (chunk + 1) * kChunk);
+            for (auto i = chunk * kChunk; i < end; ++i) {
+                apply(x + i * _cols, y + i * _rows);
+            }
+        });
+    }
+
+    void LinearTransform::apply_transpose(const float *y, float *x) const {
+        std::fill(x, x + _cols, 0.0f);
+        for (size_t r = 0; r < _rows; ++r) {
+            auto *row = _matrix.data() + r * _cols;
+            for (size_t c = 0; c < _cols; ++c) {
+                x[c] += row[c] * y[r];
+            }
+        }
+    }
+} // namespace xann
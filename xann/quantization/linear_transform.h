@@ -0,0 +1,169 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <turbo/utility/status.h>
+#include <xann/core/operator_registry.h>
+#include <xsimd/xsimd.hpp>
+
+namespace xann {
+    class ThreadPool;
+
+    typedef void (*gemv_func)(const float *matrix, size_t rows, size_t cols, const float *x, float *y);
+
+    /// y = matrix * x for a rows x cols row major matrix.
+    inline void simple_gemv(const float *matrix, size_t rows, size_t cols, const float *x, float *y) {
+        for (size_t r = 0; r < rows; ++r) {
+            auto *row = matrix + r * cols;
+            float sum = 0.0f;
+            for (size_t c = 0; c < cols; ++c) {
+                sum += row[c] * x[c];
+            }
+            y[r] = sum;
+        }
+    }
+
+    /// four rows per pass so every load of x feeds four fma.
+    template<typename ARCH>
+    void simd_gemv(const float *matrix, size_t rows, size_t cols, const float *x, float *y) {
+        using b_type = xsimd::batch<float, ARCH>;
+        std::size_t inc = b_type::size;
+        std::size_t vec_size = cols - cols % inc;
+        size_t r = 0;
+        for (; r + 4 <= rows; r += 4) {
+            auto *r0 = matrix + r * cols;
+            auto *r1 = r0 + cols;
+            auto *r2 = r1 + cols;
+            auto *r3 = r2 + cols;
+            b_type s0 = b_type::broadcast(0.0f);
+            b_type s1 = b_type::broadcast(0.0f);
+            b_type s2 = b_type::broadcast(0.0f);
+            b_type s3 = b_type::broadcast(0.0f);
+            for (std::size_t c = 0; c < vec_size; c += inc) {
+                b_type xv = b_type::load(x + c, xsimd::unaligned_mode());
+                s0 = xsimd::fma(b_type::load(r0 + c, xsimd::unaligned_mode()), xv, s0);
+                s1 = xsimd::fma(b_type::load(r1 + c, xsimd::unaligned_mode()), xv, s1);
+                s2 = xsimd::fma(b_type::load(r2 + c, xsimd::unaligned_mode()), xv, s2);
+                s3 = xsimd::fma(b_type::load(r3 + c, xsimd::unaligned_mode()), xv, s3);
+            }
+            float t0 = xsimd::reduce_add(s0);
+            float t1 = xsimd::reduce_add(s1);
+            float t2 = xsimd::reduce_add(s2);
+            float t3 = xsimd::reduce_add(s3);
+            for (std::size_t c = vec_size; c < cols; ++c) {
+                t0 += r0[c] * x[c];
+                t1 += r1[c] * x[c];
+                t2 += r2[c] * x[c];
+                t3 += r3[c] * x[c];
+            }
+            y[r] = t0;
+            y[r + 1] = t1;
+            y[r + 2] = t2;
+            y[r + 3] = t3;
+        }
+        for (; r < rows; ++r) {
+            auto *row = matrix + r * cols;
+            b_type s = b_type::broadcast(0.0f);
+            for (std::size_t c = 0; c < vec_size; c += inc) {
+                s = xsimd::fma(b_type::load(row + c, xsimd::unaligned_mode()),
+                               b_type::load(x + c, xsimd::unaligned_mode()), s);
+            }
+            float t = xsimd::reduce_add(s);
+            for (std::size_t c = vec_size; c < cols; ++c) {
+                t += row[c] * x[c];
+            }
+            y[r] = t;
+        }
+    }
+
+    /// best gemv kernel compiled in for level.
+    gemv_func select_gemv(SimdLevel level);
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Dense affine map y = A x + b applied to queries and stored vectors.
+    ///
+    /// @details  A is rows x cols row major, b is optional. Indexes keep one next to their
+    ///           codes (an OPQ rotation, a projection) and run every query
+    ///           through apply() once before scoring, so the per query cost
+    ///           is a single SIMD gemv.
+    ///
+    class LinearTransform {
+    public:
+        LinearTransform() = default;
+
+        /// matrix holds rows * cols floats.
+        turbo::Status init(size_t rows, size_t cols, std::vector<float> matrix,
+                           SimdLevel level = SimdLevel::SIMD_NONE);
+
+        /// rows x rows identity.
+        static LinearTransform identity(size_t dim, SimdLevel level = SimdLevel::SIMD_NONE);
+
+        [[nodiscard]] bool empty() const {
+            return _rows == 0;
+        }
+
+        [[nodiscard]] size_t rows() const {
+            return _rows;
+        }
+
+        [[nodiscard]] size_t cols() const {
+            return _cols;
+        }
+
+        [[nodiscard]] const std::vector<float> &matrix() const {
+            return _matrix;
+        }
+
+        /// rows floats, empty for a linear map.
+        turbo::Status set_bias(std::vector<float> bias);
+
+        [[nodiscard]] const std::vector<float> &bias() const {
+            return _bias;
+        }
+
+        void set_simd_level(SimdLevel level) {
+            _gemv = select_gemv(level);
+        }
+
+        /// x has cols floats, y rows.
+        void apply(const float *x, float *y) const {
+            _gemv(_matrix.data(), _rows, _cols, x, y);
+            for (size_t r = 0; r < _bias.size(); ++r) {
+                y[r] += _bias[r];
+            }
+        }
+
+        /// n row major rows, nullptr pool means ThreadPool::default_pool().
+        void apply_n(const float *x, size_t n, float *y, ThreadPool *pool = nullptr) const;
+
+        /// x = A^T y, the inverse of the linear part when A is orthogonal.
+        void apply_transpose(const float *y, float *x) const;
+
+    private:
+        size_t _rows{0};
+        size_t _cols{0};
+        std::vector<float> _matrix;
+        std::vector<float> _bias;
+        gemv_func _gemv{simple_gemv};
+    };
+} // namespace xann
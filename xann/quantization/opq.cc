@@ -0,0 +1,178 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/quantization/opq.h>
+#include <xann/common/thread_pool.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace xann {
+
+    static constexpr size_t kRowChunk = 16;
+    static constexpr int kMaxPolarIterations = 100;
+    static constexpr double kPolarTolerance = 1e-3;
+
+    /// c (n x m) = a (n x k) * b (k x m), all row major.
+    static void matmul(const float *a, const float *b, float *c, size_t n, size_t k, size_t m, ThreadPool &pool) {
+        pool.parallel_for((n + kRowChunk - 1) / kRowChunk, [&](size_t chunk) {
+            auto end = std::min(n, (chunk + 1) * kRowChunk);
+            for (auto i = chunk * kRowChunk; i < end; ++i) {
+                auto *ci = c + i * m;
+                std::fill(ci, ci + m, 0.0f);
+                for (size_t p = 0; p < k; ++p) {
+                    auto aip = a[i * k + p];
+                    auto *bp = b + p * m;
+                    for (size_t j = 0; j < m; ++j) {
+                        ci[j] += aip * bp[j];
+                    }
+                }
+            }
+        });
+    }
+
+    /// c (k x m) = a^T b for a (n x k) and b (n x m), all row major.
+    static void matmul_tn(const float *a, const float *b, float *c, size_t n, size_t k, size_t m, ThreadPool &pool) {
+        pool.parallel_for((k + kRowChunk - 1) / kRowChunk, [&](size_t chunk) {
+            auto begin = chunk * kRowChunk;
+            auto end = std::min(k, begin + kRowChunk);
+            std::vector<double> acc((end - begin) * m, 0.0);
+            for (size_t i = 0; i < n; ++i) {
+                auto *bi = b + i * m;
+                for (auto p = begin; p < end; ++p) {
+                    auto api = static_cast<double>(a[i * k + p]);
+                    auto *row = acc.data() + (p - begin) * m;
+                    for (size_t j = 0; j < m; ++j) {
+                        row[j] += api * bi[j];
+                    }
+                }
+            }
+            for (auto p = begin; p < end; ++p) {
+                for (size_t j = 0; j < m; ++j) {
+                    c[p * m + j] = static_cast<float>(acc[(p - begin) * m + j]);
+                }
+            }
+        });
+    }
+
+    bool orthogonal_polar(const std::vector<float> &a, size_t d, std::vector<float> *q, ThreadPool *pool) {
+        auto &p = pool ? *pool : ThreadPool::default_pool();
+        double norm = 0.0;
+        for (auto v: a) {
+            norm += static_cast<double>(v) * v;
+        }
+        if (norm <= 0.0) {
+            return false;
+        }
+        /// scaled so every singular value is in (0, 1], the iteration
+        /// X = X (3 I - X^T X) / 2 then drives them all to 1.
+        auto scale = static_cast<float>(1.0 / std::sqrt(norm));
+        std::vector<float> x(a.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            x[i] = a[i] * scale;
+        }
+        std::vector<float> g(d * d);
+        std::vector<float> next(d * d);
+        for (int it = 0; it < kMaxPolarIterations; ++it) {
+            matmul_tn(x.data(), x.data(), g.data(), d, d, d, p);
+            double err = 0.0;
+            for (size_t i = 0; i < d; ++i) {
+                for (size_t j = 0; j < d; ++j) {
+                    auto e = static_cast<double>(g[i * d + j]) - (i == j ? 1.0 : 0.0);
+                    err += e * e;
+                }
+            }
+            if (std::sqrt(err) < kPolarTolerance) {
+                *q = std::move(x);
+                return true;
+            }
+            for (size_t i = 0; i < d; ++i) {
+                for (size_t j = 0; j < d; ++j) {
+                    g[i * d + j] = (i == j ? 1.5f : 0.0f) - 0.5f * g[i * d + j];
+                }
+            }
+            matmul(x.data(), g.data(), next.data(), d, d, d, p);
+            std::swap(x, next);
+        }
+        return false;
+    }
+
+    turbo::Status train_opq(const float *data, size_t n, size_t dim, const PqOption &pq_option,
+                            const OpqOption &option, SimdLevel level, LinearTransform *rotation,
+                            ProductQuantizer *pq) {
+        if (n == 0 || dim == 0) {
+            return turbo::invalid_argument_error("opq needs data, n:", n, " dim:", dim);
+        }
+        auto &pool = pq_option.pool ? *pq_option.pool : ThreadPool::default_pool();
+        std::vector<float> r;
+        {
+            std::mt19937_64 rng(option.seed);
+            std::normal_distribution<float> gauss;
+            std::vector<float> random(dim * dim);
+            for (auto &v: random) {
+                v = gauss(rng);
+            }
+            if (!orthogonal_polar(random, dim, &r, &pool)) {
+                r = LinearTransform::identity(dim).matrix();
+            }
+        }
+        LinearTransform rot;
+        auto rs = rot.init(dim, dim, r, level);
+        if (!rs.ok()) {
+            return rs;
+        }
+        std::vector<float> rotated(n * dim);
+        std::vector<float> decoded(n * dim);
+        std::vector<uint8_t> codes;
+        std::vector<float> cross(dim * dim);
+        auto inner = pq_option;
+        inner.train_iterations = option.pq_iterations;
+        for (uint32_t it = 0; it < option.iterations; ++it) {
+            rot.apply_n(data, n, rotated.data(), &pool);
+            ProductQuantizer step;
+            rs = step.train(rotated.data(), n, dim, inner);
+            if (!rs.ok()) {
+                return rs;
+            }
+            codes.resize(n * step.code_size());
+            step.encode_n(rotated.data(), n, codes.data(), &pool);
+            for (size_t i = 0; i < n; ++i) {
+                step.decode(codes.data() + i * step.code_size(), decoded.data() + i * dim);
+            }
+            /// argmin over orthogonal R of sum |R x - y|^2 is polar(Y^T X).
+            matmul_tn(decoded.data(), data, cross.data(), n, dim, dim, pool);
+            std::vector<float> next;
+            if (!orthogonal_polar(cross, dim, &next, &pool)) {
+                break;
+            }
+            rs = rot.init(dim, dim, std::move(next), level);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        rot.apply_n(data, n, rotated.data(), &pool);
+        ProductQuantizer result;
+        rs = result.train(rotated.data(), n, dim, pq_option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        *rotation = std::move(rot);
+        *pq = std::move(result);
+        return turbo::OkStatus();
+    }
+} // namespace xann
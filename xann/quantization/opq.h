@@ -0,0 +1,46 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <xann/quantization/linear_transform.h>
+#include <xann/quantization/product_quantizer.h>
+
+namespace xann {
+
+    struct OpqOption {
+        /// alternations between codebooks and rotation.
+        uint32_t iterations{8};
+        /// k-means iterations of the codebooks inside an alternation, the
+        /// final codebooks use PqOption::train_iterations.
+        uint32_t pq_iterations{4};
+        uint64_t seed{1234};
+    };
+
+    /// orthogonal polar factor of the d x d matrix a (U V^T of its svd) by
+    /// Newton-Schulz iteration. false if a is singular and it did not converge.
+    bool orthogonal_polar(const std::vector<float> &a, size_t d, std::vector<float> *q, ThreadPool *pool = nullptr);
+
+    /// non parametric OPQ: learn an orthogonal dim x dim rotation R and the
+    /// codebooks of R x, alternating k-means on the rotated data with the
+    /// Procrustes solution R = polar(sum decode(encode(R x)) x^T). starts
+    /// from a random rotation so the sub spaces share the variance.
+    turbo::Status train_opq(const float *data, size_t n, size_t dim, const PqOption &pq_option,
+                            const OpqOption &option, SimdLevel level, LinearTransform *rotation,
+                            ProductQuantizer *pq);
+} // namespace xann
@@ -0,0 +1,104 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/quantization/product_quantizer.h>
+#include <xann/common/kmeans.h>
+#include <xann/common/thread_pool.h>
+#include <algorithm>
+
+namespace xann {
+
+    turbo::Status ProductQuantizer::train(const float *data, size_t n, size_t dim, const PqOption &option) {
+        if (n == 0 || dim == 0 || option.m == 0 || dim % option.m != 0) {
+            return turbo::invalid_argument_error("product quantizer needs data and m dividing dim, n:", n,
+                                                 " dim:", dim, " m:", option.m);
+        }
+        auto m = static_cast<size_t>(option.m);
+        auto dsub = dim / m;
+        auto ksub = std::min(kMaxKsub, n);
+        std::vector<float> codebooks(m * ksub * dsub);
+        std::vector<float> sub(n * dsub);
+        for (size_t j = 0; j < m; ++j) {
+            for (size_t i = 0; i < n; ++i) {
+                std::copy_n(data + i * dim + j * dsub, dsub, sub.data() + i * dsub);
+            }
+            KMeansOption ko;
+            ko.k = static_cast<uint32_t>(ksub);
+            ko.iterations = option.train_iterations;
+            ko.seed = option.seed + j;
+            ko.pool = option.pool;
+            std::vector<float> centroids;
+            auto rs = kmeans_train(sub.data(), n, dsub, ko, &centroids);
+            if (!rs.ok()) {
+                return rs;
+            }
+            std::copy(centroids.begin(), centroids.end(), codebooks.begin() + j * ksub * dsub);
+        }
+        _dim = dim;
+        _m = m;
+        _dsub = dsub;
+        _ksub = ksub;
+        _codebooks = std::move(codebooks);
+        return turbo::OkStatus();
+    }
+
+    void ProductQuantizer::encode(const float *x, uint8_t *code) const {
+        for (size_t j = 0; j < _m; ++j) {
+            code[j] = static_cast<uint8_t>(kmeans_nearest(centroid(j, 0), _ksub, _dsub, x + j * _dsub));
+        }
+    }
+
+    void ProductQuantizer::encode_n(const float *x, size_t n, uint8_t *codes, ThreadPool *pool) const {
+        constexpr size_t kChunk = 256;
+        auto &p = pool ? *pool : ThreadPool::default_pool();
+        p.parallel_for((n + kChunk - 1) / kChunk, [&](size_t chunk) {
+            auto end = std::min(n, (chunk + 1) * kChunk);
+            for (auto i = chunk * kChunk; i < end; ++i) {
+                encode(x + i * _dim, codes + i * _m);
+            }
+        });
+    }
+
+    void ProductQuantizer::decode(const uint8_t *code, float *x) const {
+        for (size_t j = 0; j < _m; ++j) {
+            std::copy_n(centroid(j, code[j]), _dsub, x + j * _dsub);
+        }
+    }
+
+    void ProductQuantizer::compute_l2_table(const float *q, float *table) const {
+        for (size_t j = 0; j < _m; ++j) {
+            for (size_t c = 0; c < _ksub; ++c) {
+                table[j * _ksub + c] = l2_sqr(q + j * _dsub, centroid(j, c), _dsub);
+            }
+        }
+    }
+
+    void ProductQuantizer::compute_ip_table(const float *q, float *table) const {
+        for (size_t j = 0; j < _m; ++j) {
+            auto *qs = q + j * _dsub;
+            for (size_t c = 0; c < _ksub; ++c) {
+                auto *cs = centroid(j, c);
+                float sum = 0.0f;
+                for (size_t d = 0; d < _dsub; ++d) {
+                    sum += qs[d] * cs[d];
+                }
+                table[j * _ksub + c] = sum;
+            }
+        }
+    }
+} // namespace xann
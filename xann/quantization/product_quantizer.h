@@ -0,0 +1,120 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <turbo/utility/status.h>
+
+namespace xann {
+    class ThreadPool;
+
+    struct PqOption {
+        /// number of sub quantizers, one byte of code each, must divide dim.
+        uint32_t m{8};
+        uint32_t train_iterations{20};
+        uint64_t seed{1234};
+        /// nullptr means ThreadPool::default_pool().
+        ThreadPool *pool{nullptr};
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Product quantizer with 8 bit sub codes.
+    ///
+    /// @details  The vector is cut into m contiguous sub vectors of dim / m
+    ///           floats, each is replaced by the index of its nearest of up
+    ///           to 256 k-means centroids. Scoring is asymmetric through a
+    ///           per query table of m * ksub partial distances, so a code
+    ///           costs m lookups.
+    ///
+    class ProductQuantizer {
+    public:
+        static constexpr size_t kMaxKsub = 256;
+
+        ProductQuantizer() = default;
+
+        /// n row major rows of dim floats.
+        turbo::Status train(const float *data, size_t n, size_t dim, const PqOption &option);
+
+        [[nodiscard]] bool trained() const {
+            return _dim > 0;
+        }
+
+        [[nodiscard]] size_t dim() const {
+            return _dim;
+        }
+
+        [[nodiscard]] size_t m() const {
+            return _m;
+        }
+
+        [[nodiscard]] size_t dsub() const {
+            return _dsub;
+        }
+
+        [[nodiscard]] size_t ksub() const {
+            return _ksub;
+        }
+
+        [[nodiscard]] size_t code_size() const {
+            return _m;
+        }
+
+        [[nodiscard]] const std::vector<float> &codebooks() const {
+            return _codebooks;
+        }
+
+        void encode(const float *x, uint8_t *code) const;
+
+        /// n rows into n * code_size bytes, nullptr pool means ThreadPool::default_pool().
+        void encode_n(const float *x, size_t n, uint8_t *codes, ThreadPool *pool = nullptr) const;
+
+        void decode(const uint8_t *code, float *x) const;
+
+        /// table[j * ksub + c] = |q_j - c_j|^2, m * ksub floats.
+        void compute_l2_table(const float *q, float *table) const;
+
+        /// table[j * ksub + c] = q_j . c_j, m * ksub floats.
+        void compute_ip_table(const float *q, float *table) const;
+
+        /// sum of the table entries the code selects.
+        [[nodiscard]] float table_distance(const float *table, const uint8_t *code) const {
+            float sum = 0.0f;
+            for (size_t j = 0; j < _m; ++j) {
+                sum += table[j * _ksub + code[j]];
+            }
+            return sum;
+        }
+
+    private:
+        [[nodiscard]] const float *centroid(size_t j, size_t c) const {
+            return _codebooks.data() + (j * _ksub + c) * _dsub;
+        }
+
+    private:
+        size_t _dim{0};
+        size_t _m{0};
+        size_t _dsub{0};
+        size_t _ksub{0};
+        /// m codebooks of ksub * dsub floats.
+        std::vector<float> _codebooks;
+    };
+} // namespace xann
@@ -0,0 +1,391 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/quantization/projection.h>
+#include <xann/common/thread_pool.h>
+#include <xann/store/store.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+namespace xann {
+
+    static constexpr int kMaxJacobiSweeps = 64;
+
+    void covariance(const float *data, size_t n, size_t dim, const float *mean, std::vector<double> *cov,
+                    ThreadPool *pool) {
+        auto &p = pool ? *pool : ThreadPool::default_pool();
+        auto parts = std::max<size_t>(1, std::min(n, p.size() + 1));
+        std::vector<std::vector<double> > partial(parts);
+        p.parallel_for(parts, [&](size_t part) {
+            auto &c = partial[part];
+            c.assign(dim * dim, 0.0);
+            std::vector<double> x(dim);
+            for (auto i = part; i < n; i += parts) {
+                auto *row = data + i * dim;
+                for (size_t d = 0; d < dim; ++d) {
+                    x[d] = static_cast<double>(row[d]) - (mean ? mean[d] : 0.0f);
+                }
+                for (size_t a = 0; a < dim; ++a) {
+                    auto xa = x[a];
+                    auto *ca = c.data() + a * dim;
+                    for (size_t b = a; b < dim; ++b) {
+                        ca[b] += xa * x[b];
+                    }
+                }
+            }
+        });
+        cov->assign(dim * dim, 0.0);
+        auto scale = n > 1 ? 1.0 / static_cast<double>(n - 1) : 1.0;
+        for (size_t a = 0; a < dim; ++a) {
+            for (size_t b = a; b < dim; ++b) {
+                double sum = 0.0;
+                for (auto &c: partial) {
+                    sum += c[a * dim + b];
+                }
+                (*cov)[a * dim + b] = sum * scale;
+                (*cov)[b * dim + a] = sum * scale;
+            }
+        }
+    }
+
+    /// all eigenpairs of the symmetric n x n matrix a by cyclic Jacobi
+    /// rotations, column j of vectors belongs to values[j].
+    static void jacobi_eigen(std::vector<double> a, size_t n, std::vector<double> *values,
+                             std::vector<double> *vectors) {
+        auto &v = *vectors;
+        v.assign(n * n, 0.0);
+        for (size_t i = 0; i < n; ++i) {
+            v[i * n + i] = 1.0;
+        }
+        double total = 0.0;
+        for (auto x: a) {
+            total += x * x;
+        }
+        for (int sweep = 0; sweep < kMaxJacobiSweeps; ++sweep) {
+            double off = 0.0;
+            for (size_t p = 0; p < n; ++p) {
+                for (size_t q = p + 1; q < n; ++q) {
+                    off += a[p * n + q] * a[p * n + q];
+                }
+            }
+            if (off <= 1e-24 * total) {
+                break;
+            }
+            for (size_t p = 0; p < n; ++p) {
+                for (size_t q = p + 1; q < n; ++q) {
+                    auto apq = a[p * n + q];
+                    if (std::abs(apq) < 1e-300) {
+                        continue;
+                    }
+                    auto theta = (a[q * n + q] - a[p * n + p]) / (2.0 * apq);
+                    auto t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                    auto c = 1.0 / std::sqrt(t * t + 1.0);
+                    auto s = t * c;
+                    for (size_t k = 0; k < n; ++k) {
+                        auto akp = a[k * n + p];
+                        auto akq = a[k * n + q];
+                        a[k * n + p] = c * akp - s * akq;
+                        a[k * n + q] = s * akp + c * akq;
+                    }
+                    for (size_t k = 0; k < n; ++k) {
+                        auto apk = a[p * n + k];
+                        auto aqk = a[q * n + k];
+                        a[p * n + k] = c * apk - s * aqk;
+                        a[q * n + k] = s * apk + c * aqk;
+                    }
+                    for (size_t k = 0; k < n; ++k) {
+                        auto vkp = v[k * n + p];
+                        auto vkq = v[k * n + q];
+                        v[k * n + p] = c * vkp - s * vkq;
+                        v[k * n + q] = s * vkp + c * vkq;
+                    }
+                }
+            }
+        }
+        values->resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            (*values)[i] = a[i * n + i];
+        }
+    }
+
+    /// modified Gram-Schmidt over k rows of dim, returns false on a rank drop.
+    static bool orthonormalize_rows(double *rows, size_t k, size_t dim) {
+        for (size_t i = 0; i < k; ++i) {
+            auto *ri = rows + i * dim;
+            for (size_t j = 0; j < i; ++j) {
+                auto *rj = rows + j * dim;
+                double proj = 0.0;
+                for (size_t d = 0; d < dim; ++d) {
+                    proj += ri[d] * rj[d];
+                }
+                for (size_t d = 0; d < dim; ++d) {
+                    ri[d] -= proj * rj[d];
+                }
+            }
+            double norm = 0.0;
+            for (size_t d = 0; d < dim; ++d) {
+                norm += ri[d] * ri[d];
+            }
+            if (norm <= 1e-300) {
+                return false;
+            }
+            norm = 1.0 / std::sqrt(norm);
+            for (size_t d = 0; d < dim; ++d) {
+                ri[d] *= norm;
+            }
+        }
+        return true;
+    }
+
+    /// out row i = a * rows row i for the symmetric dim x dim a.
+    static void multiply_rows(const std::vector<double> &a, size_t dim, const std::vector<double> &rows, size_t k,
+                              std::vector<double> *out, ThreadPool &pool) {
+        out->resize(k * dim);
+        pool.parallel_for(k, [&](size_t i) {
+            auto *x = rows.data() + i * dim;
+            auto *y = out->data() + i * dim;
+            for (size_t r = 0; r < dim; ++r) {
+                auto *ar = a.data() + r * dim;
+                double sum = 0.0;
+                for (size_t c = 0; c < dim; ++c) {
+                    sum += ar[c] * x[c];
+                }
+                y[r] = sum;
+            }
+        });
+    }
+
+    turbo::Status top_eigen(const std::vector<double> &a, size_t dim, size_t k, uint32_t iterations, uint64_t seed,
+                            std::vector<double> *values, std::vector<double> *vectors, ThreadPool *pool) {
+        if (k == 0 || k > dim || a.size() != dim * dim) {
+            return turbo::invalid_argument_error("top_eigen k:", k, " dim:", dim);
+        }
+        auto &tp = pool ? *pool : ThreadPool::default_pool();
+        /// oversampled block, small problems are solved in full.
+        auto p = std::min(dim, k + std::max<size_t>(8, k / 4));
+        std::vector<double> basis;
+        std::vector<double> projected;
+        size_t n = dim;
+        if (p * 2 < dim) {
+            std::mt19937_64 rng(seed);
+            std::normal_distribution<double> gauss;
+            basis.resize(p * dim);
+            for (auto &x: basis) {
+                x = gauss(rng);
+            }
+            if (!orthonormalize_rows(basis.data(), p, dim)) {
+                return turbo::internal_error("random start block is rank deficient");
+            }
+            std::vector<double> next;
+            for (uint32_t it = 0; it < iterations; ++it) {
+                multiply_rows(a, dim, basis, p, &next, tp);
+                if (!orthonormalize_rows(next.data(), p, dim)) {
+                    /// the matrix has rank below p, the current block already spans it.
+                    break;
+                }
+                std::swap(basis, next);
+            }
+            multiply_rows(a, dim, basis, p, &next, tp);
+            projected.assign(p * p, 0.0);
+            for (size_t i = 0; i < p; ++i) {
+                for (size_t j = 0; j < p; ++j) {
+                    double sum = 0.0;
+                    for (size_t d = 0; d < dim; ++d) {
+                        sum += basis[i * dim + d] * next[j * dim + d];
+                    }
+                    projected[i * p + j] = sum;
+                }
+            }
+            n = p;
+        } else {
+            projected = a;
+        }
+        std::vector<double> evals;
+        std::vector<double> evecs;
+        jacobi_eigen(std::move(projected), n, &evals, &evecs);
+        std::vector<size_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t x, size_t y) { return evals[x] > evals[y]; });
+        values->resize(k);
+        vectors->assign(k * dim, 0.0);
+        for (size_t i = 0; i < k; ++i) {
+            auto col = order[i];
+            (*values)[i] = evals[col];
+            auto *out = vectors->data() + i * dim;
+            if (basis.empty()) {
+                for (size_t d = 0; d < dim; ++d) {
+                    out[d] = evecs[d * n + col];
+                }
+                continue;
+            }
+            /// Ritz vector, the basis rows weighted by the eigenvector of the projection.
+            for (size_t j = 0; j < n; ++j) {
+                auto w = evecs[j * n + col];
+                auto *bj = basis.data() + j * dim;
+                for (size_t d = 0; d < dim; ++d) {
+                    out[d] += w * bj[d];
+                }
+            }
+        }
+        return turbo::OkStatus();
+    }
+
+    /// the normalized family compares directions, a mean shift would move them.
+    static bool centered_pca(MetricType metric) {
+        return metric == kL2 || metric == kL1;
+    }
+
+    turbo::Result<std::unique_ptr<ProjectionStage> > ProjectionStage::train(const VectorSpace *input,
+                                                                           const float *data, size_t n,
+                                                                           const ProjectionOption &option) {
+        if (input->data_type != DataType::DT_FLOAT) {
+            return turbo::invalid_argument_error("projection needs DT_FLOAT vectors");
+        }
+        if (input->has_transform()) {
+            return turbo::invalid_argument_error("projection of a weighted or whitened space, metric:", input->metric);
+        }
+        auto dim = static_cast<size_t>(input->dim);
+        auto out_dim = static_cast<size_t>(option.out_dim);
+        if (out_dim == 0 || out_dim > dim) {
+            return turbo::invalid_argument_error("projection out_dim:", out_dim, " input dim:", dim);
+        }
+        auto level = input->operation.simd_level;
+        auto vrs = VectorSpace::create(static_cast<int>(out_dim), input->metric, DataType::DT_FLOAT, level);
+        if (!vrs.ok()) {
+            return vrs.status();
+        }
+        std::unique_ptr<ProjectionStage> stage(new ProjectionStage());
+        stage->_input = input;
+        stage->_output = std::make_unique<VectorSpace>(std::move(vrs).value_or_die());
+
+        std::vector<float> matrix(out_dim * dim);
+        std::vector<float> bias;
+        if (option.type == ProjectionType::kPca) {
+            if (n < 2) {
+                return turbo::invalid_argument_error("pca needs at least 2 rows, got:", n);
+            }
+            std::vector<float> mean;
+            if (centered_pca(input->metric)) {
+                std::vector<double> sum(dim, 0.0);
+                for (size_t i = 0; i < n; ++i) {
+                    for (size_t d = 0; d < dim; ++d) {
+                        sum[d] += data[i * dim + d];
+                    }
+                }
+                mean.resize(dim);
+                for (size_t d = 0; d < dim; ++d) {
+                    mean[d] = static_cast<float>(sum[d] / static_cast<double>(n));
+                }
+            }
+            std::vector<double> cov;
+            covariance(data, n, dim, mean.empty() ? nullptr : mean.data(), &cov, option.pool);
+            std::vector<double> values;
+            std::vector<double> vectors;
+            auto rs = top_eigen(cov, dim, out_dim, option.power_iterations, option.seed, &values, &vectors,
+                                option.pool);
+            if (!rs.ok()) {
+                return rs;
+            }
+            double trace = 0.0;
+            for (size_t d = 0; d < dim; ++d) {
+                trace += cov[d * dim + d];
+            }
+            double kept = 0.0;
+            for (size_t i = 0; i < out_dim; ++i) {
+                kept += std::max(values[i], 0.0);
+                auto scale = option.whiten ? 1.0 / std::sqrt(std::max(values[i], 0.0) + 1e-9) : 1.0;
+                for (size_t d = 0; d < dim; ++d) {
+                    matrix[i * dim + d] = static_cast<float>(vectors[i * dim + d] * scale);
+                }
+            }
+            stage->_explained = trace > 0.0 ? kept / trace : 0.0;
+            if (!mean.empty()) {
+                /// y = A (x - mean) = A x - A mean.
+                bias.resize(out_dim);
+                simple_gemv(matrix.data(), out_dim, dim, mean.data(), bias.data());
+                for (auto &b: bias) {
+                    b = -b;
+                }
+            }
+        } else {
+            std::mt19937_64 rng(option.seed);
+            std::normal_distribution<double> gauss;
+            std::vector<double> rows(out_dim * dim);
+            for (auto &x: rows) {
+                x = gauss(rng);
+            }
+            double scale = 1.0 / std::sqrt(static_cast<double>(out_dim));
+            if (option.type == ProjectionType::kRandomOrthogonal) {
+                if (!orthonormalize_rows(rows.data(), out_dim, dim)) {
+                    return turbo::internal_error("random projection is rank deficient");
+                }
+                scale = std::sqrt(static_cast<double>(dim) / static_cast<double>(out_dim));
+            }
+            for (size_t i = 0; i < rows.size(); ++i) {
+                matrix[i] = static_cast<float>(rows[i] * scale);
+            }
+        }
+        auto rs = stage->_transform.init(out_dim, dim, std::move(matrix), level);
+        if (!rs.ok()) {
+            return rs;
+        }
+        rs = stage->_transform.set_bias(std::move(bias));
+        if (!rs.ok()) {
+            return rs;
+        }
+        return stage;
+    }
+
+    turbo::Result<std::unique_ptr<ProjectionStage> > ProjectionStage::train(const MemStore *store,
+                                                                           const ProjectionOption &option) {
+        auto *vs = store->get_vector_space();
+        auto lids = store->live_local_ids();
+        if (lids.size() > option.max_train_size) {
+            std::mt19937_64 rng(option.seed);
+            std::shuffle(lids.begin(), lids.end(), rng);
+            lids.resize(option.max_train_size);
+        }
+        auto dim = static_cast<size_t>(vs->dim);
+        std::vector<float> data(lids.size() * dim);
+        if (vs->data_type == DataType::DT_FLOAT) {
+            for (size_t i = 0; i < lids.size(); ++i) {
+                std::memcpy(data.data() + i * dim, store->vector_at(lids[i]).data(), dim * sizeof(float));
+            }
+        }
+        return train(vs, data.data(), lids.size(), option);
+    }
+
+    turbo::Status ProjectionStage::apply(turbo::span<uint8_t> vector, AlignedBytes *out) const {
+        auto raw = static_cast<size_t>(_input->dim) * _input->element_size;
+        if (vector.size() != raw && vector.size() != static_cast<size_t>(_input->vector_byte_size)) {
+            return turbo::invalid_argument_error("vector size:", vector.size(), " expect:", raw, " or ",
+                                                 _input->vector_byte_size);
+        }
+        out->assign(static_cast<size_t>(_output->vector_byte_size), 0);
+        _transform.apply(reinterpret_cast<const float *>(vector.data()), reinterpret_cast<float *>(out->data()));
+        /// the normalized kernels assume unit vectors, a projection shortens them.
+        if (_output->need_normalize_vector && _output->operation.normalize_vector) {
+            turbo::span<uint8_t> sp(out->data(), out->size());
+            _output->operation.normalize_vector(sp, sp);
+        }
+        return turbo::OkStatus();
+    }
+} // namespace xann
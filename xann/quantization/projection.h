@@ -0,0 +1,115 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <xann/core/vector_space.h>
+#include <xann/quantization/linear_transform.h>
+
+namespace xann {
+    class MemStore;
+
+    enum class ProjectionType {
+        /// top principal components, trained on a sample.
+        kPca = 0,
+        /// orthonormal random rows scaled by sqrt(in / out).
+        kRandomOrthogonal = 1,
+        /// iid N(0, 1 / out) entries, Johnson-Lindenstrauss.
+        kGaussian = 2,
+    };
+
+    struct ProjectionOption {
+        ProjectionType type{ProjectionType::kPca};
+        uint32_t out_dim{0};
+        /// pca only, scale every component to unit variance.
+        bool whiten{false};
+        /// pca training sample cap.
+        uint32_t max_train_size{32768};
+        /// subspace iterations when out_dim is well below the input dim.
+        uint32_t power_iterations{12};
+        uint64_t seed{1234};
+        /// nullptr means ThreadPool::default_pool().
+        ThreadPool *pool{nullptr};
+    };
+
+    /// covariance of n rows around mean (the second moment if mean is nullptr),
+    /// dim x dim doubles, accumulated over row chunks on the pool.
+    void covariance(const float *data, size_t n, size_t dim, const float *mean, std::vector<double> *cov,
+                    ThreadPool *pool = nullptr);
+
+    /// k largest eigenpairs of the symmetric dim x dim matrix a, values
+    /// descending and vectors as k rows of dim. Jacobi when k is close to dim,
+    /// subspace iteration with a Rayleigh-Ritz step otherwise.
+    turbo::Status top_eigen(const std::vector<double> &a, size_t dim, size_t k, uint32_t iterations, uint64_t seed,
+                            std::vector<double> *values, std::vector<double> *vectors, ThreadPool *pool = nullptr);
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Dimension reduction in front of a collection.
+    ///
+    /// @details  Maps DT_FLOAT vectors of the input space to out_dim floats of
+    ///           an output space with the same metric, so stores and indexes
+    ///           only ever see the reduced vectors. Inserts and queries pass
+    ///           apply(), a SIMD gemv. Pca is centered for l1 and l2 and
+    ///           uses the uncentered second moment otherwise, which keeps the
+    ///           inner products and directions the components can explain.
+    ///           Outputs of the normalized metrics are normalized again.
+    ///
+    class ProjectionStage {
+    public:
+        /// pca over n rows of input->dim floats, random types ignore data.
+        static turbo::Result<std::unique_ptr<ProjectionStage> > train(const VectorSpace *input, const float *data,
+                                                                      size_t n, const ProjectionOption &option);
+
+        /// pca over a sample of the live vectors of store, its space is the input space.
+        static turbo::Result<std::unique_ptr<ProjectionStage> > train(const MemStore *store,
+                                                                      const ProjectionOption &option);
+
+        [[nodiscard]] const VectorSpace *input_space() const {
+            return _input;
+        }
+
+        [[nodiscard]] const VectorSpace *output_space() const {
+            return _output.get();
+        }
+
+        [[nodiscard]] const LinearTransform &transform() const {
+            return _transform;
+        }
+
+        /// share of the sample variance kept by pca, 0 for random types.
+        [[nodiscard]] double explained_variance() const {
+            return _explained;
+        }
+
+        /// vector is input dim * element_size or vector_byte_size bytes, out
+        /// receives a zero padded output vector_byte_size slot.
+        turbo::Status apply(turbo::span<uint8_t> vector, AlignedBytes *out) const;
+
+    private:
+        ProjectionStage() = default;
+
+    private:
+        const VectorSpace *_input{nullptr};
+        std::unique_ptr<VectorSpace> _output;
+        LinearTransform _transform;
+        double _explained{0.0};
+    };
+} // namespace xann
@@ -0,0 +1,165 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/quantization/residual_quantizer.h>
+#include <xann/common/kmeans.h>
+#include <xann/common/thread_pool.h>
+#include <algorithm>
+
+namespace xann {
+
+    static float dot(const float *a, const float *b, size_t dim) {
+        float sum = 0.0f;
+        for (size_t i = 0; i < dim; ++i) {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+    turbo::Status ResidualQuantizer::train(const float *data, size_t n, size_t dim, const RqOption &option) {
+        if (n == 0 || dim == 0 || option.m == 0) {
+            return turbo::invalid_argument_error("residual quantizer needs data and stages, n:", n, " dim:", dim,
+                                                 " m:", option.m);
+        }
+        auto m = static_cast<size_t>(option.m);
+        auto ksub = std::min(kMaxKsub, n);
+        auto &pool = option.pool ? *option.pool : ThreadPool::default_pool();
+        std::vector<float> residual(data, data + n * dim);
+        std::vector<float> codebooks(m * ksub * dim);
+        for (size_t j = 0; j < m; ++j) {
+            KMeansOption ko;
+            ko.k = static_cast<uint32_t>(ksub);
+            ko.iterations = option.train_iterations;
+            ko.seed = option.seed + j;
+            ko.pool = &pool;
+            std::vector<float> centroids;
+            std::vector<uint32_t> assign;
+            auto rs = kmeans_train(residual.data(), n, dim, ko, &centroids, &assign);
+            if (!rs.ok()) {
+                return rs;
+            }
+            for (size_t i = 0; i < n; ++i) {
+                auto *r = residual.data() + i * dim;
+                auto *c = centroids.data() + assign[i] * dim;
+                for (size_t d = 0; d < dim; ++d) {
+                    r[d] -= c[d];
+                }
+            }
+            std::copy(centroids.begin(), centroids.end(), codebooks.begin() + j * ksub * dim);
+        }
+        _dim = dim;
+        _m = m;
+        _ksub = ksub;
+        _beam_size = std::max<uint32_t>(option.beam_size, 1);
+        _codebooks = std::move(codebooks);
+        _norms.resize(m * ksub);
+        for (size_t j = 0; j < m; ++j) {
+            for (size_t c = 0; c < ksub; ++c) {
+                _norms[j * ksub + c] = dot(centroid(j, c), centroid(j, c), dim);
+            }
+        }
+        return turbo::OkStatus();
+    }
+
+    void ResidualQuantizer::encode(const float *x, uint8_t *code) const {
+        struct Step {
+            float err;
+            uint32_t beam;
+            uint32_t c;
+
+            bool operator<(const Step &other) const {
+                return err < other.err;
+            }
+        };
+        /// residuals, codes and |residual|^2 of the live beams.
+        std::vector<float> residual(x, x + _dim);
+        std::vector<uint8_t> codes(_m, 0);
+        std::vector<float> err(1, dot(x, x, _dim));
+        std::vector<float> next_residual;
+        std::vector<uint8_t> next_codes;
+        std::vector<Step> steps;
+        for (size_t j = 0; j < _m; ++j) {
+            auto beams = err.size();
+            steps.clear();
+            steps.reserve(beams * _ksub);
+            for (size_t b = 0; b < beams; ++b) {
+                auto *r = residual.data() + b * _dim;
+                for (size_t c = 0; c < _ksub; ++c) {
+                    auto e = err[b] - 2.0f * dot(r, centroid(j, c), _dim) + _norms[j * _ksub + c];
+                    steps.push_back({e, static_cast<uint32_t>(b), static_cast<uint32_t>(c)});
+                }
+            }
+            auto keep = std::min(_beam_size, steps.size());
+            std::partial_sort(steps.begin(), steps.begin() + keep, steps.end());
+            next_residual.resize(keep * _dim);
+            next_codes.resize(keep * _m);
+            err.resize(keep);
+            for (size_t k = 0; k < keep; ++k) {
+                auto &s = steps[k];
+                auto *from = residual.data() + s.beam * _dim;
+                auto *to = next_residual.data() + k * _dim;
+                auto *c = centroid(j, s.c);
+                for (size_t d = 0; d < _dim; ++d) {
+                    to[d] = from[d] - c[d];
+                }
+                std::copy_n(codes.data() + s.beam * _m, _m, next_codes.data() + k * _m);
+                next_codes[k * _m + j] = static_cast<uint8_t>(s.c);
+                err[k] = s.err;
+            }
+            std::swap(residual, next_residual);
+            std::swap(codes, next_codes);
+        }
+        /// the beams stay sorted by error, the first is the best.
+        std::copy_n(codes.data(), _m, code);
+    }
+
+    void ResidualQuantizer::encode_n(const float *x, size_t n, uint8_t *codes, ThreadPool *pool) const {
+        constexpr size_t kChunk = 64;
+        auto &p = pool ? *pool : ThreadPool::default_pool();
+        p.parallel_for((n + kChunk - 1) / kChunk, [&](size_t chunk) {
+            auto end = std::min(n, (chunk + 1) * kChunk);
+            for (auto i = chunk * kChunk; i < end; ++i) {
+                encode(x + i * _dim, codes + i * _m);
+            }
+        });
+    }
+
+    void ResidualQuantizer::decode(const uint8_t *code, float *x) const {
+        std::fill(x, x + _dim, 0.0f);
+        for (size_t j = 0; j < _m; ++j) {
+            auto *c = centroid(j, code[j]);
+            for (size_t d = 0; d < _dim; ++d) {
+                x[d] += c[d];
+            }
+        }
+    }
+
+    float ResidualQuantizer::reconstruction_norm(const uint8_t *code) const {
+        std::vector<float> x(_dim);
+        decode(code, x.data());
+        return dot(x.data(), x.data(), _dim);
+    }
+
+    void ResidualQuantizer::compute_ip_table(const float *q, float *table) const {
+        for (size_t j = 0; j < _m; ++j) {
+            for (size_t c = 0; c < _ksub; ++c) {
+                table[j * _ksub + c] = dot(q, centroid(j, c), _dim);
+            }
+        }
+    }
+} // namespace xann
@@ -0,0 +1,119 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <turbo/utility/status.h>
+
+namespace xann {
+    class ThreadPool;
+
+    struct RqOption {
+        /// stacked codebooks, one byte of code each.
+        uint32_t m{8};
+        uint32_t train_iterations{20};
+        /// partial encodings kept per stage while encoding, 1 is greedy.
+        uint32_t beam_size{8};
+        uint64_t seed{1234};
+        /// nullptr means ThreadPool::default_pool().
+        ThreadPool *pool{nullptr};
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Residual quantizer, m stacked full dimension codebooks.
+    ///
+    /// @details  Stage j quantizes what stages 0..j-1 left over, the
+    ///           reconstruction is the sum of one centroid per stage. Codebooks
+    ///           are trained greedily stage by stage, encoding keeps the
+    ///           beam_size best partial codes per stage, which is where most
+    ///           of the gain over greedy (and over PQ at the same bytes) comes
+    ///           from. Scoring goes through a per query table of q . c, m * ksub
+    ///           floats, the l2 norm of the reconstruction is not part of the
+    ///           code and has to be kept by the caller (see reconstruction_norm).
+    ///
+    class ResidualQuantizer {
+    public:
+        static constexpr size_t kMaxKsub = 256;
+
+        ResidualQuantizer() = default;
+
+        /// n row major rows of dim floats.
+        turbo::Status train(const float *data, size_t n, size_t dim, const RqOption &option);
+
+        [[nodiscard]] bool trained() const {
+            return _dim > 0;
+        }
+
+        [[nodiscard]] size_t dim() const {
+            return _dim;
+        }
+
+        [[nodiscard]] size_t m() const {
+            return _m;
+        }
+
+        [[nodiscard]] size_t ksub() const {
+            return _ksub;
+        }
+
+        [[nodiscard]] size_t code_size() const {
+            return _m;
+        }
+
+        void encode(const float *x, uint8_t *code) const;
+
+        /// n rows into n * code_size bytes, nullptr pool means ThreadPool::default_pool().
+        void encode_n(const float *x, size_t n, uint8_t *codes, ThreadPool *pool = nullptr) const;
+
+        void decode(const uint8_t *code, float *x) const;
+
+        /// |decode(code)|^2.
+        [[nodiscard]] float reconstruction_norm(const uint8_t *code) const;
+
+        /// table[j * ksub + c] = q . c_j, m * ksub floats.
+        void compute_ip_table(const float *q, float *table) const;
+
+        /// q . decode(code) from the table of q.
+        [[nodiscard]] float table_sum(const float *table, const uint8_t *code) const {
+            float sum = 0.0f;
+            for (size_t j = 0; j < _m; ++j) {
+                sum += table[j * _ksub + code[j]];
+            }
+            return sum;
+        }
+
+    private:
+        [[nodiscard]] const float *centroid(size_t j, size_t c) const {
+            return _codebooks.data() + (j * _ksub + c) * _dim;
+        }
+
+    private:
+        size_t _dim{0};
+        size_t _m{0};
+        size_t _ksub{0};
+        size_t _beam_size{1};
+        /// m codebooks of ksub * dim floats.
+        std::vector<float> _codebooks;
+        /// |c|^2 per centroid, m * ksub.
+        std::vector<float> _norms;
+    };
+} // namespace xann
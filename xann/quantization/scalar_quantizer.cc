@@ -0,0 +1,98 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/quantization/scalar_quantizer.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace xann {
+
+    turbo::Status ScalarQuantizer::train(const float *data, size_t n, size_t dim) {
+        if (n == 0 || dim == 0) {
+            return turbo::invalid_argument_error("scalar quantizer needs data, n:", n, " dim:", dim);
+        }
+        std::vector<float> lo(dim, std::numeric_limits<float>::max());
+        std::vector<float> hi(dim, std::numeric_limits<float>::lowest());
+        for (size_t i = 0; i < n; ++i) {
+            auto *x = data + i * dim;
+            for (size_t d = 0; d < dim; ++d) {
+                lo[d] = std::min(lo[d], x[d]);
+                hi[d] = std::max(hi[d], x[d]);
+            }
+        }
+        _min = std::move(lo);
+        _scale.resize(dim);
+        for (size_t d = 0; d < dim; ++d) {
+            auto range = hi[d] - _min[d];
+            _scale[d] = range > 0.0f ? range / 255.0f : 1.0f;
+        }
+        _dim = dim;
+        return turbo::OkStatus();
+    }
+
+    void ScalarQuantizer::encode(const float *x, uint8_t *code) const {
+        for (size_t d = 0; d < _dim; ++d) {
+            auto v = std::nearbyint((x[d] - _min[d]) / _scale[d]);
+            code[d] = static_cast<uint8_t>(std::clamp(v, 0.0f, 255.0f));
+        }
+    }
+
+    void ScalarQuantizer::decode(const uint8_t *code, float *x) const {
+        for (size_t d = 0; d < _dim; ++d) {
+            x[d] = _min[d] + static_cast<float>(code[d]) * _scale[d];
+        }
+    }
+
+    void ScalarQuantizer::prepare_l2(const float *q, Query *query) const {
+        query->a.resize(_dim);
+        query->bias = 0.0f;
+        for (size_t d = 0; d < _dim; ++d) {
+            query->a[d] = q[d] - _min[d];
+        }
+    }
+
+    void ScalarQuantizer::prepare_ip(const float *q, Query *query) const {
+        query->a.resize(_dim);
+        query->bias = 0.0f;
+        for (size_t d = 0; d < _dim; ++d) {
+            query->a[d] = q[d] * _scale[d];
+            query->bias += q[d] * _min[d];
+        }
+    }
+
+    float ScalarQuantizer::l2_sqr(const Query &query, const uint8_t *code) const {
+        auto *a = query.a.data();
+        auto *s = _scale.data();
+        float sum = 0.0f;
+        for (size_t d = 0; d < _dim; ++d) {
+            auto diff = a[d] - static_cast<float>(code[d]) * s[d];
+            sum += diff * diff;
+        }
+        return sum;
+    }
+
+    float ScalarQuantizer::inner_product(const Query &query, const uint8_t *code) const {
+        auto *a = query.a.data();
+        float sum = query.bias;
+        for (size_t d = 0; d < _dim; ++d) {
+            sum += a[d] * static_cast<float>(code[d]);
+        }
+        return sum;
+    }
+} // namespace xann
@@ -0,0 +1,84 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <turbo/utility/status.h>
+
+namespace xann {
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  8 bit scalar quantizer, one byte per dimension.
+    ///
+    /// @details  Each dimension is mapped linearly from its trained [min, max]
+    ///           range to [0, 255], values outside are clamped. Distances are
+    ///           asymmetric: the query stays float and is folded with the
+    ///           ranges once by prepare(), so scoring a code is one multiply
+    ///           add per dimension.
+    ///
+    class ScalarQuantizer {
+    public:
+        /// a query folded with the trained ranges.
+        struct Query {
+            std::vector<float> a;
+            float bias{0.0f};
+        };
+
+        ScalarQuantizer() = default;
+
+        /// n row major rows of dim floats.
+        turbo::Status train(const float *data, size_t n, size_t dim);
+
+        [[nodiscard]] bool trained() const {
+            return _dim > 0;
+        }
+
+        [[nodiscard]] size_t dim() const {
+            return _dim;
+        }
+
+        [[nodiscard]] size_t code_size() const {
+            return _dim;
+        }
+
+        void encode(const float *x, uint8_t *code) const;
+
+        void decode(const uint8_t *code, float *x) const;
+
+        /// for l2_sqr: a = q - min, for inner_product: a = q * scale, bias = q . min.
+        void prepare_l2(const float *q, Query *query) const;
+
+        void prepare_ip(const float *q, Query *query) const;
+
+        /// squared l2 between the prepared query and code.
+        [[nodiscard]] float l2_sqr(const Query &query, const uint8_t *code) const;
+
+        /// inner product between the prepared query and code.
+        [[nodiscard]] float inner_product(const Query &query, const uint8_t *code) const;
+
+    private:
+        size_t _dim{0};
+        std::vector<float> _min;
+        /// (max - min) / 255
+        std::vector<float> _scale;
+    };
+} // namespace xann
@@ -0,0 +1,146 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/store/batch_arena.h>
+#include <xann/core/vector_space.h>
+
+namespace xann {
+
+    static uint8_t *system_allocate(size_t bytes) {
+        xsimd::aligned_allocator<uint8_t, VectorSpace::kAlignmentBytes> allocator;
+        return allocator.allocate(bytes);
+    }
+
+    static void system_deallocate(uint8_t *data, size_t bytes) {
+        xsimd::aligned_allocator<uint8_t, VectorSpace::kAlignmentBytes> allocator;
+        allocator.deallocate(data, bytes);
+    }
+
+    BatchArena::BatchArena(uint64_t global_limit) : _global_limit(global_limit) {
+    }
+
+    BatchArena::~BatchArena() {
+        trim();
+    }
+
+    turbo::Result<uint8_t *> BatchArena::allocate(size_t bytes, uint64_t owner) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        auto &usage = _owners[owner];
+        if (usage.limit != 0 && usage.used + bytes > usage.limit) {
+            return turbo::resource_exhausted_error("owner:", owner, " over budget, used:", usage.used, " limit:",
+                                                   usage.limit, " request:", bytes);
+        }
+        auto it = _free_lists.find(bytes);
+        if (it != _free_lists.end() && !it->second.empty()) {
+            auto *data = it->second.back();
+            it->second.pop_back();
+            _cached -= bytes;
+            _used += bytes;
+            usage.used += bytes;
+            return data;
+        }
+        if (_global_limit != 0 && _used + _cached + bytes > _global_limit) {
+            trim_locked(_used + _cached + bytes - _global_limit);
+            if (_used + _cached + bytes > _global_limit) {
+                return turbo::resource_exhausted_error("global memory over budget, used:", _used, " limit:",
+                                                       _global_limit, " request:", bytes);
+            }
+        }
+        uint8_t *data = nullptr;
+        try {
+            data = system_allocate(bytes);
+        } catch (std::exception &e) {
+            return turbo::unavailable_error(e.what());
+        }
+        _used += bytes;
+        usage.used += bytes;
+        return data;
+    }
+
+    void BatchArena::release(uint8_t *data, size_t bytes, uint64_t owner) {
+        if (!data) {
+            return;
+        }
+        std::lock_guard<std::mutex> lk(_mutex);
+        auto &usage = _owners[owner];
+        usage.used -= std::min<uint64_t>(usage.used, bytes);
+        _used -= std::min<uint64_t>(_used, bytes);
+        _free_lists[bytes].push_back(data);
+        _cached += bytes;
+    }
+
+    void BatchArena::charge(uint64_t bytes, uint64_t owner) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        _owners[owner].used += bytes;
+        _used += bytes;
+    }
+
+    void BatchArena::uncharge(uint64_t bytes, uint64_t owner) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        auto &usage = _owners[owner];
+        usage.used -= std::min<uint64_t>(usage.used, bytes);
+        _used -= std::min<uint64_t>(_used, bytes);
+    }
+
+    void BatchArena::set_owner_limit(uint64_t owner, uint64_t bytes) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        _owners[owner].limit = bytes;
+    }
+
+    void BatchArena::set_global_limit(uint64_t bytes) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        _global_limit = bytes;
+    }
+
+    uint64_t BatchArena::owner_bytes(uint64_t owner) const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        auto it = _owners.find(owner);
+        return it == _owners.end() ? 0 : it->second.used;
+    }
+
+    uint64_t BatchArena::used_bytes() const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        return _used;
+    }
+
+    uint64_t BatchArena::cached_bytes() const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        return _cached;
+    }
+
+    void BatchArena::trim() {
+        std::lock_guard<std::mutex> lk(_mutex);
+        trim_locked(_cached);
+    }
+
+    void BatchArena::trim_locked(uint64_t need) {
+        uint64_t freed = 0;
+        for (auto &it: _free_lists) {
+            auto &list = it.second;
+            while (!list.empty() && freed < need) {
+                system_deallocate(list.back(), it.first);
+                list.pop_back();
+                freed += it.first;
+            }
+            if (freed >= need) {
+                break;
+            }
+        }
+        _cached -= std::min(_cached, freed);
+    }
+} // namespace xann
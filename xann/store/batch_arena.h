@@ -0,0 +1,94 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <turbo/container/flat_hash_map.h>
+#include <turbo/utility/status.h>
+
+namespace xann {
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Shared pool of aligned VectorBatch chunks with memory budgets.
+    ///
+    /// @details  Many small stores allocate batches of the same byte size, a
+    ///           released chunk is kept on a per size free list and handed to
+    ///           the next store that asks, instead of going back to the system.
+    ///           Usage is accounted per owner (usually a tenant), allocation
+    ///           fails with resource_exhausted when either the owner limit or
+    ///           the global limit would be exceeded. Cached free chunks count
+    ///           against the global limit and are trimmed before failing.
+    ///
+    class BatchArena {
+    public:
+        /// 0 means unlimited.
+        explicit BatchArena(uint64_t global_limit = 0);
+
+        ~BatchArena();
+
+        BatchArena(const BatchArena &) = delete;
+
+        BatchArena &operator=(const BatchArena &) = delete;
+
+        turbo::Result<uint8_t *> allocate(size_t bytes, uint64_t owner);
+
+        void release(uint8_t *data, size_t bytes, uint64_t owner);
+
+        /// count bytes held outside the arena, e.g. a store's id pool, as used
+        /// by owner. never fails, the memory already exists.
+        void charge(uint64_t bytes, uint64_t owner);
+
+        void uncharge(uint64_t bytes, uint64_t owner);
+
+        /// 0 means unlimited.
+        void set_owner_limit(uint64_t owner, uint64_t bytes);
+
+        void set_global_limit(uint64_t bytes);
+
+        [[nodiscard]] uint64_t owner_bytes(uint64_t owner) const;
+
+        /// bytes handed out and not released.
+        [[nodiscard]] uint64_t used_bytes() const;
+
+        /// bytes parked on the free lists.
+        [[nodiscard]] uint64_t cached_bytes() const;
+
+        /// return every cached chunk to the system.
+        void trim();
+
+    private:
+        void trim_locked(uint64_t need);
+
+        struct OwnerUsage {
+            uint64_t used{0};
+            uint64_t limit{0};
+        };
+
+    private:
+        mutable std::mutex _mutex;
+        uint64_t _global_limit{0};
+        uint64_t _used{0};
+        uint64_t _cached{0};
+        turbo::flat_hash_map<size_t, std::vector<uint8_t *> > _free_lists;
+        turbo::flat_hash_map<uint64_t, OwnerUsage> _owners;
+    };
+} // namespace xann
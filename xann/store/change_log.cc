@@ -0,0 +1,103 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/store/change_log.h>
+#include <algorithm>
+
+namespace xann {
+
+    ChangeLog::ChangeLog(size_t max_records) : _max_records(std::max<size_t>(max_records, 1)) {
+    }
+
+    uint64_t ChangeLog::append(uint64_t snapshot_id, MutationType type, uint64_t label, turbo::span<uint8_t> vector) {
+        MutationRecord record;
+        record.snapshot_id = snapshot_id;
+        record.type = type;
+        record.label = label;
+        record.vector.assign(vector.data(), vector.data() + vector.size());
+
+        std::lock_guard<std::mutex> lk(_mutex);
+        record.sequence = ++_last_sequence;
+        _records.push_back(std::move(record));
+        while (_records.size() > _max_records) {
+            _records.pop_front();
+        }
+        return _last_sequence;
+    }
+
+    turbo::Result<std::vector<MutationRecord> > ChangeLog::read_since(uint64_t sequence, size_t max_records) const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        std::vector<MutationRecord> result;
+        if (sequence >= _last_sequence) {
+            return result;
+        }
+        if (_records.empty() || sequence + 1 < _records.front().sequence) {
+            return turbo::out_of_range_error("sequence:", sequence, " already trimmed, first retained:",
+                                             _records.empty() ? 0 : _records.front().sequence);
+        }
+        /// sequences are gap free, so the position is a direct offset.
+        auto begin = sequence + 1 - _records.front().sequence;
+        auto end = std::min<size_t>(_records.size(), begin + max_records);
+        result.reserve(end - begin);
+        for (auto i = begin; i < end; ++i) {
+            result.push_back(_records[i]);
+        }
+        return result;
+    }
+
+    turbo::Result<std::vector<MutationRecord> > ChangeLog::read_from_snapshot(uint64_t snapshot_id,
+                                                                           size_t max_records) const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        std::vector<MutationRecord> result;
+        if (!_records.empty() && _records.front().snapshot_id > snapshot_id && _records.front().sequence > 1) {
+            return turbo::out_of_range_error("snapshot id:", snapshot_id, " already trimmed, first retained:",
+                                             _records.front().snapshot_id);
+        }
+        /// snapshot ids are monotonic, binary search the first match.
+        auto it = std::lower_bound(_records.begin(), _records.end(), snapshot_id,
+                                   [](const MutationRecord &r, uint64_t sid) {
+                                       return r.snapshot_id < sid;
+                                   });
+        for (; it != _records.end() && result.size() < max_records; ++it) {
+            result.push_back(*it);
+        }
+        return result;
+    }
+
+    void ChangeLog::trim(uint64_t sequence) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        while (!_records.empty() && _records.front().sequence <= sequence) {
+            _records.pop_front();
+        }
+    }
+
+    uint64_t ChangeLog::last_sequence() const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        return _last_sequence;
+    }
+
+    uint64_t ChangeLog::first_sequence() const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        return _records.empty() ? 0 : _records.front().sequence;
+    }
+
+    size_t ChangeLog::size() const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        return _records.size();
+    }
+} // namespace xann
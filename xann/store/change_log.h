@@ -0,0 +1,100 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <turbo/container/span.h>
+#include <turbo/utility/status.h>
+
+namespace xann {
+
+    /// mutation kinds emitted by MemStore, all keyed by label so that a
+    /// replica with a different lid layout can replay them.
+    enum class MutationType : uint8_t {
+        kNone = 0,
+        kAdd = 1,
+        kSet = 2,
+        kRemove = 3,
+        kTombstone = 4,
+        /// kAdd whose bytes already went through VectorSpace::prepare_vector(),
+        /// snapshots of transformed spaces ship slots this way.
+        kAddPrepared = 5,
+    };
+
+    struct MutationRecord {
+        /// assigned by ChangeLog, strictly increasing and gap free.
+        uint64_t sequence{0};
+        /// snapshot id passed by the writer to MemStore.
+        uint64_t snapshot_id{0};
+        MutationType type{MutationType::kNone};
+        uint64_t label{0};
+        /// raw vector bytes for kAdd/kSet, slot bytes for kAddPrepared, empty otherwise.
+        std::vector<uint8_t> vector;
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Bounded, ordered log of MemStore mutations.
+    ///
+    /// @details  MemStore appends one record for every successful mutation while
+    ///           the writer holds the store's unique lock, so the log order is the
+    ///           store order. The oldest records are dropped once max_records is
+    ///           exceeded; readers that fall behind the retained window get
+    ///           out_of_range and must bootstrap from a snapshot again.
+    ///
+    class ChangeLog {
+    public:
+        static constexpr size_t kDefaultMaxRecords = 1 << 20;
+
+        explicit ChangeLog(size_t max_records = kDefaultMaxRecords);
+
+        ChangeLog(const ChangeLog &) = delete;
+
+        ChangeLog &operator=(const ChangeLog &) = delete;
+
+        /// return the sequence assigned to the record.
+        uint64_t append(uint64_t snapshot_id, MutationType type, uint64_t label, turbo::span<uint8_t> vector);
+
+        /// records with sequence > sequence, at most max_records.
+        turbo::Result<std::vector<MutationRecord> > read_since(uint64_t sequence, size_t max_records) const;
+
+        /// records with snapshot_id >= snapshot_id, at most max_records.
+        turbo::Result<std::vector<MutationRecord> > read_from_snapshot(uint64_t snapshot_id, size_t max_records) const;
+
+        /// drop every record with sequence <= sequence.
+        void trim(uint64_t sequence);
+
+        /// sequence of the newest record, 0 if nothing was ever appended.
+        [[nodiscard]] uint64_t last_sequence() const;
+
+        /// sequence of the oldest retained record, 0 if empty.
+        [[nodiscard]] uint64_t first_sequence() const;
+
+        [[nodiscard]] size_t size() const;
+
+    private:
+        size_t _max_records{kDefaultMaxRecords};
+        mutable std::mutex _mutex;
+        std::deque<MutationRecord> _records;
+        uint64_t _last_sequence{0};
+    };
+} // namespace xann
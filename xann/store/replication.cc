@@ -0,0 +1,268 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/store/replication.h>
+#include <cstring>
+
+namespace xann {
+
+    static constexpr size_t kRecordHeaderBytes = sizeof(uint64_t) * 3 + sizeof(uint8_t) + sizeof(uint32_t);
+
+    template<typename T>
+    static void put_value(std::string &buf, T v) {
+        buf.append(reinterpret_cast<const char *>(&v), sizeof(T));
+    }
+
+    template<typename T>
+    static T get_value(const char *p) {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        return v;
+    }
+
+    turbo::Status QueueTransport::send(const std::vector<MutationRecord> &records) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        _queue.insert(_queue.end(), records.begin(), records.end());
+        return turbo::OkStatus();
+    }
+
+    turbo::Result<std::vector<MutationRecord> > QueueTransport::receive(size_t max_records) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        std::vector<MutationRecord> result;
+        while (!_queue.empty() && result.size() < max_records) {
+            result.push_back(std::move(_queue.front()));
+            _queue.pop_front();
+        }
+        return result;
+    }
+
+    size_t QueueTransport::pending() const {
+        std::lock_guard<std::mutex> lk(_mutex);
+        return _queue.size();
+    }
+
+    FileTransport::FileTransport(std::string path) : _path(std::move(path)) {
+    }
+
+    turbo::Status FileTransport::send(const std::vector<MutationRecord> &records) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        if (!_writer.is_open()) {
+            _writer.open(_path, std::ios::binary | std::ios::app);
+            if (!_writer.is_open()) {
+                return turbo::unavailable_error("can not open replication file:", _path);
+            }
+        }
+        std::string buf;
+        for (auto &r: records) {
+            put_value<uint64_t>(buf, r.sequence);
+            put_value<uint64_t>(buf, r.snapshot_id);
+            put_value<uint8_t>(buf, static_cast<uint8_t>(r.type));
+            put_value<uint64_t>(buf, r.label);
+            put_value<uint32_t>(buf, static_cast<uint32_t>(r.vector.size()));
+            buf.append(reinterpret_cast<const char *>(r.vector.data()), r.vector.size());
+        }
+        _writer.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        _writer.flush();
+        if (!_writer.good()) {
+            return turbo::data_loss_error("write replication file failed:", _path);
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Result<std::vector<MutationRecord> > FileTransport::receive(size_t max_records) {
+        std::lock_guard<std::mutex> lk(_mutex);
+        std::vector<MutationRecord> result;
+        std::ifstream reader(_path, std::ios::binary);
+        if (!reader.is_open()) {
+            /// nothing shipped yet.
+            return result;
+        }
+        reader.seekg(static_cast<std::streamoff>(_read_offset));
+        char header[kRecordHeaderBytes];
+        while (result.size() < max_records) {
+            if (!reader.read(header, kRecordHeaderBytes)) {
+                break;
+            }
+            MutationRecord r;
+            const char *p = header;
+            r.sequence = get_value<uint64_t>(p);
+            p += sizeof(uint64_t);
+            r.snapshot_id = get_value<uint64_t>(p);
+            p += sizeof(uint64_t);
+            r.type = static_cast<MutationType>(get_value<uint8_t>(p));
+            p += sizeof(uint8_t);
+            r.label = get_value<uint64_t>(p);
+            p += sizeof(uint64_t);
+            auto nbytes = get_value<uint32_t>(p);
+            r.vector.resize(nbytes);
+            if (nbytes > 0 && !reader.read(reinterpret_cast<char *>(r.vector.data()), nbytes)) {
+                break;
+            }
+            _read_offset += kRecordHeaderBytes + nbytes;
+            result.push_back(std::move(r));
+        }
+        return result;
+    }
+
+    turbo::Result<ReplicationSnapshot> make_replication_snapshot(const MemStore &store) {
+        ReplicationSnapshot snapshot;
+        snapshot.snapshot_id = store.snapshot_id();
+        snapshot.sequence = store.change_log() ? store.change_log()->last_sequence() : 0;
+        auto *ids = store.id_manager();
+        if (!ids) {
+            return turbo::failed_precondition_error("store not initialized");
+        }
+        /// slots of a transformed space hold prepared bytes, the replica
+        /// must not transform them again.
+        auto add_type = store.get_vector_space()->has_transform() ? MutationType::kAddPrepared : MutationType::kAdd;
+        auto &entities = ids->ids();
+        auto end = std::min(entities.size(), static_cast<size_t>(ids->next_id()));
+        for (auto lid = ids->reserved_id(); lid < end; ++lid) {
+            auto &entity = entities[lid];
+            if (entity.label == IdManager::kInvalidId) {
+                continue;
+            }
+            auto rs = store.get_vector_by_id(lid);
+            if (!rs.ok()) {
+                return rs.status();
+            }
+            auto sp = rs.value_or_die();
+            MutationRecord add;
+            add.sequence = snapshot.sequence;
+            add.snapshot_id = snapshot.snapshot_id;
+            add.type = add_type;
+            add.label = entity.label;
+            add.vector.assign(sp.data(), sp.data() + sp.size());
+            snapshot.records.push_back(std::move(add));
+            if (entity.status == kTombstone) {
+                MutationRecord ts;
+                ts.sequence = snapshot.sequence;
+                ts.snapshot_id = snapshot.snapshot_id;
+                ts.type = MutationType::kTombstone;
+                ts.label = entity.label;
+                snapshot.records.push_back(std::move(ts));
+            }
+        }
+        return snapshot;
+    }
+
+    LogShipper::LogShipper(const ChangeLog *log, LogTransport *transport, uint64_t from_sequence)
+        : _log(log), _transport(transport), _shipped_sequence(from_sequence) {
+    }
+
+    turbo::Result<size_t> LogShipper::ship(size_t max_records) {
+        auto rs = _log->read_since(_shipped_sequence, max_records);
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        auto &records = rs.value_or_die();
+        if (records.empty()) {
+            return 0;
+        }
+        auto st = _transport->send(records);
+        if (!st.ok()) {
+            return st;
+        }
+        _shipped_sequence = records.back().sequence;
+        return records.size();
+    }
+
+    ReplicaApplier::ReplicaApplier(MemStore *replica) : _replica(replica) {
+    }
+
+    turbo::Status ReplicaApplier::bootstrap(const ReplicationSnapshot &snapshot) {
+        std::unique_lock<std::shared_mutex> lk(_replica->mutex());
+        if (_replica->size() != 0) {
+            return turbo::failed_precondition_error("replica must be empty before bootstrap, size:", _replica->size());
+        }
+        for (auto &r: snapshot.records) {
+            auto rs = apply_one(r);
+            if (!rs.ok()) {
+                return rs;
+            }
+        }
+        _applied_sequence = snapshot.sequence;
+        return turbo::OkStatus();
+    }
+
+    turbo::Status ReplicaApplier::apply(const std::vector<MutationRecord> &records) {
+        std::unique_lock<std::shared_mutex> lk(_replica->mutex());
+        for (auto &r: records) {
+            if (r.sequence <= _applied_sequence) {
+                continue;
+            }
+            if (r.sequence != _applied_sequence + 1) {
+                return turbo::failed_precondition_error("sequence gap, applied:", _applied_sequence, " got:",
+                                                        r.sequence);
+            }
+            auto rs = apply_one(r);
+            if (!rs.ok()) {
+                return rs;
+            }
+            _applied_sequence = r.sequence;
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Result<size_t> ReplicaApplier::tail(LogTransport *transport, size_t max_records) {
+        auto rs = transport->receive(max_records);
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        auto &records = rs.value_or_die();
+        auto st = apply(records);
+        if (!st.ok()) {
+            return st;
+        }
+        return records.size();
+    }
+
+    turbo::Status ReplicaApplier::apply_one(const MutationRecord &record) {
+        switch (record.type) {
+            case MutationType::kAdd:
+            case MutationType::kSet: {
+                if (record.vector.size() > static_cast<size_t>(_replica->get_vector_space()->vector_byte_size)) {
+                    return turbo::invalid_argument_error("vector bytes:", record.vector.size(),
+                                                         " larger than replica slot:",
+                                                         _replica->get_vector_space()->vector_byte_size);
+                }
+                turbo::span<uint8_t> v(const_cast<uint8_t *>(record.vector.data()), record.vector.size());
+                /// an add of a tombstoned label revives it, set_vector would refuse it.
+                auto ids = _replica->id_manager()->label_entity(record.label);
+                if (ids.ok() && ids.value_or_die().status != kTombstone) {
+                    auto rs = _replica->set_vector(record.snapshot_id, record.label, v);
+                    return rs.status();
+                }
+                auto rs = _replica->add_vector(record.snapshot_id, record.label, v);
+                return rs.status();
+            }
+            case MutationType::kAddPrepared: {
+                turbo::span<uint8_t> v(const_cast<uint8_t *>(record.vector.data()), record.vector.size());
+                return _replica->add_prepared_vector(record.snapshot_id, record.label, v).status();
+            }
+            case MutationType::kRemove:
+                _replica->remove_vector_by_label(record.snapshot_id, record.label);
+                return turbo::OkStatus();
+            case MutationType::kTombstone:
+                _replica->tombstone_vector_by_label(record.snapshot_id, record.label);
+                return turbo::OkStatus();
+            default:
+                return turbo::invalid_argument_error("unknown mutation type:", static_cast<int>(record.type));
+        }
+    }
+} // namespace xann
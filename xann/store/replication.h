@@ -0,0 +1,147 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#pragma once
+
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <xann/store/change_log.h>
+#include <xann/store/store.h>
+
+namespace xann {
+
+    /// transport between a primary's ChangeLog and its replicas.
+    /// implementations must deliver records in the order they are sent.
+    class LogTransport {
+    public:
+        virtual ~LogTransport() = default;
+
+        virtual turbo::Status send(const std::vector<MutationRecord> &records) = 0;
+
+        /// at most max_records, an empty result means nothing available yet.
+        virtual turbo::Result<std::vector<MutationRecord> > receive(size_t max_records) = 0;
+    };
+
+    /// in process queue, mostly for tests and for replicas in the same process.
+    class QueueTransport : public LogTransport {
+    public:
+        turbo::Status send(const std::vector<MutationRecord> &records) override;
+
+        turbo::Result<std::vector<MutationRecord> > receive(size_t max_records) override;
+
+        [[nodiscard]] size_t pending() const;
+
+    private:
+        mutable std::mutex _mutex;
+        std::deque<MutationRecord> _queue;
+    };
+
+    /// append only file, one writer and any number of readers each with
+    /// its own FileTransport instance and read offset.
+    ///
+    /// record layout, little endian:
+    /// | sequence u64 | snapshot_id u64 | type u8 | label u64 | nbytes u32 | bytes |
+    class FileTransport : public LogTransport {
+    public:
+        explicit FileTransport(std::string path);
+
+        turbo::Status send(const std::vector<MutationRecord> &records) override;
+
+        /// a trailing partial record (writer still flushing) is left for the next call.
+        turbo::Result<std::vector<MutationRecord> > receive(size_t max_records) override;
+
+        [[nodiscard]] uint64_t read_offset() const {
+            return _read_offset;
+        }
+
+    private:
+        std::string _path;
+        std::mutex _mutex;
+        std::ofstream _writer;
+        uint64_t _read_offset{0};
+    };
+
+    /// full copy of a store, taken at snapshot_id/sequence.
+    struct ReplicationSnapshot {
+        uint64_t snapshot_id{0};
+        /// log sequence the snapshot is consistent with, tail from sequence + 1.
+        uint64_t sequence{0};
+        std::vector<MutationRecord> records;
+    };
+
+    /// the caller must hold at least a shared lock on store->mutex(), so no
+    /// mutation can slip between the copy and the log sequence.
+    turbo::Result<ReplicationSnapshot> make_replication_snapshot(const MemStore &store);
+
+    /// ships the primary's log to a transport, tracking the last shipped sequence.
+    class LogShipper {
+    public:
+        LogShipper(const ChangeLog *log, LogTransport *transport, uint64_t from_sequence = 0);
+
+        /// ship at most max_records, return the number shipped.
+        /// out_of_range means the log was trimmed past us, replicas must bootstrap again.
+        turbo::Result<size_t> ship(size_t max_records);
+
+        [[nodiscard]] uint64_t shipped_sequence() const {
+            return _shipped_sequence;
+        }
+
+    private:
+        const ChangeLog *_log{nullptr};
+        LogTransport *_transport{nullptr};
+        uint64_t _shipped_sequence{0};
+    };
+
+    //////////////////////////////////////////////////////////////////////////
+    ///
+    /// @brief  Replays mutation records on a replica MemStore.
+    ///
+    /// @details  Records carry the primary's sequence, anything at or below
+    ///           applied_sequence() is skipped, so redelivery is harmless. The
+    ///           operations themselves are idempotent too: kAdd of an existing
+    ///           label overwrites, kRemove of a missing label does nothing.
+    ///           A gap in sequences is reported as failed_precondition, the
+    ///           replica must be bootstrapped again.
+    ///
+    class ReplicaApplier {
+    public:
+        explicit ReplicaApplier(MemStore *replica);
+
+        /// load a snapshot into an empty replica, then tail from snapshot.sequence.
+        turbo::Status bootstrap(const ReplicationSnapshot &snapshot);
+
+        turbo::Status apply(const std::vector<MutationRecord> &records);
+
+        /// receive at most max_records from transport and apply them.
+        turbo::Result<size_t> tail(LogTransport *transport, size_t max_records);
+
+        [[nodiscard]] uint64_t applied_sequence() const {
+            return _applied_sequence;
+        }
+
+    private:
+        turbo::Status apply_one(const MutationRecord &record);
+
+    private:
+        MemStore *_replica{nullptr};
+        uint64_t _applied_sequence{0};
+    };
+} // namespace xann
@@ -0,0 +1,201 @@
+// Copyright (C) Kumo inc. and its affiliates.
+// Author: Jeff.li lijippy@163.com
+// All rights reserved.
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Affero General Public License for more details.
+//
+// You should have received a copy of the GNU Affero General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+
+#include <xann/store/serializer.h>
+#include <xann/store/store.h>
+#include <fstream>
+
+namespace xann {
+
+    template<typename T>
+    static void write_value(std::ofstream &out, const T &v) {
+        out.write(reinterpret_cast<const char *>(&v), sizeof(T));
+    }
+
+    template<typename T>
+    static bool read_value(std::ifstream &in, T &v) {
+        return static_cast<bool>(in.read(reinterpret_cast<char *>(&v), sizeof(T)));
+    }
+
+    turbo::Status Serializer::save_store(const MemStore &store, const std::string &path) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return turbo::unavailable_error("can not open store file:", path);
+        }
+        auto *vs = store._vector_space;
+        auto &ids = *store._id_manager;
+        write_value(out, kStoreMagic);
+        write_value(out, kStoreVersion);
+        write_value(out, vs->dim);
+        write_value(out, vs->metric);
+        write_value(out, static_cast<int32_t>(vs->data_type));
+        write_value(out, vs->vector_byte_size);
+        write_value(out, vs->storage_scale);
+        write_value(out, store._option.batch_size);
+        write_value(out, store._option.max_elements);
+        write_value(out, store._option.enable_replace_vacant);
+        write_value(out, store._option.reserved);
+        write_value(out, store._snapshot_id);
+        write_value(out, store._mutation_count);
+        write_value(out, ids.reserved_id());
+        write_value(out, ids.next_id());
+        auto &entities = ids.ids();
+        for (uint64_t i = 0; i < ids.next_id(); ++i) {
+            write_value(out, entities[i].label);
+            write_value(out, entities[i].status);
+        }
+        uint64_t nbatch = store._vector_batches.size();
+        write_value(out, nbatch);
+        for (auto &b: store._vector_batches) {
+            auto data = b.data();
+            out.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+        }
+        out.flush();
+        if (!out.good()) {
+            return turbo::data_loss_error("write store file failed:", path);
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Result<std::unique_ptr<MemStore> > Serializer::load_store(const VectorSpace *vs, const std::string &path,
+                                                                    BatchArena *arena, uint64_t owner) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            return turbo::not_found_error("can not open store file:", path);
+        }
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        int32_t dim = 0;
+        MetricType metric = kUndefinedMetric;
+        int32_t dt = 0;
+        int32_t vector_byte_size = 0;
+        float storage_scale = 1.0f;
+        if (!read_value(in, magic) || magic != kStoreMagic || !read_value(in, version) || version == 0 ||
+            version > kStoreVersion) {
+            return turbo::data_loss_error("bad store file header:", path);
+        }
+        read_value(in, dim);
+        read_value(in, metric);
+        read_value(in, dt);
+        read_value(in, vector_byte_size);
+        if (version >= 2) {
+            read_value(in, storage_scale);
+        }
+        if (dim != vs->dim || metric != vs->metric || dt != static_cast<int32_t>(vs->data_type) ||
+            vector_byte_size != vs->vector_byte_size || storage_scale != vs->storage_scale) {
+            return turbo::invalid_argument_error("store file:", path, " does not match the vector space");
+        }
+        VectorStoreOption option;
+        read_value(in, option.batch_size);
+        read_value(in, option.max_elements);
+        read_value(in, option.enable_replace_vacant);
+        read_value(in, option.reserved);
+        uint64_t snapshot_id = 0;
+        uint64_t mutation_count = 0;
+        uint64_t reserved_id = 0;
+        uint64_t next_id = 0;
+        read_value(in, snapshot_id);
+        if (version >= 3) {
+            read_value(in, mutation_count);
+        }
+        read_value(in, reserved_id);
+        if (!read_value(in, next_id) || option.batch_size == 0) {
+            return turbo::data_loss_error("truncated store file:", path);
+        }
+
+        std::unique_ptr<MemStore> store(new MemStore());
+        store->_vector_space = vs;
+        store->_option = option;
+        store->_snapshot_id = snapshot_id;
+        store->_mutation_count = mutation_count;
+        store->_arena = arena;
+        store->_arena_owner = owner;
+        std::vector<LabelEntity> entities(std::max<uint64_t>(option.max_elements, next_id));
+        for (uint64_t i = 0; i < next_id; ++i) {
+            read_value(in, entities[i].label);
+            read_value(in, entities[i].status);
+        }
+        store->_id_manager = std::make_unique<IdManager>();
+        auto rs = store->_id_manager->initialize(std::move(entities), reserved_id, next_id);
+        if (!rs.ok()) {
+            return rs;
+        }
+        uint64_t nbatch = 0;
+        if (!read_value(in, nbatch)) {
+            return turbo::data_loss_error("truncated store file:", path);
+        }
+        store->_vector_batches.reserve(nbatch);
+        for (uint64_t i = 0; i < nbatch; ++i) {
+            VectorBatch b;
+            rs = b.init(arena, owner, vs->vector_byte_size, option.batch_size);
+            if (!rs.ok()) {
+                return rs;
+            }
+            auto data = b.data();
+            if (!in.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(data.size()))) {
+                return turbo::data_loss_error("truncated store file:", path);
+            }
+            store->_vector_batches.push_back(std::move(b));
+        }
+        return store;
+    }
+
+    turbo::Status Serializer::save_tuning(const SearchTuning &tuning, const std::string &path) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            return turbo::unavailable_error("can not open tuning file:", path);
+        }
+        write_value(out, kTuningMagic);
+        write_value(out, kTuningVersion);
+        write_value(out, tuning.knob);
+        write_value(out, tuning.value);
+        write_value(out, tuning.k);
+        write_value(out, tuning.target_recall);
+        write_value(out, tuning.recall);
+        write_value(out, tuning.mutation_count);
+        write_value(out, tuning.size);
+        out.flush();
+        if (!out.good()) {
+            return turbo::data_loss_error("write tuning file failed:", path);
+        }
+        return turbo::OkStatus();
+    }
+
+    turbo::Result<SearchTuning> Serializer::load_tuning(const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            return turbo::not_found_error("can not open tuning file:", path);
+        }
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        if (!read_value(in, magic) || magic != kTuningMagic || !read_value(in, version) || version != kTuningVersion) {
+            return turbo::data_loss_error("bad tuning file header:", path);
+        }
+        SearchTuning tuning;
+        read_value(in, tuning.knob);
+        read_value(in, tuning.value);
+        read_value(in, tuning.k);
+        read_value(in, tuning.target_recall);
+        read_value(in, tuning.recall);
+        read_value(in, tuning.mutation_count);
+        if (!read_value(in, tuning.size)) {
+            return turbo::data_loss_error("truncated tuning file:", path);
+        }
+        return tuning;
+    }
+} // namespace xann
@@ -15,13 +15,45 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 //
 
+
 #pragma once
 
+#include <memory>
+#include <string>
+#include <turbo/utility/status.h>
+#include <xann/core/option.h>
+
 namespace xann {
+    class MemStore;
+    class BatchArena;
+    struct VectorSpace;
+
+    /// binary dump of a MemStore: option, id pool and raw batches.
+    /// the VectorSpace is not stored, the loader must pass the same one.
     class Serializer {
     public:
+        static constexpr uint32_t kStoreMagic = 0x584d5354;  // "XMST"
+        /// 2 adds the uint8 storage_scale after vector_byte_size, 1 still loads as scale 1.
+        /// 3 adds the mutation count after snapshot_id, older files load it as 0.
+        static constexpr uint32_t kStoreVersion = 3;
+        static constexpr uint32_t kTuningMagic = 0x58545554;  // "XTUT"
+        /// 2 keeps the store mutation count instead of the snapshot id, 1 is refused.
+        static constexpr uint32_t kTuningVersion = 2;
+
         Serializer() = default;
 
         virtual ~Serializer() = default;
+
+        /// caller holds at least a shared lock on store.mutex().
+        static turbo::Status save_store(const MemStore &store, const std::string &path);
+
+        /// arena may be nullptr, the loaded batches are charged to owner otherwise.
+        static turbo::Result<std::unique_ptr<MemStore> > load_store(const VectorSpace *vs, const std::string &path,
+                                                                   BatchArena *arena = nullptr, uint64_t owner = 0);
+
+        /// the SearchTuning of an index, kept beside the store dump since indexes are rebuilt on load.
+        static turbo::Status save_tuning(const SearchTuning &tuning, const std::string &path);
+
+        static turbo::Result<SearchTuning> load_tuning(const std::string &path);
     };
 } // namespace xann
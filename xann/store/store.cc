@@ -16,16 +16,53 @@
 //
 
 #include <xann/store/store.h>
+#include <xann/core/dtype_convert.h>
 
 namespace xann {
+    turbo::Result<std::unique_ptr<MemStore> > MemStore::create(const VectorSpace *vs, const VectorStoreOption &option) {
+        std::unique_ptr<MemStore> store(new MemStore());
+        auto rs = store->init(vs, option);
+        if (!rs.ok()) {
+            return rs;
+        }
+        return store;
+    }
+
     turbo::Status MemStore::init(const VectorSpace *vs, const VectorStoreOption &option) {
         _vector_space = vs;
         _option = option;
         _id_manager = std::make_unique<IdManager>();
-        std::vector<LabelEntity> v;
+        /// the id pool covers every lid ensure_space may hand out.
+        std::vector<LabelEntity> v(std::max<uint64_t>(_option.max_elements, _option.reserved + 1));
         return _id_manager->initialize(std::move(v), _option.reserved, _option.reserved + 1);
     }
 
+    void MemStore::record(uint64_t snapshot_id, MutationType type, uint64_t label, turbo::span<uint8_t> vector) {
+        ++_mutation_count;
+        if (_change_log) {
+            _change_log->append(snapshot_id, type, label, vector);
+        }
+    }
+
+    turbo::Result<uint64_t> MemStore::claim_id(uint64_t label, bool *revived) {
+        auto ers = _id_manager->label_entity(label);
+        *revived = ers.ok() && ers.value_or_die().status == kTombstone;
+        if (!*revived) {
+            return _id_manager->alloc_id(label);
+        }
+        auto lid = _id_manager->local_id(label).value_or_die();
+        _id_manager->set_local_id_status(lid, LabelEntity::kNoneStatus);
+        return lid;
+    }
+
+    void MemStore::release_id(uint64_t label, bool revived) {
+        if (revived) {
+            _id_manager->set_label_status(label, kTombstone);
+        } else {
+            _id_manager->free_id(label);
+        }
+    }
+
     const VectorSpace *MemStore::get_vector_space() const {
         return _vector_space;
     }
@@ -34,58 +71,194 @@ namespace xann {
         return _vector_batches;
     }
 
+    turbo::Status MemStore::check_vector(turbo::span<uint8_t> vector) const {
+        auto raw = static_cast<size_t>(_vector_space->dim) * _vector_space->element_size;
+        if (vector.size() != raw && vector.size() != static_cast<size_t>(_vector_space->vector_byte_size)) {
+            return turbo::invalid_argument_error("vector size:", vector.size(), " expect:", raw, " or ",
+                                                 _vector_space->vector_byte_size);
+        }
+        return turbo::OkStatus();
+    }
+
+    void MemStore::copy_vector(turbo::span<uint8_t> slot, turbo::span<uint8_t> vector, bool prepare) {
+        memcpy(slot.data(), vector.data(), vector.size());
+        /// the kernels run over the aligned dim, the padding must read as zero.
+        memset(slot.data() + vector.size(), 0, slot.size() - vector.size());
+        if (prepare && _vector_space->has_transform()) {
+            _vector_space->prepare_vector(slot);
+        }
+    }
+
     turbo::Result<uint64_t> MemStore::add_vector(uint64_t snapshot_id,uint64_t label, turbo::span<uint8_t> vector) {
-        auto rs = _id_manager->alloc_id(label);
+        auto crs = check_vector(vector);
+        if (!crs.ok()) {
+            return crs;
+        }
+        bool revived = false;
+        auto rs = claim_id(label, &revived);
         if (!rs.ok()) {
             return rs.status();
         }
         auto lid = rs.value_or_die();
         auto ers = ensure_space(lid);
         if (!ers.ok()) {
+            release_id(label, revived);
             return ers.status();
         }
         auto sp = ers.value_or_die();
         /// sp must not null, guard by ensure_space
-        memcpy(sp.data(), vector.data(), vector.size());
+        copy_vector(sp, vector);
         _snapshot_id = snapshot_id;
+        record(snapshot_id, MutationType::kAdd, label, vector);
         return lid;
     }
 
-    turbo::Result<uint64_t> MemStore::set_vector(uint64_t snapshot_id,uint64_t label, turbo::span<uint8_t> vector) {
-        auto rs = _id_manager->local_id(label);
+    turbo::Result<uint64_t> MemStore::add_float_vector(uint64_t snapshot_id, uint64_t label,
+                                                       turbo::span<uint8_t> vector) {
+        if (_vector_space->data_type == DataType::DT_FLOAT) {
+            return add_vector(snapshot_id, label, vector);
+        }
+        auto dim = static_cast<size_t>(_vector_space->dim);
+        if (vector.size() != dim * sizeof(float)) {
+            return turbo::invalid_argument_error("float vector size:", vector.size(), " expect:", dim * sizeof(float));
+        }
+        bool revived = false;
+        auto rs = claim_id(label, &revived);
         if (!rs.ok()) {
             return rs.status();
         }
         auto lid = rs.value_or_die();
+        auto ers = ensure_space(lid);
+        if (!ers.ok()) {
+            release_id(label, revived);
+            return ers.status();
+        }
+        auto sp = ers.value_or_die();
+        auto raw = dim * _vector_space->element_size;
+        auto crs = narrow_floats(reinterpret_cast<const float *>(vector.data()), dim, _vector_space->data_type,
+                                 sp.data(), _vector_space->storage_scale);
+        if (!crs.ok()) {
+            release_id(label, revived);
+            return crs;
+        }
+        memset(sp.data() + raw, 0, sp.size() - raw);
+        _snapshot_id = snapshot_id;
+        record(snapshot_id, MutationType::kAdd, label, sp.subspan(0, raw));
+        return lid;
+    }
+
+    turbo::Result<std::vector<uint64_t> > MemStore::add_float_vectors(uint64_t snapshot_id,
+                                                                      const std::vector<uint64_t> &labels,
+                                                                      turbo::span<uint8_t> vectors) {
+        auto stride = static_cast<size_t>(_vector_space->dim) * sizeof(float);
+        if (vectors.size() != labels.size() * stride) {
+            return turbo::invalid_argument_error("float vectors size:", vectors.size(), " expect:",
+                                                 labels.size() * stride);
+        }
+        std::vector<uint64_t> lids;
+        lids.reserve(labels.size());
+        for (size_t i = 0; i < labels.size(); ++i) {
+            auto rs = add_float_vector(snapshot_id, labels[i], vectors.subspan(i * stride, stride));
+            if (!rs.ok()) {
+                return rs.status();
+            }
+            lids.push_back(rs.value_or_die());
+        }
+        return lids;
+    }
+
+    turbo::Result<uint64_t> MemStore::add_prepared_vector(uint64_t snapshot_id, uint64_t label,
+                                                          turbo::span<uint8_t> vector) {
+        auto crs = check_vector(vector);
+        if (!crs.ok()) {
+            return crs;
+        }
+        uint64_t lid;
+        turbo::span<uint8_t> sp;
+        auto irs = _id_manager->local_id(label);
+        if (irs.ok()) {
+            lid = irs.value_or_die();
+            auto bi = lid / _option.batch_size;
+            if (bi >= _vector_batches.size()) {
+                return turbo::out_of_range_error("vector out of range, lid:", lid, " label:", label);
+            }
+            sp = _vector_batches[bi].at(lid % _option.batch_size);
+            _id_manager->set_local_id_status(lid, LabelEntity::kNoneStatus);
+        } else {
+            auto rs = _id_manager->alloc_id(label);
+            if (!rs.ok()) {
+                return rs.status();
+            }
+            lid = rs.value_or_die();
+            auto ers = ensure_space(lid);
+            if (!ers.ok()) {
+                _id_manager->free_id(label);
+                return ers.status();
+            }
+            sp = ers.value_or_die();
+        }
+        copy_vector(sp, vector, false);
+        _snapshot_id = snapshot_id;
+        record(snapshot_id, MutationType::kAddPrepared, label, vector);
+        return lid;
+    }
+
+    turbo::Result<uint64_t> MemStore::set_vector(uint64_t snapshot_id,uint64_t label, turbo::span<uint8_t> vector) {
+        auto crs = check_vector(vector);
+        if (!crs.ok()) {
+            return crs;
+        }
+        auto rs = _id_manager->label_entity(label);
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        if (rs.value_or_die().status == kTombstone) {
+            return turbo::not_found_error("label removed: ", label);
+        }
+        auto lid = _id_manager->local_id(label).value_or_die();
         auto bi = lid / _option.batch_size;
         auto si = lid % _option.batch_size;
+        if (bi >= _vector_batches.size()) {
+            return turbo::out_of_range_error("vector out of range, lid:", lid, " label:", label, " batch index:", bi);
+        }
         auto sp = _vector_batches[bi].at(si);
         if (sp.empty()) {
             return turbo::out_of_range_error("vector out of range, lid:", lid, " label:", label, " batch index:", si);
         }
-        memcpy(sp.data(), vector.data(), vector.size());
+        copy_vector(sp, vector);
         _snapshot_id = snapshot_id;
+        record(snapshot_id, MutationType::kSet, label, vector);
         return lid;
     }
 
     void MemStore::remove_vector_by_label(uint64_t snapshot_id, uint64_t label) {
         _id_manager->free_id(label);
         _snapshot_id = snapshot_id;
+        record(snapshot_id, MutationType::kRemove, label);
     }
 
     void MemStore::remove_vector_by_id(uint64_t snapshot_id,uint64_t id) {
+        auto rs = get_label(id);
         _id_manager->free_local_id(id);
         _snapshot_id = snapshot_id;
+        if (rs.ok() && rs.value_or_die() != IdManager::kInvalidId) {
+            record(snapshot_id, MutationType::kRemove, rs.value_or_die());
+        }
     }
 
     void MemStore::tombstone_vector_by_label(uint64_t snapshot_id,uint64_t label) {
         _id_manager->set_label_status(label, kTombstone);
         _snapshot_id = snapshot_id;
+        record(snapshot_id, MutationType::kTombstone, label);
     }
 
     void MemStore::tombstone_vector_by_id(uint64_t snapshot_id,uint64_t id) {
         _id_manager->set_local_id_status(id, kTombstone);
         _snapshot_id = snapshot_id;
+        auto rs = get_label(id);
+        if (rs.ok() && rs.value_or_die() != IdManager::kInvalidId) {
+            record(snapshot_id, MutationType::kTombstone, rs.value_or_die());
+        }
     }
 
     turbo::Result<uint64_t> MemStore::get_label(uint64_t id) const {
@@ -101,13 +274,19 @@ namespace xann {
     }
 
     turbo::Result<turbo::span<uint8_t> > MemStore::get_vector_by_label(uint64_t label) const {
-        auto rs = _id_manager->local_id(label);
+        auto rs = _id_manager->label_entity(label);
         if (!rs.ok()) {
             return rs.status();
         }
-        auto lid = rs.value_or_die();
+        if (rs.value_or_die().status == kTombstone) {
+            return turbo::not_found_error("label removed: ", label);
+        }
+        auto lid = _id_manager->local_id(label).value_or_die();
         auto bi = lid / _option.batch_size;
         auto si = lid % _option.batch_size;
+        if (bi >= _vector_batches.size()) {
+            return turbo::out_of_range_error("vector out of range, lid:", lid, " label:", label, " batch index:", bi);
+        }
         auto sp = _vector_batches[bi].at(si);
         if (sp.empty()) {
             return turbo::out_of_range_error("vector out of range, lid:", lid, " label:", label, " batch index:", si);
@@ -118,6 +297,9 @@ namespace xann {
     turbo::Result<turbo::span<uint8_t> > MemStore::get_vector_by_id(uint64_t lid) const {
         auto bi = lid / _option.batch_size;
         auto si = lid % _option.batch_size;
+        if (bi >= _vector_batches.size()) {
+            return turbo::out_of_range_error("vector out of range, lid:", lid, " batch index:", bi);
+        }
         auto sp = _vector_batches[bi].at(si);
         if (sp.empty()) {
             return turbo::out_of_range_error("vector out of range, lid:", lid, " batch index:", si);
@@ -137,6 +319,24 @@ namespace xann {
         return n * _vector_space->vector_byte_size * _option.batch_size;
     }
 
+    uint64_t MemStore::add_bytes(uint64_t label) const {
+        auto ers = _id_manager->label_entity(label);
+        if (ers.ok()) {
+            /// a tombstoned label is revived in its slot, a live one is refused.
+            return 0;
+        }
+        auto &free_ids = _id_manager->free_ids();
+        auto lid = free_ids.empty() ? _id_manager->next_id() : *free_ids.begin();
+        if (lid / _option.batch_size < _vector_batches.size()) {
+            return 0;
+        }
+        return static_cast<uint64_t>(_vector_space->vector_byte_size) * _option.batch_size;
+    }
+
+    uint64_t MemStore::id_pool_bytes() const {
+        return _id_manager->ids().size() * sizeof(LabelEntity);
+    }
+
     uint64_t MemStore::free_bytes() const {
         auto n = _id_manager->free_ids().size();
         return n * _vector_space->vector_byte_size ;
@@ -176,6 +376,19 @@ namespace xann {
         return lids;
     }
 
+    std::vector<uint64_t> MemStore::live_local_ids() const {
+        std::vector<uint64_t> lids;
+        auto &ids = _id_manager->ids();
+        auto end = std::min(ids.size(), static_cast<size_t>(_id_manager->next_id()));
+        lids.reserve(_id_manager->id_map().size());
+        for (auto i = _id_manager->reserved_id(); i < end; i++) {
+            if (ids[i].label != IdManager::kInvalidId && ids[i].status != kTombstone) {
+                lids.push_back(i);
+            }
+        }
+        return lids;
+    }
+
     std::vector<uint64_t> MemStore::tombstone_labels() const {
         std::vector<uint64_t> labels;
         auto &ids = _id_manager->ids();
@@ -197,7 +410,7 @@ namespace xann {
         auto diff = bi + 1 <= _vector_batches.size() ? 0 : bi + 1 - _vector_batches.size();
         for (auto i = 0; i < diff; i++) {
             VectorBatch b;
-            auto rs = b.init(_vector_space->vector_byte_size, _option.batch_size);
+            auto rs = b.init(_arena, _arena_owner, _vector_space->vector_byte_size, _option.batch_size);
             if (!rs.ok()) {
                 return rs;
             }
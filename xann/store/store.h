@@ -17,8 +17,10 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 #include <shared_mutex>
+#include <xann/store/change_log.h>
 #include <xann/store/vector_batch.h>
 #include <xann/store/id_manager.h>
 #include <xann/core/vector_space.h>
@@ -37,16 +39,61 @@ namespace xann {
 
         MemStore &operator=(const MemStore &) = delete;
 
+        ~MemStore() = default;
+
+        static turbo::Result<std::unique_ptr<MemStore> > create(const VectorSpace *vs, const VectorStoreOption &option);
+
         turbo::Status init(const VectorSpace *vs, const VectorStoreOption &option);
 
+        /// every successful mutation is appended to the log, nullptr to disable.
+        /// the log must outlive the store or be detached first.
+        void set_change_log(ChangeLog *log) {
+            _change_log = log;
+        }
+
+        [[nodiscard]] ChangeLog *change_log() const {
+            return _change_log;
+        }
+
+        /// take new batches from a shared arena charged to owner, nullptr for the system allocator.
+        /// batches already allocated keep their origin.
+        void set_batch_arena(BatchArena *arena, uint64_t owner) {
+            _arena = arena;
+            _arena_owner = owner;
+        }
+
         [[nodiscard]] const VectorSpace *get_vector_space() const;
 
         [[nodiscard]] const std::vector<VectorBatch> &vector_batch() const;
 
-        /// add vector
+        [[nodiscard]] const IdManager *id_manager() const {
+            return _id_manager.get();
+        }
+
+        [[nodiscard]] const VectorStoreOption &option() const {
+            return _option;
+        }
+
+        /// add vector. a label that is tombstoned but not freed yet, e.g. while
+        /// a graph index still routes through it, is made live again in its
+        /// own lid, so the index must take the lid like a fresh add.
         turbo::Result<uint64_t> add_vector(uint64_t snapshot_id, uint64_t label, turbo::span<uint8_t> vector);
 
-        /// modify vector
+        /// add a vector given as dim floats, converted in bulk straight into the
+        /// slot of a fp16, bf16 or uint8 store. uint8 stores round(x * scale)
+        /// saturated with the space's storage_scale. the change log records
+        /// the converted bytes.
+        turbo::Result<uint64_t> add_float_vector(uint64_t snapshot_id, uint64_t label, turbo::span<uint8_t> vector);
+
+        /// labels.size() float vectors back to back, stops at the first error.
+        turbo::Result<std::vector<uint64_t> > add_float_vectors(uint64_t snapshot_id, const std::vector<uint64_t> &labels,
+                                                                turbo::span<uint8_t> vectors);
+
+        /// add or overwrite with slot bytes that already went through
+        /// VectorSpace::prepare_vector(), for replicas of transformed spaces.
+        turbo::Result<uint64_t> add_prepared_vector(uint64_t snapshot_id, uint64_t label, turbo::span<uint8_t> vector);
+
+        /// modify vector, a tombstoned label is not found.
         turbo::Result<uint64_t> set_vector(uint64_t snapshot_id, uint64_t label, turbo::span<uint8_t> vector);
 
         void remove_vector_by_label(uint64_t snapshot_id, uint64_t label);
@@ -65,6 +112,20 @@ namespace xann {
 
         turbo::Result<turbo::span<uint8_t> > get_vector_by_id(uint64_t id) const;
 
+        /// unchecked fast path for scans, lid must be below id_manager()->next_id().
+        [[nodiscard]] turbo::span<uint8_t> vector_at(uint64_t lid) const {
+            return _vector_batches[lid / _option.batch_size].at(lid % _option.batch_size);
+        }
+
+        /// lid maps to a label and is not tombstoned.
+        [[nodiscard]] bool is_live(uint64_t lid) const {
+            auto &ids = _id_manager->ids();
+            return lid < ids.size() && ids[lid].label != IdManager::kInvalidId && ids[lid].status != kTombstone;
+        }
+
+        /// every live lid in ascending order.
+        [[nodiscard]] std::vector<uint64_t> live_local_ids() const;
+
         [[nodiscard]] uint64_t size() const;
 
         [[nodiscard]] uint64_t bytes_size() const;
@@ -73,6 +134,12 @@ namespace xann {
         ///
         uint64_t allocated_bytes() const;
 
+        /// arena bytes an add_vector of label would allocate now, one batch or 0.
+        [[nodiscard]] uint64_t add_bytes(uint64_t label) const;
+
+        /// the id pool, max_elements label entities allocated up front.
+        [[nodiscard]] uint64_t id_pool_bytes() const;
+
         uint64_t free_bytes() const;
 
         uint64_t allocated_vector_size() const;
@@ -93,12 +160,30 @@ namespace xann {
             return _snapshot_id;
         }
 
+        /// successful mutations of this store, saved with it. snapshot ids
+        /// may be shared by the stores of a collection, this count is not.
+        [[nodiscard]] uint64_t mutation_count() const {
+            return _mutation_count;
+        }
+
     private:
         turbo::Result<turbo::span<uint8_t> > ensure_space(uint64_t lid);
 
         MemStore() = default;
 
-        ~MemStore() = default;
+        /// the lid of a tombstoned label made live again, else a new lid.
+        turbo::Result<uint64_t> claim_id(uint64_t label, bool *revived);
+
+        /// undo claim_id() after a failed add.
+        void release_id(uint64_t label, bool revived);
+
+        /// dim * element_size or vector_byte_size bytes.
+        turbo::Status check_vector(turbo::span<uint8_t> vector) const;
+
+        /// prepare false copies bytes that are already transformed.
+        void copy_vector(turbo::span<uint8_t> slot, turbo::span<uint8_t> vector, bool prepare = true);
+
+        void record(uint64_t snapshot_id, MutationType type, uint64_t label, turbo::span<uint8_t> vector = {});
 
         friend class Serializer;
     private:
@@ -108,5 +193,9 @@ namespace xann {
         VectorStoreOption _option;
         mutable std::shared_mutex _mutex;
         uint64_t _snapshot_id{0};
+        uint64_t _mutation_count{0};
+        ChangeLog *_change_log{nullptr};
+        BatchArena *_arena{nullptr};
+        uint64_t _arena_owner{0};
     };
 } // namespace xann
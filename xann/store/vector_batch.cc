@@ -16,12 +16,17 @@
 //
 
 #include <xann/store/vector_batch.h>
+#include <xann/store/batch_arena.h>
 #include <xann/core/vector_space.h>
 #include <xsimd/memory/xsimd_aligned_allocator.hpp>
 
 namespace xann {
 
     VectorBatch::~VectorBatch() {
+        if (_data && _arena) {
+            _arena->release(_data, _capacity * _vector_byte_size, _owner);
+            _data = nullptr;
+        }
         if (_data) {
             xsimd::aligned_allocator<uint8_t, VectorSpace::kAlignmentBytes> allocator;
             allocator.deallocate(_data, _capacity * _vector_byte_size);
@@ -29,11 +34,32 @@ namespace xann {
         }
     }
 
+    VectorBatch::VectorBatch(VectorBatch &&other) noexcept
+        : _vector_byte_size(other._vector_byte_size), _capacity(other._capacity), _data(other._data),
+          _arena(other._arena), _owner(other._owner) {
+        other._vector_byte_size = 0;
+        other._capacity = 0;
+        other._data = nullptr;
+        other._arena = nullptr;
+    }
+
+    VectorBatch &VectorBatch::operator=(VectorBatch &&other) noexcept {
+        if (this != &other) {
+            std::swap(_vector_byte_size, other._vector_byte_size);
+            std::swap(_capacity, other._capacity);
+            std::swap(_data, other._data);
+            std::swap(_arena, other._arena);
+            std::swap(_owner, other._owner);
+        }
+        return *this;
+    }
+
     [[nodiscard]] turbo::Status VectorBatch::init(std::size_t vector_byte_size, std::size_t n) {
 
         try {
             xsimd::aligned_allocator<uint8_t, VectorSpace::kAlignmentBytes> allocator;
             _data = allocator.allocate(vector_byte_size * n );
+            _vector_byte_size = vector_byte_size;
             _capacity = n;
         } catch (std::exception& e) {
             return turbo::unavailable_error(e.what());
@@ -41,6 +67,23 @@ namespace xann {
         return turbo::OkStatus();
     }
 
+    [[nodiscard]] turbo::Status VectorBatch::init(BatchArena *arena, uint64_t owner, std::size_t vector_byte_size,
+                                                  std::size_t n) {
+        if (!arena) {
+            return init(vector_byte_size, n);
+        }
+        auto rs = arena->allocate(vector_byte_size * n, owner);
+        if (!rs.ok()) {
+            return rs.status();
+        }
+        _data = rs.value_or_die();
+        _vector_byte_size = vector_byte_size;
+        _capacity = n;
+        _arena = arena;
+        _owner = owner;
+        return turbo::OkStatus();
+    }
+
     [[nodiscard]] turbo::span<uint8_t> VectorBatch::at(size_t index) const {
         if (index >= _capacity) {
             return turbo::span<uint8_t>{};
@@ -22,6 +22,8 @@
 #include <turbo/utility/status.h>
 
 namespace xann {
+    class BatchArena;
+
     class VectorBatch {
     public:
         VectorBatch() = default;
@@ -32,8 +34,9 @@ namespace xann {
 
         VectorBatch &operator=(const VectorBatch &other) = delete;
 
-        VectorBatch(VectorBatch &&other)  = default;
-        VectorBatch &operator=(VectorBatch &&other) = default;
+        VectorBatch(VectorBatch &&other) noexcept;
+
+        VectorBatch &operator=(VectorBatch &&other) noexcept;
 
         [[nodiscard]] size_t capacity() const {
             return _capacity;
@@ -41,6 +44,9 @@ namespace xann {
 
         [[nodiscard]] turbo::Status init(std::size_t vector_byte_size, std::size_t n);
 
+        /// take the chunk from a shared arena, charged to owner, and give it back on destruction.
+        [[nodiscard]] turbo::Status init(BatchArena *arena, uint64_t owner, std::size_t vector_byte_size, std::size_t n);
+
         [[nodiscard]] turbo::span<uint8_t> at(size_t index) const;
 
         void clear(size_t index);
@@ -58,5 +64,7 @@ namespace xann {
         uint64_t _vector_byte_size{0};
         uint64_t _capacity{0};
         uint8_t *_data{nullptr};
+        BatchArena *_arena{nullptr};
+        uint64_t _owner{0};
     };
 } // namespace xann